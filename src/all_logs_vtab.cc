@@ -68,15 +68,32 @@ void
 all_logs_vtab::extract(std::shared_ptr<logfile> lf,
                        uint64_t line_number,
                        shared_buffer_ref& line,
+                       const column_usage& cu,
                        std::vector<logline_value>& values)
 {
     auto format = lf->get_format();
     values.emplace_back(this->alv_value_meta, format->get_name());
 
-    std::vector<logline_value> sub_values;
-
     this->vi_attrs.clear();
-    format->annotate(line_number, line, this->vi_attrs, sub_values, false);
+
+    auto msg_used = cu.is_value_used(this->alv_msg_meta.lvm_column)
+        || cu.is_value_used(this->alv_schema_meta.lvm_column);
+
+    // The attributes from annotate() are only needed to find the body of the
+    // message and the original timestamp.
+    if (!msg_used && !cu.is_used(this->get_body_column())
+        && !cu.is_used(VT_COL_LOG_ACTUAL_TIME))
+    {
+        return;
+    }
+
+    this->alv_sub_values.clear();
+    format->annotate(
+        line_number, line, this->vi_attrs, this->alv_sub_values, false);
+
+    if (!msg_used) {
+        return;
+    }
 
     auto body = find_string_attr_range(this->vi_attrs, &SA_BODY);
     if (body.lr_start == -1) {
@@ -86,14 +103,17 @@ all_logs_vtab::extract(std::shared_ptr<logfile> lf,
 
     data_scanner ds(line, body.lr_start, body.lr_end);
     data_parser dp(&ds);
-    std::string str;
 
-    dp.dp_msg_format = &str;
+    this->alv_msg_manager.invalidate_refs();
+    this->alv_msg_format.clear();
+    dp.dp_msg_format = &this->alv_msg_format;
     dp.parse();
 
-    tmp_shared_buffer tsb(str.c_str());
-
-    values.emplace_back(this->alv_msg_meta, tsb.tsb_ref);
+    shared_buffer_ref msg_ref;
+    msg_ref.share(this->alv_msg_manager,
+                  (char*) this->alv_msg_format.c_str(),
+                  this->alv_msg_format.length());
+    values.emplace_back(this->alv_msg_meta, msg_ref);
 
     this->alv_schema_manager.invalidate_refs();
     this->alv_schema_buffer.clear();
@@ -49,6 +49,7 @@ public:
     void extract(std::shared_ptr<logfile> lf,
                  uint64_t line_number,
                  shared_buffer_ref& line,
+                 const column_usage& cu,
                  std::vector<logline_value>& values) override;
 
     bool is_valid(log_cursor& lc, logfile_sub_source& lss) override;
@@ -59,6 +60,9 @@ private:
     logline_value_meta alv_value_meta;
     logline_value_meta alv_msg_meta;
     logline_value_meta alv_schema_meta;
+    std::vector<logline_value> alv_sub_values;
+    shared_buffer alv_msg_manager;
+    std::string alv_msg_format;
     shared_buffer alv_schema_manager;
     fmt::basic_memory_buffer<char, data_parser::schema_id_t::STRING_SIZE>
         alv_schema_buffer;
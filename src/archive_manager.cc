@@ -29,6 +29,12 @@
  * @file archive_manager.cc
  */
 
+#include <atomic>
+#include <future>
+#include <list>
+#include <mutex>
+#include <thread>
+
 #include <unistd.h>
 
 #include "config.h"
@@ -140,7 +146,25 @@ is_archive(const fs::path& filename)
             log_debug("read next done %s", filename.c_str());
 
             static const auto RAW_FORMAT_NAME = string_fragment("raw");
-            static const auto GZ_FILTER_NAME = string_fragment("gzip");
+            /*
+             * Compressed files that the line_buffer can decode itself are
+             * read directly instead of being unpacked.
+             */
+            static const string_fragment NATIVE_FILTER_NAMES[] = {
+                string_fragment("gzip"),
+#ifdef HAVE_BZLIB_H
+                string_fragment("bzip2"),
+#endif
+#ifdef HAVE_ZSTD_H
+                string_fragment("zstd"),
+#endif
+#ifdef HAVE_LZMA_H
+                string_fragment("xz"),
+#endif
+#ifdef HAVE_LZ4FRAME_H
+                string_fragment("lz4"),
+#endif
+            };
 
             format_name = archive_format_name(arc);
 
@@ -152,8 +176,12 @@ is_archive(const fs::path& filename)
                 }
 
                 const auto* first_filter_name = archive_filter_name(arc, 0);
-                if (filter_count == 2 && GZ_FILTER_NAME == first_filter_name) {
-                    return false;
+                if (filter_count == 2) {
+                    for (const auto& native_name : NATIVE_FILTER_NAMES) {
+                        if (native_name == first_filter_name) {
+                            return false;
+                        }
+                    }
                 }
             }
             log_info(
@@ -204,6 +232,35 @@ filename_to_tmp_path(const std::string& filename)
 }
 
 #if HAVE_ARCHIVE_H
+/**
+ * Check that unpacking more data would not go below the minimum amount of
+ * free space.
+ *
+ * @param space_path A path on the disk where the data is being written.
+ * @param entry_path The path of the entry being unpacked, for the error.
+ */
+static walk_result_t
+check_free_space(const fs::path& space_path, const fs::path& entry_path)
+{
+    const auto& cfg = injector::get<const config&>();
+    auto tmp_space = fs::space(space_path);
+
+    if (tmp_space.available < static_cast<uintmax_t>(cfg.amc_min_free_space)) {
+        return Err(fmt::format(
+            FMT_STRING("available space on disk ({}) is below the "
+                       "minimum-free threshold ({}).  Unable to unpack "
+                       "'{}' to '{}'"),
+            humanize::file_size(tmp_space.available,
+                                humanize::alignment::none),
+            humanize::file_size(cfg.amc_min_free_space,
+                                humanize::alignment::none),
+            entry_path.filename().string(),
+            entry_path.parent_path().string()));
+    }
+
+    return Ok();
+}
+
 static walk_result_t
 copy_data(const std::string& filename,
           struct archive* ar,
@@ -219,21 +276,7 @@ copy_data(const std::string& filename,
 
     for (;;) {
         if (total >= next_space_check) {
-            const auto& cfg = injector::get<const config&>();
-            auto tmp_space = fs::space(entry_path);
-
-            if (tmp_space.available < cfg.amc_min_free_space) {
-                return Err(fmt::format(
-                    FMT_STRING("available space on disk ({}) is below the "
-                               "minimum-free threshold ({}).  Unable to unpack "
-                               "'{}' to '{}'"),
-                    humanize::file_size(tmp_space.available,
-                                        humanize::alignment::none),
-                    humanize::file_size(cfg.amc_min_free_space,
-                                        humanize::alignment::none),
-                    entry_path.filename().string(),
-                    entry_path.parent_path().string()));
-            }
+            TRY(check_free_space(entry_path, entry_path));
             next_space_check += 1024 * 1024;
         }
 
@@ -379,6 +422,270 @@ extract(const std::string& filename, const extract_cb& cb)
 
     return Ok();
 }
+
+static size_t
+stream_thread_count()
+{
+    return std::max(1U, std::min(std::thread::hardware_concurrency(), 8U));
+}
+
+/**
+ * The threads that are streaming archives.  The threads are stopped and
+ * joined when lnav exits instead of being left to run past the point where
+ * the rest of the program has been torn down.
+ */
+struct stream_threads {
+    ~stream_threads() { this->stop(); }
+
+    void start(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lg(this->st_mutex);
+
+        this->st_threads.remove_if([](const auto& fut) {
+            return fut.wait_for(std::chrono::seconds(0))
+                == std::future_status::ready;
+        });
+        this->st_threads.emplace_back(
+            std::async(std::launch::async, std::move(task)));
+    }
+
+    void stop()
+    {
+        std::list<std::future<void>> threads;
+
+        this->st_stopped = true;
+        {
+            std::lock_guard<std::mutex> lg(this->st_mutex);
+
+            threads = std::move(this->st_threads);
+        }
+        for (auto& fut : threads) {
+            fut.wait();
+        }
+    }
+
+    std::atomic<bool> st_stopped{false};
+    std::mutex st_mutex;
+    std::list<std::future<void>> st_threads;
+};
+
+static stream_threads&
+get_stream_threads()
+{
+    static stream_threads retval;
+
+    return retval;
+}
+
+static walk_result_t
+open_archive(const std::string& filename, auto_mem<archive>& arc)
+{
+    arc = archive_read_new();
+    enable_desired_archive_formats(arc);
+    archive_read_support_format_raw(arc);
+    archive_read_support_filter_all(arc);
+    if (archive_read_open_filename(arc, filename.c_str(), 128 * 1024)
+        != ARCHIVE_OK)
+    {
+        return Err(fmt::format(FMT_STRING("unable to open archive: {} -- {}"),
+                               filename,
+                               archive_error_string(arc)));
+    }
+
+    return Ok();
+}
+
+/**
+ * Create a temporary file for an archive member that is only reachable
+ * through the returned descriptors, so the space is released once they are
+ * closed.
+ *
+ * @return The descriptors for writing and reading the file.
+ */
+static Result<std::pair<auto_fd, auto_fd>, std::string>
+open_member_file()
+{
+    auto tmp_pair = TRY(lnav::filesystem::open_temp_file(archive_cache_path()
+                                                         / "member.XXXXXX"));
+    auto read_fd = auto_fd(lnav::filesystem::openp(tmp_pair.first, O_RDONLY));
+    auto errnum = errno;
+    std::error_code ec;
+
+    fs::remove(tmp_pair.first, ec);
+    if (read_fd == -1) {
+        return Err(
+            fmt::format(FMT_STRING("unable to open temporary file: {} -- {}"),
+                        tmp_pair.first.string(),
+                        strerror(errnum)));
+    }
+    tmp_pair.second.close_on_exec();
+    read_fd.close_on_exec();
+
+    return Ok(std::make_pair(std::move(tmp_pair.second), std::move(read_fd)));
+}
+
+static walk_result_t
+write_data(const std::string& filename,
+           struct archive* ar,
+           struct archive_entry* entry,
+           int fd,
+           const fs::path& entry_path,
+           struct extract_progress* ep)
+{
+    const void* buff;
+    size_t size, total = 0, next_space_check = 0;
+    la_int64_t offset;
+
+    for (;;) {
+        if (get_stream_threads().st_stopped) {
+            return Err(std::string("streaming was stopped"));
+        }
+        if (total >= next_space_check) {
+            TRY(check_free_space(archive_cache_path(), entry_path));
+            next_space_check += 1024 * 1024;
+        }
+
+        auto r = archive_read_data_block(ar, &buff, &size, &offset);
+        if (r == ARCHIVE_EOF) {
+            return Ok();
+        }
+        if (r != ARCHIVE_OK) {
+            return Err(fmt::format(
+                FMT_STRING("failed to extract '{}' from archive '{}' -- {}"),
+                archive_entry_pathname_utf8(entry),
+                filename,
+                archive_error_string(ar)));
+        }
+
+        const auto* data = (const char*) buff;
+        size_t written = 0;
+
+        while (written < size) {
+            auto rc = pwrite(
+                fd, &data[written], size - written, offset + written);
+
+            if (rc < 0 && errno == EINTR) {
+                continue;
+            }
+            if (rc < 0) {
+                return Err(
+                    fmt::format(FMT_STRING("failed to write file: {} -- {}"),
+                                entry_path.string(),
+                                strerror(errno)));
+            }
+            written += rc;
+        }
+
+        total += size;
+        ep->ep_out_size.fetch_add(size);
+    }
+}
+
+/**
+ * Create the temporary file for an archive member, pass it to the callback,
+ * and then decompress the member's data into it.
+ */
+static walk_result_t
+stream_member(const std::string& filename,
+              struct archive* ar,
+              struct archive_entry* entry,
+              const fs::path& member_path,
+              const fs::path& entry_path,
+              struct extract_progress* ep,
+              const stream_cb& member_cb)
+{
+    auto fds = TRY(open_member_file());
+    auto size = archive_entry_size_is_set(entry) ? archive_entry_size(entry)
+                                                 : -1;
+    streamed_member sm{member_path, size, std::move(fds.second)};
+
+    member_cb(sm);
+    if (size == 0) {
+        return Ok();
+    }
+
+    return write_data(filename, ar, entry, fds.first, entry_path, ep);
+}
+
+struct member_entry {
+    size_t me_index;
+    fs::path me_path;
+};
+
+/**
+ * Decompress the given members of a zip file with several readers at once.
+ * The members are dealt out to the readers in turn and each reader skips
+ * over the entries that belong to the others.
+ */
+static walk_result_t
+stream_in_parallel(const std::string& filename,
+                   const fs::path& tmp_path,
+                   const std::vector<member_entry>& members,
+                   struct extract_progress* ep,
+                   const stream_cb& member_cb)
+{
+    auto reader_count = std::min(stream_thread_count(), members.size());
+    std::vector<std::future<walk_result_t>> readers;
+
+    for (size_t reader = 0; reader < reader_count; reader++) {
+        readers.emplace_back(std::async(
+            std::launch::async,
+            [&filename,
+             &tmp_path,
+             &members,
+             &member_cb,
+             ep,
+             reader,
+             reader_count]() -> walk_result_t {
+                auto_mem<archive> arc(archive_free);
+
+                TRY(open_archive(filename, arc));
+                for (size_t index = 0, next = reader; next < members.size();
+                     index++)
+                {
+                    struct archive_entry* entry = nullptr;
+                    auto r = archive_read_next_header(arc, &entry);
+                    if (r != ARCHIVE_OK) {
+                        return Err(fmt::format(
+                            FMT_STRING("unable to read entry header: {} -- {}"),
+                            filename,
+                            archive_error_string(arc)));
+                    }
+                    if (index != members[next].me_index) {
+                        continue;
+                    }
+
+                    const auto& me = members[next];
+
+                    TRY(stream_member(filename,
+                                      arc,
+                                      entry,
+                                      me.me_path,
+                                      tmp_path / me.me_path,
+                                      ep,
+                                      member_cb));
+                    next += reader_count;
+                }
+                archive_read_close(arc);
+
+                return Ok();
+            }));
+    }
+
+    nonstd::optional<std::string> first_error;
+    for (auto& reader : readers) {
+        auto res = reader.get();
+
+        if (res.isErr() && !first_error) {
+            first_error = res.unwrapErr();
+        }
+    }
+    if (first_error) {
+        return Err(first_error.value());
+    }
+
+    return Ok();
+}
 #endif
 
 walk_result_t
@@ -411,6 +718,107 @@ walk_archive_files(
 #endif
 }
 
+walk_result_t
+stream_archive_files(const std::string& filename,
+                     const extract_cb& cb,
+                     const stream_cb& member_cb)
+{
+#if HAVE_ARCHIVE_H
+    auto tmp_path = filename_to_tmp_path(filename);
+    std::error_code ec;
+
+    fs::create_directories(archive_cache_path(), ec);
+    if (ec) {
+        return Err(fmt::format("unable to create directory: {} -- {}",
+                               archive_cache_path().string(),
+                               ec.message()));
+    }
+
+    auto_mem<archive> arc(archive_free);
+    std::vector<member_entry> deferred;
+    ssize_t deferred_size = 0;
+
+    TRY(open_archive(filename, arc));
+    log_info("streaming members of %s", filename.c_str());
+    for (size_t index = 0;; index++) {
+        if (get_stream_threads().st_stopped) {
+            return Err(std::string("streaming was stopped"));
+        }
+
+        struct archive_entry* entry = nullptr;
+        auto r = archive_read_next_header(arc, &entry);
+        if (r == ARCHIVE_EOF) {
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            return Err(
+                fmt::format(FMT_STRING("unable to read entry header: {} -- {}"),
+                            filename,
+                            archive_error_string(arc)));
+        }
+        if (archive_entry_filetype(entry) != AE_IFREG) {
+            continue;
+        }
+
+        auto member_path = fs::path(archive_entry_pathname(entry));
+        if (strcmp(archive_format_name(arc), "raw") == 0
+            && archive_filter_count(arc) >= 2)
+        {
+            member_path = fs::path(filename).filename();
+        }
+
+        // The entries in a zip file come from its central directory and
+        // skipping over the data for an entry is just a seek, so the
+        // members are decompressed afterward by several readers at once.
+        if ((archive_format(arc) & ARCHIVE_FORMAT_BASE_MASK)
+            == ARCHIVE_FORMAT_ZIP)
+        {
+            deferred.emplace_back(member_entry{index, member_path});
+            if (archive_entry_size_is_set(entry)) {
+                deferred_size += archive_entry_size(entry);
+            }
+            continue;
+        }
+
+        auto entry_path = tmp_path / member_path;
+        auto* prog = cb(
+            entry_path,
+            archive_entry_size_is_set(entry) ? archive_entry_size(entry) : -1);
+
+        TRY(stream_member(
+            filename, arc, entry, member_path, entry_path, prog, member_cb));
+    }
+    archive_read_close(arc);
+
+    if (!deferred.empty()) {
+        auto* prog = cb(tmp_path, deferred_size);
+
+        TRY(stream_in_parallel(filename, tmp_path, deferred, prog, member_cb));
+    }
+    log_info("finished streaming members of %s", filename.c_str());
+
+    return Ok();
+#else
+    return Err(std::string("not compiled with libarchive"));
+#endif
+}
+
+void
+start_streaming(std::function<void()> task)
+{
+#if HAVE_ARCHIVE_H
+    get_stream_threads().start(std::move(task));
+#endif
+}
+
+void
+stop_streaming()
+{
+#if HAVE_ARCHIVE_H
+    get_stream_threads().stop();
+#endif
+}
+
 void
 cleanup_cache()
 {
@@ -37,6 +37,7 @@
 #include <string>
 #include <utility>
 
+#include "base/auto_fd.hh"
 #include "base/result.h"
 #include "ghc/filesystem.hpp"
 
@@ -76,6 +77,54 @@ walk_result_t walk_archive_files(
     const std::function<void(const ghc::filesystem::path&,
                              const ghc::filesystem::directory_entry&)>&);
 
+/**
+ * A member of an archive that is being decompressed into a temporary file.
+ */
+struct streamed_member {
+    /** The path of the member in the archive. */
+    ghc::filesystem::path sm_path;
+    /** The size of the member or -1 if the archive does not record it. */
+    ssize_t sm_size;
+    /** A descriptor for reading the temporary file. */
+    auto_fd sm_fd;
+};
+
+using stream_cb = std::function<void(streamed_member&)>;
+
+/**
+ * Decompress the members of an archive into temporary files that are
+ * removed once they are closed, instead of unpacking the archive into the
+ * cache directory.  The callback is called for each member as soon as its
+ * file is created, so the member can be read while it is still being
+ * decompressed.  The members of a zip file are decompressed by several
+ * threads at once, so the callback must be thread-safe.
+ *
+ * Every member is still written out in full, so this takes the same amount
+ * of disk space as unpacking the archive while the files are open, and
+ * members are always decompressed from the start.
+ *
+ * @param filename The path to the archive.
+ * @param cb The callback used to report progress.
+ * @param member_cb The callback for each member.
+ * @return An error if the archive could not be read or if there is not
+ *   enough space left on the disk.
+ */
+walk_result_t stream_archive_files(const std::string& filename,
+                                   const extract_cb& cb,
+                                   const stream_cb& member_cb);
+
+/**
+ * Run a task that streams an archive on a thread owned by the archive
+ * manager.
+ */
+void start_streaming(std::function<void()> task);
+
+/**
+ * Stop streaming any archives that are still being read and wait for their
+ * threads to exit.
+ */
+void stop_streaming();
+
 void cleanup_cache();
 
 }  // namespace archive_manager
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file compressed_bitmap.cc
+ */
+
+#include <algorithm>
+
+#include "compressed_bitmap.hh"
+
+#include "config.h"
+
+bool
+compressed_bitmap::test(size_t pos) const
+{
+    auto chunk_index = pos / CHUNK_BITS;
+
+    if (chunk_index >= this->cb_chunks.size()) {
+        return false;
+    }
+
+    const auto& ch = this->cb_chunks[chunk_index];
+    auto offset = pos % CHUNK_BITS;
+
+    if (!ch.c_words.empty()) {
+        return (ch.c_words[offset / 64] >> (offset % 64)) & 1;
+    }
+
+    return std::binary_search(
+        ch.c_array.begin(), ch.c_array.end(), (uint16_t) offset);
+}
+
+void
+compressed_bitmap::set(size_t pos)
+{
+    auto chunk_index = pos / CHUNK_BITS;
+
+    if (chunk_index >= this->cb_chunks.size()) {
+        this->cb_chunks.resize(chunk_index + 1);
+    }
+
+    auto& ch = this->cb_chunks[chunk_index];
+    auto offset = (uint16_t) (pos % CHUNK_BITS);
+
+    if (!ch.c_words.empty()) {
+        ch.c_words[offset / 64] |= 1ULL << (offset % 64);
+        return;
+    }
+
+    /* Bits are usually set in order, so check the end of the array first. */
+    if (ch.c_array.empty() || ch.c_array.back() < offset) {
+        ch.c_array.push_back(offset);
+    } else {
+        auto iter = std::lower_bound(ch.c_array.begin(), ch.c_array.end(), offset);
+
+        if (*iter == offset) {
+            return;
+        }
+        ch.c_array.insert(iter, offset);
+    }
+
+    if (ch.c_array.size() > MAX_ARRAY_SIZE) {
+        ch.c_words.resize(CHUNK_WORDS);
+        for (auto bit : ch.c_array) {
+            ch.c_words[bit / 64] |= 1ULL << (bit % 64);
+        }
+        ch.c_array.clear();
+        ch.c_array.shrink_to_fit();
+    }
+}
+
+void
+compressed_bitmap::reset(size_t pos)
+{
+    auto chunk_index = pos / CHUNK_BITS;
+
+    if (chunk_index >= this->cb_chunks.size()) {
+        return;
+    }
+
+    auto& ch = this->cb_chunks[chunk_index];
+    auto offset = (uint16_t) (pos % CHUNK_BITS);
+
+    if (!ch.c_words.empty()) {
+        ch.c_words[offset / 64] &= ~(1ULL << (offset % 64));
+        return;
+    }
+
+    auto iter = std::lower_bound(ch.c_array.begin(), ch.c_array.end(), offset);
+
+    if (iter != ch.c_array.end() && *iter == offset) {
+        ch.c_array.erase(iter);
+    }
+}
+
+void
+compressed_bitmap::truncate(size_t size)
+{
+    auto chunk_count = (size + CHUNK_BITS - 1) / CHUNK_BITS;
+
+    if (chunk_count < this->cb_chunks.size()) {
+        this->cb_chunks.resize(chunk_count);
+    }
+    if (this->cb_chunks.size() < chunk_count || (size % CHUNK_BITS) == 0) {
+        return;
+    }
+
+    auto& ch = this->cb_chunks.back();
+    auto offset = size % CHUNK_BITS;
+
+    if (!ch.c_words.empty()) {
+        if (offset % 64) {
+            ch.c_words[offset / 64] &= (1ULL << (offset % 64)) - 1;
+        }
+        std::fill(ch.c_words.begin() + (offset + 63) / 64, ch.c_words.end(), 0);
+    } else {
+        ch.c_array.erase(std::lower_bound(
+                             ch.c_array.begin(), ch.c_array.end(), offset),
+                         ch.c_array.end());
+    }
+}
+
+size_t
+compressed_bitmap::count() const
+{
+    size_t retval = 0;
+
+    for (const auto& ch : this->cb_chunks) {
+        if (ch.c_words.empty()) {
+            retval += ch.c_array.size();
+            continue;
+        }
+        for (auto word : ch.c_words) {
+            retval += __builtin_popcountll(word);
+        }
+    }
+
+    return retval;
+}
+
+size_t
+compressed_bitmap::memory_size() const
+{
+    size_t retval = sizeof(*this)
+        + this->cb_chunks.capacity() * sizeof(chunk);
+
+    for (const auto& ch : this->cb_chunks) {
+        retval += ch.c_array.capacity() * sizeof(uint16_t);
+        retval += ch.c_words.capacity() * sizeof(uint64_t);
+    }
+
+    return retval;
+}
+
+void
+compressed_bitmap::or_into(std::vector<uint64_t>& words) const
+{
+    for (size_t chunk_index = 0; chunk_index < this->cb_chunks.size();
+         chunk_index++)
+    {
+        const auto& ch = this->cb_chunks[chunk_index];
+        auto word_base = chunk_index * CHUNK_WORDS;
+
+        if (word_base >= words.size()) {
+            break;
+        }
+        if (!ch.c_words.empty()) {
+            auto word_count = std::min(CHUNK_WORDS, words.size() - word_base);
+
+            for (size_t lpc = 0; lpc < word_count; lpc++) {
+                words[word_base + lpc] |= ch.c_words[lpc];
+            }
+            continue;
+        }
+        for (auto bit : ch.c_array) {
+            auto word_index = word_base + bit / 64;
+
+            if (word_index >= words.size()) {
+                break;
+            }
+            words[word_index] |= 1ULL << (bit % 64);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file compressed_bitmap.hh
+ */
+
+#ifndef lnav_compressed_bitmap_hh
+#define lnav_compressed_bitmap_hh
+
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * A bitmap that is split into chunks of 64K bits that are stored in a form
+ * that suits how many bits are set in the chunk, like a roaring bitmap.  A
+ * chunk with no bits set takes no space, a sparse chunk is a sorted array of
+ * the offsets of the set bits, and a dense chunk is a plain array of words.
+ */
+class compressed_bitmap {
+public:
+    static constexpr size_t CHUNK_BITS = 64 * 1024;
+    static constexpr size_t CHUNK_WORDS = CHUNK_BITS / 64;
+
+    /**
+     * The number of set bits in a chunk at which the chunk is converted from
+     * an array of offsets to an array of words, the point where they take up
+     * the same amount of space.
+     */
+    static constexpr size_t MAX_ARRAY_SIZE = CHUNK_WORDS * 4;
+
+    bool test(size_t pos) const;
+
+    void set(size_t pos);
+
+    void reset(size_t pos);
+
+    void assign(size_t pos, bool value)
+    {
+        if (value) {
+            this->set(pos);
+        } else {
+            this->reset(pos);
+        }
+    }
+
+    /**
+     * Clear all of the bits at or after the given position.
+     */
+    void truncate(size_t size);
+
+    void clear() { this->cb_chunks.clear(); }
+
+    /**
+     * @return The number of bits that are set.
+     */
+    size_t count() const;
+
+    /**
+     * @return The number of bytes used to store the bitmap.
+     */
+    size_t memory_size() const;
+
+    /**
+     * OR the bits in this bitmap into an array of words, where bit N is
+     * stored in word N / 64.  Bits past the end of the array are ignored.
+     *
+     * @param words The words to update.
+     */
+    void or_into(std::vector<uint64_t>& words) const;
+
+private:
+    struct chunk {
+        /** The offsets of the set bits, if the chunk is sparse. */
+        std::vector<uint16_t> c_array;
+        /** The bits, if the chunk is dense. */
+        std::vector<uint64_t> c_words;
+    };
+
+    std::vector<chunk> cb_chunks;
+};
+
+#endif
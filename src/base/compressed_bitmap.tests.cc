@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "base/compressed_bitmap.hh"
+#include "config.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("compressed_bitmap::sparse")
+{
+    compressed_bitmap cb;
+
+    CHECK(cb.count() == 0);
+    CHECK_FALSE(cb.test(10));
+
+    cb.set(10);
+    cb.set(5);
+    cb.set(200000);
+    cb.set(10);
+    CHECK(cb.count() == 3);
+    CHECK(cb.test(5));
+    CHECK(cb.test(10));
+    CHECK(cb.test(200000));
+    CHECK_FALSE(cb.test(11));
+    CHECK_FALSE(cb.test(199999));
+
+    cb.reset(5);
+    CHECK_FALSE(cb.test(5));
+    CHECK(cb.count() == 2);
+
+    std::vector<uint64_t> words(3, 0);
+
+    cb.or_into(words);
+    CHECK(words[0] == (1ULL << 10));
+    CHECK(words[1] == 0);
+
+    cb.truncate(100000);
+    CHECK(cb.count() == 1);
+    CHECK_FALSE(cb.test(200000));
+}
+
+TEST_CASE("compressed_bitmap::dense")
+{
+    compressed_bitmap cb;
+    auto size = compressed_bitmap::CHUNK_BITS + 100;
+
+    for (size_t lpc = 0; lpc < size; lpc += 2) {
+        cb.assign(lpc, true);
+        cb.assign(lpc + 1, false);
+    }
+    CHECK(cb.count() == size / 2);
+    CHECK(cb.test(0));
+    CHECK_FALSE(cb.test(1));
+    CHECK(cb.test(compressed_bitmap::CHUNK_BITS - 2));
+    CHECK(cb.test(compressed_bitmap::CHUNK_BITS + 98));
+
+    std::vector<uint64_t> words((size + 63) / 64, 0);
+
+    cb.or_into(words);
+    CHECK(words[0] == 0x5555555555555555ULL);
+    CHECK(words[compressed_bitmap::CHUNK_WORDS - 1] == 0x5555555555555555ULL);
+
+    cb.truncate(101);
+    CHECK(cb.count() == 51);
+    CHECK(cb.test(100));
+    CHECK_FALSE(cb.test(102));
+
+    cb.reset(100);
+    CHECK(cb.count() == 50);
+
+    cb.clear();
+    CHECK(cb.count() == 0);
+}
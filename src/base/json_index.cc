@@ -0,0 +1,916 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file json_index.cc
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "json_index.hh"
+
+#include "config.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define JSON_INDEX_X86 1
+#    include <immintrin.h>
+#endif
+
+namespace {
+
+/** Objects and arrays nested deeper than this are left to a full parser. */
+const int MAX_DEPTH = 256;
+
+/** Integers with more digits than this might overflow a long long. */
+const size_t MAX_INTEGER_DIGITS = 18;
+
+/** The masks for a block of 64 bytes, one bit per byte. */
+struct block_masks {
+    uint64_t bm_quote{0};
+    uint64_t bm_backslash{0};
+    uint64_t bm_structural{0};
+    uint64_t bm_control{0};
+};
+
+/**
+ * @return A mask with a bit set for every byte that comes after an odd number
+ *   of the bits set in the given mask.
+ */
+uint64_t
+prefix_xor(uint64_t mask)
+{
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+
+    return mask;
+}
+
+/**
+ * Turns the masks for each block into the offsets of the structural
+ * characters and the backslashes that start an escape sequence.
+ */
+struct structural_builder {
+    std::vector<uint32_t>& sb_structurals;
+    std::vector<uint32_t>& sb_escapes;
+    /** Bit zero is set if the first byte of the next block is escaped. */
+    uint64_t sb_escaped_carry{0};
+    /** All ones if the next block starts inside of a string. */
+    uint64_t sb_in_string{0};
+    bool sb_valid{true};
+
+    void process(size_t offset, const block_masks& bm)
+    {
+        uint64_t escaped = this->sb_escaped_carry;
+        auto backslashes = bm.bm_backslash;
+
+        // Backslashes are rare enough that they can be handled one at a time.
+        this->sb_escaped_carry = 0;
+        while (backslashes != 0) {
+            auto bit = __builtin_ctzll(backslashes);
+
+            if (((escaped >> bit) & 1) == 0) {
+                this->sb_escapes.push_back(offset + bit);
+                if (bit == 63) {
+                    this->sb_escaped_carry = 1;
+                } else {
+                    escaped |= (uint64_t) 1 << (bit + 1);
+                }
+            }
+            backslashes &= backslashes - 1;
+        }
+
+        auto quotes = bm.bm_quote & ~escaped;
+        auto in_string = prefix_xor(quotes) ^ this->sb_in_string;
+
+        this->sb_in_string = (uint64_t) ((int64_t) in_string >> 63);
+        if (bm.bm_control & in_string) {
+            this->sb_valid = false;
+        }
+
+        auto structurals = (bm.bm_structural & ~in_string) | quotes;
+
+        while (structurals != 0) {
+            this->sb_structurals.push_back(offset
+                                           + __builtin_ctzll(structurals));
+            structurals &= structurals - 1;
+        }
+    }
+
+    bool finish(const char* data, size_t offset, size_t len);
+};
+
+block_masks
+masks_scalar(const char* block)
+{
+    block_masks retval;
+
+    for (size_t lpc = 0; lpc < 64; lpc++) {
+        auto ch = (unsigned char) block[lpc];
+        auto bit = (uint64_t) 1 << lpc;
+
+        switch (ch) {
+            case '"':
+                retval.bm_quote |= bit;
+                break;
+            case '\\':
+                retval.bm_backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                retval.bm_structural |= bit;
+                break;
+            default:
+                if (ch < 0x20) {
+                    retval.bm_control |= bit;
+                }
+                break;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Process the partial block at the end of the text, padded with spaces.
+ *
+ * @return True if the text had no control characters in strings and did not
+ *   end inside of a string.
+ */
+bool
+structural_builder::finish(const char* data, size_t offset, size_t len)
+{
+    if (offset < len) {
+        char block[64];
+
+        memset(block, ' ', sizeof(block));
+        memcpy(block, &data[offset], len - offset);
+        this->process(offset, masks_scalar(block));
+    }
+
+    return this->sb_valid && this->sb_in_string == 0;
+}
+
+bool
+build_scalar(const char* data, size_t len, structural_builder& sb)
+{
+    size_t offset = 0;
+
+    for (; offset + 64 <= len; offset += 64) {
+        sb.process(offset, masks_scalar(&data[offset]));
+    }
+
+    return sb.finish(data, offset, len);
+}
+
+#ifdef JSON_INDEX_X86
+__attribute__((target("sse2"))) block_masks
+masks_sse2(const char* block)
+{
+    const __m128i quote_chars = _mm_set1_epi8('"');
+    const __m128i backslash_chars = _mm_set1_epi8('\\');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open_chars = _mm_set1_epi8('{');
+    const __m128i close_chars = _mm_set1_epi8('}');
+    const __m128i colon_chars = _mm_set1_epi8(':');
+    const __m128i comma_chars = _mm_set1_epi8(',');
+    const __m128i control_max = _mm_set1_epi8(0x1f);
+    block_masks retval;
+
+    for (int lpc = 0; lpc < 4; lpc++) {
+        auto bytes = _mm_loadu_si128((const __m128i*) &block[lpc * 16]);
+        // '[' and ']' only differ from '{' and '}' by the 0x20 bit.
+        auto folded = _mm_or_si128(bytes, case_bit);
+        auto structural = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open_chars),
+                         _mm_cmpeq_epi8(folded, close_chars)),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, colon_chars),
+                         _mm_cmpeq_epi8(bytes, comma_chars)));
+        auto control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, control_max),
+                                      control_max);
+        auto shift = lpc * 16;
+
+        retval.bm_quote |= (uint64_t) (uint32_t) _mm_movemask_epi8(
+                               _mm_cmpeq_epi8(bytes, quote_chars))
+            << shift;
+        retval.bm_backslash |= (uint64_t) (uint32_t) _mm_movemask_epi8(
+                                   _mm_cmpeq_epi8(bytes, backslash_chars))
+            << shift;
+        retval.bm_structural
+            |= (uint64_t) (uint32_t) _mm_movemask_epi8(structural) << shift;
+        retval.bm_control
+            |= (uint64_t) (uint32_t) _mm_movemask_epi8(control) << shift;
+    }
+
+    return retval;
+}
+
+__attribute__((target("sse2"))) bool
+build_sse2(const char* data, size_t len, structural_builder& sb)
+{
+    size_t offset = 0;
+
+    for (; offset + 64 <= len; offset += 64) {
+        sb.process(offset, masks_sse2(&data[offset]));
+    }
+
+    return sb.finish(data, offset, len);
+}
+
+__attribute__((target("avx2"))) block_masks
+masks_avx2(const char* block)
+{
+    const __m256i quote_chars = _mm256_set1_epi8('"');
+    const __m256i backslash_chars = _mm256_set1_epi8('\\');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open_chars = _mm256_set1_epi8('{');
+    const __m256i close_chars = _mm256_set1_epi8('}');
+    const __m256i colon_chars = _mm256_set1_epi8(':');
+    const __m256i comma_chars = _mm256_set1_epi8(',');
+    const __m256i control_max = _mm256_set1_epi8(0x1f);
+    block_masks retval;
+
+    for (int lpc = 0; lpc < 2; lpc++) {
+        auto bytes = _mm256_loadu_si256((const __m256i*) &block[lpc * 32]);
+        auto folded = _mm256_or_si256(bytes, case_bit);
+        auto structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open_chars),
+                            _mm256_cmpeq_epi8(folded, close_chars)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, colon_chars),
+                            _mm256_cmpeq_epi8(bytes, comma_chars)));
+        auto control = _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, control_max),
+                                         control_max);
+        auto shift = lpc * 32;
+
+        retval.bm_quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(
+                               _mm256_cmpeq_epi8(bytes, quote_chars))
+            << shift;
+        retval.bm_backslash |= (uint64_t) (uint32_t) _mm256_movemask_epi8(
+                                   _mm256_cmpeq_epi8(bytes, backslash_chars))
+            << shift;
+        retval.bm_structural
+            |= (uint64_t) (uint32_t) _mm256_movemask_epi8(structural) << shift;
+        retval.bm_control
+            |= (uint64_t) (uint32_t) _mm256_movemask_epi8(control) << shift;
+    }
+
+    return retval;
+}
+
+__attribute__((target("avx2"))) bool
+build_avx2(const char* data, size_t len, structural_builder& sb)
+{
+    size_t offset = 0;
+
+    for (; offset + 64 <= len; offset += 64) {
+        sb.process(offset, masks_avx2(&data[offset]));
+    }
+
+    return sb.finish(data, offset, len);
+}
+#endif
+
+bool
+is_digit(char ch)
+{
+    return '0' <= ch && ch <= '9';
+}
+
+bool
+is_json_space(char ch)
+{
+    switch (ch) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\v':
+        case '\f':
+        case '\r':
+            return true;
+        default:
+            return false;
+    }
+}
+
+int
+hex_value(char ch)
+{
+    if ('0' <= ch && ch <= '9') {
+        return ch - '0';
+    }
+    if ('a' <= ch && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if ('A' <= ch && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * Parse the four hex digits of a "\u" escape.
+ *
+ * @return The code point or -1 if the digits are not valid.
+ */
+int
+parse_code_point(const char* digits)
+{
+    int retval = 0;
+
+    for (int lpc = 0; lpc < 4; lpc++) {
+        auto value = hex_value(digits[lpc]);
+
+        if (value == -1) {
+            return -1;
+        }
+        retval = (retval << 4) | value;
+    }
+
+    return retval;
+}
+
+bool
+is_surrogate(int code_point)
+{
+    return 0xd800 <= code_point && code_point <= 0xdfff;
+}
+
+/**
+ * Walks the structural characters found by the first stage.
+ */
+struct structural_walker {
+    const char* sw_data;
+    const std::vector<uint32_t>& sw_structurals;
+    const std::vector<uint32_t>& sw_escapes;
+    size_t sw_index{0};
+    size_t sw_escape_index{0};
+    /** The offset just past the end of the last value that was walked. */
+    uint32_t sw_value_end{0};
+
+    bool at_end() const
+    {
+        return this->sw_index >= this->sw_structurals.size();
+    }
+
+    uint32_t current() const { return this->sw_structurals[this->sw_index]; }
+
+    bool all_space(uint32_t begin, uint32_t end) const
+    {
+        for (auto lpc = begin; lpc < end; lpc++) {
+            if (!is_json_space(this->sw_data[lpc])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Check the escape sequences in the string between the given quotes.
+     */
+    bool string(uint32_t open,
+                uint32_t close,
+                bool& escaped_out,
+                uint32_t& newlines_out)
+    {
+        auto& escapes = this->sw_escapes;
+        auto& index = this->sw_escape_index;
+
+        escaped_out = false;
+        newlines_out = 0;
+        while (index < escapes.size() && escapes[index] < open) {
+            index += 1;
+        }
+        for (; index < escapes.size() && escapes[index] < close; index++) {
+            auto pos = escapes[index] + 1;
+
+            escaped_out = true;
+            switch (this->sw_data[pos]) {
+                case '"':
+                case '\\':
+                case '/':
+                case 'b':
+                case 'f':
+                case 'r':
+                case 't':
+                    break;
+                case 'n':
+                    newlines_out += 1;
+                    break;
+                case 'u': {
+                    if (pos + 4 >= close) {
+                        return false;
+                    }
+
+                    auto code_point = parse_code_point(&this->sw_data[pos + 1]);
+
+                    // yajl decodes surrogates with some quirks, leave those
+                    // to it.
+                    if (code_point == -1 || is_surrogate(code_point)) {
+                        return false;
+                    }
+                    if (code_point == '\n') {
+                        newlines_out += 1;
+                    }
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool number(const char* str, size_t len, json_member* jm) const
+    {
+        size_t lpc = 0;
+        bool negative = false;
+        bool floating = false;
+
+        if (str[lpc] == '-') {
+            negative = true;
+            lpc += 1;
+        }
+
+        auto int_start = lpc;
+
+        if (lpc < len && str[lpc] == '0') {
+            lpc += 1;
+        } else if (lpc < len && is_digit(str[lpc])) {
+            while (lpc < len && is_digit(str[lpc])) {
+                lpc += 1;
+            }
+        } else {
+            return false;
+        }
+
+        auto int_end = lpc;
+
+        if (lpc < len && str[lpc] == '.') {
+            auto frac_start = lpc + 1;
+
+            floating = true;
+            for (lpc = frac_start; lpc < len && is_digit(str[lpc]); lpc++) {
+            }
+            if (lpc == frac_start) {
+                return false;
+            }
+        }
+
+        bool exponent = false;
+
+        if (lpc < len && (str[lpc] == 'e' || str[lpc] == 'E')) {
+            floating = true;
+            exponent = true;
+            lpc += 1;
+            if (lpc < len && (str[lpc] == '+' || str[lpc] == '-')) {
+                lpc += 1;
+            }
+
+            auto exp_start = lpc;
+
+            while (lpc < len && is_digit(str[lpc])) {
+                lpc += 1;
+            }
+            if (lpc == exp_start) {
+                return false;
+            }
+        }
+        if (lpc != len) {
+            return false;
+        }
+
+        if (!floating) {
+            if (int_end - int_start > MAX_INTEGER_DIGITS) {
+                return false;
+            }
+            if (jm != nullptr) {
+                int64_t value = 0;
+
+                for (lpc = int_start; lpc < int_end; lpc++) {
+                    value = value * 10 + (str[lpc] - '0');
+                }
+                jm->jm_kind = json_value_kind_t::integer;
+                jm->jm_integer = negative ? -value : value;
+            }
+            return true;
+        }
+
+        // A number can only overflow a double if it has an exponent or an
+        // absurd number of digits.  The number is always followed by a
+        // structural character, so strtod() will not run off the end.
+        if (jm != nullptr || exponent || len > 300) {
+            errno = 0;
+
+            auto value = strtod(str, nullptr);
+
+            if ((value == HUGE_VAL || value == -HUGE_VAL) && errno == ERANGE) {
+                return false;
+            }
+            if (jm != nullptr) {
+                jm->jm_kind = json_value_kind_t::floating;
+                jm->jm_floating = value;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Check the scalar value between the given offsets.
+     */
+    bool scalar(uint32_t begin, uint32_t end, json_member* jm)
+    {
+        while (begin < end && is_json_space(this->sw_data[begin])) {
+            begin += 1;
+        }
+        while (begin < end && is_json_space(this->sw_data[end - 1])) {
+            end -= 1;
+        }
+        if (begin == end) {
+            return false;
+        }
+
+        const auto* str = &this->sw_data[begin];
+        auto len = end - begin;
+
+        this->sw_value_end = end;
+        if (jm != nullptr) {
+            jm->jm_value_begin = begin;
+            jm->jm_value_end = end;
+        }
+        switch (str[0]) {
+            case 't':
+                if (len == 4 && strncmp(str, "true", 4) == 0) {
+                    if (jm != nullptr) {
+                        jm->jm_kind = json_value_kind_t::boolean_true;
+                    }
+                    return true;
+                }
+                return false;
+            case 'f':
+                if (len == 5 && strncmp(str, "false", 5) == 0) {
+                    if (jm != nullptr) {
+                        jm->jm_kind = json_value_kind_t::boolean_false;
+                    }
+                    return true;
+                }
+                return false;
+            case 'n':
+                if (len == 4 && strncmp(str, "null", 4) == 0) {
+                    if (jm != nullptr) {
+                        jm->jm_kind = json_value_kind_t::null;
+                    }
+                    return true;
+                }
+                return false;
+            default:
+                return this->number(str, len, jm);
+        }
+    }
+
+    /**
+     * Walk the value that starts after the given offset.
+     */
+    bool value(uint32_t after, json_member* jm, int depth)
+    {
+        if (this->at_end()) {
+            return false;
+        }
+
+        auto pos = this->current();
+
+        switch (this->sw_data[pos]) {
+            case '"': {
+                if (!this->all_space(after, pos)) {
+                    return false;
+                }
+
+                auto close = this->sw_structurals[this->sw_index + 1];
+                bool escaped;
+                uint32_t newlines;
+
+                this->sw_index += 2;
+                if (!this->string(pos, close, escaped, newlines)) {
+                    return false;
+                }
+                this->sw_value_end = close + 1;
+                if (jm != nullptr) {
+                    jm->jm_kind = json_value_kind_t::string;
+                    jm->jm_value_begin = pos + 1;
+                    jm->jm_value_end = close;
+                    jm->jm_escaped = escaped;
+                    jm->jm_newlines = newlines;
+                }
+                return true;
+            }
+            case '{':
+            case '[': {
+                if (!this->all_space(after, pos) || depth >= MAX_DEPTH) {
+                    return false;
+                }
+
+                auto is_object = this->sw_data[pos] == '{';
+
+                this->sw_index += 1;
+                if (is_object ? !this->object(pos, depth + 1, nullptr)
+                              : !this->array(pos, depth + 1))
+                {
+                    return false;
+                }
+                if (jm != nullptr) {
+                    jm->jm_kind = is_object ? json_value_kind_t::object
+                                            : json_value_kind_t::array;
+                    jm->jm_value_begin = pos;
+                    jm->jm_value_end = this->sw_value_end;
+                }
+                return true;
+            }
+            case ':':
+                return false;
+            default:
+                return this->scalar(after, pos, jm);
+        }
+    }
+
+    /**
+     * Walk the members of the object that was opened at the given offset.
+     *
+     * @param members If not null, the members are appended to this vector.
+     */
+    bool object(uint32_t open, int depth, std::vector<json_member>* members)
+    {
+        if (this->at_end()) {
+            return false;
+        }
+
+        auto pos = this->current();
+
+        if (this->sw_data[pos] == '}' && this->all_space(open + 1, pos)) {
+            this->sw_index += 1;
+            this->sw_value_end = pos + 1;
+            return true;
+        }
+
+        auto after = open + 1;
+
+        while (true) {
+            if (this->at_end()) {
+                return false;
+            }
+            pos = this->current();
+            if (this->sw_data[pos] != '"' || !this->all_space(after, pos)) {
+                return false;
+            }
+
+            auto close = this->sw_structurals[this->sw_index + 1];
+            bool escaped;
+            uint32_t newlines;
+
+            this->sw_index += 2;
+            if (!this->string(pos, close, escaped, newlines)) {
+                return false;
+            }
+            // The keys of the members are used as-is, so leave any that
+            // need to be decoded to the full parser.
+            if (members != nullptr && escaped) {
+                return false;
+            }
+            if (this->at_end()) {
+                return false;
+            }
+
+            auto colon = this->current();
+
+            if (this->sw_data[colon] != ':'
+                || !this->all_space(close + 1, colon)) {
+                return false;
+            }
+            this->sw_index += 1;
+
+            json_member jm{};
+
+            jm.jm_key_begin = pos + 1;
+            jm.jm_key_end = close;
+            if (!this->value(colon + 1, members != nullptr ? &jm : nullptr, depth))
+            {
+                return false;
+            }
+            if (members != nullptr) {
+                members->emplace_back(jm);
+            }
+            if (this->at_end()) {
+                return false;
+            }
+            pos = this->current();
+            if (!this->all_space(this->sw_value_end, pos)) {
+                return false;
+            }
+            this->sw_index += 1;
+            if (this->sw_data[pos] == ',') {
+                after = pos + 1;
+                continue;
+            }
+            if (this->sw_data[pos] == '}') {
+                this->sw_value_end = pos + 1;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    /**
+     * Walk the elements of the array that was opened at the given offset.
+     */
+    bool array(uint32_t open, int depth)
+    {
+        if (this->at_end()) {
+            return false;
+        }
+
+        auto pos = this->current();
+
+        if (this->sw_data[pos] == ']' && this->all_space(open + 1, pos)) {
+            this->sw_index += 1;
+            this->sw_value_end = pos + 1;
+            return true;
+        }
+
+        auto after = open + 1;
+
+        while (true) {
+            if (!this->value(after, nullptr, depth)) {
+                return false;
+            }
+            if (this->at_end()) {
+                return false;
+            }
+            pos = this->current();
+            if (!this->all_space(this->sw_value_end, pos)) {
+                return false;
+            }
+            this->sw_index += 1;
+            if (this->sw_data[pos] == ',') {
+                after = pos + 1;
+                continue;
+            }
+            if (this->sw_data[pos] == ']') {
+                this->sw_value_end = pos + 1;
+                return true;
+            }
+            return false;
+        }
+    }
+};
+
+void
+append_utf8(int code_point, std::string& out)
+{
+    if (code_point < 0x80) {
+        out.push_back((char) code_point);
+    } else if (code_point < 0x800) {
+        out.push_back((char) (0xc0 | (code_point >> 6)));
+        out.push_back((char) (0x80 | (code_point & 0x3f)));
+    } else {
+        out.push_back((char) (0xe0 | (code_point >> 12)));
+        out.push_back((char) (0x80 | ((code_point >> 6) & 0x3f)));
+        out.push_back((char) (0x80 | (code_point & 0x3f)));
+    }
+}
+
+}  // namespace
+
+bool
+json_index::index(const char* data, size_t len)
+{
+    return this->index(line_scan_impl(), data, len);
+}
+
+bool
+json_index::index(line_scan_impl_t impl, const char* data, size_t len)
+{
+    this->ji_structurals.clear();
+    this->ji_escapes.clear();
+    this->ji_members.clear();
+
+    if (len >= UINT32_MAX) {
+        return false;
+    }
+
+    structural_builder sb{this->ji_structurals, this->ji_escapes};
+    bool valid;
+
+    switch (impl) {
+#ifdef JSON_INDEX_X86
+        case line_scan_impl_t::avx2:
+            valid = build_avx2(data, len, sb);
+            break;
+        case line_scan_impl_t::sse2:
+            valid = build_sse2(data, len, sb);
+            break;
+#endif
+        default:
+            valid = build_scalar(data, len, sb);
+            break;
+    }
+    if (!valid || this->ji_structurals.empty()) {
+        return false;
+    }
+
+    structural_walker sw{data, this->ji_structurals, this->ji_escapes};
+    auto open = sw.current();
+
+    if (data[open] != '{' || !sw.all_space(0, open)) {
+        return false;
+    }
+    sw.sw_index += 1;
+    if (!sw.object(open, 1, &this->ji_members)) {
+        this->ji_members.clear();
+        return false;
+    }
+    if (!sw.at_end() || !sw.all_space(sw.sw_value_end, len)) {
+        this->ji_members.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void
+json_index::decode_string(const char* str, size_t len, std::string& out)
+{
+    size_t lpc = 0;
+
+    while (lpc < len) {
+        auto* backslash = (const char*) memchr(&str[lpc], '\\', len - lpc);
+
+        if (backslash == nullptr) {
+            out.append(&str[lpc], len - lpc);
+            break;
+        }
+
+        auto pos = backslash - str;
+
+        out.append(&str[lpc], pos - lpc);
+        switch (str[pos + 1]) {
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+                append_utf8(parse_code_point(&str[pos + 2]), out);
+                lpc = pos + 6;
+                continue;
+            default:
+                out.push_back(str[pos + 1]);
+                break;
+        }
+        lpc = pos + 2;
+    }
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file json_index.hh
+ */
+
+#ifndef lnav_json_index_hh
+#define lnav_json_index_hh
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "line_scan.hh"
+
+enum class json_value_kind_t : uint8_t {
+    string,
+    integer,
+    floating,
+    boolean_true,
+    boolean_false,
+    null,
+    object,
+    array,
+};
+
+/**
+ * A member of the top-level object in a JSON text.  The offsets are relative
+ * to the start of the text.
+ */
+struct json_member {
+    /** The start of the key, after the opening quote. */
+    uint32_t jm_key_begin;
+    /** The end of the key, the offset of the closing quote. */
+    uint32_t jm_key_end;
+    /**
+     * The start of the value.  For strings, this is after the opening quote.
+     * For objects and arrays, this is the opening bracket.
+     */
+    uint32_t jm_value_begin;
+    /**
+     * The end of the value.  For strings, this is the offset of the closing
+     * quote.  For objects and arrays, this is after the closing bracket.
+     */
+    uint32_t jm_value_end;
+    json_value_kind_t jm_kind;
+    /** True if the string value contains escape sequences. */
+    bool jm_escaped;
+    /** The number of line-feeds in the string value, once it is decoded. */
+    uint32_t jm_newlines;
+    int64_t jm_integer;
+    double jm_floating;
+};
+
+/**
+ * An index of the top-level members of a JSON object that can be built
+ * without producing an event for every token in the text.
+ *
+ * The first stage finds the quotes and the structural characters that are
+ * not inside of a string a block at a time with SIMD instructions, when the
+ * CPU supports them.  The second stage walks the structural characters to
+ * check the text and record the members of the top-level object.  Only the
+ * top-level members are recorded, nested values are checked and skipped.
+ *
+ * The index only accepts text that yajl would parse to the same events with
+ * validation of UTF-8 strings turned off.  Anything that would need closer
+ * inspection, like integers that might overflow, keys with escapes, and
+ * escaped UTF-16 surrogates, is rejected so that the caller can fall back to
+ * a full parser.
+ */
+class json_index {
+public:
+    /**
+     * Index the given text.
+     *
+     * @return True if the text is a JSON object that could be indexed.  If
+     *   false, the caller should parse the text with a full parser.
+     */
+    bool index(const char* data, size_t len);
+
+    /**
+     * Same as index(), but with the given implementation of the first stage
+     * instead of the one selected for the current CPU.
+     */
+    bool index(line_scan_impl_t impl, const char* data, size_t len);
+
+    /**
+     * @return The members of the top-level object found by the last call to
+     *   index().
+     */
+    const std::vector<json_member>& members() const
+    {
+        return this->ji_members;
+    }
+
+    /**
+     * @return The offsets of the quotes and the structural characters outside
+     *   of strings found by the last call to index().
+     */
+    const std::vector<uint32_t>& structurals() const
+    {
+        return this->ji_structurals;
+    }
+
+    /**
+     * Decode the escape sequences in a string that was accepted by index().
+     *
+     * @param str The contents of the string, without the quotes.
+     * @param len The length of the string.
+     * @param out The string to append the decoded contents to.
+     */
+    static void decode_string(const char* str, size_t len, std::string& out);
+
+private:
+    std::vector<uint32_t> ji_structurals;
+    std::vector<uint32_t> ji_escapes;
+    std::vector<json_member> ji_members;
+};
+
+#endif
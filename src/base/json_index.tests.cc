@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <random>
+#include <string>
+
+#include <string.h>
+
+#include "base/json_index.hh"
+#include "config.h"
+#include "doctest/doctest.h"
+
+static const line_scan_impl_t ALL_IMPLS[] = {
+    line_scan_impl_t::scalar,
+    line_scan_impl_t::sse2,
+    line_scan_impl_t::avx2,
+};
+
+static std::string
+key_of(const std::string& data, const json_member& jm)
+{
+    return data.substr(jm.jm_key_begin, jm.jm_key_end - jm.jm_key_begin);
+}
+
+static std::string
+value_of(const std::string& data, const json_member& jm)
+{
+    return data.substr(jm.jm_value_begin,
+                       jm.jm_value_end - jm.jm_value_begin);
+}
+
+TEST_CASE("json_index")
+{
+    std::string data = R"( {"ts": "2022-01-01T00:00:00Z", "n": -123, )"
+                       R"("f": 1.5e2, "t": true, "z": null,)"
+                       R"("obj": {"a": [1, {"b": "}"}]}, "arr": [ ],)"
+                       R"( "msg": "a\"b\nc\u000Ad\u00e9"} )";
+
+    for (auto impl : ALL_IMPLS) {
+        if (!line_scan_impl_supported(impl)) {
+            continue;
+        }
+
+        json_index ji;
+
+        REQUIRE(ji.index(impl, data.data(), data.size()));
+
+        const auto& members = ji.members();
+
+        REQUIRE(members.size() == 8);
+        CHECK(key_of(data, members[0]) == "ts");
+        CHECK(members[0].jm_kind == json_value_kind_t::string);
+        CHECK(value_of(data, members[0]) == "2022-01-01T00:00:00Z");
+        CHECK_FALSE(members[0].jm_escaped);
+        CHECK(members[1].jm_kind == json_value_kind_t::integer);
+        CHECK(members[1].jm_integer == -123);
+        CHECK(members[2].jm_kind == json_value_kind_t::floating);
+        CHECK(members[2].jm_floating == 150.0);
+        CHECK(members[3].jm_kind == json_value_kind_t::boolean_true);
+        CHECK(members[4].jm_kind == json_value_kind_t::null);
+        CHECK(key_of(data, members[5]) == "obj");
+        CHECK(members[5].jm_kind == json_value_kind_t::object);
+        CHECK(value_of(data, members[5]) == R"({"a": [1, {"b": "}"}]})");
+        CHECK(members[6].jm_kind == json_value_kind_t::array);
+        CHECK(value_of(data, members[6]) == "[ ]");
+        CHECK(members[7].jm_kind == json_value_kind_t::string);
+        CHECK(members[7].jm_escaped);
+        CHECK(members[7].jm_newlines == 2);
+
+        std::string decoded;
+        auto msg = value_of(data, members[7]);
+
+        json_index::decode_string(msg.data(), msg.size(), decoded);
+        CHECK(decoded == "a\"b\nc\nd\xc3\xa9");
+    }
+}
+
+TEST_CASE("json_index-reject")
+{
+    static const char* BAD[] = {
+        "",
+        "   ",
+        "[1, 2]",
+        "\"str\"",
+        "{",
+        "{\"a\": 1",
+        "{\"a\": 1,}",
+        "{\"a\" 1}",
+        "{\"a\": }",
+        "{\"a\": 01}",
+        "{\"a\": 1.}",
+        "{\"a\": .5}",
+        "{\"a\": 1e}",
+        "{\"a\": 1e999}",
+        "{\"a\": 1234567890123456789}",
+        "{\"a\": tru}",
+        "{\"a\": true false}",
+        "{\"a\": [1 2]}",
+        "{\"a\": [1,]}",
+        "{\"a\": {\"b\"}}",
+        "{\"a\": \"b\tc\"}",
+        "{\"a\": \"\\x\"}",
+        "{\"a\": \"\\u12\"}",
+        "{\"a\": \"\\ud83d\\ude00\"}",
+        "{\"a\\n\": 1}",
+        "{\"a\": \"b}",
+        "{\"a\": 1} x",
+        "{\"a\": 1}{}",
+        "{\"a\": 1, \"b\": \x01}",
+    };
+
+    for (const auto* bad : BAD) {
+        for (auto impl : ALL_IMPLS) {
+            if (!line_scan_impl_supported(impl)) {
+                continue;
+            }
+
+            json_index ji;
+
+            CHECK_MESSAGE(!ji.index(impl, bad, strlen(bad)), bad);
+        }
+    }
+}
+
+TEST_CASE("json_index-random")
+{
+    static const char* FRAGMENTS[] = {
+        "\"",
+        "\\",
+        "\\\\",
+        "\\\"",
+        "{",
+        "}",
+        "[",
+        "]",
+        ":",
+        ",",
+        "a",
+        " ",
+        "\t",
+        "\xc3\xa9",
+    };
+
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<size_t> frag_dist(
+        0, sizeof(FRAGMENTS) / sizeof(FRAGMENTS[0]) - 1);
+
+    for (int round = 0; round < 500; round++) {
+        std::string data;
+
+        while (data.size() < (size_t) round) {
+            data.append(FRAGMENTS[frag_dist(gen)]);
+        }
+
+        json_index expected;
+        auto expected_valid = expected.index(
+            line_scan_impl_t::scalar, data.data(), data.size());
+
+        for (auto impl : ALL_IMPLS) {
+            if (!line_scan_impl_supported(impl)) {
+                continue;
+            }
+
+            json_index actual;
+
+            CHECK(actual.index(impl, data.data(), data.size())
+                  == expected_valid);
+            CHECK(actual.structurals() == expected.structurals());
+        }
+    }
+}
+
+TEST_CASE("json_index-escape-across-blocks")
+{
+    std::string data = "{\"a\": \"";
+
+    data.append(63 - data.size(), 'x');
+    data.append("\\\"\"}");
+    REQUIRE(data[63] == '\\');
+
+    for (auto impl : ALL_IMPLS) {
+        if (!line_scan_impl_supported(impl)) {
+            continue;
+        }
+
+        json_index ji;
+
+        REQUIRE(ji.index(impl, data.data(), data.size()));
+        REQUIRE(ji.members().size() == 1);
+        CHECK(ji.members()[0].jm_escaped);
+        CHECK(ji.members()[0].jm_value_end == data.size() - 2);
+    }
+}
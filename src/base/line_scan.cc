@@ -0,0 +1,299 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file line_scan.cc
+ */
+
+#include <string.h>
+
+#include "line_scan.hh"
+
+#include "config.h"
+#include "is_utf8.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define LINE_SCAN_X86 1
+#    include <immintrin.h>
+#endif
+
+namespace {
+
+bool
+is_valid_utf8_line(const char* data, size_t len)
+{
+    const char* msg;
+    int faulty_bytes;
+
+    is_utf8((unsigned char*) data, len, &msg, &faulty_bytes);
+
+    return msg == nullptr;
+}
+
+/**
+ * Keeps track of the line that is currently being scanned and appends it to
+ * the output once its line-feed is found.
+ */
+struct line_tracker {
+    const char* lt_data;
+    std::vector<scanned_line>& lt_lines;
+    size_t lt_max_lines;
+    size_t lt_line_start{0};
+    bool lt_high_bytes{false};
+
+    bool full() const
+    {
+        return this->lt_lines.size() >= this->lt_max_lines;
+    }
+
+    void end_line(size_t lf_offset)
+    {
+        auto length = lf_offset - this->lt_line_start;
+        bool valid = !this->lt_high_bytes
+            || is_valid_utf8_line(&this->lt_data[this->lt_line_start], length);
+
+        this->lt_lines.emplace_back(scanned_line{(uint32_t) (length + 1), valid});
+        this->lt_line_start = lf_offset + 1;
+        this->lt_high_bytes = false;
+    }
+
+    /**
+     * Process the masks for a block of bytes.
+     *
+     * @param block_offset The offset of the block in the buffer.
+     * @param lf_mask A bit set for each line-feed in the block.
+     * @param high_mask A bit set for each byte with the high-bit set.
+     * @return False if the maximum number of lines was reached.
+     */
+    bool process_block(size_t block_offset, uint64_t lf_mask, uint64_t high_mask)
+    {
+        while (lf_mask != 0) {
+            auto bit = __builtin_ctzll(lf_mask);
+            auto before_mask = (bit == 63) ? ~(uint64_t) 0 >> 1
+                                           : ((uint64_t) 1 << bit) - 1;
+
+            if (high_mask & before_mask) {
+                this->lt_high_bytes = true;
+            }
+            this->end_line(block_offset + bit);
+            if (this->full()) {
+                return false;
+            }
+            high_mask &= ~before_mask;
+            lf_mask &= lf_mask - 1;
+        }
+        if (high_mask != 0) {
+            this->lt_high_bytes = true;
+        }
+
+        return true;
+    }
+
+    /**
+     * Scan the rest of the buffer a byte at a time.
+     */
+    size_t finish(size_t offset, size_t len)
+    {
+        for (; offset < len && !this->full(); offset++) {
+            auto ch = (unsigned char) this->lt_data[offset];
+
+            if (ch == '\n') {
+                this->end_line(offset);
+            } else if (ch & 0x80) {
+                this->lt_high_bytes = true;
+            }
+        }
+
+        return this->lt_line_start;
+    }
+};
+
+size_t
+scan_lines_scalar(const char* data,
+                  size_t len,
+                  std::vector<scanned_line>& lines_out,
+                  size_t max_lines)
+{
+    static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+    line_tracker lt{data, lines_out, max_lines};
+
+    while (!lt.full() && lt.lt_line_start < len) {
+        auto* line_start = &data[lt.lt_line_start];
+        auto* lf = (const char*) memchr(line_start, '\n', len - lt.lt_line_start);
+
+        if (lf == nullptr) {
+            break;
+        }
+
+        size_t length = lf - line_start;
+        size_t lpc = 0;
+
+        for (; lpc + sizeof(uint64_t) <= length; lpc += sizeof(uint64_t)) {
+            uint64_t word;
+
+            memcpy(&word, &line_start[lpc], sizeof(word));
+            if (word & HIGH_BITS) {
+                lt.lt_high_bytes = true;
+                break;
+            }
+        }
+        for (; !lt.lt_high_bytes && lpc < length; lpc++) {
+            if (line_start[lpc] & 0x80) {
+                lt.lt_high_bytes = true;
+            }
+        }
+        lt.end_line(lf - data);
+    }
+
+    return lt.lt_line_start;
+}
+
+#ifdef LINE_SCAN_X86
+__attribute__((target("sse2"))) size_t
+scan_lines_sse2(const char* data,
+                size_t len,
+                std::vector<scanned_line>& lines_out,
+                size_t max_lines)
+{
+    const __m128i lf_chars = _mm_set1_epi8('\n');
+    line_tracker lt{data, lines_out, max_lines};
+    size_t offset = 0;
+
+    for (; offset + 16 <= len; offset += 16) {
+        auto bytes = _mm_loadu_si128((const __m128i*) &data[offset]);
+        uint64_t lf_mask = (uint32_t) _mm_movemask_epi8(
+            _mm_cmpeq_epi8(bytes, lf_chars));
+        uint64_t high_mask = (uint32_t) _mm_movemask_epi8(bytes);
+
+        if (!lt.process_block(offset, lf_mask, high_mask)) {
+            return lt.lt_line_start;
+        }
+    }
+
+    return lt.finish(offset, len);
+}
+
+__attribute__((target("avx2"))) size_t
+scan_lines_avx2(const char* data,
+                size_t len,
+                std::vector<scanned_line>& lines_out,
+                size_t max_lines)
+{
+    const __m256i lf_chars = _mm256_set1_epi8('\n');
+    line_tracker lt{data, lines_out, max_lines};
+    size_t offset = 0;
+
+    for (; offset + 64 <= len; offset += 64) {
+        auto bytes_lo = _mm256_loadu_si256((const __m256i*) &data[offset]);
+        auto bytes_hi = _mm256_loadu_si256((const __m256i*) &data[offset + 32]);
+        uint64_t lf_mask = (uint32_t) _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(bytes_lo, lf_chars));
+        uint64_t high_mask = (uint32_t) _mm256_movemask_epi8(bytes_lo);
+
+        lf_mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(
+                       _mm256_cmpeq_epi8(bytes_hi, lf_chars))
+            << 32;
+        high_mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(bytes_hi)
+            << 32;
+        if (!lt.process_block(offset, lf_mask, high_mask)) {
+            return lt.lt_line_start;
+        }
+    }
+
+    return lt.finish(offset, len);
+}
+#endif
+
+line_scan_impl_t
+select_impl()
+{
+#ifdef LINE_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return line_scan_impl_t::avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return line_scan_impl_t::sse2;
+    }
+#endif
+
+    return line_scan_impl_t::scalar;
+}
+
+}  // namespace
+
+line_scan_impl_t
+line_scan_impl()
+{
+    static const auto retval = select_impl();
+
+    return retval;
+}
+
+bool
+line_scan_impl_supported(line_scan_impl_t impl)
+{
+    switch (impl) {
+        case line_scan_impl_t::scalar:
+            return true;
+        case line_scan_impl_t::sse2:
+            return line_scan_impl() != line_scan_impl_t::scalar;
+        case line_scan_impl_t::avx2:
+            return line_scan_impl() == line_scan_impl_t::avx2;
+    }
+
+    return false;
+}
+
+size_t
+scan_lines(line_scan_impl_t impl,
+           const char* data,
+           size_t len,
+           std::vector<scanned_line>& lines_out,
+           size_t max_lines)
+{
+    switch (impl) {
+#ifdef LINE_SCAN_X86
+        case line_scan_impl_t::avx2:
+            return scan_lines_avx2(data, len, lines_out, max_lines);
+        case line_scan_impl_t::sse2:
+            return scan_lines_sse2(data, len, lines_out, max_lines);
+#endif
+        default:
+            return scan_lines_scalar(data, len, lines_out, max_lines);
+    }
+}
+
+size_t
+scan_lines(const char* data,
+           size_t len,
+           std::vector<scanned_line>& lines_out,
+           size_t max_lines)
+{
+    return scan_lines(line_scan_impl(), data, len, lines_out, max_lines);
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file line_scan.hh
+ */
+
+#ifndef lnav_line_scan_hh
+#define lnav_line_scan_hh
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+struct scanned_line {
+    /** The length of the line, including the line-feed. */
+    uint32_t sl_length;
+    /** True if the line, excluding the line-feed, is valid UTF-8. */
+    bool sl_valid_utf;
+};
+
+enum class line_scan_impl_t {
+    scalar,
+    sse2,
+    avx2,
+};
+
+/**
+ * Find the complete lines at the start of a buffer and check whether each one
+ * is valid UTF-8.  The line-feeds are located a block at a time with SIMD
+ * instructions, when the CPU supports them, and blocks that are plain ASCII
+ * do not need any further validation.  Only lines that contain non-ASCII
+ * bytes are passed through is_utf8().
+ *
+ * @param data The buffer to scan.
+ * @param len The length of the buffer.
+ * @param lines_out The vector the lines are appended to.
+ * @param max_lines The maximum number of lines to append.
+ * @return The number of bytes covered by the lines that were appended.  Any
+ *   data after that is a partial line.
+ */
+size_t scan_lines(const char* data,
+                  size_t len,
+                  std::vector<scanned_line>& lines_out,
+                  size_t max_lines = SIZE_MAX);
+
+/**
+ * Same as scan_lines(), but with the given implementation instead of the one
+ * selected for the current CPU.  The implementation must be supported.
+ */
+size_t scan_lines(line_scan_impl_t impl,
+                  const char* data,
+                  size_t len,
+                  std::vector<scanned_line>& lines_out,
+                  size_t max_lines = SIZE_MAX);
+
+/**
+ * @return True if the given implementation can be used on the current CPU.
+ */
+bool line_scan_impl_supported(line_scan_impl_t impl);
+
+/**
+ * @return The implementation that scan_lines() uses on the current CPU.
+ */
+line_scan_impl_t line_scan_impl();
+
+#endif
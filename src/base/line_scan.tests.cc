@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <random>
+#include <string>
+
+#include "base/line_scan.hh"
+#include "config.h"
+#include "doctest/doctest.h"
+
+static const line_scan_impl_t ALL_IMPLS[] = {
+    line_scan_impl_t::scalar,
+    line_scan_impl_t::sse2,
+    line_scan_impl_t::avx2,
+};
+
+TEST_CASE("scan_lines")
+{
+    std::string data = "abc\n\n\xc3\xa9t\xc3\xa9\nbad \xff\npartial";
+
+    for (auto impl : ALL_IMPLS) {
+        if (!line_scan_impl_supported(impl)) {
+            continue;
+        }
+
+        std::vector<scanned_line> lines;
+        auto consumed = scan_lines(impl, data.data(), data.size(), lines);
+
+        CHECK(consumed == data.size() - 7);
+        REQUIRE(lines.size() == 4);
+        CHECK(lines[0].sl_length == 4);
+        CHECK(lines[0].sl_valid_utf);
+        CHECK(lines[1].sl_length == 1);
+        CHECK(lines[1].sl_valid_utf);
+        CHECK(lines[2].sl_length == 6);
+        CHECK(lines[2].sl_valid_utf);
+        CHECK(lines[3].sl_length == 6);
+        CHECK_FALSE(lines[3].sl_valid_utf);
+
+        lines.clear();
+        consumed = scan_lines(impl, data.data(), data.size(), lines, 2);
+        CHECK(consumed == 5);
+        CHECK(lines.size() == 2);
+    }
+}
+
+TEST_CASE("scan_lines-random")
+{
+    static const char* FRAGMENTS[] = {
+        "a",
+        "hello, world",
+        "\n",
+        "\n\n",
+        "\xc3\xa9",
+        "\xe2\x82\xac",
+        "\xf0\x9f\x98\x80",
+        "\xc3",
+        "\x80",
+        "                                        ",
+    };
+
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<size_t> frag_dist(
+        0, sizeof(FRAGMENTS) / sizeof(FRAGMENTS[0]) - 1);
+
+    for (int round = 0; round < 200; round++) {
+        std::string data;
+
+        while (data.size() < (size_t) round * 7) {
+            data.append(FRAGMENTS[frag_dist(gen)]);
+        }
+
+        std::vector<scanned_line> expected;
+        auto expected_consumed = scan_lines(line_scan_impl_t::scalar,
+                                            data.data(),
+                                            data.size(),
+                                            expected);
+
+        size_t total = 0;
+        for (const auto& sl : expected) {
+            total += sl.sl_length;
+        }
+        CHECK(total == expected_consumed);
+
+        for (auto impl : ALL_IMPLS) {
+            if (!line_scan_impl_supported(impl)) {
+                continue;
+            }
+
+            std::vector<scanned_line> actual;
+            auto consumed
+                = scan_lines(impl, data.data(), data.size(), actual);
+
+            CHECK(consumed == expected_consumed);
+            REQUIRE(actual.size() == expected.size());
+            for (size_t lpc = 0; lpc < actual.size(); lpc++) {
+                CHECK(actual[lpc].sl_length == expected[lpc].sl_length);
+                CHECK(actual[lpc].sl_valid_utf
+                      == expected[lpc].sl_valid_utf);
+            }
+        }
+    }
+}
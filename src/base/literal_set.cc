@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file literal_set.cc
+ */
+
+#include <algorithm>
+#include <deque>
+
+#include "literal_set.hh"
+
+#include "config.h"
+#include "lnav_log.hh"
+
+static constexpr uint32_t NO_STATE = UINT32_MAX;
+
+size_t
+literal_set::add(const std::string& lit)
+{
+    require(!lit.empty());
+
+    auto iter = this->ls_ids.find(lit);
+
+    if (iter != this->ls_ids.end()) {
+        return iter->second;
+    }
+
+    auto retval = this->ls_literals.size();
+
+    this->ls_literals.emplace_back(lit);
+    this->ls_ids[lit] = retval;
+
+    return retval;
+}
+
+void
+literal_set::clear()
+{
+    this->ls_literals.clear();
+    this->ls_ids.clear();
+    this->compile();
+}
+
+void
+literal_set::compile()
+{
+    std::fill(std::begin(this->ls_classes), std::end(this->ls_classes), 0);
+    this->ls_class_count = 1;
+    for (const auto& lit : this->ls_literals) {
+        for (auto ch : lit) {
+            auto& cls = this->ls_classes[(uint8_t) ch];
+
+            if (cls == 0) {
+                cls = this->ls_class_count;
+                this->ls_class_count += 1;
+            }
+        }
+    }
+
+    auto class_count = this->ls_class_count;
+    std::vector<std::vector<uint32_t>> outputs(1);
+
+    /* Build the trie, with NO_STATE for the missing edges. */
+    this->ls_transitions.assign(class_count, NO_STATE);
+    for (size_t id = 0; id < this->ls_literals.size(); id++) {
+        uint32_t state = 0;
+
+        for (auto ch : this->ls_literals[id]) {
+            auto cls = this->ls_classes[(uint8_t) ch];
+            auto& next = this->ls_transitions[state * class_count + cls];
+
+            if (next == NO_STATE) {
+                next = outputs.size();
+                outputs.emplace_back();
+                this->ls_transitions.resize(outputs.size() * class_count,
+                                            NO_STATE);
+            }
+            state = this->ls_transitions[state * class_count + cls];
+        }
+        outputs[state].push_back(id);
+    }
+
+    /*
+     * Fill in the missing edges by following the failure links in
+     * breadth-first order, so the failure state of a state has always been
+     * completed before the state itself.
+     */
+    std::vector<uint32_t> failure(outputs.size(), 0);
+    std::deque<uint32_t> queue;
+
+    for (size_t cls = 0; cls < class_count; cls++) {
+        auto& next = this->ls_transitions[cls];
+
+        if (next == NO_STATE) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        auto state = queue.front();
+        auto fail_row = failure[state] * class_count;
+
+        queue.pop_front();
+        for (size_t cls = 0; cls < class_count; cls++) {
+            auto& next = this->ls_transitions[state * class_count + cls];
+
+            if (next == NO_STATE) {
+                next = this->ls_transitions[fail_row + cls];
+            } else {
+                auto fail_state = this->ls_transitions[fail_row + cls];
+
+                failure[next] = fail_state;
+                outputs[next].insert(outputs[next].end(),
+                                     outputs[fail_state].begin(),
+                                     outputs[fail_state].end());
+                queue.push_back(next);
+            }
+        }
+    }
+
+    this->ls_output_offsets.clear();
+    this->ls_outputs.clear();
+    for (const auto& out : outputs) {
+        this->ls_output_offsets.push_back(this->ls_outputs.size());
+        this->ls_outputs.insert(this->ls_outputs.end(), out.begin(), out.end());
+    }
+    this->ls_output_offsets.push_back(this->ls_outputs.size());
+}
+
+void
+literal_set::find(const char* str, size_t len, match_set& found_out) const
+{
+    found_out.ms_words.assign((this->ls_literals.size() + 63) / 64, 0);
+    if (this->ls_literals.empty()) {
+        return;
+    }
+
+    auto class_count = this->ls_class_count;
+    const auto* transitions = this->ls_transitions.data();
+    const auto* offsets = this->ls_output_offsets.data();
+    uint32_t state = 0;
+
+    for (size_t lpc = 0; lpc < len; lpc++) {
+        auto cls = this->ls_classes[(uint8_t) str[lpc]];
+
+        state = transitions[state * class_count + cls];
+        for (auto out = offsets[state]; out < offsets[state + 1]; out++) {
+            auto id = this->ls_outputs[out];
+
+            found_out.ms_words[id / 64] |= 1ULL << (id % 64);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file literal_set.hh
+ */
+
+#ifndef lnav_literal_set_hh
+#define lnav_literal_set_hh
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * A set of literal strings that can all be searched for in a single pass over
+ * a string.  The literals are compiled into an Aho-Corasick automaton with a
+ * dense transition table.  To keep the table small, the bytes that do not
+ * appear in any literal share a single column.
+ */
+class literal_set {
+public:
+    /**
+     * A bitmap with a bit for each literal in the set that was found.
+     */
+    class match_set {
+    public:
+        bool contains(size_t id) const
+        {
+            return (this->ms_words[id / 64] >> (id % 64)) & 1;
+        }
+
+        bool contains_all(const std::vector<size_t>& ids) const
+        {
+            for (auto id : ids) {
+                if (!this->contains(id)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        friend class literal_set;
+
+        std::vector<uint64_t> ms_words;
+    };
+
+    /**
+     * Add a literal to the set.  The set must be recompiled before it can
+     * be used again.
+     *
+     * @param lit The literal to add, it must not be empty.
+     * @return The ID of the literal, adding the same string twice returns
+     *   the same ID.
+     */
+    size_t add(const std::string& lit);
+
+    size_t size() const { return this->ls_literals.size(); }
+
+    bool empty() const { return this->ls_literals.empty(); }
+
+    const std::string& operator[](size_t id) const
+    {
+        return this->ls_literals[id];
+    }
+
+    void clear();
+
+    /**
+     * Build the automaton for the literals that have been added.
+     */
+    void compile();
+
+    /**
+     * Search for all of the literals in the given string.  The set must
+     * have been compiled after the last literal was added.
+     *
+     * @param str The string to search.
+     * @param len The length of the string.
+     * @param found_out The set of literals that were found.
+     */
+    void find(const char* str, size_t len, match_set& found_out) const;
+
+private:
+    std::vector<std::string> ls_literals;
+    std::unordered_map<std::string, size_t> ls_ids;
+
+    uint8_t ls_classes[256]{};
+    size_t ls_class_count{1};
+    std::vector<uint32_t> ls_transitions;
+    std::vector<uint32_t> ls_output_offsets;
+    std::vector<uint32_t> ls_outputs;
+};
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+
+#include "base/literal_set.hh"
+#include "config.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("literal_set::find")
+{
+    literal_set ls;
+    literal_set::match_set found;
+
+    auto he_id = ls.add("he");
+    auto she_id = ls.add("she");
+    auto his_id = ls.add("his");
+    auto hers_id = ls.add("hers");
+
+    CHECK(ls.add("she") == she_id);
+    CHECK(ls.size() == 4);
+    ls.compile();
+
+    ls.find("ushers", 6, found);
+    CHECK(found.contains(he_id));
+    CHECK(found.contains(she_id));
+    CHECK(found.contains(hers_id));
+    CHECK_FALSE(found.contains(his_id));
+    CHECK(found.contains_all({he_id, she_id}));
+    CHECK_FALSE(found.contains_all({he_id, his_id}));
+
+    ls.find("ahishe", 6, found);
+    CHECK(found.contains(he_id));
+    CHECK(found.contains(she_id));
+    CHECK(found.contains(his_id));
+    CHECK_FALSE(found.contains(hers_id));
+
+    ls.find("nothing", 7, found);
+    CHECK_FALSE(found.contains(he_id));
+    CHECK(found.contains_all({}));
+}
+
+TEST_CASE("literal_set::many")
+{
+    literal_set ls;
+    literal_set::match_set found;
+    std::vector<size_t> ids;
+
+    for (int lpc = 0; lpc < 100; lpc++) {
+        ids.push_back(ls.add("[" + std::to_string(lpc) + "]"));
+    }
+    ls.compile();
+
+    std::string line = "prefix [7] middle [42][99] suffix\xff";
+
+    ls.find(line.data(), line.size(), found);
+    for (int lpc = 0; lpc < 100; lpc++) {
+        CHECK(found.contains(ids[lpc]) == (lpc == 7 || lpc == 42 || lpc == 99));
+    }
+}
@@ -70,6 +70,14 @@ public:
 	    this->_cache_items_map.clear();
 	    this->_cache_items_list.clear();
 	}
+
+	void erase_range(const key_t& low, const key_t& high) {
+	    auto it = _cache_items_map.lower_bound(low);
+	    while (it != _cache_items_map.end() && it->first < high) {
+	        _cache_items_list.erase(it->second);
+	        it = _cache_items_map.erase(it);
+	    }
+	}
 	
 private:
 	std::list<key_value_pair_t> _cache_items_list;
@@ -46,6 +46,7 @@
 #include "papertrail_proc.hh"
 #include "service_tags.hh"
 #include "shlex.hh"
+#include "sql_util.cfg.hh"
 #include "sql_util.hh"
 #include "yajlpp/json_ptr.hh"
 
@@ -135,18 +136,58 @@ execute_command(exec_context& ec, const std::string& cmdline)
     return ec.make_error("no command to execute");
 }
 
-Result<std::string, lnav::console::user_message>
-execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
+/**
+ * The state of a query from the SQL prompt that did not finish within its
+ * time budget and is being stepped from the main loop.
+ */
+struct pending_sql {
+    exec_context* ps_context{nullptr};
+    auto_mem<sqlite3_stmt> ps_stmt{sqlite3_finalize};
+    lnav::console::snippet ps_source;
+    struct timeval ps_start_tv {};
+    sql_done_callback_t ps_callback;
+};
+
+static std::unique_ptr<pending_sql> PENDING_SQL;
+
+enum class sql_step_t {
+    done,
+    paused,
+    limited,
+};
+
+static void
+drop_pending_sql()
+{
+    if (PENDING_SQL) {
+        log_info("dropping pending query after %d rows",
+                 lnav_data.ld_db_row_source.row_count());
+        PENDING_SQL.reset();
+        lnav_data.ld_log_source.thaw_index();
+    }
+}
+
+/**
+ * Prepare a statement and bind its parameters.
+ *
+ * @return The result of the statement if it was a "dot" command that has
+ *   already been executed.
+ */
+static Result<nonstd::optional<std::string>, lnav::console::user_message>
+prepare_sql(exec_context& ec,
+            const std::string& sql,
+            auto_mem<sqlite3_stmt>& stmt,
+            std::string& alt_msg)
 {
-    db_label_source& dls = lnav_data.ld_db_row_source;
-    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
-    struct timeval start_tv, end_tv;
     std::string stmt_str = trim(sql);
-    std::string retval;
     int retcode;
 
     log_info("Executing SQL: %s", sql.c_str());
 
+    if (ec.ec_sql_callback == sql_callback) {
+        drop_pending_sql();
+    }
+
     lnav_data.ld_bottom_source.grep_error("");
 
     if (startswith(stmt_str, ".")) {
@@ -162,7 +203,7 @@ execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
             auto retval = cmd_iter->second->c_func(ec, stmt_str, args);
             ec.ec_current_help = nullptr;
 
-            return retval;
+            return Ok(nonstd::make_optional(TRY(retval)));
         }
     }
 
@@ -172,257 +213,463 @@ execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
 
     ec.ec_accumulator->clear();
 
-    auto source = ec.ec_source.top();
-    sql_progress_guard progress_guard(sql_progress,
-                                      sql_progress_finished,
-                                      source.s_source,
-                                      source.s_line,
-                                      source.s_content);
-    gettimeofday(&start_tv, nullptr);
     retcode = sqlite3_prepare_v2(
         lnav_data.ld_db.in(), stmt_str.c_str(), -1, stmt.out(), nullptr);
     if (retcode != SQLITE_OK) {
         const char* errmsg = sqlite3_errmsg(lnav_data.ld_db);
 
         alt_msg = "";
-        return ec.make_error("{}", errmsg);
+        return Err(ec.make_error_msg("{}", errmsg));
     }
     if (stmt == nullptr) {
         alt_msg = "";
-        return ec.make_error("No statement given");
+        return Err(ec.make_error_msg("No statement given"));
     }
 #ifdef HAVE_SQLITE3_STMT_READONLY
-    else if (ec.is_read_only() && !sqlite3_stmt_readonly(stmt.in()))
-    {
-        return ec.make_error(
-            "modifying statements are not allowed in this context: {}", sql);
+    if (ec.is_read_only() && !sqlite3_stmt_readonly(stmt.in())) {
+        return Err(ec.make_error_msg(
+            "modifying statements are not allowed in this context: {}", sql));
     }
 #endif
-    else
-    {
-        bool done = false;
-        int param_count;
 
-        param_count = sqlite3_bind_parameter_count(stmt.in());
-        for (int lpc = 0; lpc < param_count; lpc++) {
-            std::map<std::string, std::string>::iterator ov_iter;
-            const char* name;
+    int param_count = sqlite3_bind_parameter_count(stmt.in());
+    for (int lpc = 0; lpc < param_count; lpc++) {
+        std::map<std::string, std::string>::iterator ov_iter;
+        const char* name;
+
+        name = sqlite3_bind_parameter_name(stmt.in(), lpc + 1);
+        ov_iter = ec.ec_override.find(name);
+        if (ov_iter != ec.ec_override.end()) {
+            sqlite3_bind_text(stmt.in(),
+                              lpc,
+                              ov_iter->second.c_str(),
+                              ov_iter->second.length(),
+                              SQLITE_TRANSIENT);
+        } else if (name[0] == '$') {
+            const auto& lvars = ec.ec_local_vars.top();
+            const auto& gvars = ec.ec_global_vars;
+            std::map<std::string, std::string>::const_iterator local_var,
+                global_var;
+            const char* env_value;
+
+            if (lnav_data.ld_window) {
+                char buf[32];
+                int lines, cols;
+
+                getmaxyx(lnav_data.ld_window, lines, cols);
+                if (strcmp(name, "$LINES") == 0) {
+                    snprintf(buf, sizeof(buf), "%d", lines);
+                    sqlite3_bind_text(
+                        stmt.in(), lpc + 1, buf, -1, SQLITE_TRANSIENT);
+                } else if (strcmp(name, "$COLS") == 0) {
+                    snprintf(buf, sizeof(buf), "%d", cols);
+                    sqlite3_bind_text(
+                        stmt.in(), lpc + 1, buf, -1, SQLITE_TRANSIENT);
+                }
+            }
 
-            name = sqlite3_bind_parameter_name(stmt.in(), lpc + 1);
-            ov_iter = ec.ec_override.find(name);
-            if (ov_iter != ec.ec_override.end()) {
+            if ((local_var = lvars.find(&name[1])) != lvars.end()) {
                 sqlite3_bind_text(stmt.in(),
-                                  lpc,
-                                  ov_iter->second.c_str(),
-                                  ov_iter->second.length(),
+                                  lpc + 1,
+                                  local_var->second.c_str(),
+                                  -1,
                                   SQLITE_TRANSIENT);
-            } else if (name[0] == '$') {
-                const auto& lvars = ec.ec_local_vars.top();
-                const auto& gvars = ec.ec_global_vars;
-                std::map<std::string, std::string>::const_iterator local_var,
-                    global_var;
-                const char* env_value;
-
-                if (lnav_data.ld_window) {
-                    char buf[32];
-                    int lines, cols;
-
-                    getmaxyx(lnav_data.ld_window, lines, cols);
-                    if (strcmp(name, "$LINES") == 0) {
-                        snprintf(buf, sizeof(buf), "%d", lines);
-                        sqlite3_bind_text(
-                            stmt.in(), lpc + 1, buf, -1, SQLITE_TRANSIENT);
-                    } else if (strcmp(name, "$COLS") == 0) {
-                        snprintf(buf, sizeof(buf), "%d", cols);
-                        sqlite3_bind_text(
-                            stmt.in(), lpc + 1, buf, -1, SQLITE_TRANSIENT);
-                    }
-                }
-
-                if ((local_var = lvars.find(&name[1])) != lvars.end()) {
-                    sqlite3_bind_text(stmt.in(),
-                                      lpc + 1,
-                                      local_var->second.c_str(),
-                                      -1,
-                                      SQLITE_TRANSIENT);
-                } else if ((global_var = gvars.find(&name[1])) != gvars.end()) {
-                    sqlite3_bind_text(stmt.in(),
-                                      lpc + 1,
-                                      global_var->second.c_str(),
-                                      -1,
-                                      SQLITE_TRANSIENT);
-                } else if ((env_value = getenv(&name[1])) != nullptr) {
-                    sqlite3_bind_text(
-                        stmt.in(), lpc + 1, env_value, -1, SQLITE_STATIC);
+            } else if ((global_var = gvars.find(&name[1])) != gvars.end()) {
+                sqlite3_bind_text(stmt.in(),
+                                  lpc + 1,
+                                  global_var->second.c_str(),
+                                  -1,
+                                  SQLITE_TRANSIENT);
+            } else if ((env_value = getenv(&name[1])) != nullptr) {
+                sqlite3_bind_text(
+                    stmt.in(), lpc + 1, env_value, -1, SQLITE_STATIC);
+            }
+        } else if (name[0] == ':' && ec.ec_line_values != nullptr) {
+            for (auto& lv : *ec.ec_line_values) {
+                if (lv.lv_meta.lvm_name != &name[1]) {
+                    continue;
                 }
-            } else if (name[0] == ':' && ec.ec_line_values != nullptr) {
-                for (auto& lv : *ec.ec_line_values) {
-                    if (lv.lv_meta.lvm_name != &name[1]) {
-                        continue;
-                    }
-                    switch (lv.lv_meta.lvm_kind) {
-                        case value_kind_t::VALUE_BOOLEAN:
-                            sqlite3_bind_int64(
-                                stmt.in(), lpc + 1, lv.lv_value.i);
-                            break;
-                        case value_kind_t::VALUE_FLOAT:
-                            sqlite3_bind_double(
-                                stmt.in(), lpc + 1, lv.lv_value.d);
-                            break;
-                        case value_kind_t::VALUE_INTEGER:
-                            sqlite3_bind_int64(
-                                stmt.in(), lpc + 1, lv.lv_value.i);
-                            break;
-                        case value_kind_t::VALUE_NULL:
-                            sqlite3_bind_null(stmt.in(), lpc + 1);
-                            break;
-                        default:
-                            sqlite3_bind_text(stmt.in(),
-                                              lpc + 1,
-                                              lv.text_value(),
-                                              lv.text_length(),
-                                              SQLITE_TRANSIENT);
-                            break;
-                    }
+                switch (lv.lv_meta.lvm_kind) {
+                    case value_kind_t::VALUE_BOOLEAN:
+                        sqlite3_bind_int64(stmt.in(), lpc + 1, lv.lv_value.i);
+                        break;
+                    case value_kind_t::VALUE_FLOAT:
+                        sqlite3_bind_double(stmt.in(), lpc + 1, lv.lv_value.d);
+                        break;
+                    case value_kind_t::VALUE_INTEGER:
+                        sqlite3_bind_int64(stmt.in(), lpc + 1, lv.lv_value.i);
+                        break;
+                    case value_kind_t::VALUE_NULL:
+                        sqlite3_bind_null(stmt.in(), lpc + 1);
+                        break;
+                    default:
+                        sqlite3_bind_text(stmt.in(),
+                                          lpc + 1,
+                                          lv.text_value(),
+                                          lv.text_length(),
+                                          SQLITE_TRANSIENT);
+                        break;
                 }
-            } else {
-                sqlite3_bind_null(stmt.in(), lpc + 1);
-                log_warning("Could not bind variable: %s", name);
             }
+        } else {
+            sqlite3_bind_null(stmt.in(), lpc + 1);
+            log_warning("Could not bind variable: %s", name);
         }
+    }
 
-        if (lnav_data.ld_rl_view != nullptr) {
-            lnav_data.ld_rl_view->set_value("Executing query: " + sql + " ...");
+    return Ok(nonstd::optional<std::string>());
+}
+
+/**
+ * Step through the rows of a statement and pass them to the SQL callback.
+ *
+ * @param deadline If given, the time after which stepping is paused so that
+ *   it can be resumed later.
+ * @param max_size If not zero, stop stepping once the query results use
+ *   more than this many bytes.
+ */
+static Result<sql_step_t, lnav::console::user_message>
+step_sql(exec_context& ec,
+         sqlite3_stmt* stmt,
+         nonstd::optional<ui_clock::time_point> deadline,
+         size_t max_size = 0)
+{
+    auto& dls = lnav_data.ld_db_row_source;
+    size_t step_count = 0;
+
+    while (true) {
+        if (deadline && step_count > 0 && ui_clock::now() >= deadline.value())
+        {
+            return Ok(sql_step_t::paused);
+        }
+        if (max_size > 0 && step_count > 0 && (step_count % 1024) == 0
+            && dls.memory_usage() > max_size)
+        {
+            return Ok(sql_step_t::limited);
         }
 
-        ec.ec_sql_callback(ec, stmt.in());
-        while (!done) {
-            retcode = sqlite3_step(stmt.in());
+        auto retcode = sqlite3_step(stmt);
+        step_count += 1;
 
-            switch (retcode) {
-                case SQLITE_OK:
-                case SQLITE_DONE:
-                    done = true;
-                    break;
+        switch (retcode) {
+            case SQLITE_OK:
+            case SQLITE_DONE:
+                return Ok(sql_step_t::done);
 
-                case SQLITE_ROW:
-                    ec.ec_sql_callback(ec, stmt.in());
-                    break;
+            case SQLITE_ROW:
+                ec.ec_sql_callback(ec, stmt);
+                break;
 
-                default: {
-                    const char* errmsg;
+            default: {
+                const char* errmsg;
 
-                    log_error("sqlite3_step error code: %d", retcode);
-                    errmsg = sqlite3_errmsg(lnav_data.ld_db);
-                    if (startswith(errmsg, "lnav-error:")) {
-                        return Err(lnav::from_json<lnav::console::user_message>(
-                            &errmsg[11]));
-                    }
-                    return ec.make_error("{}", errmsg);
+                log_error("sqlite3_step error code: %d", retcode);
+                errmsg = sqlite3_errmsg(lnav_data.ld_db);
+                if (startswith(errmsg, "lnav-error:")) {
+                    return Err(lnav::from_json<lnav::console::user_message>(
+                        &errmsg[11]));
                 }
+                return Err(ec.make_error_msg("{}", errmsg));
             }
         }
+    }
+}
 
-        if (!dls.dls_rows.empty() && !ec.ec_local_vars.empty()
-            && !ec.ec_dry_run) {
-            auto& vars = ec.ec_local_vars.top();
-
-            for (unsigned int lpc = 0; lpc < dls.dls_headers.size(); lpc++) {
-                const auto& column_name = dls.dls_headers[lpc].hm_name;
+/**
+ * Update the views and variables after a statement has finished.
+ *
+ * @return The message that summarizes the results.
+ */
+static std::string
+finish_sql(exec_context& ec,
+           sqlite3_stmt* stmt,
+           const struct timeval& start_tv,
+           std::string& alt_msg)
+{
+    db_label_source& dls = lnav_data.ld_db_row_source;
+    struct timeval end_tv;
+    std::string retval;
 
-                if (sql_ident_needs_quote(column_name.c_str())) {
-                    continue;
-                }
+    if (!dls.empty() && !ec.ec_local_vars.empty() && !ec.ec_dry_run) {
+        auto& vars = ec.ec_local_vars.top();
 
-                const auto* value = dls.dls_rows[0][lpc];
-                if (value == nullptr) {
-                    continue;
-                }
+        for (unsigned int lpc = 0; lpc < dls.dls_headers.size(); lpc++) {
+            const auto& column_name = dls.dls_headers[lpc].hm_name;
 
-                vars[column_name] = value;
+            if (sql_ident_needs_quote(column_name.c_str())) {
+                continue;
             }
-        }
 
-        if (lnav_data.ld_rl_view != nullptr) {
-            lnav_data.ld_rl_view->set_value("");
+            vars[column_name] = dls.get_cell(0, lpc);
         }
     }
 
-    gettimeofday(&end_tv, nullptr);
-    if (retcode == SQLITE_DONE) {
-        if (lnav_data.ld_log_source.is_line_meta_changed()) {
-            lnav_data.ld_log_source.text_filters_changed();
-            lnav_data.ld_views[LNV_LOG].reload_data();
-        }
-        lnav_data.ld_filter_view.reload_data();
-        lnav_data.ld_files_view.reload_data();
-        lnav_data.ld_views[LNV_DB].reload_data();
-        lnav_data.ld_views[LNV_DB].set_left(0);
-
-        if (!ec.ec_accumulator->empty()) {
-            retval = ec.ec_accumulator->get_string();
-        } else if (!dls.dls_rows.empty()) {
-            if (lnav_data.ld_flags & LNF_HEADLESS) {
-                if (ec.ec_local_vars.size() == 1) {
-                    ensure_view(&lnav_data.ld_views[LNV_DB]);
-                }
+    if (lnav_data.ld_rl_view != nullptr) {
+        lnav_data.ld_rl_view->set_value("");
+    }
 
-                retval = "";
-                alt_msg = "";
-            } else if (dls.dls_rows.size() == 1) {
-                auto& row = dls.dls_rows[0];
+    gettimeofday(&end_tv, nullptr);
+    if (lnav_data.ld_log_source.is_line_meta_changed()) {
+        lnav_data.ld_log_source.text_filters_changed();
+        lnav_data.ld_views[LNV_LOG].reload_data();
+    }
+    lnav_data.ld_filter_view.reload_data();
+    lnav_data.ld_files_view.reload_data();
+    lnav_data.ld_views[LNV_DB].reload_data();
+    lnav_data.ld_views[LNV_DB].set_left(0);
+
+    if (!ec.ec_accumulator->empty()) {
+        retval = ec.ec_accumulator->get_string();
+    } else if (!dls.empty()) {
+        if (lnav_data.ld_flags & LNF_HEADLESS) {
+            if (ec.ec_local_vars.size() == 1) {
+                ensure_view(&lnav_data.ld_views[LNV_DB]);
+            }
 
-                if (dls.dls_headers.size() == 1) {
-                    retval = row[0];
-                } else {
-                    for (unsigned int lpc = 0; lpc < dls.dls_headers.size();
-                         lpc++) {
-                        if (lpc > 0) {
-                            retval.append("; ");
-                        }
-                        retval.append(dls.dls_headers[lpc].hm_name);
-                        retval.push_back('=');
-                        retval.append(row[lpc]);
+            retval = "";
+            alt_msg = "";
+        } else if (dls.row_count() == 1) {
+            if (dls.dls_headers.size() == 1) {
+                retval = dls.get_cell(0, 0);
+            } else {
+                for (unsigned int lpc = 0; lpc < dls.dls_headers.size(); lpc++)
+                {
+                    if (lpc > 0) {
+                        retval.append("; ");
                     }
+                    retval.append(dls.dls_headers[lpc].hm_name);
+                    retval.push_back('=');
+                    retval.append(dls.get_cell(0, lpc));
                 }
-            } else {
-                int row_count = dls.dls_rows.size();
-                char row_count_buf[128];
-                struct timeval diff_tv;
-
-                timersub(&end_tv, &start_tv, &diff_tv);
-                snprintf(row_count_buf,
-                         sizeof(row_count_buf),
-                         ANSI_BOLD("%'d") " row%s matched in " ANSI_BOLD(
-                             "%ld.%03ld") " seconds",
-                         row_count,
-                         row_count == 1 ? "" : "s",
-                         diff_tv.tv_sec,
-                         std::max((long) diff_tv.tv_usec / 1000, 1L));
-                retval = row_count_buf;
-                alt_msg = HELP_MSG_2(
-                    y,
-                    Y,
-                    "to move forward/backward through query results "
-                    "in the log view");
             }
+        } else {
+            int row_count = dls.row_count();
+            char row_count_buf[128];
+            struct timeval diff_tv;
+
+            timersub(&end_tv, &start_tv, &diff_tv);
+            snprintf(row_count_buf,
+                     sizeof(row_count_buf),
+                     ANSI_BOLD("%'d") " row%s matched in " ANSI_BOLD(
+                         "%ld.%03ld") " seconds",
+                     row_count,
+                     row_count == 1 ? "" : "s",
+                     diff_tv.tv_sec,
+                     std::max((long) diff_tv.tv_usec / 1000, 1L));
+            retval = row_count_buf;
+            alt_msg = HELP_MSG_2(
+                y,
+                Y,
+                "to move forward/backward through query results "
+                "in the log view");
         }
+    }
 #ifdef HAVE_SQLITE3_STMT_READONLY
-        else if (sqlite3_stmt_readonly(stmt.in()))
-        {
-            retval = "info: No rows matched";
-            alt_msg = "";
+    else if (sqlite3_stmt_readonly(stmt))
+    {
+        retval = "info: No rows matched";
+        alt_msg = "";
 
-            if (lnav_data.ld_flags & LNF_HEADLESS) {
-                if (ec.ec_local_vars.size() == 1) {
-                    ensure_view(&lnav_data.ld_views[LNV_DB]);
-                }
+        if (lnav_data.ld_flags & LNF_HEADLESS) {
+            if (ec.ec_local_vars.size() == 1) {
+                ensure_view(&lnav_data.ld_views[LNV_DB]);
             }
         }
+    }
 #endif
+
+    return retval;
+}
+
+Result<std::string, lnav::console::user_message>
+execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
+{
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+    struct timeval start_tv;
+
+    auto source = ec.ec_source.top();
+    sql_progress_guard progress_guard(sql_progress,
+                                      sql_progress_finished,
+                                      source.s_source,
+                                      source.s_line,
+                                      source.s_content);
+    gettimeofday(&start_tv, nullptr);
+    auto dot_result = TRY(prepare_sql(ec, sql, stmt, alt_msg));
+    if (dot_result) {
+        return Ok(dot_result.value());
     }
 
-    return Ok(retval);
+    if (lnav_data.ld_rl_view != nullptr) {
+        lnav_data.ld_rl_view->set_value("Executing query: " + sql + " ...");
+    }
+
+    ec.ec_sql_callback(ec, stmt.in());
+    TRY(step_sql(ec, stmt.in(), nonstd::nullopt));
+
+    return Ok(finish_sql(ec, stmt.in(), start_tv, alt_msg));
+}
+
+static std::string
+pending_sql_status()
+{
+    return fmt::format(FMT_STRING("Executing query: {:L} rows so far ...  "
+                                  "Press " ANSI_BOLD("Esc") " to cancel"),
+                       lnav_data.ld_db_row_source.row_count());
+}
+
+void
+execute_sql_incrementally(exec_context& ec,
+                          const std::string& sql,
+                          ui_clock::time_point deadline,
+                          sql_done_callback_t cb)
+{
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+    struct timeval start_tv;
+    std::string alt_msg;
+
+    auto source = ec.ec_source.top();
+    sql_progress_guard progress_guard(
+        sql_progress, nullptr, source.s_source, source.s_line, source.s_content);
+    gettimeofday(&start_tv, nullptr);
+    auto prep_res = prepare_sql(ec, sql, stmt, alt_msg);
+    if (prep_res.isErr()) {
+        sql_progress_finished();
+        cb(Err(prep_res.unwrapErr()), alt_msg);
+        return;
+    }
+    auto dot_result = prep_res.unwrap();
+    if (dot_result) {
+        cb(Ok(dot_result.value()), alt_msg);
+        return;
+    }
+
+    const auto& cfg = injector::get<const lnav::sql::config&>();
+
+    ec.ec_sql_callback(ec, stmt.in());
+    auto step_res = step_sql(ec, stmt.in(), deadline, cfg.c_max_result_size);
+    if (step_res.isErr()) {
+        sql_progress_finished();
+        cb(Err(step_res.unwrapErr()), alt_msg);
+        return;
+    }
+
+    if (step_res.unwrap() == sql_step_t::paused) {
+        log_info("query is still running after %d rows, stepping from "
+                 "the main loop",
+                 lnav_data.ld_db_row_source.row_count());
+        PENDING_SQL = std::make_unique<pending_sql>();
+        PENDING_SQL->ps_context = &ec;
+        PENDING_SQL->ps_stmt = stmt.release();
+        PENDING_SQL->ps_source = source;
+        PENDING_SQL->ps_start_tv = start_tv;
+        PENDING_SQL->ps_callback = std::move(cb);
+        // The log tables walk the index by visible line number, so the
+        // existing lines must not move until the query is done.
+        lnav_data.ld_log_source.freeze_index();
+
+        lnav_data.ld_views[LNV_DB].reload_data();
+        if (!lnav_data.ld_db_row_source.empty()) {
+            ensure_view(&lnav_data.ld_views[LNV_DB]);
+        }
+        if (lnav_data.ld_rl_view != nullptr) {
+            lnav_data.ld_rl_view->set_value(pending_sql_status());
+        }
+        return;
+    }
+
+    auto msg = finish_sql(ec, stmt.in(), start_tv, alt_msg);
+    sql_progress_finished();
+    if (step_res.unwrap() == sql_step_t::limited) {
+        msg = fmt::format(FMT_STRING("{} (stopped at the result size limit)"),
+                          msg);
+    }
+    cb(Ok(msg), alt_msg);
+}
+
+bool
+is_sql_pending()
+{
+    return PENDING_SQL != nullptr;
+}
+
+size_t
+step_pending_sql(ui_clock::time_point deadline)
+{
+    if (!PENDING_SQL) {
+        return 0;
+    }
+
+    auto& ps = *PENDING_SQL;
+    auto& ec = *ps.ps_context;
+    auto& dls = lnav_data.ld_db_row_source;
+    const auto& cfg = injector::get<const lnav::sql::config&>();
+    auto rows_before = dls.row_count();
+    std::string alt_msg;
+
+    ec.ec_source.push(ps.ps_source);
+    auto step_res = [&]() {
+        sql_progress_guard progress_guard(sql_progress,
+                                          nullptr,
+                                          ps.ps_source.s_source,
+                                          ps.ps_source.s_line,
+                                          ps.ps_source.s_content);
+
+        return step_sql(ec, ps.ps_stmt.in(), deadline, cfg.c_max_result_size);
+    }();
+    ec.ec_source.pop();
+
+    if (step_res.isOk() && step_res.unwrap() == sql_step_t::paused) {
+        lnav_data.ld_views[LNV_DB].reload_data();
+        if (lnav_data.ld_rl_view != nullptr) {
+            lnav_data.ld_rl_view->set_value(pending_sql_status());
+        }
+        return 1 + dls.row_count() - rows_before;
+    }
+
+    auto pending = std::move(PENDING_SQL);
+    lnav_data.ld_log_source.thaw_index();
+    if (step_res.isErr()) {
+        sql_progress_finished();
+        pending->ps_callback(Err(step_res.unwrapErr()), alt_msg);
+    } else {
+        auto msg = finish_sql(
+            ec, pending->ps_stmt.in(), pending->ps_start_tv, alt_msg);
+        sql_progress_finished();
+        if (step_res.unwrap() == sql_step_t::limited) {
+            msg = fmt::format(
+                FMT_STRING("{} (stopped at the result size limit)"), msg);
+        }
+        pending->ps_callback(Ok(msg), alt_msg);
+    }
+
+    return 1 + dls.row_count() - rows_before;
+}
+
+void
+cancel_pending_sql()
+{
+    if (!PENDING_SQL) {
+        return;
+    }
+
+    auto pending = std::move(PENDING_SQL);
+    auto row_count = lnav_data.ld_db_row_source.row_count();
+
+    lnav_data.ld_log_source.thaw_index();
+    std::string alt_msg;
+
+    log_info("query cancelled after %d rows", row_count);
+    finish_sql(*pending->ps_context,
+               pending->ps_stmt.in(),
+               pending->ps_start_tv,
+               alt_msg);
+    sql_progress_finished();
+    pending->ps_callback(
+        Ok(fmt::format(FMT_STRING("query cancelled after " ANSI_BOLD("{:L}")
+                                  " row{}"),
+                       row_count,
+                       row_count == 1 ? "" : "s")),
+        alt_msg);
 }
 
 static Result<std::string, lnav::console::user_message>
@@ -735,7 +982,7 @@ execute_init_commands(
 #endif
     }
 
-    if (dls.dls_rows.size() > 1) {
+    if (dls.row_count() > 1) {
         ensure_view(&lnav_data.ld_views[LNV_DB]);
     }
 
@@ -756,11 +1003,8 @@ sql_callback(exec_context& ec, sqlite3_stmt* stmt)
     stacked_bar_chart<std::string>& chart = dls.dls_chart;
     view_colors& vc = view_colors::singleton();
     int ncols = sqlite3_column_count(stmt);
-    int row_number;
     int lpc, retval = 0;
 
-    row_number = dls.dls_rows.size();
-    dls.dls_rows.resize(row_number + 1);
     if (dls.dls_headers.empty()) {
         for (lpc = 0; lpc < ncols; lpc++) {
             int type = sqlite3_column_type(stmt, lpc);
@@ -780,10 +1024,9 @@ sql_callback(exec_context& ec, sqlite3_stmt* stmt)
         }
     }
     for (lpc = 0; lpc < ncols; lpc++) {
-        const char* value = (const char*) sqlite3_column_text(stmt, lpc);
         db_label_source::header_meta& hm = dls.dls_headers[lpc];
 
-        dls.push_column(value);
+        dls.push_column(stmt, lpc);
         if ((hm.hm_column_type == SQLITE_TEXT
              || hm.hm_column_type == SQLITE_NULL)
             && hm.hm_sub_type == 0)
@@ -30,6 +30,7 @@
 #ifndef LNAV_COMMAND_EXECUTOR_H
 #define LNAV_COMMAND_EXECUTOR_H
 
+#include <functional>
 #include <future>
 #include <stack>
 #include <string>
@@ -42,6 +43,7 @@
 #include "fmt/format.h"
 #include "ghc/filesystem.hpp"
 #include "help_text.hh"
+#include "logfile_fwd.hh"
 #include "optional.hpp"
 #include "shlex.resolver.hh"
 #include "vis_line.hh"
@@ -87,15 +89,22 @@ struct exec_context {
     void add_error_context(lnav::console::user_message& um);
 
     template<typename... Args>
-    Result<std::string, lnav::console::user_message> make_error(
-        fmt::string_view format_str, const Args&... args)
+    lnav::console::user_message make_error_msg(fmt::string_view format_str,
+                                               const Args&... args)
     {
         auto retval = lnav::console::user_message::error(
             fmt::vformat(format_str, fmt::make_format_args(args...)));
 
         this->add_error_context(retval);
 
-        return Err(retval);
+        return retval;
+    }
+
+    template<typename... Args>
+    Result<std::string, lnav::console::user_message> make_error(
+        fmt::string_view format_str, const Args&... args)
+    {
+        return Err(this->make_error_msg(format_str, args...));
     }
 
     nonstd::optional<FILE*> get_output()
@@ -181,6 +190,42 @@ Result<std::string, lnav::console::user_message> execute_command(
 
 Result<std::string, lnav::console::user_message> execute_sql(
     exec_context& ec, const std::string& sql, std::string& alt_msg);
+
+using sql_done_callback_t = std::function<void(
+    Result<std::string, lnav::console::user_message>, const std::string&)>;
+
+/**
+ * Execute a SQL statement from the prompt.  If the statement is still
+ * returning rows when the deadline passes, it is left pending so that the
+ * rows read so far can be displayed while step_pending_sql() reads the rest
+ * from the main loop.
+ *
+ * @param cb Called with the result and alternate message once the
+ *   statement has finished, was stopped, or failed.
+ */
+void execute_sql_incrementally(exec_context& ec,
+                               const std::string& sql,
+                               ui_clock::time_point deadline,
+                               sql_done_callback_t cb);
+
+/**
+ * @return True if a statement from the prompt is still returning rows.
+ */
+bool is_sql_pending();
+
+/**
+ * Read more rows from the pending statement until the deadline passes.
+ *
+ * @return Zero if there is no pending statement, otherwise a count of the
+ *   work that was done.
+ */
+size_t step_pending_sql(ui_clock::time_point deadline);
+
+/**
+ * Stop the pending statement and keep the rows that were already read.
+ */
+void cancel_pending_sql();
+
 Result<std::string, lnav::console::user_message> execute_file(
     exec_context& ec, const std::string& path_and_args, bool multiline = true);
 Result<std::string, lnav::console::user_message> execute_any(
@@ -34,6 +34,7 @@
 #include "base/date_time_scanner.hh"
 #include "base/time_util.hh"
 #include "config.h"
+#include "fmt/format.h"
 #include "yajlpp/json_ptr.hh"
 
 const char* db_label_source::NULL_STR = "<NULL>";
@@ -56,13 +57,13 @@ db_label_source::text_value_for_line(textview_curses& tc,
      */
 
     label_out.clear();
-    if (row >= (int) this->dls_rows.size()) {
+    if (row >= (int) this->dls_row_count) {
         return;
     }
-    for (int lpc = 0; lpc < (int) this->dls_rows[row].size(); lpc++) {
+    for (int lpc = 0; lpc < (int) this->dls_columns.size(); lpc++) {
         auto actual_col_size
             = std::min(MAX_COLUMN_WIDTH, this->dls_headers[lpc].hm_column_size);
-        auto raw_cell_str = std::string(this->dls_rows[row][lpc]);
+        auto raw_cell_str = this->get_cell(row, lpc);
         std::string cell_str;
 
         for (const auto ch : raw_cell_str) {
@@ -107,7 +108,7 @@ db_label_source::text_attrs_for_line(textview_curses& tc,
     struct line_range lr(0, 0);
     struct line_range lr2(0, -1);
 
-    if (row >= (int) this->dls_rows.size()) {
+    if (row >= (int) this->dls_row_count) {
         return;
     }
     for (size_t lpc = 0; lpc < this->dls_headers.size() - 1; lpc++) {
@@ -122,17 +123,27 @@ db_label_source::text_attrs_for_line(textview_curses& tc,
 
     int left = 0;
     for (size_t lpc = 0; lpc < this->dls_headers.size(); lpc++) {
-        const char* row_value = this->dls_rows[row][lpc];
-        size_t row_len = strlen(row_value);
+        const auto& cv = this->dls_columns[lpc];
 
         if (this->dls_headers[lpc].hm_graphable) {
-            double num_value;
+            auto num_value = cv.number_at(row);
 
-            if (sscanf(row_value, "%lf", &num_value) == 1) {
+            if (num_value) {
                 this->dls_chart.chart_attrs_for_value(
-                    tc, left, this->dls_headers[lpc].hm_name, num_value, sa);
+                    tc,
+                    left,
+                    this->dls_headers[lpc].hm_name,
+                    num_value.value(),
+                    sa);
             }
         }
+
+        const char* row_value = cv.text_at(row);
+        if (row_value == nullptr || cv.is_null(row)) {
+            continue;
+        }
+
+        size_t row_len = strlen(row_value);
         if (row_len > 2 && row_len < MAX_COLUMN_WIDTH
             && ((row_value[0] == '{' && row_value[row_len - 1] == '}')
                 || (row_value[0] == '[' && row_value[row_len - 1] == ']')))
@@ -164,6 +175,7 @@ db_label_source::push_header(const std::string& colstr,
                              bool graphable)
 {
     this->dls_headers.emplace_back(colstr);
+    this->dls_columns.emplace_back();
     this->dls_cell_width.push_back(0);
 
     header_meta& hm = this->dls_headers.back();
@@ -177,28 +189,54 @@ db_label_source::push_header(const std::string& colstr,
 }
 
 void
-db_label_source::push_column(const char* colstr)
+db_label_source::push_column(sqlite3_stmt* stmt, int col)
 {
     view_colors& vc = view_colors::singleton();
-    int index = this->dls_rows.back().size();
+    auto& hm = this->dls_headers[col];
+    auto& cv = this->dls_columns[col];
     double num_value = 0.0;
-    size_t value_len;
-
-    if (colstr == nullptr) {
-        colstr = NULL_STR;
-    } else {
-        colstr = strdup(colstr);
-        if (colstr == nullptr) {
-            throw "out of memory";
+    const char* colstr = nullptr;
+    size_t value_len = 0;
+    bool is_number = false;
+
+    switch (sqlite3_column_type(stmt, col)) {
+        case SQLITE_NULL:
+            cv.push_null();
+            colstr = NULL_STR;
+            value_len = strlen(NULL_STR);
+            break;
+        case SQLITE_INTEGER: {
+            auto value = sqlite3_column_int64(stmt, col);
+
+            cv.push_integer(value);
+            num_value = value;
+            is_number = true;
+            value_len = fmt::format_int(value).size();
+            break;
         }
+        case SQLITE_FLOAT:
+            num_value = sqlite3_column_double(stmt, col);
+            colstr = (const char*) sqlite3_column_text(stmt, col);
+            value_len = strlen(colstr);
+            cv.push_real(num_value, colstr, value_len);
+            is_number = true;
+            break;
+        default:
+            colstr = (const char*) sqlite3_column_text(stmt, col);
+            if (colstr == nullptr) {
+                colstr = "";
+            }
+            value_len = strlen(colstr);
+            cv.push_text(colstr, value_len);
+            break;
     }
-    value_len = strlen(colstr);
 
-    if (index == this->dls_time_column_index) {
+    if (col == this->dls_time_column_index) {
         date_time_scanner dts;
         struct timeval tv;
+        auto time_str = this->get_cell(cv.size() - 1, col);
 
-        if (!dts.convert_to_timeval(colstr, -1, nullptr, tv)) {
+        if (!dts.convert_to_timeval(time_str.c_str(), -1, nullptr, tv)) {
             tv.tv_sec = -1;
             tv.tv_usec = -1;
         }
@@ -211,17 +249,21 @@ db_label_source::push_column(const char* colstr)
         }
     }
 
-    this->dls_rows.back().push_back(colstr);
-    this->dls_headers[index].hm_column_size
-        = std::max(this->dls_headers[index].hm_column_size,
-                   utf8_string_length(colstr, value_len).unwrapOr(value_len));
+    if (colstr == nullptr) {
+        // Integers are plain ASCII, so the length is their width.
+        hm.hm_column_size = std::max(hm.hm_column_size, value_len);
+    } else {
+        hm.hm_column_size
+            = std::max(hm.hm_column_size,
+                       utf8_string_length(colstr, value_len).unwrapOr(value_len));
+    }
 
-    if (colstr != nullptr && this->dls_headers[index].hm_graphable) {
-        if (sscanf(colstr, "%lf", &num_value) != 1) {
+    if (hm.hm_graphable) {
+        if (!is_number && sscanf(colstr, "%lf", &num_value) != 1) {
             num_value = 0.0;
         }
-        this->dls_chart.add_value(this->dls_headers[index].hm_name, num_value);
-    } else if (value_len > 2
+        this->dls_chart.add_value(hm.hm_name, num_value);
+    } else if (colstr != nullptr && value_len > 2
                && ((colstr[0] == '{' && colstr[value_len - 1] == '}')
                    || (colstr[0] == '[' && colstr[value_len - 1] == ']')))
     {
@@ -242,6 +284,10 @@ db_label_source::push_column(const char* colstr)
             }
         }
     }
+
+    if (col + 1 == (int) this->dls_columns.size()) {
+        this->dls_row_count += 1;
+    }
 }
 
 void
@@ -249,16 +295,198 @@ db_label_source::clear()
 {
     this->dls_chart.clear();
     this->dls_headers.clear();
-    for (size_t row = 0; row < this->dls_rows.size(); row++) {
-        for (size_t col = 0; col < this->dls_rows[row].size(); col++) {
-            if (this->dls_rows[row][col] != NULL_STR) {
-                free((void*) this->dls_rows[row][col]);
+    this->dls_columns.clear();
+    this->dls_row_count = 0;
+    this->dls_time_column.clear();
+    this->dls_cell_width.clear();
+}
+
+size_t
+db_label_source::memory_usage() const
+{
+    size_t retval = this->dls_time_column.capacity() * sizeof(struct timeval)
+        + this->dls_cell_width.capacity() * sizeof(size_t);
+
+    for (const auto& cv : this->dls_columns) {
+        retval += cv.memory_usage();
+    }
+
+    return retval;
+}
+
+std::string
+db_label_source::get_cell(size_t row, size_t col) const
+{
+    const auto& cv = this->dls_columns[col];
+
+    if (cv.is_null(row)) {
+        return NULL_STR;
+    }
+    if (cv.is_integer()) {
+        return fmt::format_int(cv.integer_at(row)).str();
+    }
+
+    return cv.text_at(row);
+}
+
+void
+db_label_source::column_values::set_null(size_t row)
+{
+    if (row / 64 >= this->cv_nulls.size()) {
+        this->cv_nulls.resize(row / 64 + 1);
+    }
+    this->cv_nulls[row / 64] |= 1ULL << (row % 64);
+}
+
+void
+db_label_source::column_values::append_text(const char* text, size_t len)
+{
+    this->cv_offsets.push_back(this->cv_arena.size());
+    this->cv_arena.insert(this->cv_arena.end(), text, text + len);
+    this->cv_arena.push_back('\0');
+}
+
+void
+db_label_source::column_values::convert_to(kind_t kind)
+{
+    if (this->cv_kind == kind_t::integer) {
+        for (size_t row = 0; row < this->cv_size; row++) {
+            auto value = this->cv_integers[row];
+            auto str = fmt::format_int(value);
+
+            if (this->is_null(row)) {
+                this->append_text("", 0);
+            } else {
+                this->append_text(str.data(), str.size());
+            }
+            if (kind == kind_t::real) {
+                this->cv_reals.push_back(value);
             }
         }
+        this->cv_integers.clear();
+        this->cv_integers.shrink_to_fit();
     }
-    this->dls_rows.clear();
-    this->dls_time_column.clear();
-    this->dls_cell_width.clear();
+    if (kind == kind_t::text) {
+        this->cv_reals.clear();
+        this->cv_reals.shrink_to_fit();
+    }
+    this->cv_kind = kind;
+}
+
+void
+db_label_source::column_values::push_null()
+{
+    this->set_null(this->cv_size);
+    switch (this->cv_kind) {
+        case kind_t::integer:
+            this->cv_integers.push_back(0);
+            break;
+        case kind_t::real:
+            this->cv_reals.push_back(0.0);
+            this->append_text("", 0);
+            break;
+        case kind_t::text:
+            this->append_text("", 0);
+            break;
+    }
+    this->cv_size += 1;
+}
+
+void
+db_label_source::column_values::push_integer(int64_t value)
+{
+    switch (this->cv_kind) {
+        case kind_t::integer:
+            this->cv_integers.push_back(value);
+            break;
+        case kind_t::real: {
+            auto str = fmt::format_int(value);
+
+            this->cv_reals.push_back(value);
+            this->append_text(str.data(), str.size());
+            break;
+        }
+        case kind_t::text: {
+            auto str = fmt::format_int(value);
+
+            this->append_text(str.data(), str.size());
+            break;
+        }
+    }
+    this->cv_size += 1;
+}
+
+void
+db_label_source::column_values::push_real(double value,
+                                          const char* text,
+                                          size_t len)
+{
+    if (this->cv_kind == kind_t::integer) {
+        this->convert_to(kind_t::real);
+    }
+    if (this->cv_kind == kind_t::real) {
+        this->cv_reals.push_back(value);
+    }
+    this->append_text(text, len);
+    this->cv_size += 1;
+}
+
+void
+db_label_source::column_values::push_text(const char* text, size_t len)
+{
+    if (this->cv_kind != kind_t::text) {
+        this->convert_to(kind_t::text);
+    }
+    this->append_text(text, len);
+    this->cv_size += 1;
+}
+
+nonstd::optional<double>
+db_label_source::column_values::number_at(size_t row) const
+{
+    if (this->is_null(row)) {
+        return nonstd::nullopt;
+    }
+
+    switch (this->cv_kind) {
+        case kind_t::integer:
+            return (double) this->cv_integers[row];
+        case kind_t::real:
+            return this->cv_reals[row];
+        case kind_t::text: {
+            double retval;
+
+            if (sscanf(&this->cv_arena[this->cv_offsets[row]], "%lf", &retval)
+                == 1) {
+                return retval;
+            }
+            break;
+        }
+    }
+
+    return nonstd::nullopt;
+}
+
+size_t
+db_label_source::column_values::memory_usage() const
+{
+    return this->cv_nulls.capacity() * sizeof(uint64_t)
+        + this->cv_integers.capacity() * sizeof(int64_t)
+        + this->cv_reals.capacity() * sizeof(double)
+        + this->cv_arena.capacity()
+        + this->cv_offsets.capacity() * sizeof(size_t);
+}
+
+void
+db_label_source::column_values::clear()
+{
+    this->cv_kind = kind_t::integer;
+    this->cv_size = 0;
+    this->cv_nulls.clear();
+    this->cv_integers.clear();
+    this->cv_reals.clear();
+    this->cv_arena.clear();
+    this->cv_offsets.clear();
 }
 
 long
@@ -301,15 +529,18 @@ db_overlay_source::list_overlay_count(const listview_curses& lv)
 
     view_colors& vc = view_colors::singleton();
     vis_line_t top = lv.get_top();
-    const std::vector<const char*>& cols = this->dos_labels->dls_rows[top];
+    const auto& columns = this->dos_labels->dls_columns;
     unsigned long width;
     vis_line_t height;
 
     lv.get_dimensions(height, width);
 
     this->dos_lines.clear();
-    for (size_t col = 0; col < cols.size(); col++) {
-        const char* col_value = cols[col];
+    for (size_t col = 0; col < columns.size(); col++) {
+        const char* col_value = columns[col].text_at(top);
+        if (col_value == nullptr || columns[col].is_null(top)) {
+            continue;
+        }
         size_t col_len = strlen(col_value);
 
         if (!(col_len >= 2
@@ -35,6 +35,9 @@
 #include <vector>
 
 #include <sqlite3.h>
+#include <stdint.h>
+
+#include "optional.hpp"
 
 #include "hist_source.hh"
 #include "textview_curses.hh"
@@ -55,9 +58,19 @@ public:
 
     size_t text_line_count()
     {
-        return this->dls_rows.size();
+        return this->dls_row_count;
     };
 
+    bool empty() const
+    {
+        return this->dls_row_count == 0;
+    }
+
+    size_t row_count() const
+    {
+        return this->dls_row_count;
+    }
+
     size_t text_size_for_line(textview_curses& tc, int line, line_flags_t flags)
     {
         return this->text_line_width(tc);
@@ -82,10 +95,37 @@ public:
 
     void push_header(const std::string& colstr, int type, bool graphable);
 
-    void push_column(const char* colstr);
+    /**
+     * Add the value of a column in the current result row of a statement.
+     * The columns of a row must be pushed in order.
+     */
+    void push_column(sqlite3_stmt* stmt, int col);
 
     void clear();
 
+    /**
+     * @return The number of bytes allocated to hold the results.
+     */
+    size_t memory_usage() const;
+
+    bool is_null(size_t row, size_t col) const
+    {
+        return this->dls_columns[col].is_null(row);
+    }
+
+    /**
+     * @return The text of a cell or NULL_STR if the value is NULL.
+     */
+    std::string get_cell(size_t row, size_t col) const;
+
+    /**
+     * @return The numeric value of a cell, if it has one.
+     */
+    nonstd::optional<double> get_cell_number(size_t row, size_t col) const
+    {
+        return this->dls_columns[col].number_at(row);
+    }
+
     long column_name_to_index(const std::string& name) const;
 
     nonstd::optional<vis_line_t> row_for_time(struct timeval time_bucket);
@@ -119,9 +159,85 @@ public:
         size_t hm_column_size;
     };
 
+    /**
+     * The values of one column of the results.  Integer and real values are
+     * kept in typed vectors and the text of other values is appended to a
+     * single buffer for the column, so adding a cell does not allocate
+     * memory of its own.  If a column receives a value of a different type,
+     * the column is converted to hold text.
+     */
+    class column_values {
+    public:
+        void push_null();
+        void push_integer(int64_t value);
+        void push_real(double value, const char* text, size_t len);
+        void push_text(const char* text, size_t len);
+
+        size_t size() const
+        {
+            return this->cv_size;
+        }
+
+        bool is_null(size_t row) const
+        {
+            return row / 64 < this->cv_nulls.size()
+                && (this->cv_nulls[row / 64] & (1ULL << (row % 64)));
+        }
+
+        bool is_integer() const
+        {
+            return this->cv_kind == kind_t::integer;
+        }
+
+        int64_t integer_at(size_t row) const
+        {
+            return this->cv_integers[row];
+        }
+
+        /**
+         * @return The text of a cell that is stored as text, or nullptr if
+         * the column holds integers.
+         */
+        const char* text_at(size_t row) const
+        {
+            if (this->cv_kind == kind_t::integer) {
+                return nullptr;
+            }
+            return &this->cv_arena[this->cv_offsets[row]];
+        }
+
+        nonstd::optional<double> number_at(size_t row) const;
+
+        size_t memory_usage() const;
+
+        void clear();
+
+    private:
+        enum class kind_t {
+            integer,
+            real,
+            text,
+        };
+
+        void set_null(size_t row);
+        void append_text(const char* text, size_t len);
+        void convert_to(kind_t kind);
+
+        kind_t cv_kind{kind_t::integer};
+        size_t cv_size{0};
+        /** A bit for each cell that is set if the value is NULL. */
+        std::vector<uint64_t> cv_nulls;
+        std::vector<int64_t> cv_integers;
+        std::vector<double> cv_reals;
+        /** The NUL-terminated text of the cells in a real or text column. */
+        std::vector<char> cv_arena;
+        std::vector<size_t> cv_offsets;
+    };
+
     stacked_bar_chart<std::string> dls_chart;
     std::vector<header_meta> dls_headers;
-    std::vector<std::vector<const char*>> dls_rows;
+    std::vector<column_values> dls_columns;
+    size_t dls_row_count{0};
     std::vector<struct timeval> dls_time_column;
     std::vector<size_t> dls_cell_width;
     int dls_time_column_index{-1};
@@ -68,7 +68,7 @@ field_overlay_source::build_summary_lines(const listview_curses& lv)
             if (lv.get_inner_height() == 0) {
                 time_span = "None";
             } else {
-                logline *first_line, *last_line;
+                logfile::iterator first_line, last_line;
                 time_t now = time(nullptr);
 
                 first_line = lss.find_line(lss.at(vis_line_t(0)));
@@ -35,7 +35,9 @@
 
 #include <glob.h>
 
+#include "archive_manager.cfg.hh"
 #include "base/humanize.network.hh"
+#include "base/injector.hh"
 #include "base/isc.hh"
 #include "base/opt_util.hh"
 #include "base/string_util.hh"
@@ -50,6 +52,71 @@
 static std::mutex REALPATH_CACHE_MUTEX;
 static std::unordered_map<std::string, std::string> REALPATH_CACHE;
 
+/**
+ * Decompress the members of an archive in the background.  The members are
+ * handed to the next scan through the scan progress as soon as they are
+ * created so they can be indexed while the rest of the archive is read.
+ */
+static void
+stream_archive(std::string filename,
+               struct stat st,
+               std::shared_ptr<safe_scan_progress> prog)
+{
+    nonstd::optional<std::list<archive_manager::extract_progress>::iterator>
+        prog_iter_opt;
+
+    auto res = archive_manager::stream_archive_files(
+        filename,
+        [&prog, &prog_iter_opt](const auto& path, const auto total) {
+            safe::WriteAccess<safe_scan_progress> sp(*prog);
+
+            prog_iter_opt |
+                [&sp](auto prog_iter) { sp->sp_extractions.erase(prog_iter); };
+            auto prog_iter = sp->sp_extractions.emplace(
+                sp->sp_extractions.begin(), path, total);
+            prog_iter_opt = prog_iter;
+
+            return &(*prog_iter);
+        },
+        [&filename, &prog](archive_manager::streamed_member& sm) {
+            auto custom_name = filename / sm.sm_path;
+            auto key = archive_manager::filename_to_tmp_path(filename)
+                / sm.sm_path;
+
+            if (sm.sm_size == 0) {
+                log_info("hiding empty archive file: %s", key.c_str());
+            }
+            log_info("streaming file from archive: %s/%s",
+                     filename.c_str(),
+                     sm.sm_path.c_str());
+
+            logfile_open_options loo;
+
+            loo.with_filename(custom_name.string())
+                .with_source(logfile_name_source::ARCHIVE)
+                .with_visibility(sm.sm_size != 0)
+                .with_non_utf_visibility(false)
+                .with_visible_size_limit(256 * 1024)
+                .with_fd(std::move(sm.sm_fd));
+            prog->writeAccess()->sp_archive_members.emplace(key.string(),
+                                                            std::move(loo));
+        });
+
+    safe::WriteAccess<safe_scan_progress> sp(*prog);
+
+    prog_iter_opt |
+        [&sp](auto prog_iter) { sp->sp_extractions.erase(prog_iter); };
+    if (res.isErr()) {
+        log_error("archive streaming failed: %s", res.unwrapErr().c_str());
+        sp->sp_archive_errors.emplace(filename,
+                                      file_error_info{
+                                          st.st_mtime,
+                                          res.unwrapErr(),
+                                      });
+    }
+    sp->sp_streamed_archives.emplace(filename);
+}
+
 child_poll_result_t
 child_poller::poll(file_collection& fc)
 {
@@ -384,6 +451,17 @@ file_collection::watch_logfile(const std::string& filename,
                         return retval;
                     }
 
+                    const auto& amc
+                        = injector::get<const archive_manager::config&>();
+                    if (amc.amc_stream_members) {
+                        archive_manager::start_streaming(
+                            [filename, st, prog]() {
+                                stream_archive(filename, st, prog);
+                            });
+                        retval.fc_other_files[filename] = ff;
+                        return retval;
+                    }
+
                     auto res = archive_manager::walk_archive_files(
                         filename,
                         [prog, &prog_iter_opt](const auto& path,
@@ -433,6 +511,7 @@ file_collection::watch_logfile(const std::string& filename,
                                                          });
                     } else {
                         retval.fc_other_files[filename] = ff;
+                        retval.fc_synced_files.emplace(filename);
                     }
                     {
                         prog_iter_opt | [&prog](auto prog_iter) {
@@ -611,6 +690,21 @@ file_collection::rescan_files(bool required)
     lnav::futures::future_queue<file_collection> fq(
         [&retval](auto& fc) { retval.merge(fc); });
 
+    {
+        safe::WriteAccess<safe_scan_progress> sp(*this->fc_progress);
+
+        for (auto& pair : sp->sp_archive_members) {
+            retval.fc_file_names.emplace(pair.first, std::move(pair.second));
+        }
+        sp->sp_archive_members.clear();
+        retval.fc_synced_files.insert(sp->sp_streamed_archives.begin(),
+                                      sp->sp_streamed_archives.end());
+        sp->sp_streamed_archives.clear();
+        retval.fc_name_to_errors.insert(sp->sp_archive_errors.begin(),
+                                        sp->sp_archive_errors.end());
+        sp->sp_archive_errors.clear();
+    }
+
     for (auto& pair : this->fc_file_names) {
         if (!pair.second.loo_temp_file) {
             this->expand_filename(fq, pair.first, pair.second, required);
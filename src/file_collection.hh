@@ -46,6 +46,11 @@
 #include "safe/safe.h"
 #include "tailer/tailer.looper.hh"
 
+struct file_error_info {
+    const time_t fei_mtime;
+    const std::string fei_description;
+};
+
 struct tailer_progress {
     std::string tp_message;
 };
@@ -53,6 +58,11 @@ struct tailer_progress {
 struct scan_progress {
     std::list<archive_manager::extract_progress> sp_extractions;
     std::map<std::string, tailer_progress> sp_tailers;
+    /** Archive members that have started streaming since the last scan. */
+    std::map<std::string, logfile_open_options> sp_archive_members;
+    /** Archives that have finished streaming since the last scan. */
+    std::set<std::string> sp_streamed_archives;
+    std::map<std::string, file_error_info> sp_archive_errors;
 };
 
 using safe_scan_progress = safe::Safe<scan_progress>;
@@ -68,11 +78,6 @@ struct other_file_descriptor {
     }
 };
 
-struct file_error_info {
-    const time_t fei_mtime;
-    const std::string fei_description;
-};
-
 struct file_collection;
 
 enum class child_poll_result_t {
@@ -0,0 +1,411 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file file_watcher.cc
+ */
+
+#include <algorithm>
+
+#include "file_watcher.hh"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/humanize.network.hh"
+#include "base/lnav_log.hh"
+#include "base/string_util.hh"
+#include "config.h"
+#include "file_collection.hh"
+#include "fmt/format.h"
+#include "ghc/filesystem.hpp"
+#include "lnav_util.hh"
+#include "logfile.hh"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#    include <sys/inotify.h>
+#    include <sys/vfs.h>
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+static const uint32_t FILE_EVENTS
+    = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF;
+static const uint32_t DIR_EVENTS = IN_ONLYDIR | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+
+/**
+ * The filesystems where changes made by other hosts are not reported through
+ * inotify.
+ */
+static const uint32_t NETWORK_FS_TYPES[] = {
+    0x6969, /* NFS */
+    0x517B, /* SMB */
+    0xFF534D42, /* CIFS */
+    0xFE534D42, /* SMB2 */
+    0x5346414F, /* AFS */
+    0x6B414653, /* kAFS */
+    0x73757245, /* CODA */
+    0x01021997, /* 9P */
+    0x00C36400, /* CEPH */
+    0x65735546, /* FUSE, which includes sshfs */
+    0x01161970, /* GFS2 */
+    0x7461636F, /* OCFS2 */
+    0x0BD00BD0, /* Lustre */
+};
+
+static bool
+is_network_fs(const struct statfs& sfs)
+{
+    auto fs_type = static_cast<uint32_t>(sfs.f_type);
+
+    for (const auto net_type : NETWORK_FS_TYPES) {
+        if (fs_type == net_type) {
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif
+
+/**
+ * @return The directory where files for the given name would show up or an
+ *   empty string if the name cannot be watched.
+ */
+static std::string
+dir_for_name(const std::string& name)
+{
+    if (is_url(name.c_str()) || humanize::network::path::from_str(name)) {
+        return "";
+    }
+
+    auto dir = ghc::filesystem::path(name).parent_path().string();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    if (dir.find_first_of("*?[") != std::string::npos) {
+        return "";
+    }
+
+    return dir;
+}
+
+file_watcher&
+file_watcher::singleton()
+{
+    static file_watcher retval;
+
+    return retval;
+}
+
+file_watcher::file_watcher()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    this->fw_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->fw_fd == -1) {
+        log_error("unable to create inotify instance, polling files -- %s",
+                  strerror(errno));
+    }
+#endif
+}
+
+void
+file_watcher::sync(const file_collection& fc)
+{
+    if (this->fw_fd == -1) {
+        return;
+    }
+
+    for (auto iter = this->fw_files.begin(); iter != this->fw_files.end();) {
+        auto& lfs = iter->second;
+
+        lfs.erase(std::remove_if(lfs.begin(),
+                                 lfs.end(),
+                                 [](const auto& wlf) { return wlf.expired(); }),
+                  lfs.end());
+        if (lfs.empty()) {
+#ifdef HAVE_SYS_INOTIFY_H
+            inotify_rm_watch(this->fw_fd, iter->first);
+#endif
+            iter = this->fw_files.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (auto iter = this->fw_polled_files.begin();
+         iter != this->fw_polled_files.end();)
+    {
+        if (iter->expired()) {
+            iter = this->fw_polled_files.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    for (const auto& lf : fc.fc_files) {
+        if (lf->is_watched() || lf->is_closed()
+            || this->fw_polled_files.count(lf) > 0)
+        {
+            continue;
+        }
+
+        this->watch_file(lf);
+    }
+
+    std::set<std::string> dirs;
+    for (const auto& name_pair : fc.fc_file_names) {
+        if (name_pair.second.loo_temp_file) {
+            continue;
+        }
+
+        auto dir = dir_for_name(name_pair.first);
+        if (dir.empty()) {
+            continue;
+        }
+
+        dirs.insert(dir);
+        if (this->fw_dirs.count(dir) == 0) {
+            this->watch_dir(dir);
+        }
+    }
+
+    // Stop watching the directories for names that have been closed.
+    for (auto iter = this->fw_dirs.begin(); iter != this->fw_dirs.end();) {
+        if (dirs.count(iter->first) > 0) {
+            ++iter;
+            continue;
+        }
+
+        log_debug("stopped watching directory: %s", iter->first.c_str());
+        if (iter->second != -1) {
+#ifdef HAVE_SYS_INOTIFY_H
+            inotify_rm_watch(this->fw_fd, iter->second);
+#endif
+            this->fw_dir_watches.erase(iter->second);
+        }
+        iter = this->fw_dirs.erase(iter);
+    }
+}
+
+bool
+file_watcher::covers(const file_collection& fc) const
+{
+    if (this->fw_fd == -1) {
+        return false;
+    }
+
+    {
+        safe::ReadAccess<safe_scan_progress> sp(*fc.fc_progress);
+
+        if (!sp->sp_extractions.empty() || !sp->sp_tailers.empty()
+            || !sp->sp_archive_members.empty()
+            || !sp->sp_streamed_archives.empty()
+            || !sp->sp_archive_errors.empty())
+        {
+            return false;
+        }
+    }
+
+    for (const auto& other_pair : fc.fc_other_files) {
+        switch (other_pair.second.ofd_format) {
+            case file_format_t::REMOTE:
+                return false;
+            case file_format_t::ARCHIVE:
+                if (fc.fc_synced_files.count(other_pair.first) == 0) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (const auto& name_pair : fc.fc_file_names) {
+        if (name_pair.second.loo_temp_file) {
+            continue;
+        }
+
+        auto dir = dir_for_name(name_pair.first);
+        if (dir.empty()) {
+            return false;
+        }
+
+        auto dir_iter = this->fw_dirs.find(dir);
+        if (dir_iter == this->fw_dirs.end() || dir_iter->second == -1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+file_watcher::update_poll_set(std::vector<struct pollfd>& pollfds)
+{
+    if (this->fw_fd != -1) {
+        pollfds.push_back((struct pollfd){this->fw_fd, POLLIN, 0});
+    }
+}
+
+file_watcher::changes
+file_watcher::check_poll_set(const std::vector<struct pollfd>& pollfds)
+{
+    changes retval;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (this->fw_fd == -1 || !(pollfd_revents(pollfds, this->fw_fd) & POLLIN))
+    {
+        return retval;
+    }
+
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    while (true) {
+        auto rc = read(this->fw_fd, buffer, sizeof(buffer));
+
+        if (rc <= 0) {
+            break;
+        }
+
+        for (ssize_t off = 0; off < rc;) {
+            const auto* ev
+                = reinterpret_cast<const struct inotify_event*>(&buffer[off]);
+
+            off += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                log_warning("inotify queue overflowed, checking all files");
+                for (const auto& file_pair : this->fw_files) {
+                    for (const auto& wlf : file_pair.second) {
+                        auto lf = wlf.lock();
+
+                        if (lf) {
+                            lf->mark_changed();
+                        }
+                    }
+                }
+                retval.c_files = true;
+                retval.c_directories = true;
+                continue;
+            }
+
+            auto file_iter = this->fw_files.find(ev->wd);
+            if (file_iter != this->fw_files.end()) {
+                for (const auto& wlf : file_iter->second) {
+                    auto lf = wlf.lock();
+
+                    if (!lf) {
+                        continue;
+                    }
+                    if (ev->mask & IN_IGNORED) {
+                        // The watch is gone, so go back to polling.
+                        lf->set_watched(false);
+                        this->fw_polled_files.insert(lf);
+                    } else {
+                        log_debug("change event for file: %s",
+                                  lf->get_filename().c_str());
+                        lf->mark_changed();
+                    }
+                }
+                if (ev->mask & IN_IGNORED) {
+                    this->fw_files.erase(file_iter);
+                }
+                retval.c_files = true;
+                continue;
+            }
+
+            auto dir_iter = this->fw_dir_watches.find(ev->wd);
+            if (dir_iter != this->fw_dir_watches.end()) {
+                if (ev->mask & IN_IGNORED) {
+                    log_debug("stopped watching directory: %s",
+                              dir_iter->second.c_str());
+                    this->fw_dirs.erase(dir_iter->second);
+                    this->fw_dir_watches.erase(dir_iter);
+                }
+                retval.c_directories = true;
+            }
+        }
+    }
+#endif
+
+    return retval;
+}
+
+void
+file_watcher::watch_file(const std::shared_ptr<logfile>& lf)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    auto fd = lf->get_fd();
+    struct stat st;
+    struct statfs sfs;
+
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+        || fstatfs(fd, &sfs) == -1 || is_network_fs(sfs))
+    {
+        log_info("polling file for changes: %s", lf->get_filename().c_str());
+        this->fw_polled_files.insert(lf);
+        return;
+    }
+
+    // Watch the open file instead of the name since the file can be renamed
+    // or replaced while it is being read.
+    auto fd_path = fmt::format(FMT_STRING("/proc/self/fd/{}"), fd);
+    auto wd = inotify_add_watch(this->fw_fd, fd_path.c_str(), FILE_EVENTS);
+    if (wd == -1) {
+        log_info("unable to watch file, polling instead: %s -- %s",
+                 lf->get_filename().c_str(),
+                 strerror(errno));
+        this->fw_polled_files.insert(lf);
+        return;
+    }
+
+    this->fw_files[wd].emplace_back(lf);
+    lf->set_watched(true);
+#endif
+}
+
+void
+file_watcher::watch_dir(const std::string& dir)
+{
+    int wd = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    struct statfs sfs;
+
+    if (statfs(dir.c_str(), &sfs) == 0 && !is_network_fs(sfs)) {
+        wd = inotify_add_watch(this->fw_fd, dir.c_str(), DIR_EVENTS);
+    }
+#endif
+
+    this->fw_dirs[dir] = wd;
+    if (wd == -1) {
+        log_info("polling directory for new files: %s", dir.c_str());
+    } else {
+        log_debug("watching directory for new files: %s", dir.c_str());
+        this->fw_dir_watches[wd] = dir;
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file file_watcher.hh
+ */
+
+#ifndef lnav_file_watcher_hh
+#define lnav_file_watcher_hh
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "base/auto_fd.hh"
+
+struct file_collection;
+class logfile;
+
+/**
+ * Uses inotify(7) to find out when the open files are written to and when
+ * new files show up in the directories that are being scanned.  Files and
+ * directories that cannot be watched, like the ones on network filesystems,
+ * are left to be polled.
+ */
+class file_watcher {
+public:
+    static file_watcher& singleton();
+
+    struct changes {
+        /** Some of the watched files have been changed. */
+        bool c_files{false};
+        /** Files have been added/removed in some of the watched directories. */
+        bool c_directories{false};
+    };
+
+    /**
+     * Start watching the files in the collection that are not watched yet
+     * and the directories where new files for the collection can show up.
+     */
+    void sync(const file_collection& fc);
+
+    /**
+     * @return True if a change to the names in the collection will be
+     *   reported by a watch, so the collection does not need to be
+     *   rescanned regularly.
+     */
+    bool covers(const file_collection& fc) const;
+
+    void update_poll_set(std::vector<struct pollfd>& pollfds);
+
+    changes check_poll_set(const std::vector<struct pollfd>& pollfds);
+
+private:
+    file_watcher();
+
+    void watch_file(const std::shared_ptr<logfile>& lf);
+
+    void watch_dir(const std::string& dir);
+
+    auto_fd fw_fd;
+    std::map<int, std::vector<std::weak_ptr<logfile>>> fw_files;
+    /** The files that could not be watched and need to be polled. */
+    std::set<std::weak_ptr<logfile>, std::owner_less<std::weak_ptr<logfile>>>
+        fw_polled_files;
+    /** Directory path to watch descriptor, which is -1 if it was not watched. */
+    std::map<std::string, int> fw_dirs;
+    std::map<int, std::string> fw_dir_watches;
+};
+
+#endif
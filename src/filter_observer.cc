@@ -27,11 +27,18 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <future>
+
 #include "filter_observer.hh"
 
 #include "config.h"
+#include "fmt/format.h"
 #include "log_format.hh"
 
+static const size_t MAX_BATCH_LINES = 16 * 1024;
+static const size_t MAX_BATCH_TEXT = 8 * 1024 * 1024;
+static const size_t MIN_LINES_PER_THREAD = 1024;
+
 void
 line_filter_observer::logline_new_lines(const logfile& lf,
                                         logfile::const_iterator ll_begin,
@@ -51,22 +58,164 @@ line_filter_observer::logline_new_lines(const logfile& lf,
         if (lf.get_format() != nullptr) {
             lf.get_format()->get_subline(*ll_begin, sbr);
         }
-        for (auto& filter : this->lfo_filter_stack) {
-            if (filter->lf_deleted) {
+
+        /*
+         * The line is copied since the format can reuse its buffer for the
+         * next subline and the line buffer can be refilled before the batch
+         * is flushed.
+         */
+        this->lfo_batch_lines.emplace_back(
+            batch_line{(size_t) std::distance(lf.begin(), ll_begin),
+                       offset,
+                       this->lfo_batch_text.size(),
+                       sbr.length()});
+        this->lfo_batch_text.append(sbr.get_data(), sbr.length());
+    }
+
+    if (this->lfo_batch_lines.size() >= MAX_BATCH_LINES
+        || this->lfo_batch_text.size() >= MAX_BATCH_TEXT)
+    {
+        this->flush_batch();
+    }
+}
+
+void
+line_filter_observer::flush_batch()
+{
+    if (this->lfo_batch_lines.empty()) {
+        return;
+    }
+
+    const auto& lf = *this->lfo_filter_state.tfs_logfile;
+    const auto& lines = this->lfo_batch_lines;
+    std::vector<text_filter*> filters;
+    std::vector<size_t> first_lines;
+    std::vector<std::vector<uint8_t>> results;
+
+    /*
+     * A filter only needs the lines at or after the point it has already
+     * reached, which can differ from filter to filter after a new one is
+     * added.  Since the lines are in order, that is everything after the
+     * first line that qualifies.
+     */
+    for (auto& filter : this->lfo_filter_stack) {
+        if (filter->lf_deleted) {
+            continue;
+        }
+
+        auto count
+            = this->lfo_filter_state.tfs_filter_count[filter->get_index()];
+        auto first_iter = std::find_if(
+            lines.begin(), lines.end(), [count](const auto& bl) {
+                return bl.bl_message_line >= count;
+            });
+
+        if (first_iter == lines.end()) {
+            continue;
+        }
+
+        if (count == 0) {
+            this->lfo_filter_keys[filter->get_index()]
+                = filter->get_cache_key();
+        }
+
+        filters.emplace_back(filter.get());
+        first_lines.emplace_back(std::distance(lines.begin(), first_iter));
+        results.emplace_back(lines.size());
+    }
+
+    auto match_range = [&](bool thread_safe, size_t begin, size_t end) {
+        shared_buffer sb;
+        shared_buffer_ref sbr;
+
+        for (size_t filter_index = 0; filter_index < filters.size();
+             filter_index++)
+        {
+            auto* filter = filters[filter_index];
+
+            if (filter->is_thread_safe() != thread_safe) {
                 continue;
             }
-            if (offset
-                >= this->lfo_filter_state.tfs_filter_count[filter->get_index()])
+
+            auto& result = results[filter_index];
+
+            for (auto lpc = std::max(begin, first_lines[filter_index]);
+                 lpc < end;
+                 lpc++)
             {
-                filter->add_line(this->lfo_filter_state, ll_begin, sbr);
+                const auto& bl = lines[lpc];
+
+                sbr.share(sb,
+                          &this->lfo_batch_text[bl.bl_text_offset],
+                          bl.bl_text_length);
+                result[lpc]
+                    = filter->matches(lf, lf.begin() + bl.bl_line, sbr);
             }
         }
+    };
+
+    auto thread_count = std::max(
+        (size_t) 1,
+        std::min(lnav::logfile::index_thread_count(),
+                 lines.size() / MIN_LINES_PER_THREAD));
+    std::vector<std::future<void>> workers;
+
+    for (size_t lpc = 1; lpc < thread_count; lpc++) {
+        workers.emplace_back(std::async(std::launch::async,
+                                        match_range,
+                                        true,
+                                        lines.size() * lpc / thread_count,
+                                        lines.size() * (lpc + 1)
+                                            / thread_count));
+    }
+    match_range(true, 0, lines.size() / thread_count);
+    match_range(false, 0, lines.size());
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    for (size_t filter_index = 0; filter_index < filters.size();
+         filter_index++)
+    {
+        auto* filter = filters[filter_index];
+        const auto& result = results[filter_index];
+
+        for (auto lpc = first_lines[filter_index]; lpc < lines.size(); lpc++) {
+            filter->add_match(this->lfo_filter_state,
+                              lf.begin() + lines[lpc].bl_line,
+                              result[lpc]);
+        }
+    }
+
+    this->lfo_batch_lines.clear();
+    this->lfo_batch_text.clear();
+    if (this->lfo_batch_text.capacity() > MAX_BATCH_TEXT / 8) {
+        this->lfo_batch_lines.shrink_to_fit();
+        this->lfo_batch_text.shrink_to_fit();
+    }
+}
+
+void
+line_filter_observer::logline_new_batch(const logfile& lf,
+                                        logfile::const_iterator ll_begin,
+                                        logfile::const_iterator ll_end,
+                                        line_span& span)
+{
+    require(&lf == this->lfo_filter_state.tfs_logfile.get());
+
+    this->lfo_filter_state.resize(lf.size());
+    if (this->lfo_filter_stack.empty()) {
+        return;
     }
+
+    logline_observer::logline_new_batch(lf, ll_begin, ll_end, span);
+    this->flush_batch();
 }
 
 void
 line_filter_observer::logline_eof(const logfile& lf)
 {
+    this->flush_batch();
     for (auto& iter : this->lfo_filter_stack) {
         if (iter->lf_deleted) {
             continue;
@@ -105,7 +254,156 @@ line_filter_observer::clear_deleted_filter_state()
                       filter->get_lang());
             continue;
         }
-        used_mask |= (1UL << filter->get_index());
+
+        auto index = filter->get_index();
+        auto key = filter->get_cache_key();
+
+        if (key != this->lfo_filter_keys[index]) {
+            this->save_filter_state(index);
+            this->lfo_filter_state.clear_filter_state(index);
+            this->restore_filter_state(index, key);
+        }
+        used_mask |= (1UL << index);
+    }
+    for (int lpc = 0; lpc < logfile_filter_state::MAX_FILTERS; lpc++) {
+        if (!(used_mask & (1UL << lpc))) {
+            this->save_filter_state(lpc);
+        }
     }
     this->lfo_filter_state.clear_deleted_filter_state(used_mask);
 }
+
+/**
+ * @return The key for the cached results of a filter on the given file.  Files
+ *   that start with the same line have the same content ID, so the device and
+ *   inode are included to tell them apart.
+ */
+static std::string
+result_cache_key(const logfile& lf, const std::string& filter_key)
+{
+    const auto& st = lf.get_stat();
+
+    return fmt::format(FMT_STRING("{}:{}:{}:{}"),
+                       st.st_dev,
+                       st.st_ino,
+                       lf.get_content_id(),
+                       filter_key);
+}
+
+void
+line_filter_observer::save_filter_state(size_t index)
+{
+    auto& lfs = this->lfo_filter_state;
+    auto& key = this->lfo_filter_keys[index];
+
+    if (key.empty() || lfs.tfs_logfile == nullptr
+        || lfs.tfs_logfile->get_content_id().empty()
+        || lfs.tfs_filter_count[index] == 0)
+    {
+        key.clear();
+        return;
+    }
+
+    filter_result_cache::result res;
+
+    res.r_matches = std::move(lfs.tfs_matches[index]);
+    res.r_filter_count = lfs.tfs_filter_count[index];
+    res.r_filter_hits = lfs.tfs_filter_hits[index];
+    res.r_last_message_matched = lfs.tfs_last_message_matched[index];
+    res.r_last_lines_for_message = lfs.tfs_last_lines_for_message[index];
+    filter_result_cache::singleton().put(
+        result_cache_key(*lfs.tfs_logfile, key), std::move(res));
+    key.clear();
+}
+
+void
+line_filter_observer::restore_filter_state(size_t index,
+                                           const std::string& key)
+{
+    auto& lfs = this->lfo_filter_state;
+
+    this->lfo_filter_keys[index] = key;
+    if (key.empty() || lfs.tfs_logfile == nullptr
+        || lfs.tfs_logfile->get_content_id().empty())
+    {
+        return;
+    }
+
+    auto res_opt = filter_result_cache::singleton().take(
+        result_cache_key(*lfs.tfs_logfile, key));
+
+    if (!res_opt) {
+        return;
+    }
+
+    auto& res = res_opt.value();
+
+    if (res.r_filter_count > lfs.tfs_logfile->size()) {
+        return;
+    }
+
+    log_debug("reusing %zu filter results for: %s",
+              res.r_filter_count,
+              key.c_str());
+    lfs.tfs_matches[index] = std::move(res.r_matches);
+    lfs.tfs_filter_count[index] = res.r_filter_count;
+    lfs.tfs_filter_hits[index] = res.r_filter_hits;
+    lfs.tfs_last_message_matched[index] = res.r_last_message_matched;
+    lfs.tfs_last_lines_for_message[index] = res.r_last_lines_for_message;
+}
+
+filter_result_cache&
+filter_result_cache::singleton()
+{
+    static filter_result_cache retval;
+
+    return retval;
+}
+
+void
+filter_result_cache::put(const std::string& key, result res)
+{
+    this->take(key);
+
+    auto res_size = key.size() + res.r_matches.memory_size();
+
+    if (res_size > this->frc_max_size) {
+        return;
+    }
+
+    this->frc_size += res_size;
+    this->frc_results.emplace_front(key, std::move(res));
+    while (this->frc_size > this->frc_max_size) {
+        auto& last = this->frc_results.back();
+
+        this->frc_size -= last.first.size() + last.second.r_matches.memory_size();
+        this->frc_results.pop_back();
+    }
+}
+
+nonstd::optional<filter_result_cache::result>
+filter_result_cache::take(const std::string& key)
+{
+    auto iter = std::find_if(
+        this->frc_results.begin(),
+        this->frc_results.end(),
+        [&key](const auto& pair) { return pair.first == key; });
+
+    if (iter == this->frc_results.end()) {
+        return nonstd::nullopt;
+    }
+
+    auto retval = std::move(iter->second);
+
+    this->frc_size -= iter->first.size() + retval.r_matches.memory_size();
+    this->frc_results.erase(iter);
+
+    return retval;
+}
+
+void
+filter_result_cache::clear()
+{
+    this->frc_results.clear();
+    this->frc_size = 0;
+}
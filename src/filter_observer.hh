@@ -30,11 +30,49 @@
 #ifndef filter_observer_hh
 #define filter_observer_hh
 
+#include <list>
+#include <string>
+
 #include <sys/types.h>
 
 #include "logfile.hh"
 #include "textview_curses.hh"
 
+/**
+ * A cache of the lines that were matched by filters that have been removed,
+ * so that adding the same filter back only requires the lines that were
+ * indexed since then to be checked.  The results are keyed by the identity
+ * of the file and the cache key of the filter.  When the cache exceeds its
+ * memory limit, the least recently used results are dropped.
+ */
+class filter_result_cache {
+public:
+    struct result {
+        compressed_bitmap r_matches;
+        size_t r_filter_count{0};
+        int r_filter_hits{0};
+        bool r_last_message_matched{false};
+        size_t r_last_lines_for_message{0};
+    };
+
+    static filter_result_cache& singleton();
+
+    void put(const std::string& key, result res);
+
+    /**
+     * Remove the results for a key from the cache.
+     */
+    nonstd::optional<result> take(const std::string& key);
+
+    void clear();
+
+    size_t frc_max_size{64 * 1024 * 1024};
+
+private:
+    std::list<std::pair<std::string, result>> frc_results;
+    size_t frc_size{0};
+};
+
 class line_filter_observer : public logline_observer {
 public:
     line_filter_observer(filter_stack& fs, std::shared_ptr<logfile> lf)
@@ -44,6 +82,7 @@ public:
 
     void logline_restart(const logfile& lf, file_size_t rollback_size) override
     {
+        this->flush_batch();
         for (auto& filter : this->lfo_filter_stack) {
             filter->revert_to_last(this->lfo_filter_state, rollback_size);
         }
@@ -54,25 +93,58 @@ public:
                            logfile::const_iterator ll_end,
                            shared_buffer_ref& sbr) override;
 
+    void logline_new_batch(const logfile& lf,
+                           logfile::const_iterator ll_begin,
+                           logfile::const_iterator ll_end,
+                           line_span& span) override;
+
     void logline_eof(const logfile& lf) override;
 
+    bool logline_needs_content() const override
+    {
+        return !this->lfo_filter_stack.empty();
+    }
+
     bool excluded(uint32_t filter_in_mask,
                   uint32_t filter_out_mask,
                   size_t offset) const
     {
-        bool filtered_in = (filter_in_mask == 0)
-            || (this->lfo_filter_state.tfs_mask[offset] & filter_in_mask) != 0;
-        bool filtered_out
-            = (this->lfo_filter_state.tfs_mask[offset] & filter_out_mask) != 0;
-        return !filtered_in || filtered_out;
+        return this->lfo_filter_state.excluded(
+            filter_in_mask, filter_out_mask, offset);
     }
 
     size_t get_min_count(size_t max) const;
 
     void clear_deleted_filter_state();
 
+    /**
+     * Run the filters over the lines that have been collected so far.  The
+     * filters that can be used from multiple threads are run on a pool of
+     * threads with the batch split between them.
+     */
+    void flush_batch();
+
     filter_stack& lfo_filter_stack;
     logfile_filter_state lfo_filter_state;
+
+private:
+    struct batch_line {
+        /** The index of the line in the file. */
+        size_t bl_line;
+        /** The index of the first line in the message. */
+        size_t bl_message_line;
+        size_t bl_text_offset;
+        size_t bl_text_length;
+    };
+
+    void save_filter_state(size_t index);
+
+    void restore_filter_state(size_t index, const std::string& key);
+
+    std::vector<batch_line> lfo_batch_lines;
+    std::string lfo_batch_text;
+    /** The cache keys of the filters that the state is being kept for. */
+    std::string lfo_filter_keys[logfile_filter_state::MAX_FILTERS];
 };
 
 #endif
@@ -31,6 +31,8 @@
 
 #include "grep_proc.hh"
 
+#include <chrono>
+
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -46,6 +48,105 @@
 #include "lnav_util.hh"
 #include "vis_line.hh"
 
+namespace {
+
+struct grep_capture_result {
+    int gcr_start;
+    int gcr_end;
+    std::string gcr_value;
+};
+
+struct grep_match_result {
+    size_t gmr_index;
+    int gmr_start;
+    int gmr_end;
+    std::vector<grep_capture_result> gmr_captures;
+};
+
+/**
+ * Read the value of a line from a file the same way that it would be read
+ * through a line_buffer.
+ */
+void
+read_location(const grep_line_location& gll, std::string& value_out)
+{
+    size_t size = gll.gll_range.fr_size;
+    size_t off = 0;
+
+    value_out.resize(size);
+    while (off < size) {
+        auto rc = pread(gll.gll_fd->get(),
+                        &value_out[off],
+                        size - off,
+                        gll.gll_range.fr_offset + off);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            break;
+        }
+        off += rc;
+    }
+    value_out.resize(off);
+    while (!value_out.empty() && is_line_ending(value_out.back())) {
+        value_out.pop_back();
+    }
+    if (!gll.gll_valid_utf) {
+        scrub_to_utf8(&value_out[0], value_out.size());
+    }
+}
+
+/**
+ * Match the value of a line and collect the results so that they can be
+ * passed to the sink from the main thread.
+ */
+void
+match_value(const pcrepp& code,
+            size_t index,
+            const std::string& value,
+            std::vector<grep_match_result>& results)
+{
+    pcre_context_static<128> pc;
+    pcre_input pi(value);
+
+    while (code.match(pc, pi)) {
+        auto* m = pc.all();
+        grep_match_result gmr{index, m->c_begin, m->c_end};
+
+        for (auto pc_iter = pc.begin(); pc_iter != pc.end(); pc_iter++) {
+            if (!pc_iter->is_valid()) {
+                continue;
+            }
+
+            grep_capture_result gcr{pc_iter->c_begin, pc_iter->c_end};
+
+            /* If the capture was conditional, pcre will return a -1 here. */
+            if (pc_iter->c_begin >= 0) {
+                gcr.gcr_value.assign(pi.get_substr_start(pc_iter),
+                                     pc_iter->length());
+            }
+            gmr.gmr_captures.emplace_back(std::move(gcr));
+        }
+        results.emplace_back(std::move(gmr));
+    }
+}
+
+}  // namespace
+
+template<typename LineType>
+struct grep_proc<LineType>::thread_chunk {
+    struct line {
+        LineType l_line;
+        nonstd::optional<grep_line_location> l_location;
+        std::string l_value; /*< Set when the line has no location. */
+    };
+
+    std::vector<line> tc_lines;
+    std::vector<grep_match_result> tc_results;
+    bool tc_done{false}; /*< Protected by gp_work_mutex. */
+};
+
 template<typename LineType>
 grep_proc<LineType>::grep_proc(pcre* code, grep_proc_source<LineType>& gps)
     : gp_pcre(code), gp_source(gps)
@@ -59,6 +160,7 @@ template<typename LineType>
 grep_proc<LineType>::~grep_proc()
 {
     this->invalidate();
+    this->thread_stop();
 }
 
 template<typename LineType>
@@ -92,6 +194,27 @@ grep_proc<LineType>::start()
         return;
     }
 
+    if (this->gp_thread_count > 0) {
+        if (this->gp_threads.empty()) {
+            if (this->gp_wakeup_pipe.open() < 0) {
+                throw error(errno);
+            }
+            for (auto fd : {this->gp_wakeup_pipe.read_end().get(),
+                            this->gp_wakeup_pipe.write_end().get()})
+            {
+                log_perror(fcntl(fd, F_SETFL, O_NONBLOCK));
+                log_perror(fcntl(fd, F_SETFD, 1));
+            }
+            this->gp_work_stop = false;
+            for (size_t lpc = 0; lpc < this->gp_thread_count; lpc++) {
+                this->gp_threads.emplace_back(&grep_proc::thread_loop, this);
+            }
+        }
+        // The request is picked up by thread_batch() from the poll loop.
+        log_perror(write(this->gp_wakeup_pipe.write_end(), "", 1));
+        return;
+    }
+
     auto_pipe in_pipe(STDIN_FILENO);
     auto_pipe out_pipe(STDOUT_FILENO);
     auto_pipe err_pipe(STDERR_FILENO);
@@ -226,6 +349,221 @@ grep_proc<LineType>::child_loop()
     }
 }
 
+template<typename LineType>
+void
+grep_proc<LineType>::thread_loop()
+{
+    std::string value;
+
+    while (true) {
+        std::shared_ptr<thread_chunk> chunk;
+
+        {
+            std::unique_lock<std::mutex> lk(this->gp_work_mutex);
+
+            this->gp_work_cond.wait(lk, [this]() {
+                return this->gp_work_stop || !this->gp_work_queue.empty();
+            });
+            if (this->gp_work_stop) {
+                return;
+            }
+            chunk = std::move(this->gp_work_queue.front());
+            this->gp_work_queue.pop_front();
+        }
+
+        for (size_t index = 0; index < chunk->tc_lines.size(); index++) {
+            const auto& cl = chunk->tc_lines[index];
+
+            if (cl.l_location) {
+                read_location(cl.l_location.value(), value);
+                match_value(this->gp_pcre, index, value, chunk->tc_results);
+            } else {
+                match_value(
+                    this->gp_pcre, index, cl.l_value, chunk->tc_results);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lg(this->gp_work_mutex);
+
+            chunk->tc_done = true;
+        }
+        // The pipe is non-blocking, a full pipe will already wake up poll().
+        (void) write(this->gp_wakeup_pipe.write_end(), "", 1);
+    }
+}
+
+template<typename LineType>
+void
+grep_proc<LineType>::thread_stop()
+{
+    {
+        std::lock_guard<std::mutex> lg(this->gp_work_mutex);
+
+        this->gp_work_stop = true;
+        this->gp_work_queue.clear();
+    }
+    this->gp_work_cond.notify_all();
+    for (auto& thr : this->gp_threads) {
+        thr.join();
+    }
+    this->gp_threads.clear();
+    this->gp_wakeup_pipe.close();
+}
+
+template<typename LineType>
+void
+grep_proc<LineType>::thread_fill_chunk(
+    thread_chunk& chunk, std::chrono::steady_clock::time_point deadline)
+{
+    static const size_t MAX_CHUNK_LINES = 1024;
+
+    auto& line = this->gp_thread_line;
+
+    chunk.tc_lines.reserve(MAX_CHUNK_LINES);
+    while (chunk.tc_lines.size() < MAX_CHUNK_LINES) {
+        if (line == -1
+            || (this->gp_thread_stop != -1 && line >= this->gp_thread_stop))
+        {
+            this->gp_thread_located = true;
+            break;
+        }
+
+        typename thread_chunk::line cl{line};
+
+        cl.l_location = this->gp_source.grep_location_for_line(line);
+        if (!cl.l_location) {
+            if (!this->gp_source.grep_value_for_line(line, cl.l_value)) {
+                this->gp_source.grep_next_line(line);
+                this->gp_thread_located = true;
+                break;
+            }
+        }
+        chunk.tc_lines.emplace_back(std::move(cl));
+        this->gp_source.grep_next_line(line);
+
+        if (!chunk.tc_lines.back().l_location
+            && std::chrono::steady_clock::now() > deadline)
+        {
+            break;
+        }
+    }
+}
+
+template<typename LineType>
+void
+grep_proc<LineType>::thread_batch()
+{
+    static const auto MAX_LOCATE_TIME = std::chrono::milliseconds(10);
+
+    char buffer[128];
+
+    while (read(this->gp_wakeup_pipe.read_end(), buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + MAX_LOCATE_TIME;
+    auto max_pending = this->gp_thread_count * 2;
+
+    while (true) {
+        if (!this->gp_thread_active) {
+            if (this->gp_queue.empty()) {
+                break;
+            }
+
+            auto start_line = this->gp_queue.front().first;
+
+            this->gp_thread_stop = this->gp_queue.front().second;
+            this->gp_queue.pop_front();
+            this->gp_thread_line = this->gp_source.grep_initial_line(
+                start_line, this->gp_highest_line);
+            this->gp_thread_active = true;
+            this->gp_thread_located = false;
+        }
+
+        bool dispatched = false;
+
+        while (!this->gp_chunks.empty()) {
+            auto chunk = this->gp_chunks.front();
+
+            {
+                std::lock_guard<std::mutex> lg(this->gp_work_mutex);
+
+                if (!chunk->tc_done) {
+                    break;
+                }
+            }
+            this->gp_chunks.pop_front();
+            dispatched = true;
+
+            if (this->gp_sink == nullptr) {
+                continue;
+            }
+            for (auto& gmr : chunk->tc_results) {
+                auto match_line = chunk->tc_lines[gmr.gmr_index].l_line;
+
+                this->gp_last_line = match_line;
+                this->gp_sink->grep_match(
+                    *this, match_line, gmr.gmr_start, gmr.gmr_end);
+                for (auto& gcr : gmr.gmr_captures) {
+                    this->gp_sink->grep_capture(
+                        *this,
+                        match_line,
+                        gcr.gcr_start,
+                        gcr.gcr_end,
+                        gcr.gcr_start < 0 ? nullptr : &gcr.gcr_value[0]);
+                }
+                this->gp_sink->grep_match_end(*this, match_line);
+            }
+        }
+        if (dispatched && this->gp_sink != nullptr) {
+            this->gp_sink->grep_end_batch(*this);
+        }
+
+        if (this->gp_thread_located) {
+            if (!this->gp_chunks.empty()) {
+                break;
+            }
+
+            if (this->gp_thread_stop == -1) {
+                // When scanning to the end of the source, we need to
+                // remember the highest line that was seen so that the next
+                // request that continues from the end works properly.
+                this->gp_highest_line = this->gp_thread_line - LineType(1);
+            }
+            this->gp_thread_active = false;
+            if (this->gp_sink != nullptr) {
+                this->gp_sink->grep_end(*this);
+            }
+            continue;
+        }
+
+        if (this->gp_chunks.size() >= max_pending) {
+            // Wait for a search thread to finish a chunk.
+            break;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            // Come back after the rest of the main loop has had a turn.
+            log_perror(write(this->gp_wakeup_pipe.write_end(), "", 1));
+            break;
+        }
+
+        auto chunk = std::make_shared<thread_chunk>();
+
+        this->thread_fill_chunk(*chunk, deadline);
+        if (chunk->tc_lines.empty()) {
+            continue;
+        }
+        this->gp_chunks.push_back(chunk);
+        {
+            std::lock_guard<std::mutex> lg(this->gp_work_mutex);
+
+            this->gp_work_queue.emplace_back(std::move(chunk));
+        }
+        this->gp_work_cond.notify_one();
+    }
+}
+
 template<typename LineType>
 void
 grep_proc<LineType>::cleanup()
@@ -248,6 +586,21 @@ grep_proc<LineType>::cleanup()
         }
     }
 
+    if (this->gp_thread_active) {
+        this->gp_thread_active = false;
+        if (this->gp_sink) {
+            this->gp_sink->grep_end(*this);
+        }
+    }
+    if (!this->gp_chunks.empty()) {
+        // Chunks that are already being searched are dropped when they
+        // are finished.
+        std::lock_guard<std::mutex> lg(this->gp_work_mutex);
+
+        this->gp_work_queue.clear();
+        this->gp_chunks.clear();
+    }
+
     if (this->gp_err_pipe != -1) {
         this->gp_err_pipe.reset();
     }
@@ -310,6 +663,12 @@ grep_proc<LineType>::check_poll_set(const std::vector<struct pollfd>& pollfds)
 {
     require(this->invariant());
 
+    if (this->gp_wakeup_pipe.read_end() != -1
+        && pollfd_ready(pollfds, this->gp_wakeup_pipe.read_end()))
+    {
+        this->thread_batch();
+    }
+
     if (this->gp_err_pipe != -1 && pollfd_ready(pollfds, this->gp_err_pipe)) {
         char buffer[1024 + 1];
         ssize_t rc;
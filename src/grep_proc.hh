@@ -32,9 +32,14 @@
 #ifndef grep_proc_hh
 #define grep_proc_hh
 
+#include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <poll.h>
@@ -52,6 +57,17 @@
 template<typename LineType>
 class grep_proc;
 
+/**
+ * The location of the value for a line in a file.  Search threads use it to
+ * read the value themselves since sources are not expected to be
+ * thread-safe.
+ */
+struct grep_line_location {
+    std::shared_ptr<auto_fd> gll_fd;
+    file_range gll_range;
+    bool gll_valid_utf{true};
+};
+
 /**
  * Data source for lines to be searched using a grep_proc.
  */
@@ -73,6 +89,19 @@ public:
      */
     virtual bool grep_value_for_line(LineType line, std::string& value_out) = 0;
 
+    /**
+     * Get the location of the value for a line so that it can be read by a
+     * search thread.  The values for lines without a location are retrieved
+     * with grep_value_for_line() on the main thread instead.
+     *
+     * @param line The line to locate.
+     */
+    virtual nonstd::optional<grep_line_location> grep_location_for_line(
+        LineType line)
+    {
+        return nonstd::nullopt;
+    }
+
     virtual LineType grep_initial_line(LineType start, LineType highest)
     {
         if (start == -1) {
@@ -159,7 +188,8 @@ public:
  * parent process.
  *
  * Note: The "grep" executable is not actually used, instead we use the pcre(3)
- * library directly.
+ * library directly.  The search can also be done in this process by a pool
+ * of threads, see set_thread_count().
  */
 template<typename LineType>
 class grep_proc {
@@ -223,6 +253,22 @@ public:
         return *this;
     };
 
+    /**
+     * Search in this process instead of in a child process.  The lines are
+     * split into chunks that are read and matched by a pool of threads that
+     * lives as long as this object.  Lines are only located on the calling
+     * thread, see grep_proc_source::grep_location_for_line(), and the
+     * results are passed to the sink in line order from check_poll_set() as
+     * each chunk is finished.
+     *
+     * @param count The number of threads to use or zero to search in a
+     * child process.
+     */
+    void set_thread_count(size_t count)
+    {
+        this->gp_thread_count = count;
+    };
+
     /**
      * Start the search requests that have been queued up with queue_request.
      */
@@ -237,6 +283,12 @@ public:
         if (this->gp_err_pipe != -1) {
             pollfds.push_back((struct pollfd){this->gp_err_pipe, POLLIN, 0});
         }
+        if (!this->gp_threads.empty()
+            && (this->gp_thread_active || !this->gp_queue.empty()))
+        {
+            pollfds.push_back(
+                (struct pollfd){this->gp_wakeup_pipe.read_end(), POLLIN, 0});
+        }
     };
 
     /**
@@ -275,6 +327,25 @@ protected:
 
     void child_loop();
 
+    struct thread_chunk;
+
+    /**
+     * Pass the results of finished chunks to the sink and queue up more
+     * chunks for the search threads.
+     */
+    void thread_batch();
+
+    /**
+     * Locate the lines for the next chunk of the current request.  The
+     * values for lines without a location are read until the deadline.
+     */
+    void thread_fill_chunk(thread_chunk& chunk,
+                           std::chrono::steady_clock::time_point deadline);
+
+    void thread_loop();
+
+    void thread_stop();
+
     virtual void child_init(){};
 
     virtual void child_batch()
@@ -318,5 +389,27 @@ protected:
                                */
     grep_proc_sink<LineType>* gp_sink{nullptr}; /*< The sink delegate. */
     grep_proc_control* gp_control{nullptr}; /*< The control delegate. */
+
+    size_t gp_thread_count{0}; /*< The number of threads to search with. */
+    std::vector<std::thread> gp_threads;
+    auto_pipe gp_wakeup_pipe; /*<
+                               * Written to by the search threads when a
+                               * chunk is finished so that poll() returns.
+                               */
+    bool gp_thread_active{false}; /*< True if a request is in progress. */
+    bool gp_thread_located{false}; /*<
+                                    * True if all of the lines in the
+                                    * current request have been located.
+                                    */
+    LineType gp_thread_line{0}; /*< The next line to locate. */
+    LineType gp_thread_stop{0}; /*< The end of the current request. */
+    /** The chunks for the current request in line order. */
+    std::deque<std::shared_ptr<thread_chunk>> gp_chunks;
+
+    std::mutex gp_work_mutex; /*< Protects the members below. */
+    std::condition_variable gp_work_cond;
+    bool gp_work_stop{false};
+    /** The chunks waiting to be picked up by a search thread. */
+    std::deque<std::shared_ptr<thread_chunk>> gp_work_queue;
 };
 #endif
@@ -27,38 +27,33 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include "hist_source.hh"
 
 #include "base/math_util.hh"
 #include "config.h"
 #include "fmt/chrono.h"
 
-nonstd::optional<vis_line_t>
-hist_source2::row_for_time(struct timeval tv_bucket)
+std::vector<hist_source2::bucket_t>::iterator
+hist_source2::level_t::find_bucket(time_t row)
 {
-    std::map<int64_t, struct bucket_block>::iterator iter;
-    int retval = 0;
-    time_t time_bucket = rounddown(tv_bucket.tv_sec, this->hs_time_slice);
+    time_t time_bucket = rounddown(row, this->l_time_slice);
 
-    for (iter = this->hs_blocks.begin(); iter != this->hs_blocks.end(); ++iter)
-    {
-        struct bucket_block& bb = iter->second;
+    return std::lower_bound(
+        this->l_buckets.begin(),
+        this->l_buckets.end(),
+        time_bucket,
+        [](const bucket_t& lhs, time_t rhs) { return lhs.b_time < rhs; });
+}
 
-        if (time_bucket < bb.bb_buckets[0].b_time) {
-            break;
-        }
-        if (time_bucket > bb.bb_buckets[bb.bb_used].b_time) {
-            retval += bb.bb_used + 1;
-            continue;
-        }
+nonstd::optional<vis_line_t>
+hist_source2::row_for_time(struct timeval tv_bucket)
+{
+    auto& level = this->current_level();
+    auto iter = level.find_bucket(tv_bucket.tv_sec);
 
-        for (unsigned int lpc = 0; lpc <= bb.bb_used; lpc++, retval++) {
-            if (time_bucket <= bb.bb_buckets[lpc].b_time) {
-                return vis_line_t(retval);
-            }
-        }
-    }
-    return vis_line_t(retval);
+    return vis_line_t(std::distance(level.l_buckets.begin(), iter));
 }
 
 void
@@ -67,7 +62,7 @@ hist_source2::text_value_for_line(textview_curses& tc,
                                   std::string& value_out,
                                   text_sub_source::line_flags_t flags)
 {
-    bucket_t& bucket = this->find_bucket(row);
+    const bucket_t& bucket = this->current_level().l_buckets[row];
     struct tm bucket_tm;
 
     value_out.clear();
@@ -92,7 +87,9 @@ hist_source2::text_attrs_for_line(textview_curses& tc,
                                   int row,
                                   string_attrs_t& value_out)
 {
-    bucket_t& bucket = this->find_bucket(row);
+    this->update_chart();
+
+    const bucket_t& bucket = this->current_level().l_buckets[row];
     int left = 0;
 
     for (int lpc = 0; lpc < HT__MAX; lpc++) {
@@ -115,17 +112,117 @@ hist_source2::add_value(time_t row,
 
     require(row >= this->hs_last_row);
 
-    row = rounddown(row, this->hs_time_slice);
-    if (row != this->hs_last_row) {
-        this->end_of_row();
+    this->hs_last_row = row;
+
+    auto& finest = this->hs_levels.front();
+    time_t finest_bucket = rounddown(row, finest.l_time_slice);
+    bool new_bucket = finest.l_buckets.empty()
+        || finest.l_buckets.back().b_time != finest_bucket;
 
-        this->hs_last_bucket += 1;
-        this->hs_last_row = row;
+    if (new_bucket) {
+        finest.l_buckets.emplace_back();
+        finest.l_buckets.back().b_time = finest_bucket;
     }
+    finest.l_buckets.back().b_values[htype].hv_value += value;
+
+    for (size_t lpc = 1; lpc < this->hs_levels.size(); lpc++) {
+        auto& level = this->hs_levels[lpc];
+
+        if (level.l_fold) {
+            if (!new_bucket && level.l_folded == finest.l_buckets.size()) {
+                // The finest bucket was already folded into this level.
+                level.l_buckets.back().b_values[htype].hv_value += value;
+            }
+            continue;
+        }
 
-    bucket_t& bucket = this->find_bucket(this->hs_last_bucket);
-    bucket.b_time = row;
-    bucket.b_values[htype].hv_value += value;
+        time_t time_bucket = rounddown(row, level.l_time_slice);
+
+        if (level.l_buckets.empty()
+            || level.l_buckets.back().b_time != time_bucket)
+        {
+            level.l_buckets.emplace_back();
+            level.l_buckets.back().b_time = time_bucket;
+        }
+        level.l_buckets.back().b_values[htype].hv_value += value;
+    }
+    this->hs_chart_valid = false;
+}
+
+void
+hist_source2::fold_level(hist_source2::level_t& level)
+{
+    if (!level.l_fold) {
+        return;
+    }
+
+    const auto& finest = this->hs_levels.front();
+
+    for (; level.l_folded < finest.l_buckets.size(); level.l_folded++) {
+        const auto& bucket = finest.l_buckets[level.l_folded];
+        time_t time_bucket = rounddown(bucket.b_time, level.l_time_slice);
+
+        if (level.l_buckets.empty()
+            || level.l_buckets.back().b_time != time_bucket)
+        {
+            level.l_buckets.emplace_back();
+            level.l_buckets.back().b_time = time_bucket;
+        }
+        for (int lpc = 0; lpc < HT__MAX; lpc++) {
+            level.l_buckets.back().b_values[lpc].hv_value
+                += bucket.b_values[lpc].hv_value;
+        }
+    }
+}
+
+void
+hist_source2::clear_values(hist_source2::hist_type_t htype)
+{
+    for (auto& level : this->hs_levels) {
+        for (auto& bucket : level.l_buckets) {
+            bucket.b_values[htype].hv_value = 0.0;
+        }
+    }
+    this->hs_chart_valid = false;
+}
+
+void
+hist_source2::update_value(time_t row,
+                           hist_source2::hist_type_t htype,
+                           double value)
+{
+    auto& finest = this->hs_levels.front();
+    auto finest_iter = finest.find_bucket(row);
+
+    if (finest_iter == finest.l_buckets.end()
+        || finest_iter->b_time != rounddown(row, finest.l_time_slice))
+    {
+        // The line was marked after the last time the histogram was
+        // indexed, so the marks will be counted by the next rebuild.
+        log_warning("no histogram bucket for time %ld", row);
+        return;
+    }
+
+    size_t finest_index = std::distance(finest.l_buckets.begin(), finest_iter);
+
+    for (auto& level : this->hs_levels) {
+        if (level.l_fold && finest_index >= level.l_folded) {
+            // The value is picked up when the bucket is folded in.
+            continue;
+        }
+
+        auto iter = level.find_bucket(row);
+
+        if (iter == level.l_buckets.end()
+            || iter->b_time != rounddown(row, level.l_time_slice))
+        {
+            log_warning("no histogram bucket for time %ld", row);
+            continue;
+        }
+
+        iter->b_values[htype].hv_value += value;
+    }
+    this->hs_chart_valid = false;
 }
 
 void
@@ -144,48 +241,83 @@ hist_source2::init()
                               vc.attrs_for_role(role_t::VCR_KEYWORD));
 }
 
+void
+hist_source2::set_time_slices(const std::vector<int64_t>& slices)
+{
+    require(!slices.empty());
+
+    this->hs_levels.clear();
+    for (auto slice : slices) {
+        this->hs_levels.emplace_back(
+            slice,
+            !this->hs_levels.empty()
+                && (slice % this->hs_levels.front().l_time_slice) == 0);
+    }
+    this->hs_current_level = 0;
+    this->clear();
+}
+
+bool
+hist_source2::set_time_slice(int64_t slice)
+{
+    this->hs_chart_valid = false;
+    for (size_t lpc = 0; lpc < this->hs_levels.size(); lpc++) {
+        if (this->hs_levels[lpc].l_time_slice == slice) {
+            this->hs_current_level = lpc;
+            return true;
+        }
+    }
+
+    auto fold = (slice % this->hs_levels.front().l_time_slice) == 0;
+
+    if (!fold) {
+        log_warning("histogram time slice %ld is not being maintained",
+                    slice);
+    }
+    this->hs_levels.emplace_back(slice, fold);
+    this->hs_current_level = this->hs_levels.size() - 1;
+
+    return fold;
+}
+
 void
 hist_source2::clear()
 {
-    this->hs_line_count = 0;
-    this->hs_last_bucket = -1;
+    for (auto& level : this->hs_levels) {
+        level.l_folded = 0;
+        level.l_buckets.clear();
+    }
     this->hs_last_row = -1;
-    this->hs_blocks.clear();
+    this->hs_chart_valid = false;
     this->hs_chart.clear();
     this->init();
 }
 
 void
-hist_source2::end_of_row()
+hist_source2::update_chart()
 {
-    if (this->hs_last_bucket >= 0) {
-        bucket_t& last_bucket = this->find_bucket(this->hs_last_bucket);
+    if (this->hs_chart_valid) {
+        return;
+    }
 
+    this->hs_chart.clear_stats();
+    for (const auto& bucket : this->current_level().l_buckets) {
         for (int lpc = 0; lpc < HT__MAX; lpc++) {
             this->hs_chart.add_value((const hist_type_t) lpc,
-                                     last_bucket.b_values[lpc].hv_value);
+                                     bucket.b_values[lpc].hv_value);
         }
     }
+    this->hs_chart_valid = true;
 }
 
 nonstd::optional<struct timeval>
 hist_source2::time_for_row(vis_line_t row)
 {
-    if (row < 0 || row > this->hs_line_count) {
+    const auto& level = this->current_level();
+
+    if (row < 0 || row >= (ssize_t) level.l_buckets.size()) {
         return nonstd::nullopt;
     }
 
-    bucket_t& bucket = this->find_bucket(row);
-
-    return timeval{bucket.b_time, 0};
-}
-
-hist_source2::bucket_t&
-hist_source2::find_bucket(int64_t index)
-{
-    struct bucket_block& bb = this->hs_blocks[index / BLOCK_SIZE];
-    unsigned int intra_block_index = index % BLOCK_SIZE;
-    bb.bb_used = std::max(intra_block_index, bb.bb_used);
-    this->hs_line_count = std::max(this->hs_line_count, index + 1);
-    return bb.bb_buckets[intra_block_index];
+    return timeval{level.l_buckets[row].b_time, 0};
 }
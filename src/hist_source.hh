@@ -239,6 +239,13 @@ public:
         this->sbc_show_state = show_all();
     };
 
+    void clear_stats()
+    {
+        for (auto& ci : this->sbc_idents) {
+            ci.ci_stats = bucket_stats_t();
+        }
+    };
+
     void add_value(const T& ident, double amount = 1.0)
     {
         struct chart_ident& ci = this->find_ident(ident);
@@ -312,6 +319,14 @@ protected:
     show_state sbc_show_state;
 };
 
+/**
+ * The data source for the histogram view.  Values are only added to the
+ * buckets for the first, and finest, time slice.  The buckets for the other
+ * time slices that the view can be zoomed to are folded together from those
+ * when they are needed.  So, changing the zoom level only has to aggregate
+ * buckets and re-adding all of the values, like when the filters change,
+ * only costs a single bucket update for each value.
+ */
 class hist_source2
     : public text_sub_source
     , public text_time_translator {
@@ -327,26 +342,42 @@ public:
 
     hist_source2()
     {
-        this->clear();
+        this->set_time_slices({10 * 60});
     }
 
     ~hist_source2() override = default;
 
     void init();
 
-    void set_time_slice(int64_t slice)
-    {
-        this->hs_time_slice = slice;
-    }
+    /**
+     * Set the time slices that buckets should be maintained for.  Any
+     * existing values are cleared and the first slice becomes the current
+     * one.  The buckets for slices that are a multiple of the first one are
+     * folded from the buckets of the first slice.
+     *
+     * @param slices The time slices, in seconds.
+     */
+    void set_time_slices(const std::vector<int64_t>& slices);
+
+    /**
+     * Switch to the buckets for the given time slice.
+     *
+     * @param slice The time slice, in seconds.
+     * @return True if the buckets for the slice were already being
+     *   maintained or can be folded from the finest buckets.  Otherwise, a
+     *   new, empty, set of buckets is started and the values need to be
+     *   added again.
+     */
+    bool set_time_slice(int64_t slice);
 
     int64_t get_time_slice() const
     {
-        return this->hs_time_slice;
+        return this->current_level().l_time_slice;
     }
 
     size_t text_line_count() override
     {
-        return this->hs_line_count;
+        return this->current_level().l_buckets.size();
     }
 
     size_t text_line_width(textview_curses& curses) override
@@ -358,7 +389,19 @@ public:
 
     void add_value(time_t row, hist_type_t htype, double value = 1.0);
 
-    void end_of_row();
+    /**
+     * Reset the values of the given type in all of the buckets so they can
+     * be recounted with update_value().
+     */
+    void clear_values(hist_type_t htype);
+
+    /**
+     * Add to the value of the given type in the buckets that cover a time
+     * that has already been added with add_value().  Unlike add_value(), the
+     * times do not need to be in order.  Times without a bucket are
+     * skipped.
+     */
+    void update_value(time_t row, hist_type_t htype, double value = 1.0);
 
     void text_value_for_line(textview_curses& tc,
                              int row,
@@ -391,25 +434,44 @@ private:
         hist_value b_values[HT__MAX];
     };
 
-    static const int64_t BLOCK_SIZE = 100;
-
-    struct bucket_block {
-        bucket_block()
+    struct level_t {
+        level_t(int64_t time_slice, bool fold)
+            : l_time_slice(time_slice), l_fold(fold)
         {
-            memset(this->bb_buckets, 0, sizeof(this->bb_buckets));
         }
 
-        unsigned int bb_used{0};
-        bucket_t bb_buckets[BLOCK_SIZE];
+        std::vector<bucket_t>::iterator find_bucket(time_t row);
+
+        int64_t l_time_slice;
+        /** True if the buckets are folded from the finest buckets. */
+        bool l_fold;
+        /** The number of the finest buckets that have been folded in. */
+        size_t l_folded{0};
+        std::vector<bucket_t> l_buckets;
     };
 
-    bucket_t& find_bucket(int64_t index);
+    const level_t& current_level() const
+    {
+        return this->hs_levels[this->hs_current_level];
+    }
+
+    level_t& current_level()
+    {
+        auto& retval = this->hs_levels[this->hs_current_level];
+
+        this->fold_level(retval);
+        return retval;
+    }
+
+    /** Fold any new buckets from the finest level into the given level. */
+    void fold_level(level_t& level);
+
+    void update_chart();
 
-    int64_t hs_time_slice{10 * 60};
-    int64_t hs_line_count;
-    int64_t hs_last_bucket;
+    std::vector<level_t> hs_levels;
+    size_t hs_current_level{0};
     time_t hs_last_row;
-    std::map<int64_t, struct bucket_block> hs_blocks;
+    bool hs_chart_valid{false};
     stacked_bar_chart<hist_type_t> hs_chart;
 };
 
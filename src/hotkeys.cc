@@ -59,7 +59,7 @@ public:
 
         };
 
-    logline& move_to_msg_start()
+    logline move_to_msg_start()
     {
         content_line_t cl = this->lh_sub_source.at(this->lh_current_line);
         std::shared_ptr<logfile> lf = this->lh_sub_source.find(cl);
@@ -72,7 +72,7 @@ public:
         return (*lf)[cl];
     };
 
-    logline& current_line()
+    logline current_line()
     {
         content_line_t cl = this->lh_sub_source.at(this->lh_current_line);
         std::shared_ptr<logfile> lf = this->lh_sub_source.find(cl);
@@ -579,7 +579,7 @@ handle_paging_key(int ch)
                 logline_helper start_helper(*lss);
 
                 start_helper.lh_current_line = tc->get_top();
-                logline& start_line = start_helper.move_to_msg_start();
+                logline start_line = start_helper.move_to_msg_start();
                 start_helper.annotate();
 
                 struct line_range opid_range = find_string_attr_range(
@@ -606,7 +606,7 @@ handle_paging_key(int ch)
                                 break;
                             }
                         }
-                        logline& next_line = next_helper.current_line();
+                        logline next_line = next_helper.current_line();
                         if (!next_line.is_message()) {
                             continue;
                         }
@@ -738,18 +738,13 @@ handle_paging_key(int ch)
                 }
 
                 if (log_line_index != -1) {
-                    fmt::memory_buffer linestr;
                     int line_number = (int) tc->get_top();
                     unsigned int row;
 
-                    fmt::format_to(std::back_inserter(linestr),
-                                   FMT_STRING("{}"),
-                                   line_number);
-                    linestr.push_back('\0');
-                    for (row = 0; row < dls.dls_rows.size(); row++) {
-                        if (strcmp(dls.dls_rows[row][log_line_index],
-                                   linestr.data())
-                            == 0) {
+                    for (row = 0; row < dls.row_count(); row++) {
+                        if (dls.get_cell_number(row, log_line_index)
+                            == (double) line_number)
+                        {
                             vis_line_t db_line(row);
 
                             db_tc->set_top(db_line);
@@ -768,14 +763,13 @@ handle_paging_key(int ch)
                 }
 
                 if (log_line_index != -1) {
-                    unsigned int line_number;
+                    auto line_number
+                        = dls.get_cell_number(db_row, log_line_index);
 
-                    if (sscanf(dls.dls_rows[db_row][log_line_index],
-                               "%d",
-                               &line_number)
-                        && line_number < tc->listview_rows(*tc))
+                    if (line_number && line_number.value() >= 0
+                        && line_number.value() < tc->listview_rows(*tc))
                     {
-                        tc->set_top(vis_line_t(line_number));
+                        tc->set_top(vis_line_t(line_number.value()));
                         tc->set_needs_update();
                     }
                 } else {
@@ -783,10 +777,13 @@ handle_paging_key(int ch)
                         date_time_scanner dts;
                         struct timeval tv;
                         struct exttm tm;
-                        const char* col_value = dls.dls_rows[db_row][lpc];
-                        size_t col_len = strlen(col_value);
+                        auto col_value = dls.get_cell(db_row, lpc);
 
-                        if (dts.scan(col_value, col_len, nullptr, &tm, tv)
+                        if (dts.scan(col_value.c_str(),
+                                     col_value.length(),
+                                     nullptr,
+                                     &tm,
+                                     tv)
                             != nullptr) {
                             lnav_data.ld_log_source.find_from_time(tv) |
                                 [tc](auto vl) {
@@ -892,7 +889,7 @@ handle_paging_key(int ch)
                     }
 
                     cl = lnav_data.ld_log_source.at(vl);
-                    logline* ll = lnav_data.ld_log_source.find_line(cl);
+                    auto ll = lnav_data.ld_log_source.find_line(cl);
                     ll->to_exttm(tm);
                     do {
                         tm = rt.adjust(tm);
@@ -915,6 +912,13 @@ handle_paging_key(int ch)
             }
             break;
 
+        case KEY_CTRL_RBRACKET:
+            if (!is_sql_pending()) {
+                return false;
+            }
+            cancel_pending_sql();
+            break;
+
         case KEY_CTRL_W:
             execute_command(ec,
                             lnav_data.ld_views[LNV_LOG].get_word_wrap()
@@ -31,8 +31,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "config.h"
@@ -41,7 +44,24 @@
 #    include <bzlib.h>
 #endif
 
+#ifdef HAVE_ZSTD_H
+#    include <zstd.h>
+#endif
+
+#ifdef HAVE_LZMA_H
+#    include <lzma.h>
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+#    include <lz4frame.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <set>
+#include <thread>
 
 #ifdef HAVE_X86INTRIN_H
 #    include "simdutf8check.h"
@@ -49,69 +69,13 @@
 
 #include "base/is_utf8.hh"
 #include "base/math_util.hh"
+#include "base/string_util.hh"
 #include "fmtlib/fmt/format.h"
 #include "line_buffer.hh"
 
 static const ssize_t DEFAULT_INCREMENT = 128 * 1024;
 static const ssize_t MAX_COMPRESSED_BUFFER_SIZE = 32 * 1024 * 1024;
 
-/*
- * XXX REMOVE ME
- *
- * The stock bzipped file code does not use pread, so we need to use a lock to
- * get exclusive access to the file.  In the future, we should just rewrite
- * the bzipped file code to use pread.
- */
-class lock_hack {
-public:
-    class guard {
-    public:
-        guard() : g_lock(lock_hack::singleton())
-        {
-            this->g_lock.lock();
-        };
-
-        ~guard()
-        {
-            this->g_lock.unlock();
-        };
-
-    private:
-        lock_hack& g_lock;
-    };
-
-    static lock_hack& singleton()
-    {
-        static lock_hack retval;
-
-        return retval;
-    };
-
-    void lock()
-    {
-        lockf(this->lh_fd, F_LOCK, 0);
-    };
-
-    void unlock()
-    {
-        lockf(this->lh_fd, F_ULOCK, 0);
-    };
-
-private:
-    lock_hack()
-    {
-        char lockname[64];
-
-        snprintf(lockname, sizeof(lockname), "/tmp/lnav.%d.lck", getpid());
-        this->lh_fd = open(lockname, O_CREAT | O_RDWR, 0600);
-        log_perror(fcntl(this->lh_fd, F_SETFD, FD_CLOEXEC));
-        unlink(lockname);
-    };
-
-    auto_fd lh_fd;
-};
-/* XXX END */
-
 static int32_t
 read_le32(const unsigned char* data)
 {
@@ -160,139 +124,1485 @@ line_buffer::gz_indexed::init_stream()
     }
 }
 
-void
-line_buffer::gz_indexed::continue_stream()
+void
+line_buffer::gz_indexed::continue_stream()
+{
+    // Save our position and output buffer
+    auto total_in = this->strm.total_in;
+    auto total_out = this->strm.total_out;
+    auto avail_out = this->strm.avail_out;
+    auto next_out = this->strm.next_out;
+
+    init_stream();
+
+    // Restore position and output buffer
+    this->strm.total_in = total_in;
+    this->strm.total_out = total_out;
+    this->strm.avail_out = avail_out;
+    this->strm.next_out = next_out;
+}
+
+void
+line_buffer::gz_indexed::open(int fd)
+{
+    this->close();
+    this->init_stream();
+    this->gz_fd = fd;
+}
+
+int
+line_buffer::gz_indexed::stream_data(void* buf, size_t size)
+{
+    this->strm.avail_out = size;
+    this->strm.next_out = (unsigned char*) buf;
+
+    size_t last = this->syncpoints.empty() ? 0 : this->syncpoints.back().in;
+    while (this->strm.avail_out) {
+        if (!this->strm.avail_in) {
+            int rc = ::pread(
+                this->gz_fd, &this->inbuf[0], Z_BUFSIZE, this->strm.total_in);
+            if (rc < 0) {
+                return rc;
+            }
+            this->strm.next_in = this->inbuf;
+            this->strm.avail_in = rc;
+        }
+        if (this->strm.avail_in) {
+            int flush = last > this->strm.total_in ? Z_SYNC_FLUSH : Z_BLOCK;
+            auto err = inflate(&this->strm, flush);
+            if (err == Z_STREAM_END) {
+                // Reached end of stream; re-init for a possible subsequent
+                // stream
+                continue_stream();
+            } else if (err != Z_OK) {
+                log_error(" inflate-error: %d  %s",
+                          (int) err,
+                          this->strm.msg ? this->strm.msg : "");
+                break;
+            }
+
+            if (this->strm.total_in >= last + SYNCPOINT_SIZE
+                && size > this->strm.avail_out + GZ_WINSIZE
+                && (this->strm.data_type & GZ_END_OF_BLOCK_MASK)
+                && !(this->strm.data_type & GZ_END_OF_FILE_MASK))
+            {
+                this->syncpoints.emplace_back(this->strm, size);
+                last = this->strm.total_out;
+            }
+        } else if (this->strm.avail_out) {
+            // Processed all the gz file data but didn't fill
+            // the output buffer.  We're done, even though we
+            // produced fewer bytes than requested.
+            break;
+        }
+    }
+    return size - this->strm.avail_out;
+}
+
+void
+line_buffer::gz_indexed::seek(off_t offset)
+{
+    if ((size_t) offset == this->strm.total_out) {
+        return;
+    }
+
+    indexDict* dict = nullptr;
+    // Find highest syncpoint not past offset
+    auto sync_iter = std::upper_bound(
+        this->syncpoints.begin(),
+        this->syncpoints.end(),
+        offset,
+        [](off_t off, const indexDict& d) { return off < d.out; });
+    if (sync_iter != this->syncpoints.begin()) {
+        dict = &(*std::prev(sync_iter));
+    }
+
+    // Choose highest available syncpoint, or keep current offset if it's ok
+    if ((size_t) offset < this->strm.total_out
+        || (dict && this->strm.total_out < (size_t) dict->out))
+    {
+        // Release the old z_stream
+        inflateEnd(&this->strm);
+        if (dict) {
+            dict->apply(&this->strm);
+        } else {
+            init_stream();
+        }
+    }
+
+    // Stream from compressed file until we reach our offset
+    unsigned char dummy[Z_BUFSIZE];
+    while ((size_t) offset > this->strm.total_out) {
+        size_t to_copy
+            = std::min(static_cast<size_t>(Z_BUFSIZE),
+                       static_cast<size_t>(offset - this->strm.total_out));
+        auto bytes = stream_data(dummy, to_copy);
+        if (bytes <= 0) {
+            break;
+        }
+    }
+}
+
+int
+line_buffer::gz_indexed::read(void* buf, size_t offset, size_t size)
+{
+    if (offset != this->strm.total_out) {
+        this->seek(offset);
+    }
+
+    int bytes = stream_data(buf, size);
+
+    return bytes;
+}
+
+/* The magic numbers at the start of a block and the end of a stream. */
+static const uint64_t BZ_BLOCK_MAGIC = 0x314159265359ULL;
+static const uint64_t BZ_END_OF_STREAM_MAGIC = 0x177245385090ULL;
+static const uint64_t BZ_MAGIC_MASK = (1ULL << 48) - 1;
+static const size_t BZ_SCAN_SIZE = 256 * 1024;
+/*
+ * The number of candidate block boundaries to try when a block cannot be
+ * decompressed because a block magic number showed up by chance inside of
+ * the compressed data.
+ */
+static const int BZ_MAX_FALSE_MAGICS = 8;
+
+static size_t
+bz_thread_count()
+{
+    return std::max(1U, std::min(std::thread::hardware_concurrency(), 8U));
+}
+
+namespace {
+
+/**
+ * Appends bits to a string, most significant bit first, which is the order
+ * that bzip2 uses.
+ */
+class bit_writer {
+public:
+    explicit bit_writer(std::string& out) : bw_out(out) {}
+
+    void put(uint32_t value, int count)
+    {
+        require(count <= 32);
+
+        this->bw_bits = (this->bw_bits << count)
+            | (value & ((count == 32) ? 0xffffffffULL : ((1ULL << count) - 1)));
+        this->bw_count += count;
+        while (this->bw_count >= 8) {
+            this->bw_out.push_back(
+                (char) (this->bw_bits >> (this->bw_count - 8)));
+            this->bw_count -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (this->bw_count > 0) {
+            this->bw_out.push_back(
+                (char) (this->bw_bits << (8 - this->bw_count)));
+            this->bw_count = 0;
+        }
+    }
+
+private:
+    std::string& bw_out;
+    uint64_t bw_bits{0};
+    int bw_count{0};
+};
+
+}  // namespace
+
+static bool
+pread_fully(int fd, char* buf, size_t len, file_off_t off)
+{
+    while (len > 0) {
+        auto rc = pread(fd, buf, len, off);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            return false;
+        }
+        buf += rc;
+        len -= rc;
+        off += rc;
+    }
+
+    return true;
+}
+
+#ifdef HAVE_BZLIB_H
+/**
+ * Read a block out of a bzip2 file and wrap it in a stream header and
+ * trailer so that it can be decompressed by itself.  Since there is only one
+ * block in the new stream, the combined CRC in the trailer is the same as
+ * the CRC of the block.
+ */
+static bool
+bz_extract_block(int fd,
+                 int64_t in_bits,
+                 int64_t in_end_bits,
+                 char level,
+                 std::string& stream_out)
+{
+    auto first_byte = in_bits / 8;
+    auto shift = in_bits % 8;
+    auto bit_count = in_end_bits - in_bits;
+    size_t in_len = (in_end_bits + 7) / 8 - first_byte;
+    std::string in;
+
+    if (bit_count < 48 + 32) {
+        return false;
+    }
+
+    // An extra byte so the shifted copy below can always read ahead.
+    in.resize(in_len + 1);
+    if (!pread_fully(fd, &in[0], in_len, first_byte)) {
+        return false;
+    }
+
+    auto in_bytes = (const unsigned char*) in.data();
+    auto shifted_byte = [in_bytes, shift](size_t index) -> uint8_t {
+        if (shift == 0) {
+            return in_bytes[index];
+        }
+        return (in_bytes[index] << shift) | (in_bytes[index + 1] >> (8 - shift));
+    };
+    uint32_t block_crc = 0;
+
+    for (size_t lpc = 0; lpc < 4; lpc++) {
+        block_crc = (block_crc << 8) | shifted_byte(6 + lpc);
+    }
+
+    stream_out.clear();
+    stream_out.reserve(4 + in_len + 11);
+    stream_out.append("BZh");
+    stream_out.push_back(level);
+    for (int64_t lpc = 0; lpc < bit_count / 8; lpc++) {
+        stream_out.push_back((char) shifted_byte(lpc));
+    }
+
+    bit_writer bw(stream_out);
+    auto remaining_bits = bit_count % 8;
+
+    if (remaining_bits > 0) {
+        bw.put(shifted_byte(bit_count / 8) >> (8 - remaining_bits),
+               remaining_bits);
+    }
+    bw.put((uint32_t) (BZ_END_OF_STREAM_MAGIC >> 24), 24);
+    bw.put((uint32_t) (BZ_END_OF_STREAM_MAGIC & 0xffffff), 24);
+    bw.put(block_crc, 32);
+    bw.flush();
+
+    return true;
+}
+
+static bool
+bz_decompress_stream(const std::string& stream, char level, std::string& out)
+{
+    bz_stream strm;
+    size_t produced = 0;
+    int rc;
+
+    memset(&strm, 0, sizeof(strm));
+    if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK) {
+        return false;
+    }
+
+    strm.next_in = (char*) stream.data();
+    strm.avail_in = stream.size();
+    out.resize((level - '0') * 100 * 1000 + 1024);
+    do {
+        if (produced == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        strm.next_out = &out[produced];
+        strm.avail_out = out.size() - produced;
+        rc = BZ2_bzDecompress(&strm);
+        produced = out.size() - strm.avail_out;
+    } while (rc == BZ_OK && (strm.avail_in > 0 || strm.avail_out == 0));
+    BZ2_bzDecompressEnd(&strm);
+    out.resize(produced);
+
+    return rc == BZ_STREAM_END;
+}
+#endif
+
+void
+line_buffer::bz_indexed::open(int fd)
+{
+    this->close();
+    this->bz_fd = fd;
+}
+
+void
+line_buffer::bz_indexed::close()
+{
+    this->bz_fd = -1;
+    this->bz_blocks.clear();
+    this->bz_level = '9';
+    this->bz_eof = false;
+}
+
+void
+line_buffer::bz_indexed::set_blocks(std::vector<block_entry> blocks)
+{
+    this->bz_blocks = std::move(blocks);
+    this->bz_eof = false;
+    if (!this->bz_blocks.empty()) {
+        this->bz_level = this->bz_blocks.back().be_level;
+    }
+}
+
+nonstd::optional<line_buffer::bz_indexed::magic_hit>
+line_buffer::bz_indexed::find_magic(int64_t from_bits) const
+{
+    std::vector<unsigned char> buf(BZ_SCAN_SIZE);
+    auto first_byte = from_bits / 8;
+    auto off = first_byte;
+    uint64_t window = 0;
+
+    while (true) {
+        auto rc = pread(this->bz_fd, buf.data(), buf.size(), off);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            return nonstd::nullopt;
+        }
+
+        for (ssize_t lpc = 0; lpc < rc; lpc++) {
+            window = (window << 8) | buf[lpc];
+
+            auto end_bits = (off + lpc + 1) * 8;
+            // Check the earliest possible position first.
+            for (int shift = 7; shift >= 0; shift--) {
+                auto start_bits = end_bits - shift - 48;
+
+                if (start_bits < from_bits || start_bits < first_byte * 8) {
+                    continue;
+                }
+
+                auto bits = (window >> shift) & BZ_MAGIC_MASK;
+
+                if (bits == BZ_BLOCK_MAGIC) {
+                    return magic_hit{start_bits, false};
+                }
+                if (bits == BZ_END_OF_STREAM_MAGIC) {
+                    return magic_hit{start_bits, true};
+                }
+            }
+        }
+        off += rc;
+    }
+}
+
+std::vector<nonstd::optional<std::string>>
+line_buffer::bz_indexed::decompress_blocks(
+    const std::vector<block_range>& ranges) const
+{
+    std::vector<nonstd::optional<std::string>> retval(ranges.size());
+
+#ifdef HAVE_BZLIB_H
+    auto decompress_one = [this, &ranges, &retval](size_t index) {
+        const auto& br = ranges[index];
+        std::string stream, data;
+
+        if (bz_extract_block(this->bz_fd,
+                             br.br_in_bits,
+                             br.br_in_end_bits,
+                             br.br_level,
+                             stream)
+            && bz_decompress_stream(stream, br.br_level, data))
+        {
+            retval[index] = std::move(data);
+        }
+    };
+    auto thread_count = std::min(bz_thread_count(), ranges.size());
+
+    if (thread_count <= 1) {
+        for (size_t lpc = 0; lpc < ranges.size(); lpc++) {
+            decompress_one(lpc);
+        }
+        return retval;
+    }
+
+    std::atomic<size_t> next_range{0};
+    std::vector<std::future<void>> workers;
+
+    for (size_t lpc = 0; lpc < thread_count; lpc++) {
+        workers.emplace_back(std::async(std::launch::async, [&]() {
+            for (auto pos = next_range++; pos < ranges.size();
+                 pos = next_range++) {
+                decompress_one(pos);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+#endif
+
+    return retval;
+}
+
+bool
+line_buffer::bz_indexed::index_next_blocks(
+    std::vector<std::pair<size_t, std::string>>& data_out)
+{
+    if (this->bz_eof) {
+        return false;
+    }
+
+    auto thread_count = bz_thread_count();
+    std::vector<block_range> ranges;
+    int64_t scan_bits = this->bz_blocks.empty()
+        ? 4 * 8
+        : this->bz_blocks.back().be_in_end_bits;
+    auto level = this->bz_level;
+
+    if (this->bz_blocks.empty()) {
+        char hdr[4];
+
+        if (pread(this->bz_fd, hdr, sizeof(hdr), 0) != sizeof(hdr)
+            || memcmp(hdr, "BZh", 3) != 0 || hdr[3] < '1' || hdr[3] > '9')
+        {
+            this->bz_eof = true;
+            return false;
+        }
+        level = hdr[3];
+    }
+
+    while (ranges.size() < thread_count) {
+        auto start_hit = this->find_magic(scan_bits);
+
+        if (!start_hit) {
+            break;
+        }
+        if (start_hit->mh_end_of_stream) {
+            // Another stream might have been concatenated to this one, it
+            // would start at the byte after the end-of-stream marker and
+            // CRC.
+            auto next_stream_off = (start_hit->mh_bits + 48 + 32 + 7) / 8;
+            char hdr[4];
+
+            if (pread(this->bz_fd, hdr, sizeof(hdr), next_stream_off)
+                    != sizeof(hdr)
+                || memcmp(hdr, "BZh", 3) != 0 || hdr[3] < '1' || hdr[3] > '9')
+            {
+                break;
+            }
+            level = hdr[3];
+            scan_bits = (next_stream_off + 4) * 8;
+            continue;
+        }
+
+        auto end_hit = this->find_magic(start_hit->mh_bits + 48);
+        struct stat st;
+        int64_t end_bits;
+
+        if (end_hit) {
+            end_bits = end_hit->mh_bits;
+        } else if (fstat(this->bz_fd, &st) == 0) {
+            end_bits = st.st_size * 8;
+        } else {
+            break;
+        }
+        ranges.emplace_back(block_range{start_hit->mh_bits, end_bits, level});
+        scan_bits = end_bits;
+    }
+
+    if (ranges.empty()) {
+        this->bz_eof = true;
+        return false;
+    }
+
+    auto results = this->decompress_blocks(ranges);
+
+    for (size_t lpc = 0; lpc < ranges.size(); lpc++) {
+        auto br = ranges[lpc];
+        auto& result = results[lpc];
+
+        if (!result) {
+            // The end of the block might have been a magic number that
+            // showed up by chance in the compressed data, so try again with
+            // the following boundaries.  The later ranges in this batch
+            // started at the bad boundary, so they are dropped.
+            for (int retry = 0; retry < BZ_MAX_FALSE_MAGICS && !result;
+                 retry++) {
+                auto end_hit = this->find_magic(br.br_in_end_bits + 1);
+
+                if (!end_hit) {
+                    break;
+                }
+                br.br_in_end_bits = end_hit->mh_bits;
+                result = std::move(this->decompress_blocks({br})[0]);
+            }
+            if (!result) {
+                log_error("unable to decompress bzip2 block at bit %lld",
+                          br.br_in_bits);
+                this->bz_eof = true;
+                return !data_out.empty();
+            }
+            ranges.resize(lpc + 1);
+        }
+
+        int64_t out = this->bz_blocks.empty()
+            ? 0
+            : this->bz_blocks.back().be_out
+                + this->bz_blocks.back().be_out_size;
+
+        this->bz_blocks.emplace_back(block_entry{br.br_in_bits,
+                                                 br.br_in_end_bits,
+                                                 out,
+                                                 (int64_t) result->size(),
+                                                 br.br_level});
+        this->bz_level = br.br_level;
+        data_out.emplace_back(this->bz_blocks.size() - 1,
+                              std::move(result.value()));
+    }
+
+    return true;
+}
+
+int
+line_buffer::bz_indexed::read(void* buf, size_t offset, size_t size)
+{
+    auto* out = (char*) buf;
+    size_t copied = 0;
+
+    while (copied < size) {
+        int64_t pos = offset + copied;
+        std::vector<std::pair<size_t, std::string>> decoded;
+        auto iter = std::upper_bound(
+            this->bz_blocks.begin(),
+            this->bz_blocks.end(),
+            pos,
+            [](int64_t off, const block_entry& be) { return off < be.be_out; });
+
+        if (iter != this->bz_blocks.begin()
+            && pos < std::prev(iter)->be_out + std::prev(iter)->be_out_size)
+        {
+            // Decompress enough of the indexed blocks to fill the request,
+            // as many at a time as there are threads.
+            std::vector<block_range> ranges;
+            size_t first_index = std::distance(this->bz_blocks.begin(), iter)
+                - 1;
+            int64_t wanted = size - copied;
+
+            for (auto index = first_index; index < this->bz_blocks.size()
+                 && ranges.size() < bz_thread_count() && wanted > 0;
+                 index++)
+            {
+                const auto& be = this->bz_blocks[index];
+
+                ranges.emplace_back(
+                    block_range{be.be_in_bits, be.be_in_end_bits, be.be_level});
+                wanted -= be.be_out + be.be_out_size - pos;
+                pos = be.be_out + be.be_out_size;
+            }
+
+            auto results = this->decompress_blocks(ranges);
+
+            for (size_t lpc = 0; lpc < results.size(); lpc++) {
+                if (!results[lpc]) {
+                    log_error("unable to decompress indexed bzip2 block at "
+                              "bit %lld",
+                              ranges[lpc].br_in_bits);
+                    break;
+                }
+                decoded.emplace_back(first_index + lpc,
+                                     std::move(results[lpc].value()));
+            }
+            if (decoded.empty()) {
+                break;
+            }
+        } else if (!this->index_next_blocks(decoded)) {
+            break;
+        }
+
+        for (const auto& block : decoded) {
+            const auto& be = this->bz_blocks[block.first];
+            int64_t curr = offset + copied;
+
+            if (curr < be.be_out || curr >= be.be_out + be.be_out_size) {
+                continue;
+            }
+
+            auto block_off = curr - be.be_out;
+            auto to_copy = std::min((size_t) (be.be_out_size - block_off),
+                                    size - copied);
+
+            memcpy(&out[copied], &block.second[block_off], to_copy);
+            copied += to_copy;
+        }
+    }
+
+    return copied;
+}
+
+static const size_t FRAME_INBUF_SIZE = 64 * 1024;
+static const size_t FRAME_SCRATCH_SIZE = 64 * 1024;
+
+/* The magic numbers at the start of the supported frame formats. */
+static const unsigned char ZSTD_FRAME_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+static const unsigned char XZ_STREAM_MAGIC[]
+    = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+static const unsigned char LZ4_FRAME_MAGIC[] = {0x04, 0x22, 0x4d, 0x18};
+
+/*
+ * The seek table of the zstd seekable format is stored in a skippable frame
+ * at the end of the file and finishes with a footer that has the number of
+ * frames, a descriptor byte, and this magic number.
+ */
+static const uint32_t ZSTD_SEEKABLE_MAGIC = 0x8f92eab1;
+static const uint32_t ZSTD_SEEK_TABLE_SKIPPABLE_MAGIC = 0x184d2a5e;
+static const size_t ZSTD_SEEK_TABLE_FOOTER_SIZE = 9;
+static const size_t ZSTD_SKIPPABLE_HEADER_SIZE = 8;
+static const uint8_t ZSTD_SEEK_TABLE_CHECKSUM_FLAG = 0x80;
+static const uint8_t ZSTD_SEEK_TABLE_RESERVED_MASK = 0x7c;
+
+class line_buffer::frame_indexed::decoder {
+public:
+    enum class result_t {
+        ok,
+        frame_end,
+        error,
+    };
+
+    virtual ~decoder() = default;
+
+    /**
+     * Load the index that is stored in the file, if there is one.
+     *
+     * @param frames The vector to fill with the frames in the file.
+     * @return True if the frames cover the whole file.
+     */
+    virtual bool read_index(int fd, std::vector<frame_entry>& frames)
+    {
+        return false;
+    }
+
+    /**
+     * Prepare to decode the given frame.
+     *
+     * @return The number of bytes at the start of the frame that were read
+     * directly from the file or -1 if there was an error.
+     */
+    virtual int64_t reset(int fd, const frame_entry& fe) = 0;
+
+    /**
+     * Decode the given input.
+     *
+     * @param in_len The amount of input available, on return, the amount of
+     * input that was consumed.
+     * @param out_len The amount of room in the output buffer, on return, the
+     * amount of data that was written.
+     * @param at_eof True if there is no more input after this.
+     */
+    virtual result_t decode(const unsigned char* in,
+                            size_t& in_len,
+                            unsigned char* out,
+                            size_t& out_len,
+                            bool at_eof)
+        = 0;
+};
+
+namespace {
+
+#ifdef HAVE_ZSTD_H
+class zstd_frame_decoder : public line_buffer::frame_indexed::decoder {
+public:
+    zstd_frame_decoder() : zfd_ctx(ZSTD_createDCtx())
+    {
+        if (this->zfd_ctx == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ~zstd_frame_decoder() override
+    {
+        ZSTD_freeDCtx(this->zfd_ctx);
+    }
+
+    bool read_index(
+        int fd,
+        std::vector<line_buffer::frame_indexed::frame_entry>& frames) override
+    {
+        struct stat st;
+        unsigned char footer[ZSTD_SEEK_TABLE_FOOTER_SIZE];
+
+        if (fstat(fd, &st) == -1
+            || st.st_size < (off_t) (ZSTD_SKIPPABLE_HEADER_SIZE
+                                     + ZSTD_SEEK_TABLE_FOOTER_SIZE)
+            || !pread_fully(fd,
+                            (char*) footer,
+                            sizeof(footer),
+                            st.st_size - sizeof(footer))
+            || (uint32_t) read_le32(&footer[5]) != ZSTD_SEEKABLE_MAGIC
+            || (footer[4] & ZSTD_SEEK_TABLE_RESERVED_MASK))
+        {
+            return false;
+        }
+
+        uint32_t frame_count = read_le32(footer);
+        size_t entry_size
+            = (footer[4] & ZSTD_SEEK_TABLE_CHECKSUM_FLAG) ? 12 : 8;
+        int64_t table_size
+            = (int64_t) frame_count * entry_size + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+        int64_t table_start
+            = st.st_size - table_size - ZSTD_SKIPPABLE_HEADER_SIZE;
+
+        if (table_start < 0) {
+            return false;
+        }
+
+        std::vector<unsigned char> table(ZSTD_SKIPPABLE_HEADER_SIZE
+                                         + table_size);
+
+        if (!pread_fully(fd, (char*) table.data(), table.size(), table_start)
+            || (uint32_t) read_le32(&table[0])
+                != ZSTD_SEEK_TABLE_SKIPPABLE_MAGIC
+            || read_le32(&table[4]) != table_size)
+        {
+            return false;
+        }
+
+        int64_t in = 0, out = 0;
+
+        frames.clear();
+        for (uint32_t lpc = 0; lpc < frame_count; lpc++) {
+            const auto* entry
+                = &table[ZSTD_SKIPPABLE_HEADER_SIZE + lpc * entry_size];
+
+            frames.emplace_back(
+                line_buffer::frame_indexed::frame_entry{in, out, 0});
+            in += (uint32_t) read_le32(&entry[0]);
+            out += (uint32_t) read_le32(&entry[4]);
+        }
+        if (frames.empty() || in != table_start) {
+            log_warning("zstd seek table does not match the file, ignoring");
+            frames.clear();
+            return false;
+        }
+
+        log_info("loaded zstd seek table with %zu frames", frames.size());
+        return true;
+    }
+
+    int64_t reset(int fd,
+                  const line_buffer::frame_indexed::frame_entry& fe) override
+    {
+        ZSTD_DCtx_reset(this->zfd_ctx, ZSTD_reset_session_only);
+        return 0;
+    }
+
+    result_t decode(const unsigned char* in,
+                    size_t& in_len,
+                    unsigned char* out,
+                    size_t& out_len,
+                    bool at_eof) override
+    {
+        ZSTD_inBuffer in_buf = {in, in_len, 0};
+        ZSTD_outBuffer out_buf = {out, out_len, 0};
+        auto rc = ZSTD_decompressStream(this->zfd_ctx, &out_buf, &in_buf);
+
+        in_len = in_buf.pos;
+        out_len = out_buf.pos;
+        if (ZSTD_isError(rc)) {
+            log_error("zstd decompression failed: %s", ZSTD_getErrorName(rc));
+            return result_t::error;
+        }
+
+        return rc == 0 ? result_t::frame_end : result_t::ok;
+    }
+
+private:
+    ZSTD_DCtx* zfd_ctx;
+};
+#endif
+
+#ifdef HAVE_LZMA_H
+class xz_frame_decoder : public line_buffer::frame_indexed::decoder {
+public:
+    ~xz_frame_decoder() override
+    {
+        lzma_end(&this->xfd_strm);
+    }
+
+    bool read_index(
+        int fd,
+        std::vector<line_buffer::frame_indexed::frame_entry>& frames) override
+    {
+#if LZMA_VERSION >= 50040002
+        lzma_stream strm = LZMA_STREAM_INIT;
+        lzma_index* index = nullptr;
+        std::vector<uint8_t> buf(FRAME_INBUF_SIZE);
+        struct stat st;
+        off_t pos = 0;
+        lzma_ret rc;
+
+        if (fstat(fd, &st) == -1) {
+            return false;
+        }
+
+        rc = lzma_file_info_decoder(&strm, &index, UINT64_MAX, st.st_size);
+        while (rc == LZMA_OK) {
+            if (strm.avail_in == 0) {
+                auto bytes = pread(fd, buf.data(), buf.size(), pos);
+
+                if (bytes < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytes < 0) {
+                    break;
+                }
+                strm.next_in = buf.data();
+                strm.avail_in = bytes;
+                pos += bytes;
+            }
+
+            rc = lzma_code(&strm, strm.avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
+            if (rc == LZMA_SEEK_NEEDED) {
+                pos = strm.seek_pos;
+                strm.avail_in = 0;
+                rc = LZMA_OK;
+            }
+        }
+        lzma_end(&strm);
+
+        if (rc != LZMA_STREAM_END) {
+            log_info("unable to read xz index, decoding as a stream -- %d",
+                     rc);
+            return false;
+        }
+
+        lzma_index_iter iter;
+
+        frames.clear();
+        lzma_index_iter_init(&iter, index);
+        while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+            frames.emplace_back(line_buffer::frame_indexed::frame_entry{
+                (int64_t) iter.block.compressed_file_offset,
+                (int64_t) iter.block.uncompressed_file_offset,
+                (int64_t) iter.stream.flags->check,
+            });
+        }
+        lzma_index_end(index, nullptr);
+
+        if (frames.empty()) {
+            return false;
+        }
+
+        log_info("loaded xz index with %zu blocks", frames.size());
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    int64_t reset(int fd,
+                  const line_buffer::frame_indexed::frame_entry& fe) override
+    {
+        lzma_ret rc;
+
+        if (fe.fe_flags < 0) {
+            rc = lzma_stream_decoder(
+                &this->xfd_strm, UINT64_MAX, LZMA_CONCATENATED);
+            if (rc != LZMA_OK) {
+                log_error("unable to initialize xz stream decoder -- %d", rc);
+                return -1;
+            }
+            return 0;
+        }
+
+        uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+        lzma_filter filters[LZMA_FILTERS_MAX + 1];
+        lzma_block block;
+
+        if (!pread_fully(fd, (char*) header, 1, fe.fe_in)) {
+            return -1;
+        }
+
+        memset(&block, 0, sizeof(block));
+        block.version = 1;
+        block.check = (lzma_check) fe.fe_flags;
+        block.filters = filters;
+        block.header_size = lzma_block_header_size_decode(header[0]);
+        if (!pread_fully(fd,
+                         (char*) &header[1],
+                         block.header_size - 1,
+                         fe.fe_in + 1))
+        {
+            return -1;
+        }
+
+        rc = lzma_block_header_decode(&block, nullptr, header);
+        if (rc != LZMA_OK) {
+            log_error("invalid xz block header at %lld -- %d", fe.fe_in, rc);
+            return -1;
+        }
+        rc = lzma_block_decoder(&this->xfd_strm, &block);
+        // The decoder has its own copy of the filter options.
+        for (size_t lpc = 0; filters[lpc].id != LZMA_VLI_UNKNOWN; lpc++) {
+            free(filters[lpc].options);
+        }
+        if (rc != LZMA_OK) {
+            log_error("unable to initialize xz block decoder -- %d", rc);
+            return -1;
+        }
+
+        return block.header_size;
+    }
+
+    result_t decode(const unsigned char* in,
+                    size_t& in_len,
+                    unsigned char* out,
+                    size_t& out_len,
+                    bool at_eof) override
+    {
+        this->xfd_strm.next_in = in;
+        this->xfd_strm.avail_in = in_len;
+        this->xfd_strm.next_out = out;
+        this->xfd_strm.avail_out = out_len;
+
+        auto rc
+            = lzma_code(&this->xfd_strm, at_eof ? LZMA_FINISH : LZMA_RUN);
+
+        in_len -= this->xfd_strm.avail_in;
+        out_len -= this->xfd_strm.avail_out;
+        switch (rc) {
+            case LZMA_OK:
+            case LZMA_BUF_ERROR:
+                return result_t::ok;
+            case LZMA_STREAM_END:
+                return result_t::frame_end;
+            default:
+                log_error("xz decompression failed -- %d", rc);
+                return result_t::error;
+        }
+    }
+
+private:
+    lzma_stream xfd_strm = LZMA_STREAM_INIT;
+};
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+class lz4_frame_decoder : public line_buffer::frame_indexed::decoder {
+public:
+    lz4_frame_decoder()
+    {
+        auto rc = LZ4F_createDecompressionContext(&this->lfd_ctx, LZ4F_VERSION);
+
+        if (LZ4F_isError(rc)) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ~lz4_frame_decoder() override
+    {
+        LZ4F_freeDecompressionContext(this->lfd_ctx);
+    }
+
+    int64_t reset(int fd,
+                  const line_buffer::frame_indexed::frame_entry& fe) override
+    {
+        LZ4F_resetDecompressionContext(this->lfd_ctx);
+        return 0;
+    }
+
+    result_t decode(const unsigned char* in,
+                    size_t& in_len,
+                    unsigned char* out,
+                    size_t& out_len,
+                    bool at_eof) override
+    {
+        auto rc = LZ4F_decompress(
+            this->lfd_ctx, out, &out_len, in, &in_len, nullptr);
+
+        if (LZ4F_isError(rc)) {
+            log_error("lz4 decompression failed: %s", LZ4F_getErrorName(rc));
+            return result_t::error;
+        }
+
+        return rc == 0 ? result_t::frame_end : result_t::ok;
+    }
+
+private:
+    LZ4F_dctx* lfd_ctx{nullptr};
+};
+#endif
+
+}  // namespace
+
+line_buffer::frame_indexed::frame_indexed() = default;
+
+line_buffer::frame_indexed::frame_indexed(frame_indexed&& other) noexcept
+    = default;
+
+line_buffer::frame_indexed::~frame_indexed() = default;
+
+nonstd::optional<line_buffer::frame_indexed::kind_t>
+line_buffer::frame_indexed::detect(const char* header, size_t len)
+{
+#ifdef HAVE_ZSTD_H
+    if (len >= sizeof(ZSTD_FRAME_MAGIC)
+        && memcmp(header, ZSTD_FRAME_MAGIC, sizeof(ZSTD_FRAME_MAGIC)) == 0)
+    {
+        return kind_t::zstd;
+    }
+#endif
+#ifdef HAVE_LZMA_H
+    if (len >= sizeof(XZ_STREAM_MAGIC)
+        && memcmp(header, XZ_STREAM_MAGIC, sizeof(XZ_STREAM_MAGIC)) == 0)
+    {
+        return kind_t::xz;
+    }
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    if (len >= sizeof(LZ4_FRAME_MAGIC)
+        && memcmp(header, LZ4_FRAME_MAGIC, sizeof(LZ4_FRAME_MAGIC)) == 0)
+    {
+        return kind_t::lz4;
+    }
+#endif
+
+    return nonstd::nullopt;
+}
+
+void
+line_buffer::frame_indexed::open(int fd, kind_t kind)
+{
+    this->close();
+
+    switch (kind) {
+#ifdef HAVE_ZSTD_H
+        case kind_t::zstd:
+            this->fi_decoder = std::make_unique<zstd_frame_decoder>();
+            break;
+#endif
+#ifdef HAVE_LZMA_H
+        case kind_t::xz:
+            this->fi_decoder = std::make_unique<xz_frame_decoder>();
+            break;
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        case kind_t::lz4:
+            this->fi_decoder = std::make_unique<lz4_frame_decoder>();
+            break;
+#endif
+        default:
+            return;
+    }
+
+    this->fi_fd = fd;
+    this->fi_kind = kind;
+    this->fi_inbuf.resize(FRAME_INBUF_SIZE);
+    this->fi_scratch.resize(FRAME_SCRATCH_SIZE);
+    this->fi_complete = this->fi_decoder->read_index(fd, this->fi_frames);
+    if (!this->fi_complete) {
+        // Without an index, xz files are decoded as a single stream.
+        this->fi_frames.clear();
+        this->fi_frames.emplace_back(
+            frame_entry{0, 0, kind == kind_t::xz ? -1 : 0});
+    }
+}
+
+void
+line_buffer::frame_indexed::close()
+{
+    this->fi_fd = -1;
+    this->fi_decoder.reset();
+    this->fi_frames.clear();
+    this->fi_complete = false;
+    this->fi_active = false;
+    this->fi_frame_index = 0;
+    this->fi_out_pos = 0;
+    this->fi_eof = false;
+    this->fi_in_next = 0;
+    this->fi_in_avail = 0;
+    this->fi_in_file = 0;
+}
+
+void
+line_buffer::frame_indexed::set_frames(std::vector<frame_entry> frames)
+{
+    if (this->fi_complete || frames.empty() || frames.front().fe_in != 0
+        || frames.front().fe_out != 0)
+    {
+        return;
+    }
+
+    for (size_t lpc = 1; lpc < frames.size(); lpc++) {
+        if (frames[lpc].fe_in <= frames[lpc - 1].fe_in
+            || frames[lpc].fe_out < frames[lpc - 1].fe_out)
+        {
+            return;
+        }
+    }
+
+    this->fi_frames = std::move(frames);
+    this->fi_active = false;
+}
+
+bool
+line_buffer::frame_indexed::fill_input()
+{
+    while (true) {
+        auto rc = pread(this->fi_fd,
+                        this->fi_inbuf.data(),
+                        this->fi_inbuf.size(),
+                        this->fi_in_file);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            return false;
+        }
+
+        this->fi_in_next = 0;
+        this->fi_in_avail = rc;
+        this->fi_in_file += rc;
+        return true;
+    }
+}
+
+bool
+line_buffer::frame_indexed::restart(size_t index)
+{
+    const auto& fe = this->fi_frames[index];
+    auto in_pos = this->get_source_offset();
+    auto consumed = this->fi_decoder->reset(this->fi_fd, fe);
+
+    if (consumed < 0) {
+        this->fi_active = false;
+        return false;
+    }
+
+    // Keep the buffered input if the frame starts right where we left off.
+    if (consumed > 0 || !this->fi_active || fe.fe_in != in_pos) {
+        this->fi_in_next = 0;
+        this->fi_in_avail = 0;
+        this->fi_in_file = fe.fe_in + consumed;
+    }
+    this->fi_active = true;
+    this->fi_frame_index = index;
+    this->fi_out_pos = fe.fe_out;
+    this->fi_eof = false;
+
+    return true;
+}
+
+int
+line_buffer::frame_indexed::read(void* buf, size_t offset, size_t size)
+{
+    auto* out = (unsigned char*) buf;
+    size_t copied = 0;
+    auto iter = std::upper_bound(
+        this->fi_frames.begin(),
+        this->fi_frames.end(),
+        (int64_t) offset,
+        [](int64_t off, const frame_entry& fe) { return off < fe.fe_out; });
+    size_t index = std::distance(this->fi_frames.begin(), iter) - 1;
+
+    if (!this->fi_active || (int64_t) offset < this->fi_out_pos
+        || index > this->fi_frame_index)
+    {
+        if (!this->restart(index)) {
+            return copied;
+        }
+    }
+
+    while (copied < size && !this->fi_eof) {
+        bool at_eof = false;
+
+        if (this->fi_in_avail == 0) {
+            at_eof = !this->fill_input();
+        }
+
+        // Decode into the scratch buffer until the requested offset is
+        // reached.
+        bool skipping = this->fi_out_pos < (int64_t) offset;
+        auto* out_ptr
+            = skipping ? this->fi_scratch.data() : &out[copied];
+        size_t out_len = skipping
+            ? std::min(this->fi_scratch.size(),
+                       (size_t) (offset - this->fi_out_pos))
+            : size - copied;
+        size_t in_len = this->fi_in_avail;
+        auto res = this->fi_decoder->decode(&this->fi_inbuf[this->fi_in_next],
+                                            in_len,
+                                            out_ptr,
+                                            out_len,
+                                            at_eof);
+
+        this->fi_in_next += in_len;
+        this->fi_in_avail -= in_len;
+        this->fi_out_pos += out_len;
+        if (!skipping) {
+            copied += out_len;
+        }
+
+        switch (res) {
+            case decoder::result_t::error:
+                this->fi_eof = true;
+                break;
+            case decoder::result_t::ok:
+                if (in_len == 0 && out_len == 0
+                    && (at_eof || this->fi_in_avail > 0))
+                {
+                    log_warning("compressed file is truncated at %lld",
+                                this->get_source_offset());
+                    this->fi_eof = true;
+                }
+                break;
+            case decoder::result_t::frame_end: {
+                auto next = this->fi_frame_index + 1;
+
+                if (next < this->fi_frames.size()) {
+                    if (!this->restart(next)) {
+                        this->fi_eof = true;
+                    }
+                } else if (this->fi_complete) {
+                    this->fi_eof = true;
+                } else if (this->fi_in_avail > 0 || this->fill_input()) {
+                    this->fi_frames.emplace_back(
+                        frame_entry{this->get_source_offset(),
+                                    this->fi_out_pos,
+                                    this->fi_frames.back().fe_flags});
+                    if (!this->restart(next)) {
+                        this->fi_eof = true;
+                    }
+                } else {
+                    this->fi_eof = true;
+                    this->fi_complete = true;
+                }
+                break;
+            }
+        }
+    }
+
+    return copied;
+}
+
+namespace {
+
+/**
+ * An entry in the table of mappings that is checked by the SIGBUS handler.
+ * The table has a fixed size so the handler does not need to take a lock.
+ */
+struct mapping_slot {
+    std::atomic<bool> ms_used{false};
+    std::atomic<char*> ms_base{nullptr};
+    std::atomic<size_t> ms_size{0};
+    std::atomic<bool> ms_damaged{false};
+};
+
+}  // namespace
+
+static constexpr size_t MAX_MAPPINGS = 256;
+static mapping_slot MAPPING_SLOTS[MAX_MAPPINGS];
+static struct sigaction PREV_SIGBUS_ACTION;
+
+static void
+sigbus_handler(int sig, siginfo_t* info, void* context)
+{
+    auto* addr = (char*) info->si_addr;
+
+    for (auto& slot : MAPPING_SLOTS) {
+        auto* base = slot.ms_base.load();
+        auto size = slot.ms_size.load();
+
+        if (base == nullptr || addr < base || addr >= base + size) {
+            continue;
+        }
+
+        /*
+         * The file was truncated underneath the mapping.  Replace it with
+         * zero-filled pages so the read that faulted can finish and the
+         * owner can notice that the mapping needs to be dropped.
+         */
+        if (mmap(base,
+                 size,
+                 PROT_READ,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                 -1,
+                 0)
+            != MAP_FAILED)
+        {
+            slot.ms_damaged.store(true);
+            return;
+        }
+        break;
+    }
+
+    /*
+     * Not one of ours, forward it to the previous handler.  Our handler is
+     * left in place since it is only installed once.
+     */
+    if (PREV_SIGBUS_ACTION.sa_flags & SA_SIGINFO) {
+        if (PREV_SIGBUS_ACTION.sa_sigaction != nullptr) {
+            PREV_SIGBUS_ACTION.sa_sigaction(sig, info, context);
+            return;
+        }
+    } else if (PREV_SIGBUS_ACTION.sa_handler == SIG_IGN) {
+        // A fault cannot be ignored, but a signal sent by kill() can.
+        if (info->si_code <= 0) {
+            return;
+        }
+    } else if (PREV_SIGBUS_ACTION.sa_handler != SIG_DFL) {
+        PREV_SIGBUS_ACTION.sa_handler(sig);
+        return;
+    }
+
+    /*
+     * The default action terminates the process, so there is no need to
+     * restore our handler afterward.  A fault will happen again when we
+     * return and a signal sent by another process is delivered when it is
+     * unblocked.
+     */
+    signal(SIGBUS, SIG_DFL);
+    if (info->si_code <= 0) {
+        raise(sig);
+    }
+}
+
+static void
+install_sigbus_handler()
 {
-    // Save our position and output buffer
-    auto total_in = this->strm.total_in;
-    auto total_out = this->strm.total_out;
-    auto avail_out = this->strm.avail_out;
-    auto next_out = this->strm.next_out;
+    struct sigaction sa;
 
-    init_stream();
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sa.sa_sigaction = sigbus_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, &PREV_SIGBUS_ACTION);
+}
 
-    // Restore position and output buffer
-    this->strm.total_in = total_in;
-    this->strm.total_out = total_out;
-    this->strm.avail_out = avail_out;
-    this->strm.next_out = next_out;
+line_buffer::file_mapping::file_mapping(file_mapping&& other) noexcept
+    : fm_base(std::exchange(other.fm_base, nullptr)),
+      fm_size(std::exchange(other.fm_size, 0)),
+      fm_slot(std::exchange(other.fm_slot, -1)),
+      fm_sequential(other.fm_sequential)
+{
 }
 
-void
-line_buffer::gz_indexed::open(int fd)
+line_buffer::file_mapping&
+line_buffer::file_mapping::operator=(file_mapping&& other) noexcept
 {
-    this->close();
-    this->init_stream();
-    this->gz_fd = fd;
+    if (this != &other) {
+        this->unmap();
+        this->fm_base = std::exchange(other.fm_base, nullptr);
+        this->fm_size = std::exchange(other.fm_size, 0);
+        this->fm_slot = std::exchange(other.fm_slot, -1);
+        this->fm_sequential = other.fm_sequential;
+    }
+
+    return *this;
 }
 
-int
-line_buffer::gz_indexed::stream_data(void* buf, size_t size)
+line_buffer::file_mapping::~file_mapping()
 {
-    this->strm.avail_out = size;
-    this->strm.next_out = (unsigned char*) buf;
+    this->unmap();
+}
 
-    size_t last = this->syncpoints.empty() ? 0 : this->syncpoints.back().in;
-    while (this->strm.avail_out) {
-        if (!this->strm.avail_in) {
-            int rc = ::pread(
-                this->gz_fd, &this->inbuf[0], Z_BUFSIZE, this->strm.total_in);
-            if (rc < 0) {
-                return rc;
-            }
-            this->strm.next_in = this->inbuf;
-            this->strm.avail_in = rc;
-        }
-        if (this->strm.avail_in) {
-            int flush = last > this->strm.total_in ? Z_SYNC_FLUSH : Z_BLOCK;
-            auto err = inflate(&this->strm, flush);
-            if (err == Z_STREAM_END) {
-                // Reached end of stream; re-init for a possible subsequent
-                // stream
-                continue_stream();
-            } else if (err != Z_OK) {
-                log_error(" inflate-error: %d  %s",
-                          (int) err,
-                          this->strm.msg ? this->strm.msg : "");
-                break;
-            }
+bool
+line_buffer::file_mapping::map(int fd, file_ssize_t size)
+{
+    static std::once_flag HANDLER_INSTALLED;
 
-            if (this->strm.total_in >= last + SYNCPOINT_SIZE
-                && size > this->strm.avail_out + GZ_WINSIZE
-                && (this->strm.data_type & GZ_END_OF_BLOCK_MASK)
-                && !(this->strm.data_type & GZ_END_OF_FILE_MASK))
-            {
-                this->syncpoints.emplace_back(this->strm, size);
-                last = this->strm.total_out;
-            }
-        } else if (this->strm.avail_out) {
-            // Processed all the gz file data but didn't fill
-            // the output buffer.  We're done, even though we
-            // produced fewer bytes than requested.
+    require(this->fm_base == nullptr);
+
+    if (size <= 0 || (uint64_t) size > SIZE_MAX) {
+        return false;
+    }
+
+    std::call_once(HANDLER_INSTALLED, install_sigbus_handler);
+
+    for (size_t lpc = 0; lpc < MAX_MAPPINGS; lpc++) {
+        bool expected = false;
+
+        if (MAPPING_SLOTS[lpc].ms_used.compare_exchange_strong(expected, true))
+        {
+            this->fm_slot = lpc;
             break;
         }
     }
-    return size - this->strm.avail_out;
+    if (this->fm_slot == -1) {
+        log_warning("too many files are mapped, reading the file instead");
+        return false;
+    }
+
+    auto* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    auto& slot = MAPPING_SLOTS[this->fm_slot];
+
+    if (base == MAP_FAILED) {
+        log_warning("unable to map file: %s", strerror(errno));
+        slot.ms_used.store(false);
+        this->fm_slot = -1;
+        return false;
+    }
+
+    this->fm_base = (char*) base;
+    this->fm_size = size;
+    slot.ms_damaged.store(false);
+    slot.ms_size.store(size);
+    slot.ms_base.store(this->fm_base);
+    this->advise_sequential(true);
+
+    return true;
 }
 
 void
-line_buffer::gz_indexed::seek(off_t offset)
+line_buffer::file_mapping::unmap()
 {
-    if ((size_t) offset == this->strm.total_out) {
+    if (this->fm_base == nullptr) {
         return;
     }
 
-    indexDict* dict = nullptr;
-    // Find highest syncpoint not past offset
-    // FIXME: Make this a binary-tree search
-    for (auto& d : this->syncpoints) {
-        if (d.out <= offset) {
-            dict = &d;
-        } else {
-            break;
-        }
-    }
+    auto& slot = MAPPING_SLOTS[this->fm_slot];
 
-    // Choose highest available syncpoint, or keep current offset if it's ok
-    if ((size_t) offset < this->strm.total_out
-        || (dict && this->strm.total_out < (size_t) dict->out))
-    {
-        // Release the old z_stream
-        inflateEnd(&this->strm);
-        if (dict) {
-            dict->apply(&this->strm);
-        } else {
-            init_stream();
-        }
-    }
+    slot.ms_base.store(nullptr);
+    slot.ms_size.store(0);
+    munmap(this->fm_base, this->fm_size);
+    slot.ms_used.store(false);
+    this->fm_base = nullptr;
+    this->fm_size = 0;
+    this->fm_slot = -1;
+    this->fm_sequential = false;
+}
 
-    // Stream from compressed file until we reach our offset
-    unsigned char dummy[Z_BUFSIZE];
-    while ((size_t) offset > this->strm.total_out) {
-        size_t to_copy
-            = std::min(static_cast<size_t>(Z_BUFSIZE),
-                       static_cast<size_t>(offset - this->strm.total_out));
-        auto bytes = stream_data(dummy, to_copy);
-        if (bytes <= 0) {
-            break;
-        }
-    }
+bool
+line_buffer::file_mapping::is_damaged() const
+{
+    return this->fm_slot != -1 && MAPPING_SLOTS[this->fm_slot].ms_damaged;
 }
 
-int
-line_buffer::gz_indexed::read(void* buf, size_t offset, size_t size)
+void
+line_buffer::file_mapping::advise_sequential(bool sequential)
 {
-    if (offset != this->strm.total_out) {
-        this->seek(offset);
+    if (this->fm_base == nullptr || this->fm_sequential == sequential) {
+        return;
     }
 
-    int bytes = stream_data(buf, size);
-
-    return bytes;
+    this->fm_sequential = sequential;
+    if (madvise(this->fm_base,
+                this->fm_size,
+                sequential ? MADV_SEQUENTIAL : MADV_RANDOM)
+        == -1)
+    {
+        log_debug("madvise() failed -- %s", strerror(errno));
+    }
 }
 
 line_buffer::line_buffer()
-    : lb_bz_file(false), lb_compressed_offset(0), lb_file_size(-1),
+    : lb_compressed_offset(0), lb_file_size(-1),
       lb_file_offset(0), lb_file_time(0), lb_buffer_size(0),
       lb_buffer_max(DEFAULT_LINE_BUFFER_SIZE), lb_seekable(false),
       lb_last_line_offset(-1)
@@ -318,12 +1628,18 @@ line_buffer::set_fd(auto_fd& fd)
 {
     file_off_t newoff = 0;
 
+    this->unmap_file();
+
     if (this->lb_gz_file) {
         this->lb_gz_file.close();
     }
 
     if (this->lb_bz_file) {
-        this->lb_bz_file = false;
+        this->lb_bz_file.close();
+    }
+
+    if (this->lb_frame_file) {
+        this->lb_frame_file.close();
     }
 
     if (fd != -1) {
@@ -359,12 +1675,13 @@ line_buffer::set_fd(auto_fd& fd)
                         = lseek(this->lb_fd, 0, SEEK_CUR);
                 }
 #ifdef HAVE_BZLIB_H
-                else if (gz_id[0] == 'B' && gz_id[1] == 'Z')
+                else if (gz_id[0] == 'B' && gz_id[1] == 'Z' && gz_id[2] == 'h'
+                         && gz_id[3] >= '1' && gz_id[3] <= '9')
                 {
                     if (lseek(fd, 0, SEEK_SET) < 0) {
                         throw error(errno);
                     }
-                    this->lb_bz_file = true;
+                    this->lb_bz_file.open(fd);
 
                     /*
                      * Loading data from a bzip2 file is pretty slow, so we try
@@ -375,6 +1692,17 @@ line_buffer::set_fd(auto_fd& fd)
                     this->lb_compressed_offset = 0;
                 }
 #endif
+                else if (auto kind
+                         = frame_indexed::detect(gz_id, sizeof(gz_id)))
+                {
+                    if (lseek(fd, 0, SEEK_SET) < 0) {
+                        throw error(errno);
+                    }
+                    this->lb_frame_file.open(fd, kind.value());
+                    this->resize_buffer(MAX_COMPRESSED_BUFFER_SIZE);
+
+                    this->lb_compressed_offset = 0;
+                }
             }
             this->lb_seekable = true;
         }
@@ -386,11 +1714,56 @@ line_buffer::set_fd(auto_fd& fd)
     ensure(this->invariant());
 }
 
+bool
+line_buffer::map_file()
+{
+    struct stat st;
+
+    if (this->lb_mapping || this->lb_fd == -1 || !this->lb_seekable
+        || this->is_compressed())
+    {
+        return false;
+    }
+    if (fstat(this->lb_fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if (!this->lb_mapping.map(this->lb_fd, st.st_size)) {
+        return false;
+    }
+
+    this->lb_share_manager.invalidate_refs();
+    this->lb_file_offset = 0;
+    this->lb_buffer_size = 0;
+
+    return true;
+}
+
+void
+line_buffer::unmap_file()
+{
+    if (!this->lb_mapping) {
+        return;
+    }
+
+    this->lb_share_manager.invalidate_refs();
+    this->lb_mapping.unmap();
+    this->lb_file_offset = 0;
+    this->lb_buffer_size = 0;
+}
+
+void
+line_buffer::check_mapping()
+{
+    if (this->lb_mapping && this->lb_mapping.is_damaged()) {
+        log_warning("mapped file was truncated, reading it instead");
+        this->unmap_file();
+    }
+}
+
 void
 line_buffer::resize_buffer(size_t new_max)
 {
-    require(this->lb_bz_file || this->lb_gz_file
-            || new_max <= MAX_LINE_BUFFER_SIZE);
+    require(this->is_compressed() || new_max <= MAX_LINE_BUFFER_SIZE);
 
     if (new_max > (size_t) this->lb_buffer_max) {
         char *tmp, *old;
@@ -417,6 +1790,11 @@ line_buffer::ensure_available(file_off_t start, ssize_t max_length)
 
     require(max_length <= MAX_LINE_BUFFER_SIZE);
 
+    if (this->lb_mapping) {
+        // The whole file is already in memory.
+        return;
+    }
+
     if (this->lb_file_size != -1) {
         if (start + (file_off_t) max_length > this->lb_file_size) {
             max_length = (this->lb_file_size - start);
@@ -489,6 +1867,32 @@ line_buffer::fill_range(file_off_t start, ssize_t max_length)
 
     require(start >= 0);
 
+    if (this->lb_mapping) {
+        auto map_size = this->lb_mapping.size();
+        struct stat st;
+
+        if (start + max_length > map_size && fstat(this->lb_fd, &st) == 0
+            && st.st_size > map_size)
+        {
+            log_info("mapped file has grown, reading it instead");
+            this->unmap_file();
+        } else {
+            if (start >= map_size) {
+                return false;
+            }
+
+            /*
+             * Just move the window onto the mapping.  The references to the
+             * previous window stay valid, so they are not invalidated.
+             */
+            this->lb_file_offset = start;
+            this->lb_buffer_size = std::min(
+                map_size - start,
+                (file_ssize_t) std::max(this->lb_buffer_max, max_length));
+            return true;
+        }
+    }
+
     if (this->in_range(start) && this->in_range(start + max_length - 1)) {
         /* Cache already has the data, nothing to do. */
         retval = true;
@@ -528,46 +1932,12 @@ line_buffer::fill_range(file_off_t start, ssize_t max_length)
             {
                 rc = 0;
             } else {
-                lock_hack::guard guard;
-                char scratch[32 * 1024];
-                BZFILE* bz_file;
-                file_off_t seek_to;
-                int bzfd;
-
-                /*
-                 * Unfortunately, there is no bzseek, so we need to reopen the
-                 * file every time we want to do a read.
-                 */
-                bzfd = dup(this->lb_fd);
-                if (lseek(this->lb_fd, 0, SEEK_SET) < 0) {
-                    close(bzfd);
-                    throw error(errno);
-                }
-                if ((bz_file = BZ2_bzdopen(bzfd, "r")) == NULL) {
-                    close(bzfd);
-                    if (errno == 0) {
-                        throw std::bad_alloc();
-                    } else {
-                        throw error(errno);
-                    }
-                }
-
-                seek_to = this->lb_file_offset + this->lb_buffer_size;
-                while (seek_to > 0) {
-                    int count;
-
-                    count = BZ2_bzread(
-                        bz_file,
-                        scratch,
-                        std::min((size_t) seek_to, sizeof(scratch)));
-                    seek_to -= count;
-                }
-                rc = BZ2_bzread(bz_file,
-                                &this->lb_buffer[this->lb_buffer_size],
-                                this->lb_buffer_max - this->lb_buffer_size);
-                this->lb_compressed_offset = lseek(bzfd, 0, SEEK_SET);
-                BZ2_bzclose(bz_file);
-
+                rc = this->lb_bz_file.read(
+                    &this->lb_buffer[this->lb_buffer_size],
+                    this->lb_file_offset + this->lb_buffer_size,
+                    this->lb_buffer_max - this->lb_buffer_size);
+                this->lb_compressed_offset
+                    = this->lb_bz_file.get_source_offset();
                 if (rc != -1
                     && (rc < (this->lb_buffer_max - this->lb_buffer_size))) {
                     this->lb_file_size
@@ -576,6 +1946,28 @@ line_buffer::fill_range(file_off_t start, ssize_t max_length)
             }
         }
 #endif
+        else if (this->lb_frame_file)
+        {
+            if (this->lb_file_size != (ssize_t) -1
+                && (((ssize_t) start >= this->lb_file_size)
+                    || (this->in_range(start)
+                        && this->in_range(this->lb_file_size - 1))))
+            {
+                rc = 0;
+            } else {
+                rc = this->lb_frame_file.read(
+                    &this->lb_buffer[this->lb_buffer_size],
+                    this->lb_file_offset + this->lb_buffer_size,
+                    this->lb_buffer_max - this->lb_buffer_size);
+                this->lb_compressed_offset
+                    = this->lb_frame_file.get_source_offset();
+                if (rc != -1
+                    && (rc < (this->lb_buffer_max - this->lb_buffer_size))) {
+                    this->lb_file_size
+                        = (this->lb_file_offset + this->lb_buffer_size + rc);
+                }
+            }
+        }
         else if (this->lb_seekable)
         {
             rc = pread(this->lb_fd,
@@ -607,7 +1999,7 @@ line_buffer::fill_range(file_off_t start, ssize_t max_length)
                     retval = true;
                 }
 
-                if (this->lb_gz_file || this->lb_bz_file) {
+                if (this->is_compressed()) {
                     /*
                      * For compressed files, increase the buffer size so we
                      * don't have to spend as much time uncompressing the data.
@@ -654,6 +2046,8 @@ line_buffer::load_next_line(file_range prev_line)
 
     require(this->lb_fd != -1);
 
+    this->check_mapping();
+
     auto offset = prev_line.next_offset();
     retval.li_file_range.fr_offset = offset;
     while (!done) {
@@ -765,6 +2159,56 @@ line_buffer::load_next_line(file_range prev_line)
     return Ok(retval);
 }
 
+Result<void, std::string>
+line_buffer::load_next_lines(file_range prev_line,
+                             std::vector<line_info>& lines_out,
+                             size_t max_lines)
+{
+    require(this->lb_fd != -1);
+
+    this->check_mapping();
+
+    auto offset = prev_line.next_offset();
+
+    lines_out.clear();
+    if (this->fill_range(offset, DEFAULT_INCREMENT)) {
+        file_ssize_t avail = 0;
+        auto* data = this->get_range(offset, avail);
+
+        this->lb_scanned_lines.clear();
+        scan_lines(data, avail, this->lb_scanned_lines, max_lines);
+        for (const auto& sl : this->lb_scanned_lines) {
+            if (sl.sl_length >= MAX_LINE_BUFFER_SIZE - 1) {
+                break;
+            }
+
+            line_info li;
+
+            li.li_file_range.fr_offset = offset;
+            li.li_file_range.fr_size = sl.sl_length;
+            li.li_valid_utf = sl.sl_valid_utf;
+            if (offset >= this->lb_last_line_offset) {
+                this->lb_last_line_offset = offset + sl.sl_length;
+            }
+            offset += sl.sl_length;
+            lines_out.emplace_back(li);
+        }
+    }
+
+    if (lines_out.empty()) {
+        auto load_result = this->load_next_line(prev_line);
+
+        if (load_result.isErr()) {
+            return Err(load_result.unwrapErr());
+        }
+        lines_out.emplace_back(load_result.unwrap());
+    }
+
+    ensure(this->invariant());
+
+    return Ok();
+}
+
 Result<shared_buffer_ref, std::string>
 line_buffer::read_range(const file_range fr)
 {
@@ -772,6 +2216,8 @@ line_buffer::read_range(const file_range fr)
     char* line_start;
     file_ssize_t avail;
 
+    this->check_mapping();
+
     if (this->lb_last_line_offset != -1
         && fr.fr_offset > this->lb_last_line_offset) {
         /*
@@ -795,6 +2241,51 @@ line_buffer::read_range(const file_range fr)
     return Ok(retval);
 }
 
+Result<line_span, std::string>
+line_buffer::read_span(std::vector<line_info>::const_iterator begin,
+                       std::vector<line_info>::const_iterator end)
+{
+    require(begin != end);
+
+    auto last = std::prev(end);
+    auto span_start = begin->li_file_range.fr_offset;
+    auto span_range = file_range{
+        span_start,
+        last->li_file_range.next_offset() - span_start,
+    };
+    auto read_result = this->read_range(span_range);
+
+    if (read_result.isErr()) {
+        return Err(read_result.unwrapErr());
+    }
+
+    line_span retval;
+
+    retval.ls_begin = begin;
+    retval.ls_end = end;
+    retval.ls_sbr = read_result.unwrap();
+
+    return Ok(std::move(retval));
+}
+
+bool
+line_span::line_ref(const line_info& li, shared_buffer_ref& sbr_out)
+{
+    auto span_start = this->ls_begin->li_file_range.fr_offset;
+
+    require(li.li_file_range.fr_offset >= span_start);
+
+    if (!sbr_out.subset(this->ls_sbr,
+                        li.li_file_range.fr_offset - span_start,
+                        li.li_file_range.fr_size))
+    {
+        return false;
+    }
+    sbr_out.rtrim(is_line_ending);
+
+    return true;
+}
+
 file_range
 line_buffer::get_available()
 {
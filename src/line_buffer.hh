@@ -33,6 +33,10 @@
 #define line_buffer_hh
 
 #include <exception>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <errno.h>
@@ -43,8 +47,10 @@
 #include "base/auto_fd.hh"
 #include "base/auto_mem.hh"
 #include "base/file_range.hh"
+#include "base/line_scan.hh"
 #include "base/lnav_log.hh"
 #include "base/result.h"
+#include "optional.hpp"
 #include "shared_buffer.hh"
 
 struct line_info {
@@ -53,6 +59,27 @@ struct line_info {
     bool li_valid_utf{true};
 };
 
+/**
+ * A run of lines that are contiguous in the file along with a reference to
+ * the buffer that holds all of them, see line_buffer::read_span().
+ */
+struct line_span {
+    std::vector<line_info>::const_iterator ls_begin;
+    std::vector<line_info>::const_iterator ls_end;
+    shared_buffer_ref ls_sbr;
+
+    size_t size() const
+    {
+        return std::distance(this->ls_begin, this->ls_end);
+    }
+
+    /**
+     * Point the given reference at the contents of a line in this span,
+     * without the line ending.
+     */
+    bool line_ref(const line_info& li, shared_buffer_ref& sbr_out);
+};
+
 /**
  * Buffer for reading whole lines out of file descriptors.  The class presents
  * a stateless interface, callers specify the offset where a line starts and
@@ -118,6 +145,8 @@ public:
         int read(void* buf, size_t offset, size_t size);
 
         struct indexDict {
+            indexDict() = default;
+
             off_t in = 0;
             off_t out = 0;
             unsigned char bits = 0;
@@ -159,6 +188,16 @@ public:
             }
         };
 
+        const std::vector<indexDict>& get_syncpoints() const
+        {
+            return this->syncpoints;
+        }
+
+        void set_syncpoints(std::vector<indexDict> sp)
+        {
+            this->syncpoints = std::move(sp);
+        }
+
     private:
         z_stream strm; /*< gzip streams structure */
         std::vector<indexDict>
@@ -167,6 +206,276 @@ public:
         int gz_fd = -1; /*< The file to read data from. */
     };
 
+    /**
+     * A bzip2 file reader that keeps an index of where each compressed block
+     * starts in the file and in the decompressed data.  The blocks in a
+     * bzip2 stream do not depend on each other, so a block can be
+     * decompressed on its own by wrapping it in a stream header and trailer.
+     * That allows reads to start at the block that contains the requested
+     * offset and lets a run of blocks be decompressed in parallel.
+     */
+    class bz_indexed {
+    public:
+        struct block_entry {
+            /** The offset in bits of the block's magic number. */
+            int64_t be_in_bits;
+            /** The offset in bits of the end of the block. */
+            int64_t be_in_end_bits;
+            /** The offset of the block's data in the decompressed stream. */
+            int64_t be_out;
+            /** The size of the block's data once it is decompressed. */
+            int64_t be_out_size;
+            /** The block size level of the stream, '1' through '9'. */
+            char be_level;
+        };
+
+        inline operator bool() const
+        {
+            return this->bz_fd != -1;
+        }
+
+        /**
+         * @param fd The file to read from, it is not owned by this object.
+         */
+        void open(int fd);
+        void close();
+
+        /**
+         * Decompress bytes from the bzip2 file returning at most `size`
+         * bytes.  offset is the byte-offset in the decompressed data stream.
+         */
+        int read(void* buf, size_t offset, size_t size);
+
+        /**
+         * @return The offset in the file of the end of the last block that
+         * has been indexed.
+         */
+        file_off_t get_source_offset() const
+        {
+            if (this->bz_blocks.empty()) {
+                return 0;
+            }
+
+            return (this->bz_blocks.back().be_in_end_bits + 7) / 8;
+        }
+
+        const std::vector<block_entry>& get_blocks() const
+        {
+            return this->bz_blocks;
+        }
+
+        void set_blocks(std::vector<block_entry> blocks);
+
+    private:
+        struct magic_hit {
+            int64_t mh_bits;
+            bool mh_end_of_stream;
+        };
+
+        struct block_range {
+            int64_t br_in_bits;
+            int64_t br_in_end_bits;
+            char br_level;
+        };
+
+        /**
+         * Find the next block or end-of-stream magic number at or after the
+         * given bit offset in the file.
+         */
+        nonstd::optional<magic_hit> find_magic(int64_t from_bits) const;
+
+        /**
+         * Decompress the given blocks in parallel.
+         *
+         * @return The decompressed data for each block or nullopt if the
+         * block could not be decompressed.
+         */
+        std::vector<nonstd::optional<std::string>> decompress_blocks(
+            const std::vector<block_range>& ranges) const;
+
+        /**
+         * Find the boundaries of the blocks that follow the ones that have
+         * already been indexed, decompress them, and add them to the index.
+         *
+         * @param data_out The decompressed data for the new blocks, indexed
+         * by their position in bz_blocks.
+         * @return False if there are no more blocks in the file.
+         */
+        bool index_next_blocks(
+            std::vector<std::pair<size_t, std::string>>& data_out);
+
+        int bz_fd{-1};
+        std::vector<block_entry> bz_blocks;
+        /** The level of the stream that contains the end of the index. */
+        char bz_level{'9'};
+        bool bz_eof{false};
+    };
+
+    /**
+     * A reader for the compression formats that are made up of a sequence of
+     * independent frames: zstd, xz, and lz4.  The index records where each
+     * frame starts in the file and in the decompressed data so that a read
+     * can start decoding at the frame that contains the requested offset
+     * instead of the start of the file.  If the file has an index of its
+     * own, like the seek table of the zstd seekable format or the index at
+     * the end of an xz stream, it is loaded when the file is opened.
+     * Otherwise, frames are added to the index as they are discovered.
+     */
+    class frame_indexed {
+    public:
+        enum class kind_t : int32_t {
+            zstd,
+            xz,
+            lz4,
+        };
+
+        struct frame_entry {
+            /** The offset of the frame in the file. */
+            int64_t fe_in;
+            /** The offset of the frame's data in the decompressed stream. */
+            int64_t fe_out;
+            /**
+             * Format-specific flags.  For xz, the check type of the block or
+             * -1 if the rest of the file should be decoded as a stream.
+             */
+            int64_t fe_flags;
+        };
+
+        class decoder;
+
+        frame_indexed();
+        frame_indexed(frame_indexed&& other) noexcept;
+        ~frame_indexed();
+
+        inline operator bool() const
+        {
+            return this->fi_fd != -1;
+        }
+
+        /**
+         * @param header The first few bytes of a file.
+         * @return The kind of compression used by the file if it is one that
+         * can be decoded by this class.
+         */
+        static nonstd::optional<kind_t> detect(const char* header, size_t len);
+
+        /**
+         * @param fd The file to read from, it is not owned by this object.
+         */
+        void open(int fd, kind_t kind);
+        void close();
+
+        /**
+         * Decompress bytes from the file returning at most `size` bytes.
+         * offset is the byte-offset in the decompressed data stream.
+         */
+        int read(void* buf, size_t offset, size_t size);
+
+        /** @return The offset in the file of the next byte to decode. */
+        file_off_t get_source_offset() const
+        {
+            return this->fi_in_file - this->fi_in_avail;
+        }
+
+        const std::vector<frame_entry>& get_frames() const
+        {
+            return this->fi_frames;
+        }
+
+        /**
+         * Restore frames that were previously retrieved with get_frames().
+         * The frames are ignored if the file had an index of its own.
+         */
+        void set_frames(std::vector<frame_entry> frames);
+
+    private:
+        /**
+         * Start decoding at the beginning of the given frame in the index.
+         */
+        bool restart(size_t index);
+
+        /**
+         * Read the next chunk of the file into the input buffer.
+         *
+         * @return False if the end of the file was reached.
+         */
+        bool fill_input();
+
+        int fi_fd{-1};
+        kind_t fi_kind{kind_t::zstd};
+        std::unique_ptr<decoder> fi_decoder;
+        std::vector<frame_entry> fi_frames;
+        /** True if the index covers all of the frames in the file. */
+        bool fi_complete{false};
+        /** True if the decoder is positioned in the current frame. */
+        bool fi_active{false};
+        size_t fi_frame_index{0};
+        /** The offset in the decompressed stream of the next decoded byte. */
+        int64_t fi_out_pos{0};
+        bool fi_eof{false};
+        std::vector<unsigned char> fi_inbuf;
+        std::vector<unsigned char> fi_scratch;
+        size_t fi_in_next{0};
+        size_t fi_in_avail{0};
+        /** The offset in the file of the end of the data in fi_inbuf. */
+        int64_t fi_in_file{0};
+    };
+
+    /**
+     * A read-only mapping of a file that is not expected to change, like a
+     * log that has been rotated.  Reading a page of the mapping that is past
+     * the end of the file raises SIGBUS, so each mapping is registered with
+     * a handler that replaces it with zero-filled pages when that happens
+     * and marks it as damaged.  The owner is then expected to drop the
+     * mapping and go back to reading the file.
+     */
+    class file_mapping {
+    public:
+        file_mapping() = default;
+        file_mapping(file_mapping&& other) noexcept;
+        file_mapping& operator=(file_mapping&& other) noexcept;
+        ~file_mapping();
+
+        inline operator bool() const
+        {
+            return this->fm_base != nullptr;
+        }
+
+        /**
+         * @param fd The file to map, it is not owned by this object.
+         * @param size The number of bytes at the start of the file to map.
+         * @return True if the file was mapped.
+         */
+        bool map(int fd, file_ssize_t size);
+        void unmap();
+
+        char* data() const
+        {
+            return this->fm_base;
+        }
+
+        file_ssize_t size() const
+        {
+            return this->fm_size;
+        }
+
+        /** @return True if the file was truncated while it was mapped. */
+        bool is_damaged() const;
+
+        /**
+         * Tell the kernel whether the mapping is going to be read in order,
+         * so pages are read ahead and dropped behind, or at random.
+         */
+        void advise_sequential(bool sequential);
+
+    private:
+        char* fm_base{nullptr};
+        file_ssize_t fm_size{0};
+        /** The slot in the table of mappings checked by the handler. */
+        int fm_slot{-1};
+        bool fm_sequential{false};
+    };
+
     /** Construct an empty line_buffer. */
     line_buffer();
 
@@ -206,11 +515,93 @@ public:
         return !this->lb_seekable && (this->lb_file_size != -1);
     };
 
+    /**
+     * Read the file through a mapping instead of copying it into the buffer,
+     * so the references returned by read_range() point straight into the
+     * mapping.  This should only be used for files that are not expected to
+     * change.  If the file grows, the line buffer goes back to reading it
+     * and, if it is truncated, the reads that were in flight see zeroes
+     * until the mapping is dropped.
+     *
+     * @return True if the file was mapped.
+     */
+    bool map_file();
+
+    bool is_mapped() const
+    {
+        return (bool) this->lb_mapping;
+    }
+
+    /**
+     * Tell the kernel that the mapped file is going to be read in order, as
+     * it is while the file is being indexed, or at random afterward.
+     */
+    void advise_sequential(bool sequential)
+    {
+        if (this->lb_mapping) {
+            this->lb_mapping.advise_sequential(sequential);
+        }
+    }
+
     bool is_compressed() const
     {
-        return this->lb_gz_file || this->lb_bz_file;
+        return this->lb_gz_file || this->lb_bz_file || this->lb_frame_file;
     };
 
+    /**
+     * @return The decompression checkpoints that have been discovered so far
+     * for a gzipped file.
+     */
+    const std::vector<gz_indexed::indexDict>& get_gz_syncpoints() const
+    {
+        return this->lb_gz_file.get_syncpoints();
+    }
+
+    /**
+     * Restore decompression checkpoints that were previously retrieved with
+     * get_gz_syncpoints() so that seeks do not have to decompress from the
+     * start of the file.
+     */
+    void set_gz_syncpoints(std::vector<gz_indexed::indexDict> syncpoints)
+    {
+        this->lb_gz_file.set_syncpoints(std::move(syncpoints));
+    }
+
+    /**
+     * @return The blocks that have been indexed so far for a bzip2 file.
+     */
+    const std::vector<bz_indexed::block_entry>& get_bz_blocks() const
+    {
+        return this->lb_bz_file.get_blocks();
+    }
+
+    /**
+     * Restore a block index that was previously retrieved with
+     * get_bz_blocks().
+     */
+    void set_bz_blocks(std::vector<bz_indexed::block_entry> blocks)
+    {
+        this->lb_bz_file.set_blocks(std::move(blocks));
+    }
+
+    /**
+     * @return The frames that have been indexed so far for a zstd, xz, or
+     * lz4 file.
+     */
+    const std::vector<frame_indexed::frame_entry>& get_frame_index() const
+    {
+        return this->lb_frame_file.get_frames();
+    }
+
+    /**
+     * Restore a frame index that was previously retrieved with
+     * get_frame_index().
+     */
+    void set_frame_index(std::vector<frame_indexed::frame_entry> frames)
+    {
+        this->lb_frame_file.set_frames(std::move(frames));
+    }
+
     file_off_t get_read_offset(file_off_t off) const
     {
         if (this->is_compressed()) {
@@ -237,8 +628,37 @@ public:
      */
     Result<line_info, std::string> load_next_line(file_range prev_line = {});
 
+    /**
+     * Attempt to load a batch of lines that follow the given line.  The
+     * complete lines that are already in the buffer are found in a single
+     * pass with scan_lines().  If there are none, this falls back to
+     * load_next_line() and returns the single line it found, which might be
+     * partial or empty at the end of the file.
+     *
+     * @param prev_line The range of the previous line.
+     * @param lines_out The vector to fill with information about the lines.
+     * @param max_lines The maximum number of lines to return.
+     * @return An error message if the read was not successful.
+     */
+    Result<void, std::string> load_next_lines(file_range prev_line,
+                                              std::vector<line_info>& lines_out,
+                                              size_t max_lines);
+
     Result<shared_buffer_ref, std::string> read_range(file_range fr);
 
+    /**
+     * Get a reference to a run of lines returned by load_next_lines() so
+     * that the contents of each line can be referenced without going back
+     * through read_range().
+     *
+     * @param begin The first line in the run.
+     * @param end The end of the run, the lines must be contiguous.
+     * @return The span or an error message if the read was not successful.
+     */
+    Result<line_span, std::string> read_span(
+        std::vector<line_info>::const_iterator begin,
+        std::vector<line_info>::const_iterator end);
+
     file_range get_available();
 
     void clear()
@@ -249,6 +669,7 @@ public:
     /** Release any resources held by this object. */
     void reset()
     {
+        this->unmap_file();
         this->lb_fd.reset();
 
         this->lb_file_offset = 0;
@@ -261,7 +682,8 @@ public:
     bool invariant()
     {
         require(this->lb_buffer != nullptr);
-        require(this->lb_buffer_size <= this->lb_buffer_max);
+        require(this->lb_mapping
+                || this->lb_buffer_size <= this->lb_buffer_max);
 
         return true;
     };
@@ -279,6 +701,19 @@ private:
 
     void resize_buffer(size_t new_max);
 
+    /**
+     * Drop the mapping of the file, after giving the outstanding references
+     * into it their own copy of the data.
+     */
+    void unmap_file();
+
+    /**
+     * Drop the mapping if its file was truncated.  This is only done at the
+     * start of an operation so the buffer does not change in the middle of
+     * one.
+     */
+    void check_mapping();
+
     /**
      * Ensure there is enough room in the buffer to cache a range of data from
      * the file.  First, this method will check to see if there is enough room
@@ -321,7 +756,11 @@ private:
         require(buffer_offset >= 0);
         require(this->lb_buffer_size >= buffer_offset);
 
-        retval = &this->lb_buffer[buffer_offset];
+        if (this->lb_mapping) {
+            retval = this->lb_mapping.data() + start;
+        } else {
+            retval = &this->lb_buffer[buffer_offset];
+        }
         avail_out = this->lb_buffer_size - buffer_offset;
 
         return retval;
@@ -331,8 +770,10 @@ private:
 
     auto_fd lb_fd; /*< The file to read data from. */
     gz_indexed lb_gz_file; /*< File reader for gzipped files. */
-    bool lb_bz_file; /*< Flag set for bzip2 compressed files. */
+    bz_indexed lb_bz_file; /*< File reader for bzip2 files. */
+    frame_indexed lb_frame_file; /*< File reader for zstd, xz, and lz4 files. */
     file_off_t lb_compressed_offset; /*< The offset into the compressed file. */
+    file_mapping lb_mapping; /*< The mapping of an unchanging file. */
 
     auto_mem<char> lb_buffer; /*< The internal buffer where data is cached */
 
@@ -351,5 +792,6 @@ private:
                             *  buffer. */
     bool lb_seekable; /*< Flag set for seekable file descriptors. */
     file_off_t lb_last_line_offset; /*< */
+    std::vector<scanned_line> lb_scanned_lines; /*< Scratch for batches. */
 };
 #endif
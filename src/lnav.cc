@@ -73,6 +73,18 @@
 #    include <bzlib.h>
 #endif
 
+#ifdef HAVE_ZSTD_H
+#    include <zstd.h>
+#endif
+
+#ifdef HAVE_LZMA_H
+#    include <lzma.h>
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+#    include <lz4frame.h>
+#endif
+
 #include "all_logs_vtab.hh"
 #include "base/ansi_scrubber.hh"
 #include "base/fs_util.hh"
@@ -92,6 +104,7 @@
 #include "bound_tags.hh"
 #include "column_namer.hh"
 #include "environ_vtab.hh"
+#include "file_watcher.hh"
 #include "fstat_vtab.hh"
 #include "grep_proc.hh"
 #include "help-txt.h"
@@ -485,6 +498,16 @@ public:
     off_t lo_last_offset;
 };
 
+/**
+ * @return True if the line is counted in the histogram.  Continued lines
+ *   and lines without a time do not have a bucket.
+ */
+static bool
+is_hist_line(const logline& ll)
+{
+    return !ll.is_continued() && ll.get_time() != 0;
+}
+
 class hist_index_delegate : public index_delegate {
 public:
     hist_index_delegate(hist_source2& hs, textview_curses& tc)
@@ -501,7 +524,7 @@ public:
                     logfile* lf,
                     logfile::iterator ll) override
     {
-        if (ll->is_continued() || ll->get_time() == 0) {
+        if (!is_hist_line(*ll)) {
             return;
         }
 
@@ -544,8 +567,37 @@ rebuild_hist()
     hist_source2& hs = lnav_data.ld_hist_source2;
     int zoom = lnav_data.ld_zoom_level;
 
-    hs.set_time_slice(ZOOM_LEVELS[zoom]);
-    lss.reload_index_delegate();
+    if (!hs.set_time_slice(ZOOM_LEVELS[zoom])) {
+        lss.reload_index_delegate();
+        return;
+    }
+
+    // The buckets for every zoom level are kept up-to-date while indexing,
+    // so only the marks, which can change without a rebuild, are recounted.
+    auto& bm = lnav_data.ld_views[LNV_LOG].get_bookmarks();
+    const auto& user_marks = bm[&textview_curses::BM_USER];
+    const auto& expr_marks = bm[&textview_curses::BM_USER_EXPR];
+    std::vector<vis_line_t> marked_lines;
+
+    std::set_union(user_marks.begin(),
+                   user_marks.end(),
+                   expr_marks.begin(),
+                   expr_marks.end(),
+                   std::back_inserter(marked_lines));
+    hs.clear_values(hist_source2::HT_MARK);
+    for (const auto& vl : marked_lines) {
+        if (vl >= (ssize_t) lss.text_line_count()) {
+            continue;
+        }
+
+        auto ll = lss.find_line(lss.at(vl));
+
+        if (!is_hist_line(*ll)) {
+            continue;
+        }
+        hs.update_value(ll->get_time(), hist_source2::HT_MARK);
+    }
+    lnav_data.ld_views[LNV_HISTOGRAM].reload_data();
 }
 
 class textfile_callback {
@@ -658,6 +710,10 @@ rebuild_indexes(nonstd::optional<ui_clock::time_point> deadline)
 
     std::vector<std::shared_ptr<logfile>> closed_files;
     for (auto& lf : lnav_data.ld_active_files.fc_files) {
+        if (lss.is_index_frozen()) {
+            // A pending query might still read the lines of a closed file.
+            break;
+        }
         if ((!lf->exists() || lf->is_closed())) {
             log_info("closed log file: %s", lf->get_filename().c_str());
             lnav_data.ld_text_source.remove(lf);
@@ -1015,7 +1071,9 @@ rescan_files(bool req)
         mlooper.get_port().process_for(delay);
         if (lnav_data.ld_flags & LNF_HEADLESS) {
             for (const auto& pair : lnav_data.ld_active_files.fc_other_files) {
-                if (pair.second.ofd_format != file_format_t::REMOTE) {
+                if (pair.second.ofd_format != file_format_t::REMOTE
+                    && pair.second.ofd_format != file_format_t::ARCHIVE)
+                {
                     continue;
                 }
 
@@ -1630,6 +1688,13 @@ looper()
         auto next_rebuild_time = ui_clock::now();
         auto next_status_update_time = next_rebuild_time;
         auto next_rescan_time = next_rebuild_time;
+        // Set once the tests have been asked for a key in paging mode and
+        // cleared when it is read, so only one key is requested at a time.
+        auto input_requested = false;
+        // Set when a watched directory changes while a rescan is running.
+        auto dir_changed_during_rescan = false;
+        auto rescanned_files_generation
+            = lnav_data.ld_active_files.fc_files_generation;
 
         while (lnav_data.ld_looping) {
             auto loop_deadline
@@ -1681,6 +1746,7 @@ looper()
                               lnav_data.ld_active_files.fc_files.size())
                 }
                 update_active_files(new_files);
+                file_watcher::singleton().sync(lnav_data.ld_active_files);
                 if (!initial_rescan_completed) {
                     auto& fview = lnav_data.ld_files_view;
                     auto height = fview.get_inner_height();
@@ -1692,7 +1758,31 @@ looper()
 
                 active_copy.clear();
                 rescan_future = std::future<file_collection>{};
-                next_rescan_time = ui_clock::now() + 333ms;
+                if (new_files.fc_files.empty() && new_files.fc_file_names.empty()
+                    && !dir_changed_during_rescan
+                    && file_watcher::singleton().covers(
+                        lnav_data.ld_active_files))
+                {
+                    // New files will be reported by the directory watches,
+                    // so this rescan is only a fallback.
+                    next_rescan_time = ui_clock::now() + 10s;
+                } else {
+                    next_rescan_time = ui_clock::now() + 333ms;
+                }
+                dir_changed_during_rescan = false;
+                rescanned_files_generation
+                    = lnav_data.ld_active_files.fc_files_generation;
+            }
+
+            if (lnav_data.ld_active_files.fc_files_generation
+                != rescanned_files_generation)
+            {
+                // A file was closed, so check for its replacement as soon
+                // as the directories would have been polled.
+                next_rescan_time
+                    = std::min(next_rescan_time, ui_clock::now() + 333ms);
+                rescanned_files_generation
+                    = lnav_data.ld_active_files.fc_files_generation;
             }
 
             if (!rescan_future.valid()
@@ -1700,6 +1790,8 @@ looper()
             {
                 active_copy.clear();
                 active_copy.merge(lnav_data.ld_active_files);
+                active_copy.fc_progress
+                    = lnav_data.ld_active_files.fc_progress;
                 rescan_future = std::async(std::launch::async,
                                            &file_collection::rescan_files,
                                            std::move(active_copy),
@@ -1714,6 +1806,12 @@ looper()
 
             auto ui_now = ui_clock::now();
             if (initial_rescan_completed) {
+                if (is_sql_pending()) {
+                    // The log index is frozen while the query is pending, so
+                    // files are still tailed between the steps.
+                    changes += step_pending_sql(
+                        std::max(loop_deadline, ui_now + 10ms));
+                }
                 if (ui_now >= next_rebuild_time) {
                     auto text_file_count = lnav_data.ld_text_source.size();
                     changes += rebuild_indexes(loop_deadline);
@@ -1770,6 +1868,17 @@ looper()
             }
             refresh();
 
+            if (!changes && initial_rescan_completed
+                && lnav_data.ld_view_stack.top().value_or(nullptr)
+                    == &lnav_data.ld_views[LNV_LOG])
+            {
+                // Use some of the idle time to annotate the lines around the
+                // view so that scrolling to them is quick.
+                lnav_data.ld_log_source.prefetch_lines(
+                    lnav_data.ld_views[LNV_LOG],
+                    std::min(loop_deadline, ui_clock::now() + 10ms));
+            }
+
             if (lnav_data.ld_session_loaded) {
                 // Only take input from the user after everything has loaded.
                 pollfds.push_back((struct pollfd){STDIN_FILENO, POLLIN, 0});
@@ -1788,8 +1897,11 @@ looper()
                             }
                             break;
                         default:
-                            // log_debug("waiting for paging input");
-                            view_curses::awaiting_user_input();
+                            if (!input_requested) {
+                                // log_debug("waiting for paging input");
+                                view_curses::awaiting_user_input();
+                                input_requested = true;
+                            }
                             break;
                     }
                 }
@@ -1802,6 +1914,7 @@ looper()
             }
             lnav_data.ld_filter_view.update_poll_set(pollfds);
             lnav_data.ld_files_view.update_poll_set(pollfds);
+            file_watcher::singleton().update_poll_set(pollfds);
 
             ui_now = ui_clock::now();
             auto poll_to
@@ -1841,6 +1954,7 @@ looper()
                 } else if (in_revents & POLLIN) {
                     int ch;
 
+                    input_requested = false;
                     while ((ch = getch()) != ERR) {
                         alerter::singleton().new_input(ch);
 
@@ -1898,6 +2012,30 @@ looper()
                 lnav_data.ld_filter_view.check_poll_set(pollfds);
                 lnav_data.ld_files_view.check_poll_set(pollfds);
 
+                auto fw_changes
+                    = file_watcher::singleton().check_poll_set(pollfds);
+                auto fw_now = ui_clock::now();
+                // Changes are picked up right away unless the checks have
+                // been put off while the user is typing.
+                if (fw_changes.c_files && next_rebuild_time <= fw_now + 333ms)
+                {
+                    next_rebuild_time = fw_now;
+                }
+                if (fw_changes.c_directories) {
+                    if (rescan_future.valid()) {
+                        dir_changed_during_rescan = true;
+                    }
+                    switch (lnav_data.ld_mode) {
+                        case LNM_PAGING:
+                        case LNM_FILTER:
+                        case LNM_FILES:
+                            next_rescan_time = fw_now;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+
                 if (lnav_data.ld_mode != old_mode) {
                     switch (lnav_data.ld_mode) {
                         case LNM_PAGING:
@@ -2002,6 +2140,7 @@ looper()
                     if (!ran_cleanup) {
                         archive_manager::cleanup_cache();
                         tailer::cleanup_cache();
+                        lnav::logfile::cleanup_index_cache();
                         ran_cleanup = true;
                     }
                 }
@@ -2626,11 +2765,13 @@ main(int argc, char* argv[])
     {
         hist_source2& hs = lnav_data.ld_hist_source2;
 
+        hs.set_time_slices(
+            std::vector<int64_t>(ZOOM_LEVELS, ZOOM_LEVELS + ZOOM_COUNT));
+        lnav_data.ld_zoom_level = 3;
+        hs.set_time_slice(ZOOM_LEVELS[lnav_data.ld_zoom_level]);
         lnav_data.ld_log_source.set_index_delegate(new hist_index_delegate(
             lnav_data.ld_hist_source2, lnav_data.ld_views[LNV_HISTOGRAM]));
         hs.init();
-        lnav_data.ld_zoom_level = 3;
-        hs.set_time_slice(ZOOM_LEVELS[lnav_data.ld_zoom_level]);
     }
 
     for (lpc = 0; lpc < LNV__MAX; lpc++) {
@@ -2947,7 +3088,7 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
                 }
                 shared_buffer_ref sbr = read_result.unwrap();
                 if (fmt->scan_for_partial(sbr, partial_len)) {
-                    long line_number = distance(lf->begin(), line_iter);
+                    long line_number = std::distance(lf->begin(), line_iter);
                     std::string full_line(sbr.get_data(), sbr.length());
                     std::string partial_line(sbr.get_data(), partial_len);
 
@@ -3068,12 +3209,21 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
 #endif
 #ifdef HAVE_ARCHIVE_H
             log_info("  libarchive=%d", ARCHIVE_VERSION_NUMBER);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+            log_info("  lz4=%u", LZ4F_getVersion());
+#endif
+#ifdef HAVE_LZMA_H
+            log_info("  lzma=%s", lzma_version_string());
 #endif
             log_info("  ncurses=%s", NCURSES_VERSION);
             log_info("  pcre=%s", pcre_version());
             log_info("  readline=%s", rl_library_version);
             log_info("  sqlite=%s", sqlite3_version);
             log_info("  zlib=%s", zlibVersion());
+#ifdef HAVE_ZSTD_H
+            log_info("  zstd=%s", ZSTD_versionString());
+#endif
             log_info("lnav_data:");
             log_info("  flags=%x", lnav_data.ld_flags);
             log_info("  commands:");
@@ -3140,6 +3290,7 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
                 execute_init_commands(lnav_data.ld_exec_context, cmd_results);
                 archive_manager::cleanup_cache();
                 tailer::cleanup_cache();
+                lnav::logfile::cleanup_index_cache();
                 wait_for_pipers();
                 isc::to<curl_looper&, services::curl_streamer_t>()
                     .send_and_wait(
@@ -3270,6 +3421,7 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
         } catch (line_buffer::error& e) {
             fprintf(stderr, "error: %s\n", strerror(e.e_err));
         }
+        archive_manager::stop_streaming();
 
         // When reading from stdin, tell the user where the capture file is
         // stored so they can look at it later.
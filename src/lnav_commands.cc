@@ -205,7 +205,7 @@ com_adjust_log_time(exec_context& ec,
         top_content = lss.at(top_line);
         lf = lss.find(top_content);
 
-        logline& ll = (*lf)[top_content];
+        logline ll = (*lf)[top_content];
 
         top_time = ll.get_timeval();
 
@@ -743,22 +743,21 @@ json_write_row(yajl_gen handle, int row)
     for (size_t col = 0; col < dls.dls_headers.size(); col++) {
         obj_map.gen(dls.dls_headers[col].hm_name);
 
-        if (dls.dls_rows[row][col] == db_label_source::NULL_STR) {
+        if (dls.is_null(row, col)) {
             obj_map.gen();
             continue;
         }
 
         db_label_source::header_meta& hm = dls.dls_headers[col];
+        auto cell = dls.get_cell(row, col);
 
         switch (hm.hm_column_type) {
             case SQLITE_FLOAT:
             case SQLITE_INTEGER: {
-                auto len = strlen(dls.dls_rows[row][col]);
-
-                if (len == 0) {
+                if (cell.empty()) {
                     obj_map.gen();
                 } else {
-                    yajl_gen_number(handle, dls.dls_rows[row][col], len);
+                    yajl_gen_number(handle, cell.c_str(), cell.length());
                 }
                 break;
             }
@@ -776,19 +775,17 @@ json_write_row(yajl_gen handle, int row)
                             yajl_alloc(&json_op::ptr_callbacks, nullptr, &jo));
 
                         const unsigned char* json_in
-                            = (const unsigned char*) dls.dls_rows[row][col];
-                        switch (yajl_parse(parse_handle.in(),
-                                           json_in,
-                                           strlen((const char*) json_in))) {
+                            = (const unsigned char*) cell.c_str();
+                        switch (yajl_parse(
+                            parse_handle.in(), json_in, cell.length())) {
                             case yajl_status_error:
                             case yajl_status_client_canceled: {
-                                err = yajl_get_error(
-                                    parse_handle.in(),
-                                    0,
-                                    json_in,
-                                    strlen((const char*) json_in));
+                                err = yajl_get_error(parse_handle.in(),
+                                                     0,
+                                                     json_in,
+                                                     cell.length());
                                 log_error("unable to parse JSON cell: %s", err);
-                                obj_map.gen(dls.dls_rows[row][col]);
+                                obj_map.gen(cell);
                                 yajl_free_error(parse_handle.in(), err);
                                 return;
                             }
@@ -799,13 +796,12 @@ json_write_row(yajl_gen handle, int row)
                         switch (yajl_complete_parse(parse_handle.in())) {
                             case yajl_status_error:
                             case yajl_status_client_canceled: {
-                                err = yajl_get_error(
-                                    parse_handle.in(),
-                                    0,
-                                    json_in,
-                                    strlen((const char*) json_in));
+                                err = yajl_get_error(parse_handle.in(),
+                                                     0,
+                                                     json_in,
+                                                     cell.length());
                                 log_error("unable to parse JSON cell: %s", err);
-                                obj_map.gen(dls.dls_rows[row][col]);
+                                obj_map.gen(cell);
                                 yajl_free_error(parse_handle.in(), err);
                                 return;
                             }
@@ -815,12 +811,12 @@ json_write_row(yajl_gen handle, int row)
                         break;
                     }
                     default:
-                        obj_map.gen(dls.dls_rows[row][col]);
+                        obj_map.gen(cell);
                         break;
                 }
                 break;
             default:
-                obj_map.gen(dls.dls_rows[row][col]);
+                obj_map.gen(cell);
                 break;
         }
     }
@@ -973,8 +969,6 @@ com_save_to(exec_context& ec,
     int line_count = 0;
 
     if (args[0] == "write-csv-to") {
-        std::vector<std::vector<const char*>>::iterator row_iter;
-        std::vector<const char*>::iterator iter;
         std::vector<db_label_source::header_meta>::iterator hdr_iter;
         bool first = true;
 
@@ -990,21 +984,16 @@ com_save_to(exec_context& ec,
         }
         fprintf(outfile, "\n");
 
-        for (row_iter = dls.dls_rows.begin(); row_iter != dls.dls_rows.end();
-             ++row_iter)
-        {
-            if (ec.ec_dry_run && distance(dls.dls_rows.begin(), row_iter) > 10)
-            {
+        for (size_t row = 0; row < dls.row_count(); row++) {
+            if (ec.ec_dry_run && row > 10) {
                 break;
             }
 
-            first = true;
-            for (iter = row_iter->begin(); iter != row_iter->end(); ++iter) {
-                if (!first) {
+            for (size_t col = 0; col < dls.dls_columns.size(); col++) {
+                if (col > 0) {
                     fprintf(outfile, ",");
                 }
-                csv_write_string(outfile, *iter);
-                first = false;
+                csv_write_string(outfile, dls.get_cell(row, col));
             }
             fprintf(outfile, "\n");
 
@@ -1056,16 +1045,15 @@ com_save_to(exec_context& ec,
 
                 fprintf(outfile, "\u2502");
 
-                auto cell = dls.dls_rows[row][col];
-                auto cell_byte_len = strlen(cell);
-                auto cell_length = utf8_string_length(cell, cell_byte_len)
-                                       .unwrapOr(cell_byte_len);
+                auto cell = dls.get_cell(row, col);
+                auto cell_length
+                    = utf8_string_length(cell).unwrapOr(cell.length());
                 auto padding = hdr.hm_column_size - cell_length;
 
                 if (hdr.hm_column_type != SQLITE3_TEXT) {
                     fprintf(outfile, "%s", std::string(padding, ' ').c_str());
                 }
-                fprintf(outfile, "%s", cell);
+                fprintf(outfile, "%s", cell.c_str());
                 if (hdr.hm_column_type == SQLITE3_TEXT) {
                     fprintf(outfile, "%s", std::string(padding, ' ').c_str());
                 }
@@ -1097,7 +1085,7 @@ com_save_to(exec_context& ec,
         {
             yajlpp_array root_array(gen);
 
-            for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+            for (size_t row = 0; row < dls.row_count(); row++) {
                 if (ec.ec_dry_run && row > 10) {
                     break;
                 }
@@ -1112,7 +1100,7 @@ com_save_to(exec_context& ec,
         yajl_gen_config(gen, yajl_gen_beautify, 0);
         yajl_gen_config(gen, yajl_gen_print_callback, yajl_writer, outfile);
 
-        for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+        for (size_t row = 0; row < dls.row_count(); row++) {
             if (ec.ec_dry_run && row > 10) {
                 break;
             }
@@ -1142,21 +1130,13 @@ com_save_to(exec_context& ec,
         tc->set_top(orig_top);
     } else if (args[0] == "write-raw-to") {
         if (tc == &lnav_data.ld_views[LNV_DB]) {
-            std::vector<std::vector<const char*>>::iterator row_iter;
-            std::vector<const char*>::iterator iter;
-
-            for (row_iter = dls.dls_rows.begin();
-                 row_iter != dls.dls_rows.end();
-                 ++row_iter)
-            {
-                if (ec.ec_dry_run
-                    && distance(dls.dls_rows.begin(), row_iter) > 10) {
+            for (size_t row = 0; row < dls.row_count(); row++) {
+                if (ec.ec_dry_run && row > 10) {
                     break;
                 }
 
-                for (iter = row_iter->begin(); iter != row_iter->end(); ++iter)
-                {
-                    fputs(*iter, outfile);
+                for (size_t col = 0; col < dls.dls_columns.size(); col++) {
+                    fputs(dls.get_cell(row, col).c_str(), outfile);
                 }
                 fprintf(outfile, "\n");
 
@@ -3322,7 +3302,7 @@ com_summarize(exec_context& ec,
                 lnav_data.ld_views[LNV_DB].reload_data();
                 lnav_data.ld_views[LNV_DB].set_left(0);
 
-                if (dls.dls_rows.size() > 0) {
+                if (!dls.empty()) {
                     ensure_view(&lnav_data.ld_views[LNV_DB]);
                 }
             }
@@ -3623,6 +3603,7 @@ com_toggle_field(exec_context& ec,
                                 HELP_MSG_1(x, "to quickly show hidden fields"));
                         }
                     }
+                    lss.invalidate_annotations();
                     tc->set_needs_update();
                 } else {
                     missing_fields.push_back(args[lpc]);
@@ -3703,11 +3684,10 @@ com_hide_line(exec_context& ec,
                     content_line_t cl;
                     struct exttm tm;
                     vis_line_t vl;
-                    logline* ll;
 
                     vl = tc->get_top();
                     cl = lnav_data.ld_log_source.at(vl);
-                    ll = lnav_data.ld_log_source.find_line(cl);
+                    auto ll = lnav_data.ld_log_source.find_line(cl);
                     ll->to_exttm(tm);
                     tv = parse_res.unwrap().adjust(tm).to_timeval();
 
@@ -4287,47 +4267,13 @@ public:
             = lss.find_from_time(sr.sr_begin_time).value_or(0_vl);
         vis_line_t end_line = lss.find_from_time(sr.sr_end_time)
                                   .value_or(lss.text_line_count());
-        std::vector<logline_value> values;
-        string_attrs_t sa;
-
-        for (vis_line_t curr_line = begin_line; curr_line < end_line;
-             ++curr_line) {
-            content_line_t cl = lss.at(curr_line);
-            std::shared_ptr<logfile> lf = lss.find(cl);
-            auto ll = lf->begin() + cl;
-            auto format = lf->get_format();
-            shared_buffer_ref sbr;
 
-            if (!ll->is_message()) {
-                continue;
-            }
-
-            lf->read_full_message(ll, sbr);
-            sa.clear();
-            values.clear();
-            format->annotate(cl, sbr, sa, values, false);
-
-            std::vector<logline_value>::iterator lv_iter;
-
-            lv_iter = find_if(values.begin(),
-                              values.end(),
-                              logline_value_cmp(&this->lsvs_colname));
-
-            if (lv_iter != values.end()) {
-                switch (lv_iter->lv_meta.lvm_kind) {
-                    case value_kind_t::VALUE_FLOAT:
-                        row_out.add_value(
-                            sr, lv_iter->lv_value.d, ll->is_marked());
-                        break;
-                    case value_kind_t::VALUE_INTEGER:
-                        row_out.add_value(
-                            sr, lv_iter->lv_value.i, ll->is_marked());
-                        break;
-                    default:
-                        break;
-                }
-            }
-        }
+        this->for_each_value(
+            begin_line,
+            end_line,
+            [&sr, &row_out](vis_line_t vl, logfile::iterator ll, double value) {
+                row_out.add_value(sr, value, ll->is_marked());
+            });
     };
 
     void spectro_mark(textview_curses& tc,
@@ -4336,60 +4282,87 @@ public:
                       double range_min,
                       double range_max)
     {
-        // XXX need to refactor this and the above method
         textview_curses& log_tc = lnav_data.ld_views[LNV_LOG];
         logfile_sub_source& lss = lnav_data.ld_log_source;
         vis_line_t begin_line = lss.find_from_time(begin_time).value_or(0_vl);
         vis_line_t end_line
             = lss.find_from_time(end_time).value_or(lss.text_line_count());
+
+        this->for_each_value(
+            begin_line,
+            end_line,
+            [&](vis_line_t vl, logfile::iterator ll, double value) {
+                if (range_min <= value && value <= range_max) {
+                    log_tc.toggle_user_mark(&textview_curses::BM_USER, vl);
+                }
+            });
+    };
+
+    /**
+     * Call the given function with the value of the column for each message
+     * in a range of lines.  The values come from the file's index of numeric
+     * values, so the messages only need to be read and annotated the first
+     * time they are looked at.  The index is only extended a bounded number
+     * of lines at a time, so lines far past the end of it are annotated
+     * directly instead.
+     */
+    template<typename F>
+    void for_each_value(vis_line_t begin_line, vis_line_t end_line, F func)
+    {
+        logfile_sub_source& lss = lnav_data.ld_log_source;
         std::vector<logline_value> values;
         string_attrs_t sa;
 
         for (vis_line_t curr_line = begin_line; curr_line < end_line;
-             ++curr_line) {
+             ++curr_line)
+        {
             content_line_t cl = lss.at(curr_line);
             std::shared_ptr<logfile> lf = lss.find(cl);
             auto ll = lf->begin() + cl;
-            auto format = lf->get_format();
-            shared_buffer_ref sbr;
 
             if (!ll->is_message()) {
                 continue;
             }
 
+            if (lf->index_values_to(cl)) {
+                const auto* col = lf->get_value_column(this->lsvs_colname);
+
+                if (col != nullptr) {
+                    const auto* val = col->value_for(cl);
+
+                    if (val != nullptr) {
+                        func(curr_line, ll, col->to_double(*val));
+                    }
+                    continue;
+                }
+            }
+
+            auto format = lf->get_format();
+            shared_buffer_ref sbr;
+
             lf->read_full_message(ll, sbr);
             sa.clear();
             values.clear();
             format->annotate(cl, sbr, sa, values, false);
 
-            std::vector<logline_value>::iterator lv_iter;
-
-            lv_iter = find_if(values.begin(),
-                              values.end(),
-                              logline_value_cmp(&this->lsvs_colname));
+            auto lv_iter = find_if(values.begin(),
+                                   values.end(),
+                                   logline_value_cmp(&this->lsvs_colname));
 
             if (lv_iter != values.end()) {
                 switch (lv_iter->lv_meta.lvm_kind) {
                     case value_kind_t::VALUE_FLOAT:
-                        if (range_min <= lv_iter->lv_value.d
-                            && lv_iter->lv_value.d <= range_max) {
-                            log_tc.toggle_user_mark(&textview_curses::BM_USER,
-                                                    curr_line);
-                        }
+                        func(curr_line, ll, lv_iter->lv_value.d);
                         break;
                     case value_kind_t::VALUE_INTEGER:
-                        if (range_min <= lv_iter->lv_value.i
-                            && lv_iter->lv_value.i <= range_max) {
-                            log_tc.toggle_user_mark(&textview_curses::BM_USER,
-                                                    curr_line);
-                        }
+                        func(curr_line, ll, lv_iter->lv_value.i);
                         break;
                     default:
                         break;
                 }
             }
         }
-    };
+    }
 
     intern_string_t lsvs_colname;
     logline_value_stats lsvs_stats;
@@ -4436,7 +4409,7 @@ public:
             return;
         }
 
-        if (dls.dls_rows.empty()) {
+        if (dls.empty()) {
             this->dsvs_error_msg = "empty result set";
             return;
         }
@@ -4448,7 +4421,7 @@ public:
         this->dsvs_end_time = dls.dls_time_column.back().tv_sec;
         this->dsvs_stats.lvs_min_value = bs.bs_min_value;
         this->dsvs_stats.lvs_max_value = bs.bs_max_value;
-        this->dsvs_stats.lvs_count = dls.dls_rows.size();
+        this->dsvs_stats.lvs_count = dls.row_count();
     };
 
     void spectro_bounds(spectrogram_bounds& sb_out)
@@ -4473,12 +4446,11 @@ public:
         db_label_source& dls = lnav_data.ld_db_row_source;
         auto begin_row = dls.row_for_time({sr.sr_begin_time, 0}).value_or(0_vl);
         auto end_row = dls.row_for_time({sr.sr_end_time, 0})
-                           .value_or(dls.dls_rows.size());
+                           .value_or(dls.row_count());
 
         for (auto lpc = begin_row; lpc < end_row; ++lpc) {
-            double value = 0.0;
-
-            sscanf(dls.dls_rows[lpc][this->dsvs_column_index], "%lf", &value);
+            auto value
+                = dls.get_cell_number(lpc, this->dsvs_column_index).value_or(0.0);
 
             row_out.add_value(sr, value, false);
         }
@@ -87,6 +87,12 @@ static auto fvc = injector::bind<file_vtab::config>::to_instance(
 static auto lc = injector::bind<lnav::logfile::config>::to_instance(
     +[]() { return &lnav_config.lc_logfile; });
 
+static auto sc = injector::bind<lnav::search::config>::to_instance(
+    +[]() { return &lnav_config.lc_search; });
+
+static auto sqlc = injector::bind<lnav::sql::config>::to_instance(
+    +[]() { return &lnav_config.lc_sql; });
+
 static auto tc = injector::bind<tailer::config>::to_instance(
     +[]() { return &lnav_config.lc_tailer; });
 
@@ -988,6 +994,14 @@ static const struct json_path_container archive_handlers = {
         .with_example("12h")
         .for_field(&_lnav_config::lc_archive_manager,
                    &archive_manager::config::amc_cache_ttl),
+    yajlpp::property_handler("stream-members")
+        .with_synopsis("<bool>")
+        .with_description(
+            "Decompress archive members into temporary files that are "
+            "indexed while they are being written, instead of unpacking the "
+            "archive into the cache directory first")
+        .for_field(&_lnav_config::lc_archive_manager,
+                   &archive_manager::config::amc_stream_members),
 };
 
 static const struct json_path_container file_vtab_handlers = {
@@ -1008,6 +1022,87 @@ static const struct json_path_container logfile_handlers = {
         .with_min_value(1)
         .for_field(&_lnav_config::lc_logfile,
                    &lnav::logfile::config::lc_max_unrecognized_lines),
+    yajlpp::property_handler("index-cache-min-size")
+        .with_synopsis("<bytes>")
+        .with_description("The minimum size of a file before its line index "
+                          "is saved to the cache for faster reopening")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_index_cache_min_size),
+    yajlpp::property_handler("index-cache-ttl")
+        .with_synopsis("<duration>")
+        .with_description(
+            "The time-to-live for cached line indexes, expressed as a "
+            "duration (e.g. '3d' for three days)")
+        .with_example("3d")
+        .with_example("12h")
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_index_cache_ttl),
+    yajlpp::property_handler("index-threads")
+        .with_synopsis("<count>")
+        .with_description(
+            "The number of threads used to index log files concurrently.  "
+            "A value of zero will use one thread per CPU, up to eight, and "
+            "a value of one will index files on the main thread")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_index_threads),
+    yajlpp::property_handler("scan-chunk-size")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The minimum size of the chunks that a large file is split into "
+            "so that they can be scanned by multiple threads")
+        .with_min_value(1)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_scan_chunk_size),
+    yajlpp::property_handler("compact-index")
+        .with_synopsis("<bool>")
+        .with_description(
+            "Pack the older lines in the index of a file into blocks that use "
+            "less memory")
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_compact_index),
+    yajlpp::property_handler("mmap-min-size")
+        .with_synopsis("<bytes>")
+        .with_description("The minimum size of an unchanging file before it "
+                          "is mapped into memory instead of being read")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_mmap_min_size),
+    yajlpp::property_handler("mmap-min-age")
+        .with_synopsis("<duration>")
+        .with_description(
+            "The time since a file was last modified before it is treated as "
+            "unchanging and mapped into memory, expressed as a duration "
+            "(e.g. '1h' for one hour)")
+        .with_example("10m")
+        .with_example("1h")
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_mmap_min_age),
+};
+
+static const struct json_path_container search_handlers = {
+    yajlpp::property_handler("threads")
+        .with_synopsis("<count>")
+        .with_description(
+            "The number of threads used to read and match lines when "
+            "searching.  A value of zero will use one thread per CPU, up to "
+            "eight, and a value of -1 will search in a separate process "
+            "instead")
+        .with_min_value(-1)
+        .for_field(&_lnav_config::lc_search, &lnav::search::config::c_threads),
+};
+
+static const struct json_path_container sql_handlers = {
+    yajlpp::property_handler("max-result-size")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The amount of memory that the results of a query from the SQL "
+            "prompt can use before the query is stopped.  A value of zero "
+            "means there is no limit")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_sql,
+                   &lnav::sql::config::c_max_result_size),
 };
 
 static const struct json_path_container ssh_config_handlers = {
@@ -1150,6 +1245,12 @@ static const struct json_path_container tuning_handlers = {
     yajlpp::property_handler("remote")
         .with_description("Settings related to remote file support")
         .with_children(remote_handlers),
+    yajlpp::property_handler("search")
+        .with_description("Settings related to searching")
+        .with_children(search_handlers),
+    yajlpp::property_handler("sql")
+        .with_description("Settings related to SQL queries")
+        .with_children(sql_handlers),
     yajlpp::property_handler("clipboard")
         .with_description("Settings related to the clipboard")
         .with_children(sysclip_handlers),
@@ -45,9 +45,11 @@
 #include "base/result.h"
 #include "file_vtab.cfg.hh"
 #include "ghc/filesystem.hpp"
+#include "grep_proc.cfg.hh"
 #include "lnav_config_fwd.hh"
 #include "log_level.hh"
 #include "logfile.cfg.hh"
+#include "sql_util.cfg.hh"
 #include "styling.hh"
 #include "sysclip.cfg.hh"
 #include "tailer/tailer.looper.cfg.hh"
@@ -99,6 +101,8 @@ struct _lnav_config {
     archive_manager::config lc_archive_manager;
     file_vtab::config lc_file_vtab;
     lnav::logfile::config lc_logfile;
+    lnav::search::config lc_search;
+    lnav::sql::config lc_sql;
     tailer::config lc_tailer;
     sysclip::config lc_sysclip;
 };
@@ -124,7 +124,7 @@ log_data_table::next(log_cursor& lc, logfile_sub_source& lss)
     lc.lc_curr_line = lc.lc_curr_line + vis_line_t(1);
     lc.lc_sub_index = 0;
 
-    if (lc.lc_curr_line == (int) lss.text_line_count()) {
+    if (lc.is_eof()) {
         return true;
     }
 
@@ -177,14 +177,20 @@ void
 log_data_table::extract(std::shared_ptr<logfile> lf,
                         uint64_t line_number,
                         shared_buffer_ref& line,
+                        const column_usage& cu,
                         std::vector<logline_value>& values)
 {
     auto meta_iter = this->ldt_value_metas.begin();
 
-    this->ldt_format_impl->extract(lf, line_number, line, values);
+    this->ldt_format_impl->extract(lf, line_number, line, cu, values);
     values.emplace_back(*meta_iter, this->ldt_instance);
     ++meta_iter;
     for (auto& ldt_pair : this->ldt_pairs) {
+        if (!cu.is_value_used(meta_iter->lvm_column)) {
+            ++meta_iter;
+            continue;
+        }
+
         const data_parser::element& pvalue = ldt_pair.get_pair_value();
 
         switch (pvalue.value_token()) {
@@ -66,6 +66,7 @@ public:
     void extract(std::shared_ptr<logfile> lf,
                  uint64_t line_number,
                  shared_buffer_ref& line,
+                 const column_usage& cu,
                  std::vector<logline_value>& values) override;
 
 private:
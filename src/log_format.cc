@@ -28,6 +28,7 @@
  */
 
 #include <memory>
+#include <mutex>
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -57,6 +58,10 @@ string_attr_type<void> logline::L_OPID("opid");
 string_attr_type<bookmark_metadata*> logline::L_META("meta");
 
 external_log_format::mod_map_t external_log_format::MODULE_FORMATS;
+/**
+ * Guards MODULE_FORMATS since files can be scanned by multiple threads.
+ */
+static std::mutex MODULE_FORMATS_MUTEX;
 std::vector<std::shared_ptr<external_log_format>>
     external_log_format::GRAPH_ORDERED_FORMATS;
 
@@ -239,6 +244,14 @@ log_format::get_root_formats()
     return lf_root_formats;
 }
 
+literal_set&
+log_format::get_detection_literals()
+{
+    static literal_set retval;
+
+    return retval;
+}
+
 static bool
 next_format(
     const std::vector<std::shared_ptr<external_log_format::pattern>>& patterns,
@@ -344,7 +357,7 @@ log_format::log_scanf(uint32_t line_number,
 }
 
 void
-log_format::check_for_new_year(std::vector<logline>& dst,
+log_format::check_for_new_year(logline_store& dst,
                                exttm etm,
                                struct timeval log_tv)
 {
@@ -374,13 +387,14 @@ log_format::check_for_new_year(std::vector<logline>& dst,
     if (!do_change) {
         return;
     }
+    this->lf_rollover_count += 1;
     log_debug("%d:detected time rollover; offsets=%d %d %d %d",
               dst.size(),
               off_year,
               off_month,
               off_day,
               off_hour);
-    for (auto& ll : dst) {
+    for (auto&& ll : dst) {
         time_t ot = ll.get_time();
         struct tm otm;
 
@@ -420,6 +434,7 @@ struct json_log_userdata {
 static int read_json_field(yajlpp_parse_context* ypc,
                            const unsigned char* str,
                            size_t len);
+static void read_json_members(json_log_userdata* jlu, const json_index& ji);
 
 static int
 read_json_null(yajlpp_parse_context* ypc)
@@ -445,12 +460,11 @@ read_json_bool(yajlpp_parse_context* ypc, int val)
     return 1;
 }
 
-static int
-read_json_int(yajlpp_parse_context* ypc, long long val)
+static void
+json_log_int(json_log_userdata* jlu,
+             const intern_string_t field_name,
+             long long val)
 {
-    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
-    const intern_string_t field_name = ypc->get_path();
-
     if (jlu->jlu_format->lf_timestamp_field == field_name) {
         long long divisor = jlu->jlu_format->elf_timestamp_divisor;
         struct timeval tv;
@@ -483,6 +497,15 @@ read_json_int(yajlpp_parse_context* ypc, long long val)
             }
         }
     }
+}
+
+static int
+read_json_int(yajlpp_parse_context* ypc, long long val)
+{
+    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
+    const intern_string_t field_name = ypc->get_path();
+
+    json_log_int(jlu, field_name, val);
 
     jlu->jlu_sub_line_count
         += jlu->jlu_format->value_line_count(field_name, ypc->is_level(1));
@@ -490,12 +513,11 @@ read_json_int(yajlpp_parse_context* ypc, long long val)
     return 1;
 }
 
-static int
-read_json_double(yajlpp_parse_context* ypc, double val)
+static void
+json_log_double(json_log_userdata* jlu,
+                const intern_string_t field_name,
+                double val)
 {
-    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
-    const intern_string_t field_name = ypc->get_path();
-
     if (jlu->jlu_format->lf_timestamp_field == field_name) {
         double divisor = jlu->jlu_format->elf_timestamp_divisor;
         struct timeval tv;
@@ -504,6 +526,15 @@ read_json_double(yajlpp_parse_context* ypc, double val)
         tv.tv_usec = fmod(val, divisor) * (1000000.0 / divisor);
         jlu->jlu_base_line->set_time(tv);
     }
+}
+
+static int
+read_json_double(yajlpp_parse_context* ypc, double val)
+{
+    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
+    const intern_string_t field_name = ypc->get_path();
+
+    json_log_double(jlu, field_name, val);
 
     jlu->jlu_sub_line_count
         += jlu->jlu_format->value_line_count(field_name, ypc->is_level(1));
@@ -673,9 +704,27 @@ external_log_format::get_snippets() const
     return retval;
 }
 
+void
+log_format::scan_batch(logfile& lf,
+                       logline_store& dst,
+                       line_span& span,
+                       const scan_batch_callback_t& callback)
+{
+    shared_buffer_ref sbr;
+
+    for (auto iter = span.ls_begin; iter != span.ls_end; ++iter) {
+        auto found = SCAN_NO_MATCH;
+
+        if (span.line_ref(*iter, sbr)) {
+            found = this->scan(lf, dst, *iter, sbr);
+        }
+        callback(*iter, sbr, found);
+    }
+}
+
 log_format::scan_result_t
 external_log_format::scan(logfile& lf,
-                          std::vector<logline>& dst,
+                          logline_store& dst,
                           const line_info& li,
                           shared_buffer_ref& sbr)
 {
@@ -714,9 +763,20 @@ external_log_format::scan(logfile& lf,
         jlu.jlu_line_value = sbr.get_data();
         jlu.jlu_line_size = sbr.length();
         jlu.jlu_handle = handle;
-        if (yajl_parse(handle, line_data, sbr.length()) == yajl_status_ok
-            && yajl_complete_parse(handle) == yajl_status_ok)
+
+        bool parsed;
+
+        if (this->jlf_index_scan
+            && this->jlf_json_index.index(sbr.get_data(), sbr.length()))
         {
+            read_json_members(&jlu, this->jlf_json_index);
+            parsed = true;
+        } else {
+            parsed = yajl_parse(handle, line_data, sbr.length())
+                    == yajl_status_ok
+                && yajl_complete_parse(handle) == yajl_status_ok;
+        }
+        if (parsed) {
             if (ll.get_time() == 0) {
                 if (this->lf_specialized) {
                     ll.set_ignore(true);
@@ -839,6 +899,7 @@ external_log_format::scan(logfile& lf,
         if (mod_cap != nullptr) {
             intern_string_t mod_name = intern_string::lookup(
                 pi.get_substr_start(mod_cap), mod_cap->length());
+            std::unique_lock<std::mutex> mod_lock(MODULE_FORMATS_MUTEX);
             auto mod_iter = MODULE_FORMATS.find(mod_name);
 
             if (mod_iter == MODULE_FORMATS.end()) {
@@ -847,6 +908,7 @@ external_log_format::scan(logfile& lf,
             } else if (mod_iter->second.mf_mod_format) {
                 mod_index = mod_iter->second.mf_mod_format->lf_mod_index;
             }
+            mod_lock.unlock();
 
             if (mod_index && level_cap && body_cap) {
                 auto mod_elf = std::dynamic_pointer_cast<external_log_format>(
@@ -947,6 +1009,10 @@ external_log_format::scan(logfile& lf,
     return log_format::SCAN_NO_MATCH;
 }
 
+/**
+ * Find the format for a module and record it in MODULE_FORMATS.  The caller
+ * must hold MODULE_FORMATS_MUTEX.
+ */
 uint8_t
 external_log_format::module_scan(const pcre_input& pi,
                                  pcre_context::capture_t* body_cap,
@@ -974,13 +1040,18 @@ external_log_format::module_scan(const pcre_input& pi,
                 continue;
             }
 
+            auto spec_iter = elf->elf_module_formats.find(curr_fmt);
+            if (spec_iter == elf->elf_module_formats.end()) {
+                continue;
+            }
+
             log_debug("%s:module format found -- %s (%d)",
                       mod_name.get(),
                       elf->get_name().get(),
                       elf->lf_mod_index);
 
             mod_index = elf->lf_mod_index;
-            mf.mf_mod_format = elf->specialized(curr_fmt);
+            mf.mf_mod_format = spec_iter->second;
             MODULE_FORMATS[mod_name] = mf;
 
             return mod_index;
@@ -1097,12 +1168,16 @@ external_log_format::annotate(uint64_t line_number,
     {
         intern_string_t mod_name = intern_string::lookup(
             pi.get_substr_start(module_cap), module_cap->length());
+        std::unique_lock<std::mutex> mod_lock(MODULE_FORMATS_MUTEX);
         auto mod_iter = MODULE_FORMATS.find(mod_name);
+        module_format mf;
 
-        if (mod_iter != MODULE_FORMATS.end()
-            && mod_iter->second.mf_mod_format != nullptr)
-        {
-            module_format& mf = mod_iter->second;
+        if (mod_iter != MODULE_FORMATS.end()) {
+            mf = mod_iter->second;
+        }
+        mod_lock.unlock();
+
+        if (mf.mf_mod_format != nullptr) {
             shared_buffer_ref body_ref;
 
             body_cap->ltrim(line.get_data());
@@ -1185,11 +1260,12 @@ external_log_format::rewrite(exec_context& ec,
     }
 }
 
-static int
-read_json_field(yajlpp_parse_context* ypc, const unsigned char* str, size_t len)
+static void
+json_log_string(json_log_userdata* jlu,
+                const intern_string_t field_name,
+                const unsigned char* str,
+                size_t len)
 {
-    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
-    const intern_string_t field_name = ypc->get_path();
     struct exttm tm_out;
     struct timeval tv_out;
 
@@ -1225,6 +1301,15 @@ read_json_field(yajlpp_parse_context* ypc, const unsigned char* str, size_t len)
         uint8_t opid = hash_str((const char*) str, len);
         jlu->jlu_base_line->set_opid(opid);
     }
+}
+
+static int
+read_json_field(yajlpp_parse_context* ypc, const unsigned char* str, size_t len)
+{
+    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
+    const intern_string_t field_name = ypc->get_path();
+
+    json_log_string(jlu, field_name, str, len);
 
     jlu->jlu_sub_line_count += jlu->jlu_format->value_line_count(
         field_name, ypc->is_level(1), str, len);
@@ -1232,14 +1317,71 @@ read_json_field(yajlpp_parse_context* ypc, const unsigned char* str, size_t len)
     return 1;
 }
 
-static int
-rewrite_json_field(yajlpp_parse_context* ypc,
-                   const unsigned char* str,
-                   size_t len)
+/**
+ * Does the same work as the read_json_*() callbacks for the members of the
+ * top-level object found by the structural index.
+ */
+static void
+read_json_members(json_log_userdata* jlu, const json_index& ji)
+{
+    const auto* format = jlu->jlu_format;
+    const auto* line = (const unsigned char*) jlu->jlu_line_value;
+    std::string decoded;
+
+    for (const auto& jm : ji.members()) {
+        const intern_string_t field_name = intern_string::lookup(
+            jlu->jlu_line_value + jm.jm_key_begin,
+            jm.jm_key_end - jm.jm_key_begin);
+
+        switch (jm.jm_kind) {
+            case json_value_kind_t::string: {
+                const auto* str = &line[jm.jm_value_begin];
+                size_t len = jm.jm_value_end - jm.jm_value_begin;
+
+                if (!jm.jm_escaped) {
+                    json_log_string(jlu, field_name, str, len);
+                } else if (field_name == format->lf_timestamp_field
+                           || field_name == format->elf_level_field
+                           || field_name == format->elf_opid_field)
+                {
+                    // Only decode the values that are actually looked at.
+                    decoded.clear();
+                    json_index::decode_string((const char*) str, len, decoded);
+                    json_log_string(jlu,
+                                    field_name,
+                                    (const unsigned char*) decoded.data(),
+                                    decoded.size());
+                }
+                jlu->jlu_sub_line_count += format->value_line_count(
+                    field_name, true, (long) jm.jm_newlines + 1);
+                break;
+            }
+            case json_value_kind_t::integer:
+                json_log_int(jlu, field_name, jm.jm_integer);
+                jlu->jlu_sub_line_count
+                    += format->value_line_count(field_name, true);
+                break;
+            case json_value_kind_t::floating:
+                json_log_double(jlu, field_name, jm.jm_floating);
+                jlu->jlu_sub_line_count
+                    += format->value_line_count(field_name, true);
+                break;
+            default:
+                jlu->jlu_sub_line_count
+                    += format->value_line_count(field_name, true);
+                break;
+        }
+    }
+}
+
+static void
+rewrite_json_string(json_log_userdata* jlu,
+                    const intern_string_t field_name,
+                    bool top_level,
+                    const unsigned char* str,
+                    size_t len)
 {
     static const intern_string_t body_name = intern_string::lookup("body", -1);
-    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
-    const intern_string_t field_name = ypc->get_path();
 
     if (jlu->jlu_format->lf_timestamp_field == field_name) {
         char time_buf[64];
@@ -1277,8 +1419,8 @@ rewrite_json_field(yajlpp_parse_context* ypc,
                                                 value_kind_t::VALUE_TEXT),
                 sbr);
         }
-        if (!ypc->is_level(1) && !jlu->jlu_format->has_value_def(field_name)) {
-            return 1;
+        if (!top_level && !jlu->jlu_format->has_value_def(field_name)) {
+            return;
         }
 
         jlu->jlu_format->jlf_line_values.emplace_back(
@@ -1294,8 +1436,8 @@ rewrite_json_field(yajlpp_parse_context* ypc,
                                                 value_kind_t::VALUE_TEXT),
                 tsb.tsb_ref);
         }
-        if (!ypc->is_level(1) && !jlu->jlu_format->has_value_def(field_name)) {
-            return 1;
+        if (!top_level && !jlu->jlu_format->has_value_def(field_name)) {
+            return;
         }
 
         jlu->jlu_format->jlf_line_values.emplace_back(
@@ -1303,10 +1445,135 @@ rewrite_json_field(yajlpp_parse_context* ypc,
                                             value_kind_t::VALUE_TEXT),
             tsb.tsb_ref);
     }
+}
+
+static int
+rewrite_json_field(yajlpp_parse_context* ypc,
+                   const unsigned char* str,
+                   size_t len)
+{
+    json_log_userdata* jlu = (json_log_userdata*) ypc->ypc_userdata;
+
+    rewrite_json_string(jlu, ypc->get_path(), ypc->is_level(1), str, len);
 
     return 1;
 }
 
+/**
+ * Does the same work as the rewrite_json_*() callbacks for the members of
+ * the top-level object found by the structural index.
+ */
+static void
+rewrite_json_members(json_log_userdata* jlu,
+                     const std::vector<json_member>& members)
+{
+    auto* format = jlu->jlu_format;
+    const auto* line = (const unsigned char*) jlu->jlu_line_value;
+    std::string decoded;
+
+    for (const auto& jm : members) {
+        const intern_string_t field_name = intern_string::lookup(
+            jlu->jlu_line_value + jm.jm_key_begin,
+            jm.jm_key_end - jm.jm_key_begin);
+
+        switch (jm.jm_kind) {
+            case json_value_kind_t::string:
+                if (jm.jm_escaped) {
+                    decoded.clear();
+                    json_index::decode_string(
+                        jlu->jlu_line_value + jm.jm_value_begin,
+                        jm.jm_value_end - jm.jm_value_begin,
+                        decoded);
+                    rewrite_json_string(jlu,
+                                        field_name,
+                                        true,
+                                        (const unsigned char*) decoded.data(),
+                                        decoded.size());
+                } else {
+                    rewrite_json_string(jlu,
+                                        field_name,
+                                        true,
+                                        &line[jm.jm_value_begin],
+                                        jm.jm_value_end - jm.jm_value_begin);
+                }
+                break;
+            case json_value_kind_t::integer:
+                format->jlf_line_values.emplace_back(
+                    format->get_value_meta(field_name,
+                                           value_kind_t::VALUE_INTEGER),
+                    jm.jm_integer);
+                break;
+            case json_value_kind_t::floating:
+                format->jlf_line_values.emplace_back(
+                    format->get_value_meta(field_name,
+                                           value_kind_t::VALUE_FLOAT),
+                    jm.jm_floating);
+                break;
+            case json_value_kind_t::boolean_true:
+            case json_value_kind_t::boolean_false:
+                format->jlf_line_values.emplace_back(
+                    format->get_value_meta(field_name,
+                                           value_kind_t::VALUE_BOOLEAN),
+                    jm.jm_kind == json_value_kind_t::boolean_true);
+                break;
+            case json_value_kind_t::null:
+                format->jlf_line_values.emplace_back(format->get_value_meta(
+                    field_name, value_kind_t::VALUE_NULL));
+                break;
+            case json_value_kind_t::object:
+            case json_value_kind_t::array: {
+                shared_buffer_ref sbr;
+
+                sbr.subset(jlu->jlu_shared_buffer,
+                           jm.jm_value_begin,
+                           jm.jm_value_end - jm.jm_value_begin);
+                format->jlf_line_values.emplace_back(
+                    format->get_value_meta(field_name,
+                                           value_kind_t::VALUE_JSON),
+                    sbr);
+                break;
+            }
+        }
+    }
+}
+
+const std::vector<json_member>*
+external_log_format::index_json_line(file_off_t offset,
+                                     const char* line,
+                                     size_t len)
+{
+    json_index_cache_entry* victim = nullptr;
+
+    this->jlf_index_cache_counter += 1;
+    for (auto& entry : this->jlf_index_cache) {
+        if (entry.jice_offset == offset && entry.jice_line.size() == len
+            && memcmp(entry.jice_line.data(), line, len) == 0)
+        {
+            entry.jice_last_used = this->jlf_index_cache_counter;
+            return &entry.jice_members;
+        }
+        if (victim == nullptr
+            || entry.jice_last_used < victim->jice_last_used) {
+            victim = &entry;
+        }
+    }
+
+    if (!this->jlf_json_index.index(line, len)) {
+        return nullptr;
+    }
+
+    if (this->jlf_index_cache.size() < JSON_INDEX_CACHE_SIZE) {
+        this->jlf_index_cache.emplace_back();
+        victim = &this->jlf_index_cache.back();
+    }
+    victim->jice_offset = offset;
+    victim->jice_last_used = this->jlf_index_cache_counter;
+    victim->jice_line.assign(line, len);
+    victim->jice_members = this->jlf_json_index.members();
+
+    return &victim->jice_members;
+}
+
 void
 external_log_format::get_subline(const logline& ll,
                                  shared_buffer_ref& sbr,
@@ -1342,11 +1609,24 @@ external_log_format::get_subline(const logline& ll,
         jlu.jlu_handle = handle;
         jlu.jlu_line_value = sbr.get_data();
 
-        yajl_status parse_status = yajl_parse(
-            handle, (const unsigned char*) sbr.get_data(), sbr.length());
-        if (parse_status != yajl_status_ok
-            || yajl_complete_parse(handle) != yajl_status_ok)
-        {
+        const std::vector<json_member>* members = nullptr;
+        bool parsed;
+
+        if (this->jlf_index_scan) {
+            members = this->index_json_line(
+                ll.get_offset(), sbr.get_data(), sbr.length());
+        }
+        if (members != nullptr) {
+            rewrite_json_members(&jlu, *members);
+            parsed = true;
+        } else {
+            parsed = yajl_parse(handle,
+                                (const unsigned char*) sbr.get_data(),
+                                sbr.length())
+                    == yajl_status_ok
+                && yajl_complete_parse(handle) == yajl_status_ok;
+        }
+        if (!parsed) {
             unsigned char* msg;
             std::string full_msg;
 
@@ -1801,6 +2081,21 @@ external_log_format::build(std::vector<lnav::console::user_message>& errors)
                 yajl_handle_deleter());
             yajl_config(
                 this->jlf_yajl_handle.get(), yajl_dont_validate_strings, 1);
+
+            auto is_top_level = [](const intern_string_t& name) {
+                return strpbrk(name.get(), "/#") == nullptr;
+            };
+
+            this->jlf_index_scan = this->elf_level_pointer.empty()
+                && is_top_level(this->lf_timestamp_field)
+                && is_top_level(this->elf_level_field)
+                && is_top_level(this->elf_opid_field)
+                && is_top_level(this->elf_body_field);
+            for (const auto& vd : this->elf_value_defs) {
+                if (!is_top_level(vd.first)) {
+                    this->jlf_index_scan = false;
+                }
+            }
         }
 
     } else {
@@ -2344,8 +2639,13 @@ public:
                         &line.get_data()[mod_name_range.lr_start],
                         mod_name_range.length());
                     this->vi_attrs.clear();
-                    this->elt_module_format
-                        = external_log_format::MODULE_FORMATS[mod_name];
+                    {
+                        std::lock_guard<std::mutex> mod_lock(
+                            MODULE_FORMATS_MUTEX);
+
+                        this->elt_module_format
+                            = external_log_format::MODULE_FORMATS[mod_name];
+                    }
                     if (!this->elt_module_format.mf_mod_format) {
                         return false;
                     }
@@ -2361,6 +2661,7 @@ public:
     virtual void extract(std::shared_ptr<logfile> lf,
                          uint64_t line_number,
                          shared_buffer_ref& line,
+                         const column_usage& cu,
                          std::vector<logline_value>& values)
     {
         auto format = lf->get_format();
@@ -2381,6 +2682,17 @@ public:
         }
     };
 
+    intern_string_t get_numeric_value_name(int sub_col) const override
+    {
+        for (const auto& vd : this->elt_format.elf_numeric_value_defs) {
+            if (vd->vd_meta.lvm_column == sub_col) {
+                return vd->vd_meta.lvm_name;
+            }
+        }
+
+        return intern_string_t();
+    }
+
     const external_log_format& elt_format;
     module_format elt_module_format;
     struct line_range elt_container_body;
@@ -2421,6 +2733,19 @@ external_log_format::specialized(int fmt_lock)
     return retval;
 }
 
+void
+external_log_format::specialize_module_formats()
+{
+    std::map<int, std::shared_ptr<log_format>> mod_formats;
+
+    for (size_t lpc = 0; lpc < this->elf_pattern_order.size(); lpc++) {
+        if (this->elf_pattern_order[lpc]->p_module_format) {
+            mod_formats[lpc] = this->specialized(lpc);
+        }
+    }
+    this->elf_module_formats = std::move(mod_formats);
+}
+
 bool
 external_log_format::match_name(const std::string& filename)
 {
@@ -2444,6 +2769,27 @@ external_log_format::match_mime_type(const file_format_t ff) const
     return this->elf_mime_types.count(ff) == 1;
 }
 
+bool
+external_log_format::may_match(const literal_set::match_set& found) const
+{
+    if (this->elf_type != elf_type_t::ELF_TYPE_TEXT
+        || !this->elf_has_literal_ids)
+    {
+        return true;
+    }
+
+    for (const auto& pat : this->elf_pattern_order) {
+        if (pat->p_module_format) {
+            continue;
+        }
+        if (found.contains_all(pat->p_literal_ids)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 int
 log_format::pattern_index_for_line(uint64_t line_number) const
 {
@@ -36,6 +36,7 @@
 #include <sys/time.h>
 #include <time.h>
 #define __STDC_FORMAT_MACROS
+#include <functional>
 #include <limits>
 #include <list>
 #include <memory>
@@ -50,6 +51,7 @@
 
 #include "base/date_time_scanner.hh"
 #include "base/intern_string.hh"
+#include "base/literal_set.hh"
 #include "base/lnav_log.hh"
 #include "byte_array.hh"
 #include "file_format.hh"
@@ -57,6 +59,7 @@
 #include "line_buffer.hh"
 #include "log_format_fwd.hh"
 #include "log_level.hh"
+#include "logline_store.hh"
 #include "optional.hpp"
 #include "pcrepp/pcrepp.hh"
 #include "shared_buffer.hh"
@@ -316,6 +319,13 @@ public:
      */
     static std::vector<std::shared_ptr<log_format>>& get_root_formats();
 
+    /**
+     * @return The literal strings from the patterns of the root formats that
+     * are used to narrow down the formats to try when detecting the format
+     * of a file.  See may_match().
+     */
+    static literal_set& get_detection_literals();
+
     static std::shared_ptr<log_format> find_root_format(const char* name)
     {
         auto& fmts = get_root_formats();
@@ -369,6 +379,20 @@ public:
         return false;
     };
 
+    /**
+     * Check whether this format could match a line based on the detection
+     * literals that were found in it.  This is a cheap test that is done
+     * before scan() when detecting the format of a file.
+     *
+     * @param found The literals from get_detection_literals() that are in
+     *   the line.
+     * @return False if scan() would not match the line.
+     */
+    virtual bool may_match(const literal_set::match_set& found) const
+    {
+        return true;
+    }
+
     enum scan_result_t {
         SCAN_MATCH,
         SCAN_NO_MATCH,
@@ -385,11 +409,29 @@ public:
      * @param len The length of the prefix string.
      */
     virtual scan_result_t scan(logfile& lf,
-                               std::vector<logline>& dst,
+                               logline_store& dst,
                                const line_info& li,
                                shared_buffer_ref& sbr)
         = 0;
 
+    using scan_batch_callback_t = std::function<void(
+        const line_info& li, shared_buffer_ref& sbr, scan_result_t found)>;
+
+    /**
+     * Scan a span of lines that were read from the file together.  The
+     * default implementation calls scan() for each line in turn.  Formats
+     * that can do better by looking at many lines at once can override it.
+     *
+     * @param dst The vector of loglines that the formatter should append to.
+     * @param span The lines to scan.
+     * @param callback Called after each line is scanned so that the caller
+     *   can finish indexing the line before the next one is scanned.
+     */
+    virtual void scan_batch(logfile& lf,
+                            logline_store& dst,
+                            line_span& span,
+                            const scan_batch_callback_t& callback);
+
     virtual bool scan_for_partial(shared_buffer_ref& sbr, size_t& len_out) const
     {
         return false;
@@ -436,6 +478,12 @@ public:
                              shared_buffer_ref& sbr,
                              bool full_message = false){};
 
+    /** @return True if get_subline() replaces the text read from the file. */
+    virtual bool has_sublines() const
+    {
+        return false;
+    }
+
     virtual const std::vector<std::string>* get_actions(
         const logline_value& lv) const
     {
@@ -465,7 +513,7 @@ public:
         return &this->lf_timestamp_format[0];
     };
 
-    void check_for_new_year(std::vector<logline>& dst,
+    void check_for_new_year(logline_store& dst,
                             exttm log_tv,
                             timeval timeval1);
 
@@ -507,6 +555,8 @@ public:
     bool lf_is_self_describing{false};
     bool lf_time_ordered{true};
     bool lf_specialized{false};
+    /** The number of times check_for_new_year() adjusted earlier lines. */
+    uint32_t lf_rollover_count{0};
 
 protected:
     static std::vector<std::shared_ptr<log_format>> lf_root_formats;
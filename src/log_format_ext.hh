@@ -34,6 +34,7 @@
 
 #include <unordered_map>
 
+#include "base/json_index.hh"
 #include "log_format.hh"
 #include "yajlpp/yajlpp.hh"
 
@@ -99,6 +100,11 @@ public:
         int p_body_field_index{-1};
         int p_timestamp_end{-1};
         bool p_module_format{false};
+        /**
+         * The IDs of the detection literals that must be in a line for this
+         * pattern to match it.
+         */
+        std::vector<size_t> p_literal_ids;
     };
 
     struct level_pattern {
@@ -132,8 +138,10 @@ public:
 
     bool match_mime_type(const file_format_t ff) const;
 
+    bool may_match(const literal_set::match_set& found) const;
+
     scan_result_t scan(logfile& lf,
-                       std::vector<logline>& dst,
+                       logline_store& dst,
                        const line_info& offset,
                        shared_buffer_ref& sbr);
 
@@ -171,6 +179,12 @@ public:
 
     std::shared_ptr<log_format> specialized(int fmt_lock);
 
+    /**
+     * Create the specialized formats that are used for the modules that
+     * match this format's module-format patterns.
+     */
+    void specialize_module_formats();
+
     const logline_value_stats* stats_for_value(
         const intern_string_t& name) const
     {
@@ -192,6 +206,11 @@ public:
                      shared_buffer_ref& sbr,
                      bool full_message);
 
+    bool has_sublines() const
+    {
+        return this->elf_type != elf_type_t::ELF_TYPE_TEXT;
+    }
+
     std::shared_ptr<log_vtab_impl> get_vtab_impl() const;
 
     const std::vector<std::string>* get_actions(const logline_value& lv) const
@@ -281,10 +300,21 @@ public:
                           const unsigned char* str = nullptr,
                           ssize_t len = -1) const
     {
-        const auto iter = this->elf_value_defs.find(ist);
         long line_count
             = (str != NULL) ? std::count(&str[0], &str[len], '\n') + 1 : 1;
 
+        return this->value_line_count(ist, top_level, line_count);
+    };
+
+    /**
+     * Same as above, but for a value whose number of lines is already known.
+     */
+    long value_line_count(const intern_string_t ist,
+                          bool top_level,
+                          long line_count) const
+    {
+        const auto iter = this->elf_value_defs.find(ist);
+
         if (iter == this->elf_value_defs.end()) {
             return (this->jlf_hide_extra || !top_level) ? 0 : line_count;
         }
@@ -369,6 +399,11 @@ public:
     std::shared_ptr<pcrepp> elf_filename_pcre;
     std::map<std::string, std::shared_ptr<pattern>> elf_patterns;
     std::vector<std::shared_ptr<pattern>> elf_pattern_order;
+    /**
+     * True if the p_literal_ids for the patterns have been filled in by
+     * register_detection_literals().
+     */
+    bool elf_has_literal_ids{false};
     std::vector<sample> elf_samples;
     std::unordered_map<const intern_string_t, std::shared_ptr<value_def>>
         elf_value_defs;
@@ -385,6 +420,13 @@ public:
     std::vector<std::pair<int64_t, log_level_t>> elf_level_pairs;
     bool elf_container{false};
     bool elf_has_module_format{false};
+    /**
+     * The formats used for modules, by the index of the module-format
+     * pattern that matched.  These are made when the formats are loaded
+     * since files can be scanned on other threads while the main thread is
+     * using the root formats.
+     */
+    std::map<int, std::shared_ptr<log_format>> elf_module_formats;
     bool elf_builtin_format{false};
 
     struct search_table_def {
@@ -473,7 +515,42 @@ public:
     std::shared_ptr<yajlpp_parse_context> jlf_parse_context;
     std::shared_ptr<yajl_handle_t> jlf_yajl_handle;
 
+    /**
+     * True if the members of the top-level object are all that is needed to
+     * scan and render a line, so the structural index can be used instead of
+     * yajl.  If a field or value is nested, yajl has to be used to get the
+     * same results.
+     */
+    bool jlf_index_scan{false};
+    json_index jlf_json_index;
+
+    struct json_index_cache_entry {
+        file_off_t jice_offset{-1};
+        uint64_t jice_last_used{0};
+        std::string jice_line;
+        std::vector<json_member> jice_members;
+    };
+
+    static constexpr size_t JSON_INDEX_CACHE_SIZE = 64;
+
+    /**
+     * The structural indexes for the most recently rendered lines, so that
+     * redrawing the view does not need to reindex each line.
+     */
+    std::vector<json_index_cache_entry> jlf_index_cache;
+    uint64_t jlf_index_cache_counter{0};
+
 private:
+    /**
+     * Get the structural index for a JSON line from the cache or build it.
+     *
+     * @return The members of the top-level object or nullptr if the line
+     *   needs to be parsed by yajl.
+     */
+    const std::vector<json_member>* index_json_line(file_off_t offset,
+                                                    const char* line,
+                                                    size_t len);
+
     const intern_string_t elf_name;
 
     static uint8_t module_scan(const pcre_input& pi,
@@ -331,6 +331,8 @@ public:
     };
 
 private:
+    friend class logline_store;
+
     file_off_t ll_offset;
     time_t ll_time;
     unsigned int ll_millis : 10;
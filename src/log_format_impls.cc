@@ -158,7 +158,7 @@ class generic_log_format : public log_format {
     };
 
     scan_result_t scan(logfile& lf,
-                       std::vector<logline>& dst,
+                       logline_store& dst,
                        const line_info& li,
                        shared_buffer_ref& sbr) override
     {
@@ -436,7 +436,7 @@ public:
         this->blf_field_defs.clear();
     };
 
-    scan_result_t scan_int(std::vector<logline>& dst,
+    scan_result_t scan_int(logline_store& dst,
                            const line_info& li,
                            shared_buffer_ref& sbr)
     {
@@ -515,7 +515,7 @@ public:
     }
 
     scan_result_t scan(logfile& lf,
-                       std::vector<logline>& dst,
+                       logline_store& dst,
                        const line_info& li,
                        shared_buffer_ref& sbr) override
     {
@@ -999,7 +999,7 @@ public:
         this->wlf_field_defs.clear();
     };
 
-    scan_result_t scan_int(std::vector<logline>& dst,
+    scan_result_t scan_int(logline_store& dst,
                            const line_info& li,
                            shared_buffer_ref& sbr)
     {
@@ -1121,7 +1121,7 @@ public:
     }
 
     scan_result_t scan(logfile& lf,
-                       std::vector<logline>& dst,
+                       logline_store& dst,
                        const line_info& li,
                        shared_buffer_ref& sbr) override
     {
@@ -1581,7 +1581,7 @@ public:
     }
 
     scan_result_t scan(logfile& lf,
-                       std::vector<logline>& dst,
+                       logline_store& dst,
                        const line_info& li,
                        shared_buffer_ref& sbr) override
     {
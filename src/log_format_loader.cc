@@ -52,6 +52,7 @@
 #include "file_format.hh"
 #include "fmt/format.h"
 #include "lnav_config.hh"
+#include "lnav_util.hh"
 #include "log_format_ext.hh"
 #include "sql_util.hh"
 #include "yajlpp/yajlpp.hh"
@@ -66,6 +67,15 @@ using log_formats_map_t
 
 static auto intern_lifetime = intern_string::get_table_lifetime();
 static log_formats_map_t LOG_FORMATS;
+static std::string FORMAT_DEFINITIONS_ID;
+
+static hasher&
+definitions_hasher()
+{
+    static hasher retval;
+
+    return retval;
+}
 
 struct userdata {
     yajlpp_parse_context* ud_parse_context{nullptr};
@@ -905,6 +915,7 @@ write_sample_file()
             / fmt::format(FMT_STRING("formats/default/{}.sample"),
                           bsf.get_name());
         auto sf = bsf.to_string_fragment();
+        definitions_hasher().update(sf);
         auto_fd sample_fd;
 
         if ((sample_fd = lnav::filesystem::openp(
@@ -1023,6 +1034,7 @@ load_format_file(const ghc::filesystem::path& filename,
                 // Turn it into a JavaScript comment.
                 buffer[0] = buffer[1] = '/';
             }
+            definitions_hasher().update(buffer, rc);
             if (ypc.parse((const unsigned char*) buffer, rc) != yajl_status_ok)
             {
                 break;
@@ -1069,6 +1081,44 @@ load_from_path(const ghc::filesystem::path& path,
     }
 }
 
+/**
+ * Collect the literals that are required by the patterns of the text formats
+ * into a single set so that a line only needs to be searched once to rule
+ * out most of the formats during detection.
+ */
+static void
+register_detection_literals(
+    const std::vector<std::shared_ptr<external_log_format>>& formats)
+{
+    auto& literals = log_format::get_detection_literals();
+
+    literals.clear();
+    for (const auto& elf : formats) {
+        for (auto& pat : elf->elf_pattern_order) {
+            auto& ids = pat->p_literal_ids;
+
+            ids.clear();
+            if (elf->elf_type != external_log_format::elf_type_t::ELF_TYPE_TEXT
+                || pat->p_module_format)
+            {
+                continue;
+            }
+
+            for (const auto& lit : pat->p_pcre->required_literals()) {
+                auto id = literals.add(lit);
+
+                if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+                    ids.emplace_back(id);
+                }
+            }
+        }
+        elf->elf_has_literal_ids = true;
+    }
+    literals.compile();
+
+    log_info("format detection literals: %zu", literals.size());
+}
+
 void
 load_formats(const std::vector<ghc::filesystem::path>& extra_paths,
              std::vector<lnav::console::user_message>& errors)
@@ -1112,6 +1162,7 @@ load_formats(const std::vector<ghc::filesystem::path>& extra_paths,
     for (const auto& extra_path : extra_paths) {
         load_from_path(extra_path, errors);
     }
+    FORMAT_DEFINITIONS_ID = definitions_hasher().to_string();
 
     uint8_t mod_counter = 0;
 
@@ -1201,12 +1252,26 @@ load_formats(const std::vector<ghc::filesystem::path>& extra_paths,
         log_info("  %s", graph_ordered_format->get_name().get());
     }
 
+    for (auto& graph_ordered_format : graph_ordered_formats) {
+        if (graph_ordered_format->elf_has_module_format) {
+            graph_ordered_format->specialize_module_formats();
+        }
+    }
+
     auto& roots = log_format::get_root_formats();
     auto iter = std::find_if(roots.begin(), roots.end(), [](const auto& elem) {
         return elem->get_name() == "generic_log";
     });
     roots.insert(
         iter, graph_ordered_formats.begin(), graph_ordered_formats.end());
+
+    register_detection_literals(graph_ordered_formats);
+}
+
+const std::string&
+format_definitions_id()
+{
+    return FORMAT_DEFINITIONS_ID;
 }
 
 static void
@@ -50,6 +50,12 @@ std::vector<intern_string_t> load_format_file(
 void load_formats(const std::vector<ghc::filesystem::path>& extra_paths,
                   std::vector<lnav::console::user_message>& errors);
 
+/**
+ * @return An identifier for the content of the format definitions that were
+ * loaded by load_formats() or an empty string if no formats were loaded.
+ */
+const std::string& format_definitions_id();
+
 void load_format_vtabs(log_vtab_manager* vtab_manager,
                        std::vector<lnav::console::user_message>& errors);
 
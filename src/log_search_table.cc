@@ -106,7 +106,7 @@ log_search_table::next(log_cursor& lc, logfile_sub_source& lss)
     lc.lc_curr_line = lc.lc_curr_line + 1_vl;
     lc.lc_sub_index = 0;
 
-    if (lc.lc_curr_line == (int) lss.text_line_count()) {
+    if (lc.is_eof()) {
         return true;
     }
 
@@ -140,6 +140,7 @@ void
 log_search_table::extract(std::shared_ptr<logfile> lf,
                           uint64_t line_number,
                           shared_buffer_ref& line,
+                          const column_usage& cu,
                           std::vector<logline_value>& values)
 {
     values.emplace_back(instance_meta, this->lst_instance);
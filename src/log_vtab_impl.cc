@@ -31,6 +31,7 @@
 
 #include "base/lnav_log.hh"
 #include "base/string_util.hh"
+#include "base/strnatcmp.h"
 #include "config.h"
 #include "lnav_util.hh"
 #include "logfile_sub_source.hh"
@@ -176,11 +177,93 @@ struct vtab {
     std::shared_ptr<log_vtab_impl> vi;
 };
 
+static constexpr uint32_t ALL_LEVELS_MASK = (1UL << LEVEL__MAX) - 1;
+
 struct vtab_cursor {
     sqlite3_vtab_cursor base;
     struct log_cursor log_cursor;
     shared_buffer_ref log_msg;
+    /**
+     * The values extracted from the current line.  The vector is cleared,
+     * not freed, when the cursor moves so the storage is reused by every
+     * row in the scan.
+     */
     std::vector<logline_value> line_values;
+    /** True if line_values holds the values for the current line. */
+    bool line_values_valid{false};
+    /** The columns referenced by the query, from the index plan. */
+    column_usage columns_used;
+    /**
+     * If not empty, all of the format values used by the query are numeric
+     * and can be read from the value index of the files.  Indexed by the
+     * column number of the value.
+     */
+    std::vector<intern_string_t> indexed_value_names;
+    /** Bit N is set if lines with level N can satisfy the query. */
+    uint32_t level_mask{ALL_LEVELS_MASK};
+    /** The mark state that lines need to have to satisfy the query. */
+    nonstd::optional<bool> marked;
+    /**
+     * Indexed by the position of a file in the logfile_sub_source.  If not
+     * empty, only lines from files with a true entry can satisfy the query.
+     */
+    std::vector<bool> file_mask;
+
+    bool has_line_constraints() const
+    {
+        return this->level_mask != ALL_LEVELS_MASK || this->marked
+            || !this->file_mask.empty();
+    }
+
+    /**
+     * Check the constraints that can be evaluated using only the logline
+     * for the given line, without reading the message from the file.
+     */
+    bool line_matches(logfile_sub_source& lss, vis_line_t vl) const
+    {
+        content_line_t cl = lss.at(vl);
+        uint64_t line_number;
+        auto ld_iter = lss.find_data(cl, line_number);
+
+        if (!this->file_mask.empty()
+            && !this->file_mask[std::distance(lss.begin(), ld_iter)])
+        {
+            return false;
+        }
+
+        auto ll = (*ld_iter)->get_file_ptr()->begin() + line_number;
+
+        if (!(this->level_mask & (1UL << ll->get_msg_level()))) {
+            return false;
+        }
+        if (this->marked && ll->is_marked() != this->marked.value()) {
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Read the message for the current line and extract the values for the
+     * columns used by the query, unless that was already done for this line.
+     */
+    void ensure_line_values(log_vtab_impl& vi,
+                            std::shared_ptr<logfile> lf,
+                            logfile::iterator ll,
+                            uint64_t line_number)
+    {
+        if (this->line_values_valid) {
+            return;
+        }
+
+        lf->read_full_message(ll, this->log_msg);
+        vi.extract(lf,
+                   line_number,
+                   this->log_msg,
+                   this->columns_used,
+                   this->line_values);
+        this->line_values_valid = true;
+    }
 };
 
 static int vt_destructor(sqlite3_vtab* p_svt);
@@ -300,6 +383,7 @@ vt_next(sqlite3_vtab_cursor* cur)
     bool done = false;
 
     vc->line_values.clear();
+    vc->line_values_valid = false;
     do {
         log_cursor_latest = vc->log_cursor;
         if (((log_cursor_latest.lc_curr_line % 1024) == 0)
@@ -308,12 +392,66 @@ vt_next(sqlite3_vtab_cursor* cur)
         {
             break;
         }
+        if (vc->has_line_constraints()) {
+            // Skip the lines that cannot satisfy the query before handing
+            // the cursor to the implementation, which might need to read
+            // and parse each line that it looks at.
+            while (vc->log_cursor.lc_curr_line + 1_vl
+                       < vc->log_cursor.lc_end_line
+                   && !vc->line_matches(*vt->lss,
+                                        vc->log_cursor.lc_curr_line + 1_vl))
+            {
+                vc->log_cursor.lc_curr_line += 1_vl;
+            }
+        }
         done = vt->vi->next(vc->log_cursor, *vt->lss);
     } while (!done);
 
     return SQLITE_OK;
 }
 
+/**
+ * Try to answer a column for a numeric format value using the value index
+ * of the file instead of reading and annotating the message.
+ *
+ * @return True if the result was set.
+ */
+static bool
+result_from_value_index(sqlite3_context* ctx,
+                        vtab* vt,
+                        vtab_cursor* vc,
+                        logfile& lf,
+                        uint64_t line_number,
+                        size_t sub_col)
+{
+    if (vc->line_values_valid || sub_col >= vc->indexed_value_names.size()
+        || lf.get_format_name() != vt->vi->get_name())
+    {
+        return false;
+    }
+
+    if (!lf.index_values_to(line_number)) {
+        return false;
+    }
+
+    const auto* val_col
+        = lf.get_value_column(vc->indexed_value_names[sub_col]);
+    if (val_col == nullptr) {
+        return false;
+    }
+
+    const auto* val = val_col->value_for(line_number);
+    if (val == nullptr) {
+        sqlite3_result_null(ctx);
+    } else if (val_col->lvc_integer) {
+        sqlite3_result_int64(ctx, val->i);
+    } else {
+        sqlite3_result_double(ctx, val->d);
+    }
+
+    return true;
+}
+
 static int
 vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
 {
@@ -380,11 +518,7 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
             char buffer[64];
 
             if (ll->is_time_skewed()) {
-                if (vc->line_values.empty()) {
-                    lf->read_full_message(ll, vc->log_msg);
-                    vt->vi->extract(
-                        lf, line_number, vc->log_msg, vc->line_values);
-                }
+                vc->ensure_line_values(*vt->vi, lf, ll, line_number);
 
                 struct line_range time_range;
 
@@ -491,10 +625,11 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
         }
 
         case VT_COL_FILTERS: {
-            auto& filter_mask
-                = (*ld)->ld_filter_state.lfo_filter_state.tfs_mask;
+            auto filter_mask
+                = (*ld)->ld_filter_state.lfo_filter_state.line_mask(
+                    line_number);
 
-            if (!filter_mask[line_number]) {
+            if (!filter_mask) {
                 sqlite3_result_null(ctx);
             } else {
                 auto& filters = vt->lss->get_filters();
@@ -512,7 +647,7 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
 
                         uint32_t mask = (1UL << filter->get_index());
 
-                        if (filter_mask[line_number] & mask) {
+                        if (filter_mask & mask) {
                             arr.gen(filter->get_index());
                         }
                     }
@@ -552,11 +687,7 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
                         break;
                     }
                     case 3: {
-                        if (vc->line_values.empty()) {
-                            lf->read_full_message(ll, vc->log_msg);
-                            vt->vi->extract(
-                                lf, line_number, vc->log_msg, vc->line_values);
-                        }
+                        vc->ensure_line_values(*vt->vi, lf, ll, line_number);
 
                         struct line_range body_range;
 
@@ -595,13 +726,16 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
                     }
                 }
             } else {
-                if (vc->line_values.empty()) {
-                    lf->read_full_message(ll, vc->log_msg);
-                    vt->vi->extract(
-                        lf, line_number, vc->log_msg, vc->line_values);
+                size_t sub_col = col - VT_COL_MAX;
+
+                if (result_from_value_index(
+                        ctx, vt, vc, *lf, line_number, sub_col))
+                {
+                    break;
                 }
 
-                size_t sub_col = col - VT_COL_MAX;
+                vc->ensure_line_values(*vt->vi, lf, ll, line_number);
+
                 std::vector<logline_value>::iterator lv_iter;
 
                 lv_iter = find_if(vc->line_values.begin(),
@@ -799,26 +933,166 @@ log_cursor::update(unsigned char op, vis_line_t vl, bool exact)
     }
     switch (op) {
         case SQLITE_INDEX_CONSTRAINT_EQ:
-            if (vl < this->lc_end_line) {
+            if (this->lc_curr_line <= vl && vl < this->lc_end_line) {
                 this->lc_curr_line = vl;
                 this->lc_end_line = vis_line_t(this->lc_curr_line + 1);
+            } else {
+                this->lc_curr_line = this->lc_end_line;
             }
             break;
         case SQLITE_INDEX_CONSTRAINT_GE:
-            this->lc_curr_line = vl;
+            this->lc_curr_line = std::max(this->lc_curr_line, vl);
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GT:
+            this->lc_curr_line = std::max(this->lc_curr_line,
+                                          vis_line_t(vl + (exact ? 1 : 0)));
+            break;
+        case SQLITE_INDEX_CONSTRAINT_LE:
+            this->lc_end_line = std::min(this->lc_end_line,
+                                         vis_line_t(vl + (exact ? 1 : 0)));
+            break;
+        case SQLITE_INDEX_CONSTRAINT_LT:
+            this->lc_end_line = std::min(this->lc_end_line, vl);
+            break;
+    }
+}
+
+/**
+ * Narrow the cursor to the lines whose time satisfies a constraint.  The
+ * lines in the view are in time order, so the bounds can be found with a
+ * binary search.
+ */
+static void
+update_from_time(log_cursor& lc,
+                 logfile_sub_source& lss,
+                 unsigned char op,
+                 struct timeval tv)
+{
+    // Line times are kept to the millisecond, so the lines that come after
+    // the given time start at the next millisecond.
+    struct timeval next_ms = tv;
+
+    next_ms.tv_usec = (tv.tv_usec / 1000 + 1) * 1000;
+    if (next_ms.tv_usec >= 1000000) {
+        next_ms.tv_sec += 1;
+        next_ms.tv_usec -= 1000000;
+    }
+
+    auto first_line_at = [&lss](const struct timeval& bound) {
+        return lss.find_from_time(bound).value_or(
+            vis_line_t(lss.text_line_count()));
+    };
+
+    switch (op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ:
+            lc.update(SQLITE_INDEX_CONSTRAINT_GE, first_line_at(tv));
+            lc.update(SQLITE_INDEX_CONSTRAINT_LT, first_line_at(next_ms));
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GE:
+            lc.update(SQLITE_INDEX_CONSTRAINT_GE, first_line_at(tv));
             break;
         case SQLITE_INDEX_CONSTRAINT_GT:
-            this->lc_curr_line = vis_line_t(vl + (exact ? 1 : 0));
+            lc.update(SQLITE_INDEX_CONSTRAINT_GE, first_line_at(next_ms));
             break;
         case SQLITE_INDEX_CONSTRAINT_LE:
-            this->lc_end_line = vis_line_t(vl + (exact ? 1 : 0));
+            lc.update(SQLITE_INDEX_CONSTRAINT_LT, first_line_at(next_ms));
             break;
         case SQLITE_INDEX_CONSTRAINT_LT:
-            this->lc_end_line = vl;
+            lc.update(SQLITE_INDEX_CONSTRAINT_LT, first_line_at(tv));
             break;
     }
 }
 
+/**
+ * Convert a log_time constraint value into a timeval.  The value is only
+ * used if it is a prefix of the timestamp format used by the log_time
+ * column so that comparing the strings gives the same answer as comparing
+ * the times.
+ */
+static nonstd::optional<struct timeval>
+log_time_constraint_value(sqlite3_value* val)
+{
+    if (sqlite3_value_type(val) != SQLITE3_TEXT) {
+        return nonstd::nullopt;
+    }
+
+    const auto* datestr = (const char*) sqlite3_value_text(val);
+    auto datelen = strlen(datestr);
+    date_time_scanner dts;
+    struct timeval tv;
+    struct exttm mytm;
+
+    if (dts.scan(datestr, datelen, nullptr, &mytm, tv) == nullptr) {
+        return nonstd::nullopt;
+    }
+
+    char buffer[64];
+    auto len = sql_strftime(buffer, sizeof(buffer), tv);
+
+    if (len < 0 || datelen > (size_t) len
+        || strncmp(buffer, datestr, datelen) != 0)
+    {
+        return nonstd::nullopt;
+    }
+
+    return tv;
+}
+
+/**
+ * @return The mask of levels that satisfy a comparison against the given
+ * level using the "loglevel" collation.
+ */
+static uint32_t
+level_mask_for(unsigned char op, log_level_t level)
+{
+    uint32_t retval = 0;
+
+    for (int lpc = 0; lpc < LEVEL__MAX; lpc++) {
+        bool matches = false;
+
+        switch (op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ:
+                matches = lpc == level;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_GE:
+                matches = lpc >= level;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_GT:
+                matches = lpc > level;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_LE:
+                matches = lpc <= level;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_LT:
+                matches = lpc < level;
+                break;
+            default:
+                matches = true;
+                break;
+        }
+        if (matches) {
+            retval |= (1UL << lpc);
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * The plan picked by vt_best_index() that is passed to vt_filter() through
+ * idxStr.  The constraints that were used follow the header and the number
+ * of them is passed in idxNum.
+ */
+struct vtab_index_plan {
+    column_usage vip_columns_used;
+
+    const sqlite3_index_info::sqlite3_index_constraint* constraints() const
+    {
+        return reinterpret_cast<
+            const sqlite3_index_info::sqlite3_index_constraint*>(this + 1);
+    }
+};
+
 static int
 vt_filter(sqlite3_vtab_cursor* p_vtc,
           int idxNum,
@@ -828,56 +1102,193 @@ vt_filter(sqlite3_vtab_cursor* p_vtc,
 {
     vtab_cursor* p_cur = (vtab_cursor*) p_vtc;
     vtab* vt = (vtab*) p_vtc->pVtab;
-    sqlite3_index_info::sqlite3_index_constraint* index
-        = (sqlite3_index_info::sqlite3_index_constraint*) idxStr;
+    const auto* plan = (const vtab_index_plan*) idxStr;
+    const auto* index = plan == nullptr ? nullptr : plan->constraints();
+    const int time_msecs_col = VT_COL_MAX + vt->vi->vi_column_count;
+    const int path_col = time_msecs_col + 1;
+    const int body_col = vt->vi->get_body_column();
 
     log_info("(%p) filter called: %d", vt, idxNum);
     p_cur->log_cursor.lc_curr_line = -1_vl;
     p_cur->log_cursor.lc_end_line = vis_line_t(vt->lss->text_line_count());
+    p_cur->level_mask = ALL_LEVELS_MASK;
+    p_cur->marked = nonstd::nullopt;
+    p_cur->file_mask.clear();
+    p_cur->columns_used
+        = plan == nullptr ? column_usage{} : plan->vip_columns_used;
+    p_cur->indexed_value_names.clear();
+    if (!p_cur->columns_used.is_used(VT_COL_LOG_ACTUAL_TIME)
+        && !p_cur->columns_used.is_used(body_col))
+    {
+        // Reading the values from the index only pays off if the messages
+        // do not need to be extracted for any of the other columns.
+        for (int sub_col = 0; sub_col < vt->vi->vi_column_count; sub_col++) {
+            if (!p_cur->columns_used.is_value_used(sub_col)) {
+                p_cur->indexed_value_names.emplace_back();
+                continue;
+            }
+
+            auto name = vt->vi->get_numeric_value_name(sub_col);
+            if (name.empty()) {
+                p_cur->indexed_value_names.clear();
+                break;
+            }
+            p_cur->indexed_value_names.emplace_back(name);
+        }
+    }
+
+    // Collect the constraints that vt_next() can check using just the
+    // logline so it can skip the lines that do not match.
+    for (int lpc = 0; lpc < idxNum; lpc++) {
+        if (index[lpc].iColumn == VT_COL_LEVEL) {
+            if (sqlite3_value_type(argv[lpc]) != SQLITE3_TEXT) {
+                continue;
+            }
+
+            const auto* level_name
+                = (const char*) sqlite3_value_text(argv[lpc]);
+            auto level = abbrev2level(level_name, strlen(level_name));
+
+            p_cur->level_mask &= level_mask_for(index[lpc].op, level);
+        } else if (index[lpc].iColumn == VT_COL_MARK) {
+            if (sqlite3_value_numeric_type(argv[lpc]) != SQLITE_INTEGER) {
+                continue;
+            }
+
+            auto mark_value = sqlite3_value_int64(argv[lpc]);
+
+            if (mark_value != 0 && mark_value != 1) {
+                p_cur->log_cursor.set_eof();
+                return SQLITE_OK;
+            }
+            if (p_cur->marked && p_cur->marked.value() != (mark_value == 1)) {
+                p_cur->log_cursor.set_eof();
+                return SQLITE_OK;
+            }
+            p_cur->marked = mark_value == 1;
+        } else if (index[lpc].iColumn == path_col) {
+            if (sqlite3_value_type(argv[lpc]) != SQLITE3_TEXT) {
+                continue;
+            }
+
+            const auto* path = (const char*) sqlite3_value_text(argv[lpc]);
+            auto path_len = strlen(path);
+            size_t file_index = 0;
+
+            p_cur->file_mask.resize(
+                std::distance(vt->lss->begin(), vt->lss->end()), true);
+            for (const auto& ld : *vt->lss) {
+                auto* lf = ld->get_file_ptr();
+
+                if (lf == nullptr
+                    || strnatcasecmp(lf->get_filename().size(),
+                                     lf->get_filename().c_str(),
+                                     path_len,
+                                     path)
+                        != 0)
+                {
+                    p_cur->file_mask[file_index] = false;
+                }
+                file_index += 1;
+            }
+        }
+    }
+    if (p_cur->level_mask == 0) {
+        p_cur->log_cursor.set_eof();
+        return SQLITE_OK;
+    }
+
     vt_next(p_vtc);
 
     if (!idxNum) {
         return SQLITE_OK;
     }
 
+    auto first_line = p_cur->log_cursor.lc_curr_line;
     for (int lpc = 0; lpc < idxNum; lpc++) {
-        switch (index[lpc].iColumn) {
-            case VT_COL_LINE_NUMBER:
-                p_cur->log_cursor.update(
-                    index[lpc].op, vis_line_t(sqlite3_value_int64(argv[lpc])));
-                break;
+        if (index[lpc].iColumn == VT_COL_LINE_NUMBER) {
+            p_cur->log_cursor.update(
+                index[lpc].op, vis_line_t(sqlite3_value_int64(argv[lpc])));
+        } else if (index[lpc].iColumn == VT_COL_LOG_TIME) {
+            auto tv_opt = log_time_constraint_value(argv[lpc]);
+
+            if (tv_opt) {
+                update_from_time(
+                    p_cur->log_cursor, *vt->lss, index[lpc].op, tv_opt.value());
+            }
+        } else if (index[lpc].iColumn == time_msecs_col) {
+            if (sqlite3_value_numeric_type(argv[lpc]) != SQLITE_INTEGER) {
+                continue;
+            }
 
-            case VT_COL_LOG_TIME:
-                if (sqlite3_value_type(argv[lpc]) == SQLITE3_TEXT) {
-                    const unsigned char* datestr
-                        = sqlite3_value_text(argv[lpc]);
-                    date_time_scanner dts;
-                    struct timeval tv;
-                    struct exttm mytm;
-
-                    dts.scan((const char*) datestr,
-                             strlen((const char*) datestr),
-                             NULL,
-                             &mytm,
-                             tv);
-                    auto vl_opt = vt->lss->find_from_time(tv);
-                    if (!vl_opt) {
-                        p_cur->log_cursor.lc_curr_line
-                            = p_cur->log_cursor.lc_end_line;
-                    } else {
-                        p_cur->log_cursor.update(
-                            index[lpc].op, vl_opt.value(), false);
-                    }
-                }
-                break;
+            auto msecs = sqlite3_value_int64(argv[lpc]);
+            struct timeval tv;
+
+            tv.tv_sec = msecs / 1000;
+            tv.tv_usec = (msecs % 1000) * 1000;
+            if (tv.tv_usec < 0) {
+                tv.tv_sec -= 1;
+                tv.tv_usec += 1000000;
+            }
+            update_from_time(p_cur->log_cursor, *vt->lss, index[lpc].op, tv);
         }
     }
 
-    while (!p_cur->log_cursor.is_eof()
-           && !vt->vi->is_valid(p_cur->log_cursor, *vt->lss))
+    // If the start of the range moved, find the first line from there that
+    // the implementation accepts.
+    if (p_cur->log_cursor.lc_curr_line > first_line
+        && !p_cur->log_cursor.is_eof())
     {
-        p_cur->log_cursor.lc_curr_line += 1_vl;
+        p_cur->log_cursor.lc_curr_line -= 1_vl;
+        vt_next(p_vtc);
+    }
+
+    return SQLITE_OK;
+}
+
+static bool
+is_range_op(unsigned char op)
+{
+    switch (op) {
+        case SQLITE_INDEX_CONSTRAINT_GT:
+        case SQLITE_INDEX_CONSTRAINT_LE:
+        case SQLITE_INDEX_CONSTRAINT_LT:
+        case SQLITE_INDEX_CONSTRAINT_GE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Store the plan for the chosen constraints in the index info so that
+ * vt_filter() can apply them.  The plan is always passed, even if there
+ * are no constraints, so the cursor knows which columns need to be
+ * extracted from the messages.
+ */
+static int
+set_index_plan(
+    sqlite3_index_info* p_info,
+    const std::vector<sqlite3_index_info::sqlite3_index_constraint>& indexes)
+{
+    vtab_index_plan plan;
+    size_t cons_len = indexes.size() * sizeof(indexes[0]);
+
+#if SQLITE_VERSION_NUMBER >= 3010000
+    plan.vip_columns_used.cu_mask = p_info->colUsed;
+#endif
+
+    auto* plan_copy = (char*) sqlite3_malloc(sizeof(plan) + cons_len);
+    if (!plan_copy) {
+        return SQLITE_NOMEM;
     }
+    memcpy(plan_copy, &plan, sizeof(plan));
+    if (cons_len > 0) {
+        memcpy(plan_copy + sizeof(plan), indexes.data(), cons_len);
+    }
+    p_info->idxNum = indexes.size();
+    p_info->idxStr = plan_copy;
+    p_info->needToFreeIdxStr = 1;
 
     return SQLITE_OK;
 }
@@ -888,63 +1299,108 @@ vt_best_index(sqlite3_vtab* tab, sqlite3_index_info* p_info)
     std::vector<sqlite3_index_info::sqlite3_index_constraint> indexes;
     int argvInUse = 0;
     vtab* vt = (vtab*) tab;
+    const int time_msecs_col = VT_COL_MAX + vt->vi->vi_column_count;
+    const int path_col = time_msecs_col + 1;
+    double line_count = std::max(vt->lss->text_line_count(), (size_t) 1);
+    double scan_rows = line_count;
+    double match_fraction = 1.0;
+    bool unique = false;
 
     log_info(
         "(%p) best index called: nConstraint=%d", tab, p_info->nConstraint);
     if (!vt->vi->vi_supports_indexes) {
-        return SQLITE_OK;
+        return set_index_plan(p_info, indexes);
     }
     for (int lpc = 0; lpc < p_info->nConstraint; lpc++) {
-        if (!p_info->aConstraint[lpc].usable
-            || p_info->aConstraint[lpc].op == SQLITE_INDEX_CONSTRAINT_MATCH)
+        const auto& cons = p_info->aConstraint[lpc];
+
+        if (!cons.usable
+            || (cons.op != SQLITE_INDEX_CONSTRAINT_EQ
+                && !is_range_op(cons.op)))
         {
             continue;
         }
 
-        switch (p_info->aConstraint[lpc].iColumn) {
-            case VT_COL_LINE_NUMBER:
-                argvInUse += 1;
-                indexes.push_back(p_info->aConstraint[lpc]);
-                p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
-                break;
-        }
-    }
+        // The estimates below follow the rule of thumb used by SQLite:
+        // equality matches a small fraction of the rows and each side of a
+        // range matches about a quarter of them.
+        bool used = false;
 
-    if (!argvInUse) {
-        for (int lpc = 0; lpc < p_info->nConstraint; lpc++) {
-            if (!p_info->aConstraint[lpc].usable
-                || p_info->aConstraint[lpc].op == SQLITE_INDEX_CONSTRAINT_MATCH)
+        if (cons.iColumn == VT_COL_LINE_NUMBER) {
+            if (cons.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                scan_rows = 1;
+                unique = true;
+            } else {
+                scan_rows /= 4.0;
+            }
+            used = true;
+        } else if (cons.iColumn == VT_COL_LOG_TIME
+                   || cons.iColumn == time_msecs_col)
+        {
+            if (cons.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                scan_rows /= 100.0;
+            } else {
+                scan_rows /= 4.0;
+            }
+            used = true;
+        } else if (cons.iColumn == VT_COL_LEVEL) {
+            if (cons.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                match_fraction /= 10.0;
+                used = true;
+            }
+#if SQLITE_VERSION_NUMBER >= 3022000
+            else if (strcasecmp(sqlite3_vtab_collation(p_info, lpc),
+                                "loglevel")
+                     == 0)
             {
-                continue;
+                // Range comparisons only line up with the level order when
+                // the column's collation is used.
+                match_fraction /= 4.0;
+                used = true;
             }
-
-            switch (p_info->aConstraint[lpc].iColumn) {
-                case VT_COL_LOG_TIME:
-                    argvInUse += 1;
-                    indexes.push_back(p_info->aConstraint[lpc]);
-                    p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
-                    break;
+#endif
+        } else if (cons.iColumn == VT_COL_MARK) {
+            if (cons.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                match_fraction /= 10.0;
+                used = true;
             }
+        } else if (cons.iColumn == path_col) {
+            if (cons.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                match_fraction /= std::max(vt->lss->file_count(), (size_t) 1);
+                used = true;
+            }
+        }
+
+        if (used) {
+            argvInUse += 1;
+            indexes.push_back(cons);
+            p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
         }
     }
 
     if (argvInUse) {
-        sqlite3_index_info::sqlite3_index_constraint* index_copy;
-        size_t len = indexes.size() * sizeof(*index_copy);
-
         log_info("found index, passing %d args", argvInUse);
+    }
+    auto rc = set_index_plan(p_info, indexes);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
 
-        index_copy
-            = (sqlite3_index_info::sqlite3_index_constraint*) sqlite3_malloc(
-                len);
-        if (!index_copy) {
-            return SQLITE_NOMEM;
-        }
-        memcpy(index_copy, &indexes[0], len);
-        p_info->idxNum = argvInUse;
-        p_info->idxStr = (char*) index_copy;
-        p_info->needToFreeIdxStr = 1;
-        p_info->estimatedCost = 10.0;
+    // Finding the range of lines is a binary search, checking a line against
+    // the level/mark/path constraints only needs the logline, and every row
+    // that is returned has to be read from the file.
+    scan_rows = std::max(scan_rows, 1.0);
+    auto est_rows = std::max(scan_rows * match_fraction, 1.0);
+    p_info->estimatedCost = log2(line_count) + scan_rows / 10.0 + est_rows;
+    p_info->estimatedRows = est_rows;
+    if (unique) {
+        p_info->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+    }
+    if (p_info->nOrderBy == 1
+        && p_info->aOrderBy[0].iColumn == VT_COL_LINE_NUMBER
+        && !p_info->aOrderBy[0].desc)
+    {
+        p_info->orderByConsumed = 1;
     }
 
     return SQLITE_OK;
@@ -1069,7 +1525,7 @@ vt_update(sqlite3_vtab* tab,
         while ((size_t) rowid < vt->lss->text_line_count()) {
             vis_line_t vl(rowid);
             content_line_t cl = vt->lss->at(vl);
-            logline* ll = vt->lss->find_line(cl);
+            auto ll = vt->lss->find_line(cl);
             if (ll->is_message()) {
                 break;
             }
@@ -30,6 +30,7 @@
 #ifndef vtab_impl_hh
 #define vtab_impl_hh
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -61,6 +62,16 @@ struct log_cursor {
     int lc_sub_index;
     vis_line_t lc_end_line;
 
+    /**
+     * Narrow the range of lines covered by the cursor using a constraint
+     * from the WHERE clause.  Multiple constraints are intersected.
+     *
+     * @param op The SQLITE_INDEX_CONSTRAINT_* operator.
+     * @param vl The line the constraint is comparing against.
+     * @param exact True if 'vl' is the exact value of the constraint, false
+     *   if it is the first line past the value, as is the case when the
+     *   line was found by a time search.
+     */
     void update(unsigned char op, vis_line_t vl, bool exact = true);
 
     void set_eof()
@@ -74,6 +85,30 @@ struct log_cursor {
     };
 };
 
+/**
+ * The set of table columns that are referenced by a query, as reported by
+ * SQLite in the colUsed field passed to xBestIndex.  Bit N is set if column
+ * N is used and the last bit covers all of the columns past it.
+ */
+struct column_usage {
+    sqlite3_uint64 cu_mask{~0ULL};
+
+    bool is_used(int col) const
+    {
+        return this->cu_mask & (1ULL << std::min(col, 63));
+    }
+
+    /**
+     * @param sub_col The column number of a value from the format, as
+     *   stored in logline_value_meta::lvm_column.
+     * @return True if the column for the given value is used by the query.
+     */
+    bool is_value_used(int sub_col) const
+    {
+        return this->is_used(VT_COL_MAX + sub_col);
+    }
+};
+
 const std::string LOG_BODY = "log_body";
 const std::string LOG_TIME = "log_time";
 
@@ -145,9 +180,15 @@ public:
         keys_inout.emplace_back("log_time_msecs");
     };
 
+    /**
+     * Extract the values for the format-specific columns from a message.
+     * Implementations can skip the work for any columns that are not in
+     * the given usage set, the values for those columns are never read.
+     */
     virtual void extract(std::shared_ptr<logfile> lf,
                          uint64_t line_number,
                          shared_buffer_ref& line,
+                         const column_usage& cu,
                          std::vector<logline_value>& values)
     {
         auto format = lf->get_format();
@@ -156,6 +197,26 @@ public:
         format->annotate(line_number, line, this->vi_attrs, values, false);
     };
 
+    /**
+     * @param sub_col The column number of a value from the format.
+     * @return The name of the numeric format field shown in the given
+     *   column if its values can be read from the value index of a file
+     *   with this table's format, instead of using extract().
+     */
+    virtual intern_string_t get_numeric_value_name(int sub_col) const
+    {
+        return intern_string_t();
+    }
+
+    /**
+     * @return The number of the hidden log_body column, which comes after
+     *   the format-specific columns.
+     */
+    int get_body_column() const
+    {
+        return VT_COL_MAX + this->vi_column_count + 3;
+    }
+
     bool vi_supports_indexes;
     int vi_column_count;
     string_attrs_t vi_attrs;
@@ -29,6 +29,10 @@
  * @file logfile.cc
  */
 
+#include <atomic>
+#include <deque>
+#include <future>
+#include <thread>
 #include <utility>
 
 #include "logfile.hh"
@@ -44,15 +48,257 @@
 
 #include "base/fs_util.hh"
 #include "base/injector.hh"
+#include "base/paths.hh"
 #include "base/string_util.hh"
 #include "config.h"
 #include "lnav_util.hh"
 #include "log_format.hh"
+#include "log_format_ext.hh"
+#include "log_format_loader.hh"
 #include "logfile.cfg.hh"
 
 static auto intern_lifetime = intern_string::get_table_lifetime();
 
 static const size_t INDEX_RESERVE_INCREMENT = 1024;
+static const size_t LINE_BATCH_SIZE = 1024;
+
+static const char INDEX_CACHE_MAGIC[8] = {'l', 'n', 'a', 'v', 'i', 'd', 'x', 0};
+static const uint32_t INDEX_CACHE_VERSION = 3;
+static const size_t INDEX_CACHE_BLOCK_SIZE = 4096;
+
+/**
+ * The fixed-size header at the start of a cached index file.  The header is
+ * followed by length-prefixed strings for the key, block hashes, format name,
+ * and content ID, then the pattern locks, value stats, the decompression
+ * indexes for gzip, bzip2, and the frame-based formats, and, finally, the
+ * logline array.  A hash of everything before it is appended to
+ * the end of the file.
+ */
+struct index_cache_header {
+    char ich_magic[8];
+    uint32_t ich_version;
+    uint32_t ich_logline_size;
+    uint64_t ich_dev;
+    uint64_t ich_ino;
+    int64_t ich_size;
+    int64_t ich_mtime;
+    int64_t ich_hashed_size;
+    int64_t ich_index_size;
+    int64_t ich_index_time;
+    uint64_t ich_line_count;
+    uint64_t ich_longest_line;
+    int32_t ich_text_format;
+    uint8_t ich_compressed;
+    uint8_t ich_partial_line;
+    uint8_t ich_padding[2];
+};
+
+class index_cache_writer {
+public:
+    explicit index_cache_writer(int fd) : icw_fd(fd) {}
+
+    bool write(const void* data, size_t len)
+    {
+        auto* bits = static_cast<const char*>(data);
+
+        this->icw_hasher.update(bits, len);
+        while (len > 0) {
+            auto rc = ::write(this->icw_fd, bits, len);
+
+            if (rc <= 0) {
+                if (rc == -1 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bits += rc;
+            len -= rc;
+        }
+
+        return true;
+    }
+
+    template<typename T>
+    bool write_value(const T& value)
+    {
+        return this->write(&value, sizeof(value));
+    }
+
+    bool write_string(const std::string& str)
+    {
+        uint64_t len = str.size();
+
+        return this->write_value(len) && this->write(str.data(), str.size());
+    }
+
+    template<typename T>
+    bool write_vector(const std::vector<T>& vec)
+    {
+        uint64_t count = vec.size();
+
+        return this->write_value(count)
+            && this->write(vec.data(), vec.size() * sizeof(T));
+    }
+
+    /**
+     * Write the lines in the same layout as write_vector() so that they can
+     * be read back into a vector.
+     */
+    bool write_lines(const logline_store& lines)
+    {
+        uint64_t count = lines.size();
+        std::vector<logline> batch;
+
+        if (!this->write_value(count)) {
+            return false;
+        }
+        batch.reserve(logline_store::BLOCK_SIZE);
+        for (const auto& ll : lines) {
+            batch.push_back(ll);
+            if (batch.size() == logline_store::BLOCK_SIZE) {
+                if (!this->write(batch.data(), batch.size() * sizeof(logline)))
+                {
+                    return false;
+                }
+                batch.clear();
+            }
+        }
+
+        return this->write(batch.data(), batch.size() * sizeof(logline));
+    }
+
+    bool finish()
+    {
+        auto checksum = this->icw_hasher.to_string();
+
+        return this->write(checksum.data(), checksum.size());
+    }
+
+private:
+    int icw_fd;
+    hasher icw_hasher;
+};
+
+class index_cache_reader {
+public:
+    explicit index_cache_reader(int fd) : icr_fd(fd) {}
+
+    bool read(void* data, size_t len)
+    {
+        auto* bits = static_cast<char*>(data);
+        auto total = len;
+
+        while (len > 0) {
+            auto rc = ::read(this->icr_fd, bits, len);
+
+            if (rc <= 0) {
+                if (rc == -1 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bits += rc;
+            len -= rc;
+        }
+        this->icr_hasher.update(static_cast<const char*>(data), total);
+
+        return true;
+    }
+
+    template<typename T>
+    bool read_value(T& value)
+    {
+        return this->read(&value, sizeof(value));
+    }
+
+    bool read_string(std::string& str)
+    {
+        uint64_t len;
+
+        if (!this->read_value(len) || len > 4096) {
+            return false;
+        }
+        str.resize(len);
+        return this->read(&str[0], len);
+    }
+
+    template<typename T>
+    bool read_vector(std::vector<T>& vec,
+                     uint64_t max_count,
+                     const T& proto = T())
+    {
+        uint64_t count;
+
+        if (!this->read_value(count) || count > max_count) {
+            return false;
+        }
+        vec.resize(count, proto);
+        return this->read(vec.data(), count * sizeof(T));
+    }
+
+    bool check_finish()
+    {
+        auto expected = this->icr_hasher.to_string();
+        std::string actual;
+        char extra;
+
+        actual.resize(expected.size());
+        if (!this->read(&actual[0], actual.size())) {
+            return false;
+        }
+
+        return actual == expected && ::read(this->icr_fd, &extra, 1) == 0;
+    }
+
+private:
+    int icr_fd;
+    hasher icr_hasher;
+};
+
+static ghc::filesystem::path
+index_cache_path()
+{
+    return lnav::paths::workdir() / "index-cache";
+}
+
+static ghc::filesystem::path
+index_cache_path_for(const struct stat& st)
+{
+    auto id = hasher()
+                  .update((uint64_t) st.st_dev)
+                  .update((uint64_t) st.st_ino)
+                  .to_string();
+
+    return index_cache_path() / fmt::format(FMT_STRING("idx-{}"), id);
+}
+
+/**
+ * @return The key that must match for a cached index to be usable.  It is
+ * derived from the lnav version and the loaded format definitions since the
+ * index is a function of both.
+ */
+static std::string
+index_cache_key()
+{
+    return hasher()
+        .update(std::string(VCS_PACKAGE_STRING))
+        .update(format_definitions_id())
+        .update((uint64_t) sizeof(logline))
+        .to_string();
+}
+
+static nonstd::optional<std::string>
+index_cache_block_hash(int fd, file_off_t start, file_off_t end)
+{
+    char buffer[INDEX_CACHE_BLOCK_SIZE];
+    auto len = std::min((size_t) (end - start), sizeof(buffer));
+
+    if (pread(fd, buffer, len, start) != (ssize_t) len) {
+        return nonstd::nullopt;
+    }
+
+    return hasher().update(buffer, len).to_string();
+}
 
 Result<std::shared_ptr<logfile>, std::string>
 logfile::open(std::string filename, logfile_open_options& loo)
@@ -114,7 +360,22 @@ logfile::open(std::string filename, logfile_open_options& loo)
 
     lf->lf_content_id = hasher().update(lf->lf_filename).to_string();
     lf->lf_line_buffer.set_fd(lf->lf_options.loo_fd);
+    if (lf->lf_named_file) {
+        const auto& cfg = injector::get<const lnav::logfile::config&>();
+        auto age = time(nullptr) - lf->lf_stat.st_mtime;
+
+        // Files that have not been touched in a while, like rotated logs,
+        // are not expected to change and can be read through a mapping.
+        if (lf->lf_stat.st_size >= cfg.lc_mmap_min_size
+            && age >= cfg.lc_mmap_min_age.count()
+            && lf->lf_line_buffer.map_file())
+        {
+            log_info("mapped unchanging file: %s", lf->lf_filename.c_str());
+        }
+    }
     lf->lf_index.reserve(INDEX_RESERVE_INCREMENT);
+    lf->lf_index.set_compact(
+        injector::get<const lnav::logfile::config&>().lc_compact_index);
 
     lf->lf_indexing = lf->lf_options.loo_is_visible;
 
@@ -123,6 +384,46 @@ logfile::open(std::string filename, logfile_open_options& loo)
     return Ok(lf);
 }
 
+struct logfile::parallel_scan {
+    struct chunk {
+        file_off_t c_start;
+        file_off_t c_end;
+        std::shared_ptr<external_log_format> c_format;
+        logline_store c_index;
+        size_t c_longest_line{0};
+        uint32_t c_out_of_time_order_count{0};
+        bool c_sort_needed{false};
+        bool c_valid{false};
+    };
+
+    ~parallel_scan()
+    {
+        this->ps_abort = true;
+        for (auto& worker : this->ps_workers) {
+            if (worker.valid()) {
+                worker.wait();
+            }
+        }
+    }
+
+    /** @return True if all of the workers have finished their chunks. */
+    bool is_done() const
+    {
+        return std::all_of(
+            this->ps_workers.begin(),
+            this->ps_workers.end(),
+            [](const auto& worker) {
+                return worker.wait_for(std::chrono::seconds(0))
+                    == std::future_status::ready;
+            });
+    }
+
+    file_off_t ps_end{0};
+    std::deque<chunk> ps_chunks;
+    std::vector<std::future<void>> ps_workers;
+    std::atomic<bool> ps_abort{false};
+};
+
 logfile::logfile(std::string filename, logfile_open_options& loo)
     : lf_filename(std::move(filename)), lf_options(std::move(loo))
 {
@@ -173,13 +474,102 @@ logfile::set_format_base_time(log_format* lf)
     lf->lf_date_time.set_base_time(file_time);
 }
 
+/**
+ * Finish indexing a line after it has been passed to a format's scan()
+ * method.  Lines that are out of time order are fixed up and lines that the
+ * format did not recognize are treated as a continuation of the previous
+ * line.
+ *
+ * @return True if the index needs to be sorted.
+ */
+static bool
+apply_scan_result(log_format::scan_result_t found,
+                  const log_format* format,
+                  logline_store& index,
+                  size_t prescan_size,
+                  time_t prescan_time,
+                  time_t index_time,
+                  const line_info& li,
+                  uint32_t& out_of_time_order_count)
+{
+    bool retval = false;
+
+    switch (found) {
+        case log_format::SCAN_MATCH:
+            if (!index.empty()) {
+                index.back().set_valid_utf(li.li_valid_utf);
+            }
+            if (prescan_size > 0 && index.size() >= prescan_size
+                && prescan_time != index[prescan_size - 1].get_time())
+            {
+                retval = true;
+            }
+            if (prescan_size > 0 && prescan_size < index.size()) {
+                auto&& second_to_last = index[prescan_size - 1];
+                auto&& latest = index[prescan_size];
+
+                if (!second_to_last.is_ignored() && latest < second_to_last) {
+                    if (format->lf_time_ordered) {
+                        out_of_time_order_count += 1;
+                        for (size_t lpc = prescan_size; lpc < index.size();
+                             lpc++) {
+                            auto&& line_to_update = index[lpc];
+
+                            line_to_update.set_time_skew(true);
+                            line_to_update.set_time(second_to_last.get_time());
+                            line_to_update.set_millis(
+                                second_to_last.get_millis());
+                        }
+                    } else {
+                        retval = true;
+                    }
+                }
+            }
+            break;
+        case log_format::SCAN_NO_MATCH: {
+            log_level_t last_level = LEVEL_UNKNOWN;
+            time_t last_time = index_time;
+            short last_millis = 0;
+            uint8_t last_mod = 0, last_opid = 0;
+
+            if (!index.empty()) {
+                logline& ll = index.back();
+
+                /*
+                 * Assume this line is part of the previous one(s) and copy the
+                 * metadata over.
+                 */
+                last_time = ll.get_time();
+                last_millis = ll.get_millis();
+                if (format != nullptr) {
+                    last_level = (log_level_t) (ll.get_level_and_flags()
+                                                | LEVEL_CONTINUED);
+                }
+                last_mod = ll.get_module_id();
+                last_opid = ll.get_opid();
+            }
+            index.emplace_back(li.li_file_range.fr_offset,
+                               last_time,
+                               last_millis,
+                               last_level,
+                               last_mod,
+                               last_opid);
+            index.back().set_valid_utf(li.li_valid_utf);
+            break;
+        }
+        case log_format::SCAN_INCOMPLETE:
+            break;
+    }
+
+    return retval;
+}
+
 bool
 logfile::process_prefix(shared_buffer_ref& sbr, const line_info& li)
 {
     log_format::scan_result_t found = log_format::SCAN_NO_MATCH;
     size_t prescan_size = this->lf_index.size();
     time_t prescan_time = 0;
-    bool retval = false;
 
     if (this->lf_format.get() != nullptr) {
         if (!this->lf_index.empty()) {
@@ -194,6 +584,9 @@ logfile::process_prefix(shared_buffer_ref& sbr, const line_info& li)
     {
         const auto& root_formats = log_format::get_root_formats();
 
+        log_format::get_detection_literals().find(
+            sbr.get_data(), sbr.length(), this->lf_detection_matches);
+
         /*
          * Try each scanner until we get a match.  Fortunately, all the formats
          * are sufficiently different that there are no ambiguities...
@@ -214,6 +607,9 @@ logfile::process_prefix(shared_buffer_ref& sbr, const line_info& li)
                           this->lf_options.loo_file_format);
                 continue;
             }
+            if (!(*iter)->may_match(this->lf_detection_matches)) {
+                continue;
+            }
 
             (*iter)->clear();
             this->set_format_base_time(iter->get());
@@ -240,7 +636,7 @@ logfile::process_prefix(shared_buffer_ref& sbr, const line_info& li)
                  * written out at the same time as the last one, so we need to
                  * go back and update everything.
                  */
-                logline& last_line = this->lf_index[this->lf_index.size() - 1];
+                auto last_line = this->lf_index.back();
 
                 for (size_t lpc = 0; lpc < this->lf_index.size() - 1; lpc++) {
                     if (this->lf_format->lf_multiline) {
@@ -255,73 +651,54 @@ logfile::process_prefix(shared_buffer_ref& sbr, const line_info& li)
         }
     }
 
-    switch (found) {
-        case log_format::SCAN_MATCH:
-            if (!this->lf_index.empty()) {
-                this->lf_index.back().set_valid_utf(li.li_valid_utf);
-            }
-            if (prescan_size > 0 && this->lf_index.size() >= prescan_size
-                && prescan_time != this->lf_index[prescan_size - 1].get_time())
-            {
-                retval = true;
-            }
-            if (prescan_size > 0 && prescan_size < this->lf_index.size()) {
-                logline& second_to_last = this->lf_index[prescan_size - 1];
-                logline& latest = this->lf_index[prescan_size];
+    return apply_scan_result(found,
+                             this->lf_format.get(),
+                             this->lf_index,
+                             prescan_size,
+                             prescan_time,
+                             this->lf_index_time,
+                             li,
+                             this->lf_out_of_time_order_count);
+}
 
-                if (!second_to_last.is_ignored() && latest < second_to_last) {
-                    if (this->lf_format->lf_time_ordered) {
-                        this->lf_out_of_time_order_count += 1;
-                        for (size_t lpc = prescan_size;
-                             lpc < this->lf_index.size();
-                             lpc++) {
-                            logline& line_to_update = this->lf_index[lpc];
+bool
+logfile::process_span(line_span& span)
+{
+    require(this->lf_format != nullptr);
 
-                            line_to_update.set_time_skew(true);
-                            line_to_update.set_time(second_to_last.get_time());
-                            line_to_update.set_millis(
-                                second_to_last.get_millis());
-                        }
-                    } else {
-                        retval = true;
-                    }
-                }
-            }
-            break;
-        case log_format::SCAN_NO_MATCH: {
-            log_level_t last_level = LEVEL_UNKNOWN;
-            time_t last_time = this->lf_index_time;
-            short last_millis = 0;
-            uint8_t last_mod = 0, last_opid = 0;
+    auto* format = this->lf_format.get();
+    auto retval = false;
+    auto prescan_size = this->lf_index.size();
+    time_t prescan_time = 0;
 
+    if (!this->lf_index.empty()) {
+        prescan_time = this->lf_index.back().get_time();
+    }
+    format->scan_batch(
+        *this,
+        this->lf_index,
+        span,
+        [this, format, &retval, &prescan_size, &prescan_time](
+            const line_info& li,
+            shared_buffer_ref& sbr,
+            log_format::scan_result_t found) {
+            this->lf_longest_line
+                = std::max(this->lf_longest_line, sbr.length());
+            this->lf_partial_line = li.li_partial;
+            retval = apply_scan_result(found,
+                                       format,
+                                       this->lf_index,
+                                       prescan_size,
+                                       prescan_time,
+                                       this->lf_index_time,
+                                       li,
+                                       this->lf_out_of_time_order_count)
+                || retval;
+            prescan_size = this->lf_index.size();
             if (!this->lf_index.empty()) {
-                logline& ll = this->lf_index.back();
-
-                /*
-                 * Assume this line is part of the previous one(s) and copy the
-                 * metadata over.
-                 */
-                last_time = ll.get_time();
-                last_millis = ll.get_millis();
-                if (this->lf_format.get() != nullptr) {
-                    last_level = (log_level_t) (ll.get_level_and_flags()
-                                                | LEVEL_CONTINUED);
-                }
-                last_mod = ll.get_module_id();
-                last_opid = ll.get_opid();
+                prescan_time = this->lf_index.back().get_time();
             }
-            this->lf_index.emplace_back(li.li_file_range.fr_offset,
-                                        last_time,
-                                        last_millis,
-                                        last_level,
-                                        last_mod,
-                                        last_opid);
-            this->lf_index.back().set_valid_utf(li.li_valid_utf);
-            break;
-        }
-        case log_format::SCAN_INCOMPLETE:
-            break;
-    }
+        });
 
     return retval;
 }
@@ -337,13 +714,26 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
         return rebuild_result_t::NO_NEW_LINES;
     }
 
+    if (this->lf_watched && !this->lf_changed) {
+        // Nothing has been written to the file since it was last indexed.
+        log_trace("%s: skipping rebuild of unchanged watched file",
+                  this->lf_filename.c_str());
+        if (this->lf_sort_needed) {
+            this->lf_sort_needed = false;
+            return rebuild_result_t::NEW_ORDER;
+        }
+        return rebuild_result_t::NO_NEW_LINES;
+    }
+
     auto retval = rebuild_result_t::NO_NEW_LINES;
     struct stat st;
 
     this->lf_activity.la_polls += 1;
+    this->lf_changed = false;
 
     if (fstat(this->lf_line_buffer.get_fd(), &st) == -1) {
         if (errno == EINTR) {
+            this->lf_changed = true;
             return rebuild_result_t::NO_NEW_LINES;
         }
         return rebuild_result_t::INVALID;
@@ -368,7 +758,24 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
                  this->lf_stat.st_mtime);
         this->close();
         return rebuild_result_t::NO_NEW_LINES;
-    } else if (this->lf_line_buffer.is_data_available(this->lf_index_size,
+    }
+
+    if (!this->lf_index_cache_checked) {
+        this->lf_index_cache_checked = true;
+        if (this->lf_index.empty() && this->load_index_cache(st)) {
+            // The observer has not seen the lines from the cache yet.
+            if (this->lf_indexing_in_background) {
+                this->lf_deferred_restart
+                    = std::make_pair(size_t{0}, size_t{0});
+            } else if (this->lf_logline_observer != nullptr) {
+                this->replay_new_lines(this->begin());
+                this->lf_logline_observer->logline_eof(*this);
+            }
+            retval = rebuild_result_t::NEW_LINES;
+        }
+    }
+
+    if (this->lf_line_buffer.is_data_available(this->lf_index_size,
                                                       st.st_size))
     {
         this->lf_activity.la_reads += 1;
@@ -426,7 +833,12 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
         } else {
             off = 0;
         }
-        if (this->lf_logline_observer != nullptr) {
+        if (this->lf_indexing_in_background) {
+            if (!this->lf_deferred_restart) {
+                this->lf_deferred_restart
+                    = std::make_pair(this->lf_index.size(), rollback_size);
+            }
+        } else if (this->lf_logline_observer != nullptr) {
             this->lf_logline_observer->logline_restart(*this, rollback_size);
         }
 
@@ -454,43 +866,191 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
                 "loading file... %s:%d", this->lf_filename.c_str(), begin_size);
         }
         auto prev_range = file_range{off};
+        auto reached_eof = false;
+        // Large files with a known format are split into chunks that are
+        // scanned by other threads while the first chunk is scanned here.
+        auto parallel_ok = has_format && this->lf_format != nullptr
+            && !this->lf_indexing_in_background;
+        // A scan started by an earlier rebuild is picked up again as long
+        // as its chunks are still ahead of where indexing resumes.
+        auto pending_scan = std::move(this->lf_pending_scan);
+        if (pending_scan
+            && (!parallel_ok || pending_scan->ps_chunks.front().c_start < off))
+        {
+            pending_scan.reset();
+        }
+        // The line buffer finds the lines in a whole buffer at once, so the
+        // lines are consumed from this batch until it runs out or the loop
+        // jumps to another offset.
+        std::vector<line_info> line_batch;
+        size_t batch_index = 0;
         while (limit > 0) {
-            auto load_result = this->lf_line_buffer.load_next_line(prev_range);
-
-            if (load_result.isErr()) {
-                log_error("%s: load next line failure -- %s",
-                          this->lf_filename.c_str(),
-                          load_result.unwrapErr().c_str());
-                this->close();
-                return rebuild_result_t::INVALID;
+            if (parallel_ok && !pending_scan) {
+                pending_scan
+                    = this->start_parallel_scan(prev_range.next_offset(), st);
+                if (!pending_scan) {
+                    parallel_ok = false;
+                }
             }
 
-            auto li = load_result.unwrap();
+            if (batch_index >= line_batch.size()
+                || line_batch[batch_index].li_file_range.fr_offset
+                    != prev_range.next_offset())
+            {
+                // The first chunk of a parallel scan can be large, so the
+                // rest of it is left for the next rebuild once the deadline
+                // has passed.
+                if (pending_scan && deadline && !line_batch.empty()
+                    && ui_clock::now() > deadline.value())
+                {
+                    break;
+                }
 
-            if (li.li_file_range.empty()) {
-                break;
-            }
-            prev_range = li.li_file_range;
+                auto load_result = this->lf_line_buffer.load_next_lines(
+                    prev_range, line_batch, LINE_BATCH_SIZE);
 
-            if (!this->lf_options.loo_non_utf_is_visible && !li.li_valid_utf) {
-                log_info("file is not utf, hiding: %s",
-                         this->lf_filename.c_str());
-                this->lf_indexing = false;
-                this->lf_options.loo_is_visible = false;
-                this->lf_notes.writeAccess()->emplace(note_type::not_utf,
-                                                      "hiding non-UTF-8 file");
-                if (this->lf_logfile_observer != nullptr) {
-                    this->lf_logfile_observer->logfile_indexing(
-                        this->shared_from_this(), 0, 0);
+                if (load_result.isErr()) {
+                    log_error("%s: load next line failure -- %s",
+                              this->lf_filename.c_str(),
+                              load_result.unwrapErr().c_str());
+                    this->close();
+                    return rebuild_result_t::INVALID;
                 }
-                break;
+                batch_index = 0;
             }
 
-            size_t old_size = this->lf_index.size();
-
+            // Once the format is known, the run of ordinary lines at the
+            // front of the batch is scanned and passed to the observers in
+            // one go.  Anything else is handled one line at a time below.
+            if (has_format && !this->lf_index.empty()) {
+                auto run_end = batch_index;
+
+                while (run_end < line_batch.size()
+                       && (run_end - batch_index) < limit)
+                {
+                    const auto& run_li = line_batch[run_end];
+
+                    if (run_li.li_file_range.empty() || run_li.li_partial
+                        || (!this->lf_options.loo_non_utf_is_visible
+                            && !run_li.li_valid_utf)
+                        || (pending_scan
+                            && run_li.li_file_range.fr_offset
+                                >= pending_scan->ps_chunks.front().c_start))
+                    {
+                        break;
+                    }
+                    run_end += 1;
+                }
+
+                if (run_end > batch_index) {
+                    // The span is released before calling the indexing
+                    // observer in case it reads from the line buffer.
+                    {
+                        auto span_result = this->lf_line_buffer.read_span(
+                            line_batch.cbegin() + batch_index,
+                            line_batch.cbegin() + run_end);
+
+                        if (span_result.isErr()) {
+                            log_error("%s:read failure -- %s",
+                                      this->lf_filename.c_str(),
+                                      span_result.unwrapErr().c_str());
+                            this->close();
+                            return rebuild_result_t::INVALID;
+                        }
+
+                        auto span = span_result.unwrap();
+                        auto old_size = this->lf_index.size();
+
+                        sort_needed = this->process_span(span) || sort_needed;
+                        prev_range = line_batch[run_end - 1].li_file_range;
+                        this->lf_index_size = prev_range.next_offset();
+                        limit -= span.size();
+                        batch_index = run_end;
+
+                        if (this->lf_logline_observer != nullptr) {
+                            this->lf_logline_observer->logline_new_batch(
+                                *this,
+                                this->begin() + old_size,
+                                this->end(),
+                                span);
+                        }
+                        this->lf_index.seal();
+                    }
+
+                    if (this->lf_logfile_observer != nullptr) {
+                        auto indexing_res
+                            = this->lf_logfile_observer->logfile_indexing(
+                                this->shared_from_this(),
+                                this->lf_line_buffer.get_read_offset(
+                                    prev_range.next_offset()),
+                                st.st_size);
+
+                        if (indexing_res
+                            == logfile_observer::indexing_result::BREAK)
+                        {
+                            break;
+                        }
+                    }
+                    continue;
+                }
+            }
+
+            auto li = line_batch[batch_index];
+            batch_index += 1;
+
+            if (pending_scan
+                && li.li_file_range.fr_offset
+                    >= pending_scan->ps_chunks.front().c_start)
+            {
+                if (deadline && ui_clock::now() > deadline.value()
+                    && !pending_scan->is_done())
+                {
+                    // Check on the workers again in the next rebuild
+                    // instead of waiting for them here.
+                    break;
+                }
+
+                auto scan = std::move(pending_scan);
+
+                if (this->finish_parallel_scan(*scan, sort_needed)) {
+                    prev_range = file_range{scan->ps_end};
+                    this->lf_index_size = scan->ps_end;
+                    continue;
+                }
+                parallel_ok = false;
+            }
+
+            if (li.li_file_range.empty()) {
+                reached_eof = true;
+                break;
+            }
+            prev_range = li.li_file_range;
+
+            if (!this->lf_options.loo_non_utf_is_visible && !li.li_valid_utf) {
+                log_info("file is not utf, hiding: %s",
+                         this->lf_filename.c_str());
+                this->lf_indexing = false;
+                this->lf_options.loo_is_visible = false;
+                this->lf_notes.writeAccess()->emplace(note_type::not_utf,
+                                                      "hiding non-UTF-8 file");
+                if (this->lf_logfile_observer != nullptr) {
+                    this->lf_logfile_observer->logfile_indexing(
+                        this->shared_from_this(), 0, 0);
+                }
+                break;
+            }
+
+            size_t old_size = this->lf_index.size();
+
             if (old_size == 0
                 && this->lf_text_format == text_format_t::TF_UNKNOWN) {
+                // The buffer for a compressed file can be much larger than
+                // what is needed to detect the format.
+                const file_ssize_t max_detect_size
+                    = line_buffer::MAX_LINE_BUFFER_SIZE;
                 file_range fr = this->lf_line_buffer.get_available();
+
+                fr.fr_size = std::min(fr.fr_size, max_detect_size);
                 auto avail_data = this->lf_line_buffer.read_range(fr);
 
                 this->lf_text_format
@@ -552,7 +1112,15 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
                 break;
             }
 
-            limit -= 1;
+            if (limit > 0) {
+                limit -= 1;
+            }
+        }
+
+        if (pending_scan && this->lf_indexing) {
+            log_debug("%s: continuing the parallel scan in the next rebuild",
+                      this->lf_filename.c_str());
+            this->lf_pending_scan = std::move(pending_scan);
         }
 
         if (this->lf_format == nullptr
@@ -599,6 +1167,18 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
          */
         this->lf_index_size = prev_range.next_offset();
         this->lf_stat = st;
+        this->lf_index.seal();
+
+        if (reached_eof) {
+            // Lines are read at random once the file has been indexed.
+            this->lf_line_buffer.advise_sequential(false);
+        } else {
+            // The rest of the file is picked up by the next rebuild.
+            this->lf_changed = true;
+        }
+        if (reached_eof && this->lf_indexing) {
+            this->save_index_cache(st);
+        }
 
         if (sort_needed) {
             retval = rebuild_result_t::NEW_ORDER;
@@ -625,6 +1205,295 @@ logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
     return retval;
 }
 
+bool
+logfile::load_index_cache(const struct stat& st)
+{
+    const auto& cfg = injector::get<const lnav::logfile::config&>();
+
+    if (this->lf_line_buffer.is_pipe() || !S_ISREG(st.st_mode)
+        || st.st_size < cfg.lc_index_cache_min_size
+        || format_definitions_id().empty())
+    {
+        return false;
+    }
+
+    auto cache_path = index_cache_path_for(st);
+    auto_fd cache_fd;
+
+    if ((cache_fd = lnav::filesystem::openp(cache_path, O_RDONLY)) == -1) {
+        return false;
+    }
+
+    index_cache_reader reader(cache_fd);
+    index_cache_header hdr;
+    std::string key, first_hash, last_hash, format_name, content_id;
+    std::vector<log_format::pattern_for_lines> pattern_locks;
+    std::vector<logline_value_stats> value_stats;
+    std::vector<line_buffer::gz_indexed::indexDict> syncpoints;
+    std::vector<line_buffer::bz_indexed::block_entry> bz_blocks;
+    std::vector<line_buffer::frame_indexed::frame_entry> frames;
+    std::vector<logline> index;
+
+    if (!reader.read_value(hdr)
+        || memcmp(hdr.ich_magic, INDEX_CACHE_MAGIC, sizeof(hdr.ich_magic)) != 0
+        || hdr.ich_version != INDEX_CACHE_VERSION
+        || hdr.ich_logline_size != sizeof(logline)
+        || hdr.ich_dev != (uint64_t) st.st_dev
+        || hdr.ich_ino != (uint64_t) st.st_ino
+        || hdr.ich_compressed != this->is_compressed())
+    {
+        log_info("%s: ignoring incompatible index cache -- %s",
+                 this->lf_filename.c_str(),
+                 cache_path.c_str());
+        return false;
+    }
+
+    if (this->is_compressed()) {
+        // The offsets in a compressed file's index are in the uncompressed
+        // data, so the file has to be unchanged for the cache to be valid.
+        if (hdr.ich_size != st.st_size || hdr.ich_mtime != st.st_mtime) {
+            return false;
+        }
+    } else if (st.st_size < hdr.ich_hashed_size) {
+        return false;
+    }
+
+    if (!reader.read_string(key) || key != index_cache_key()
+        || !reader.read_string(first_hash) || !reader.read_string(last_hash))
+    {
+        log_info("%s: index cache is stale -- %s",
+                 this->lf_filename.c_str(),
+                 cache_path.c_str());
+        return false;
+    }
+
+    auto fd = this->lf_line_buffer.get_fd();
+    auto first_start = 0;
+    auto first_end = std::min(hdr.ich_hashed_size,
+                              (int64_t) INDEX_CACHE_BLOCK_SIZE);
+    auto last_start = std::max((int64_t) 0,
+                               hdr.ich_hashed_size
+                                   - (int64_t) INDEX_CACHE_BLOCK_SIZE);
+    auto curr_first_hash = index_cache_block_hash(fd, first_start, first_end);
+    auto curr_last_hash
+        = index_cache_block_hash(fd, last_start, hdr.ich_hashed_size);
+
+    if (!curr_first_hash || curr_first_hash.value() != first_hash
+        || !curr_last_hash || curr_last_hash.value() != last_hash)
+    {
+        log_info("%s: file content does not match index cache",
+                 this->lf_filename.c_str());
+        return false;
+    }
+
+    if (!reader.read_string(format_name) || !reader.read_string(content_id)
+        || !reader.read_vector(
+            pattern_locks, hdr.ich_line_count, {0, 0})
+        || !reader.read_vector(value_stats, 1024)
+        || !reader.read_vector(syncpoints, hdr.ich_size / GZ_WINSIZE + 1)
+        || !reader.read_vector(bz_blocks, hdr.ich_size / 16 + 1)
+        || !reader.read_vector(frames, hdr.ich_size + 1))
+    {
+        return false;
+    }
+
+    uint64_t line_count;
+    if (!reader.read_value(line_count) || line_count != hdr.ich_line_count) {
+        return false;
+    }
+    index.resize(line_count, logline(0, 0, 0, LEVEL_UNKNOWN));
+    if (!reader.read(index.data(), line_count * sizeof(logline))
+        || !reader.check_finish())
+    {
+        log_warning("%s: index cache is corrupt -- %s",
+                    this->lf_filename.c_str(),
+                    cache_path.c_str());
+        return false;
+    }
+
+    if (!this->lf_options.loo_non_utf_is_visible) {
+        for (const auto& ll : index) {
+            if (!ll.is_valid_utf()) {
+                return false;
+            }
+        }
+    }
+
+    std::shared_ptr<log_format> format;
+    if (!format_name.empty()) {
+        auto root_format = log_format::find_root_format(format_name.c_str());
+
+        if (!this->lf_options.loo_detect_format
+            || dynamic_cast<external_log_format*>(root_format.get())
+                == nullptr)
+        {
+            return false;
+        }
+
+        root_format->clear();
+        this->set_format_base_time(root_format.get());
+        format = root_format->specialized();
+        if (value_stats.size() != format->lf_value_stats.size()) {
+            return false;
+        }
+        format->lf_pattern_locks = std::move(pattern_locks);
+        format->lf_value_stats = std::move(value_stats);
+        this->set_format_base_time(format.get());
+    }
+
+    if (!syncpoints.empty()) {
+        this->lf_line_buffer.set_gz_syncpoints(std::move(syncpoints));
+    }
+    if (!bz_blocks.empty()) {
+        this->lf_line_buffer.set_bz_blocks(std::move(bz_blocks));
+    }
+    if (!frames.empty()) {
+        this->lf_line_buffer.set_frame_index(std::move(frames));
+    }
+    this->lf_format = format;
+    this->lf_index.assign(std::move(index));
+    this->lf_index.seal();
+    this->lf_index_size = hdr.ich_index_size;
+    this->lf_index_time = hdr.ich_index_time;
+    this->lf_longest_line = hdr.ich_longest_line;
+    this->lf_partial_line = hdr.ich_partial_line;
+    this->lf_text_format = (text_format_t) hdr.ich_text_format;
+    this->lf_content_id = content_id;
+    this->lf_index_cache_size = hdr.ich_index_size;
+    this->lf_stat = st;
+
+    log_info("%s: restored %d lines from index cache -- %s",
+             this->lf_filename.c_str(),
+             this->lf_index.size(),
+             cache_path.c_str());
+
+    return true;
+}
+
+void
+logfile::save_index_cache(const struct stat& st)
+{
+    const auto& cfg = injector::get<const lnav::logfile::config&>();
+
+    if (this->lf_line_buffer.is_pipe() || !S_ISREG(st.st_mode)
+        || st.st_size < cfg.lc_index_cache_min_size
+        || this->lf_index.empty() || format_definitions_id().empty())
+    {
+        return;
+    }
+
+    auto min_growth = std::max((file_off_t) cfg.lc_index_cache_min_size,
+                               this->lf_index_cache_size / 8);
+    if (this->lf_index_cache_size > 0
+        && this->lf_index_size < this->lf_index_cache_size + min_growth)
+    {
+        return;
+    }
+
+    if (this->lf_format != nullptr
+        && dynamic_cast<external_log_format*>(this->lf_format.get())
+            == nullptr)
+    {
+        // Formats implemented in C++ can keep state from the lines they have
+        // scanned, so they need to see the whole file.
+        return;
+    }
+
+    auto hashed_size
+        = this->is_compressed() ? (int64_t) st.st_size : this->lf_index_size;
+    auto fd = this->lf_line_buffer.get_fd();
+    auto first_hash = index_cache_block_hash(
+        fd, 0, std::min(hashed_size, (int64_t) INDEX_CACHE_BLOCK_SIZE));
+    auto last_hash = index_cache_block_hash(
+        fd,
+        std::max((int64_t) 0,
+                 hashed_size - (int64_t) INDEX_CACHE_BLOCK_SIZE),
+        hashed_size);
+    if (!first_hash || !last_hash) {
+        return;
+    }
+
+    auto cache_path = index_cache_path_for(st);
+    std::error_code ec;
+
+    ghc::filesystem::create_directories(index_cache_path(), ec);
+    if (ec) {
+        log_error("unable to create index cache directory: %s -- %s",
+                  index_cache_path().c_str(),
+                  ec.message().c_str());
+        return;
+    }
+
+    auto tmp_pattern = cache_path;
+    tmp_pattern += ".XXXXXX";
+    auto open_res = lnav::filesystem::open_temp_file(tmp_pattern);
+    if (open_res.isErr()) {
+        log_error("unable to save index cache: %s",
+                  open_res.unwrapErr().c_str());
+        return;
+    }
+
+    auto tmp_pair = open_res.unwrap();
+    index_cache_writer writer(tmp_pair.second);
+    index_cache_header hdr;
+    std::vector<log_format::pattern_for_lines> pattern_locks;
+    std::vector<logline_value_stats> value_stats;
+    std::string format_name;
+
+    if (this->lf_format != nullptr) {
+        format_name = this->lf_format->get_name().to_string();
+        pattern_locks = this->lf_format->lf_pattern_locks;
+        value_stats = this->lf_format->lf_value_stats;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.ich_magic, INDEX_CACHE_MAGIC, sizeof(hdr.ich_magic));
+    hdr.ich_version = INDEX_CACHE_VERSION;
+    hdr.ich_logline_size = sizeof(logline);
+    hdr.ich_dev = st.st_dev;
+    hdr.ich_ino = st.st_ino;
+    hdr.ich_size = st.st_size;
+    hdr.ich_mtime = st.st_mtime;
+    hdr.ich_hashed_size = hashed_size;
+    hdr.ich_index_size = this->lf_index_size;
+    hdr.ich_index_time = this->lf_index_time;
+    hdr.ich_line_count = this->lf_index.size();
+    hdr.ich_longest_line = this->lf_longest_line;
+    hdr.ich_text_format = (int32_t) this->lf_text_format;
+    hdr.ich_compressed = this->is_compressed();
+    hdr.ich_partial_line = this->lf_partial_line;
+
+    auto success = writer.write_value(hdr)
+        && writer.write_string(index_cache_key())
+        && writer.write_string(first_hash.value())
+        && writer.write_string(last_hash.value())
+        && writer.write_string(format_name)
+        && writer.write_string(this->lf_content_id)
+        && writer.write_vector(pattern_locks)
+        && writer.write_vector(value_stats)
+        && writer.write_vector(this->lf_line_buffer.get_gz_syncpoints())
+        && writer.write_vector(this->lf_line_buffer.get_bz_blocks())
+        && writer.write_vector(this->lf_line_buffer.get_frame_index())
+        && writer.write_lines(this->lf_index) && writer.finish();
+
+    tmp_pair.second.reset();
+    if (!success
+        || rename(tmp_pair.first.c_str(), cache_path.c_str()) == -1)
+    {
+        log_error("unable to save index cache: %s -- %s",
+                  cache_path.c_str(),
+                  strerror(errno));
+        ghc::filesystem::remove(tmp_pair.first, ec);
+        return;
+    }
+
+    this->lf_index_cache_size = this->lf_index_size;
+    log_info("%s: saved %d lines to index cache -- %s",
+             this->lf_filename.c_str(),
+             this->lf_index.size(),
+             cache_path.c_str());
+}
+
 Result<shared_buffer_ref, std::string>
 logfile::read_line(logfile::iterator ll)
 {
@@ -647,6 +1516,28 @@ logfile::read_line(logfile::iterator ll)
     }
 }
 
+std::shared_ptr<auto_fd>
+logfile::get_shared_fd()
+{
+    if (this->lf_line_buffer.is_compressed()
+        || (this->lf_format != nullptr && this->lf_format->has_sublines()))
+    {
+        return nullptr;
+    }
+
+    if (this->lf_shared_fd == nullptr) {
+        auto_fd fd(dup(this->lf_line_buffer.get_fd()));
+
+        if (fd == -1) {
+            return nullptr;
+        }
+        log_perror(fcntl(fd, F_SETFD, FD_CLOEXEC));
+        this->lf_shared_fd = std::make_shared<auto_fd>(std::move(fd));
+    }
+
+    return this->lf_shared_fd;
+}
+
 void
 logfile::read_full_message(logfile::const_iterator ll,
                            shared_buffer_ref& msg_out,
@@ -670,6 +1561,108 @@ logfile::read_full_message(logfile::const_iterator ll,
     }
 }
 
+bool
+logfile::index_values_to(size_t line_number, size_t max_lines)
+{
+    if (this->lf_format == nullptr || this->lf_index.empty()) {
+        return false;
+    }
+
+    // Lines are only removed from the end of the index when the last line
+    // is read again, so anything before the last message is stable.
+    auto last_msg = this->lf_index.end() - 1;
+    while (last_msg != this->lf_index.begin() && last_msg->is_continued()) {
+        --last_msg;
+    }
+
+    size_t stable_lines = std::distance(this->lf_index.begin(), last_msg);
+    if (this->lf_value_index_lines > stable_lines) {
+        this->lf_value_columns.clear();
+        this->lf_unindexed_values.clear();
+        this->lf_value_index_lines = 0;
+    }
+    if (line_number < this->lf_value_index_lines) {
+        return true;
+    }
+    if (line_number >= stable_lines
+        || line_number - this->lf_value_index_lines >= max_lines)
+    {
+        return false;
+    }
+
+    std::vector<logline_value> values;
+    string_attrs_t sa;
+
+    for (auto lpc = this->lf_value_index_lines; lpc <= line_number; lpc++) {
+        auto ll = this->begin() + lpc;
+        shared_buffer_ref sbr;
+
+        if (!ll->is_message()) {
+            continue;
+        }
+
+        this->read_full_message(ll, sbr);
+        sa.clear();
+        values.clear();
+        this->lf_format->annotate(lpc, sbr, sa, values, false);
+
+        for (const auto& lv : values) {
+            const auto& name = lv.lv_meta.lvm_name;
+            bool is_integer
+                = lv.lv_meta.lvm_kind == value_kind_t::VALUE_INTEGER;
+
+            if (lv.lv_meta.lvm_kind == value_kind_t::VALUE_NULL
+                || this->lf_format->stats_for_value(name) == nullptr
+                || this->lf_unindexed_values.count(name) > 0)
+            {
+                continue;
+            }
+
+            auto& col = this->lf_value_columns[name];
+
+            if (!col.lvc_lines.empty() && col.lvc_lines.back() == lpc) {
+                continue;
+            }
+            if (!lv.lv_meta.lvm_struct_name.empty()
+                || (!is_integer
+                    && lv.lv_meta.lvm_kind != value_kind_t::VALUE_FLOAT)
+                || (!col.lvc_lines.empty() && col.lvc_integer != is_integer))
+            {
+                this->lf_value_columns.erase(name);
+                this->lf_unindexed_values.insert(name);
+                continue;
+            }
+
+            logfile_value_column::value_t val;
+
+            if (is_integer) {
+                val.i = lv.lv_value.i;
+            } else {
+                val.d = lv.lv_value.d;
+            }
+            col.lvc_integer = is_integer;
+            col.lvc_lines.push_back(lpc);
+            col.lvc_values.push_back(val);
+        }
+    }
+    this->lf_value_index_lines = line_number + 1;
+
+    return true;
+}
+
+const logfile_value_column*
+logfile::get_value_column(const intern_string_t name)
+{
+    if (this->lf_format == nullptr
+        || this->lf_format->stats_for_value(name) == nullptr
+        || this->lf_unindexed_values.count(name) > 0)
+    {
+        return nullptr;
+    }
+
+    return &this->lf_value_columns[name];
+}
+
 void
 logfile::set_logline_observer(logline_observer* llo)
 {
@@ -679,6 +1672,449 @@ logfile::set_logline_observer(logline_observer* llo)
     }
 }
 
+bool
+logfile::can_index_in_background() const
+{
+    struct stat st;
+
+    if (!this->lf_indexing || this->lf_line_buffer.is_pipe()
+        || (this->lf_watched && !this->lf_changed)
+        || dynamic_cast<external_log_format*>(this->lf_format.get()) == nullptr
+        || fstat(this->lf_line_buffer.get_fd(), &st) == -1)
+    {
+        return false;
+    }
+
+    return this->lf_line_buffer.is_data_available(this->lf_index_size,
+                                                  st.st_size);
+}
+
+logfile::rebuild_result_t
+logfile::rebuild_index_in_background(
+    nonstd::optional<ui_clock::time_point> deadline)
+{
+    auto* llo = this->lf_logline_observer;
+    auto* lfo = this->lf_logfile_observer;
+
+    this->lf_logline_observer = nullptr;
+    this->lf_logfile_observer = nullptr;
+    this->lf_indexing_in_background = true;
+    auto _restore = finally([this, llo, lfo] {
+        this->lf_logline_observer = llo;
+        this->lf_logfile_observer = lfo;
+        this->lf_indexing_in_background = false;
+    });
+
+    return this->rebuild_index(deadline);
+}
+
+void
+logfile::finish_background_index()
+{
+    if (!this->lf_deferred_restart) {
+        return;
+    }
+
+    auto restart = this->lf_deferred_restart.value();
+
+    this->lf_deferred_restart = nonstd::nullopt;
+    if (this->lf_logline_observer == nullptr) {
+        return;
+    }
+
+    this->lf_logline_observer->logline_restart(*this, restart.second);
+    if (restart.first > this->lf_index.size()) {
+        restart.first = this->lf_index.size();
+    }
+    this->replay_new_lines(this->begin() + restart.first);
+    if (this->lf_logfile_observer != nullptr) {
+        this->lf_logfile_observer->logfile_indexing(
+            this->shared_from_this(), this->size(), this->size());
+    }
+    this->lf_logline_observer->logline_eof(*this);
+}
+
+void
+logfile::replay_new_lines(iterator iter)
+{
+    if (this->lf_logline_observer == nullptr) {
+        return;
+    }
+
+    if (!this->lf_logline_observer->logline_needs_content()) {
+        shared_buffer_ref sbr;
+
+        this->lf_logline_observer->logline_new_lines(
+            *this, iter, this->end(), sbr);
+        return;
+    }
+
+    for (; iter != this->end(); ++iter) {
+        if (iter->get_sub_offset() > 0) {
+            continue;
+        }
+
+        this->read_line(iter).then([this, iter](auto sbr) {
+            auto iter_end = iter + 1;
+
+            while (iter_end != this->end() && iter_end->get_sub_offset() != 0) {
+                ++iter_end;
+            }
+            this->lf_logline_observer->logline_new_lines(
+                *this, iter, iter_end, sbr);
+        });
+    }
+}
+
+void
+logline_observer::logline_new_batch(const logfile& lf,
+                                    logfile::const_iterator ll_begin,
+                                    logfile::const_iterator ll_end,
+                                    line_span& span)
+{
+    shared_buffer_ref sbr;
+
+    if (!this->logline_needs_content()) {
+        this->logline_new_lines(lf, ll_begin, ll_end, sbr);
+        return;
+    }
+
+    auto li_iter = span.ls_begin;
+
+    while (ll_begin != ll_end) {
+        auto msg_end = std::next(ll_begin);
+
+        while (msg_end != ll_end
+               && msg_end->get_offset() == ll_begin->get_offset())
+        {
+            ++msg_end;
+        }
+        while (li_iter != span.ls_end
+               && li_iter->li_file_range.fr_offset < ll_begin->get_offset())
+        {
+            ++li_iter;
+        }
+        if (li_iter != span.ls_end) {
+            span.line_ref(*li_iter, sbr);
+        }
+        this->logline_new_lines(lf, ll_begin, msg_end, sbr);
+        ll_begin = msg_end;
+    }
+}
+
+/**
+ * Find the start of the first line at or after the given offset.
+ */
+static nonstd::optional<file_off_t>
+find_line_start(int fd, file_off_t off, file_off_t limit)
+{
+    char buffer[16 * 1024];
+
+    if (off == 0) {
+        return off;
+    }
+
+    // Start at the previous byte in case the offset is already the start of
+    // a line.
+    off -= 1;
+    while (off < limit) {
+        auto rc = pread(fd, buffer, sizeof(buffer), off);
+
+        if (rc <= 0) {
+            return nonstd::nullopt;
+        }
+
+        auto* eol = (const char*) memchr(buffer, '\n', rc);
+        if (eol != nullptr) {
+            auto retval = off + (eol - buffer) + 1;
+
+            if (retval >= limit) {
+                return nonstd::nullopt;
+            }
+            return retval;
+        }
+        off += rc;
+    }
+
+    return nonstd::nullopt;
+}
+
+std::unique_ptr<logfile::parallel_scan>
+logfile::start_parallel_scan(file_off_t off, const struct stat& st)
+{
+    static const size_t MAX_PROBE_LINES = 1000;
+    static const file_off_t TAIL_SIZE = 64 * 1024;
+
+    const auto& cfg = injector::get<const lnav::logfile::config&>();
+    const auto min_chunk_size = (file_off_t) cfg.lc_scan_chunk_size;
+    auto* elf = dynamic_cast<external_log_format*>(this->lf_format.get());
+    auto thread_count = lnav::logfile::index_thread_count();
+
+    if (elf == nullptr || elf->elf_type != external_log_format::elf_type_t::ELF_TYPE_TEXT
+        || thread_count <= 1 || this->is_compressed()
+        || this->lf_line_buffer.is_pipe()
+        || (st.st_size - off) < min_chunk_size * 2
+        || (st.st_size - off) < TAIL_SIZE * 2)
+    {
+        return nullptr;
+    }
+
+    auto chunk_count = std::min(
+        (size_t) thread_count, (size_t) ((st.st_size - off) / min_chunk_size));
+    auto fd = this->lf_line_buffer.get_fd();
+    auto retval = std::make_unique<parallel_scan>();
+    auto_fd probe_fd(dup(fd));
+    line_buffer probe_lb;
+    auto probe_format = std::make_shared<external_log_format>(*elf);
+    logline_store probe_index;
+
+    if (probe_fd == -1) {
+        return nullptr;
+    }
+    probe_lb.set_fd(probe_fd);
+
+    // The first chunk is indexed by the caller, so find the start of the
+    // remaining chunks.  Each chunk needs to start with a line that the
+    // format recognizes so that the chunk does not depend on the lines that
+    // come before it.
+    std::vector<file_off_t> starts;
+    for (size_t lpc = 1; lpc <= chunk_count; lpc++) {
+        auto nominal = off + (st.st_size - off) * lpc / chunk_count;
+        if (lpc == chunk_count) {
+            // Leave the tail of the file, which might have a partial line,
+            // to the caller.
+            nominal = st.st_size - TAIL_SIZE;
+        }
+        auto line_start_opt = find_line_start(fd, nominal, st.st_size);
+
+        if (!line_start_opt) {
+            break;
+        }
+        if (lpc == chunk_count) {
+            retval->ps_end = line_start_opt.value();
+            break;
+        }
+
+        auto prev_range = file_range{line_start_opt.value()};
+        nonstd::optional<file_off_t> message_start;
+        for (size_t probe_count = 0; probe_count < MAX_PROBE_LINES;
+             probe_count++) {
+            auto load_result = probe_lb.load_next_line(prev_range);
+
+            if (load_result.isErr()) {
+                break;
+            }
+
+            auto li = load_result.unwrap();
+            if (li.li_file_range.empty() || li.li_partial) {
+                break;
+            }
+            prev_range = li.li_file_range;
+
+            auto read_result = probe_lb.read_range(li.li_file_range);
+            if (read_result.isErr()) {
+                break;
+            }
+
+            auto sbr = read_result.unwrap().rtrim(is_line_ending);
+            probe_index.clear();
+            probe_index.emplace_back(0, 0, 0, LEVEL_UNKNOWN);
+            auto found = probe_format->scan(*this, probe_index, li, sbr);
+            if (found == log_format::SCAN_MATCH && probe_index.size() > 1
+                && probe_index.back().get_msg_level() != LEVEL_INVALID
+                && !probe_index.back().is_continued())
+            {
+                message_start = li.li_file_range.fr_offset;
+                break;
+            }
+        }
+
+        if (!message_start) {
+            continue;
+        }
+        if (!starts.empty() && message_start.value() <= starts.back()) {
+            continue;
+        }
+        starts.emplace_back(message_start.value());
+    }
+
+    if (starts.empty() || retval->ps_end <= starts.back()) {
+        return nullptr;
+    }
+
+    auto last_pattern = elf->last_pattern_index();
+    for (size_t lpc = 0; lpc < starts.size(); lpc++) {
+        parallel_scan::chunk ch;
+
+        ch.c_start = starts[lpc];
+        ch.c_end = lpc + 1 < starts.size() ? starts[lpc + 1] : retval->ps_end;
+        // The copies of the format need to be made and destroyed on this
+        // thread since the pcre reference counts are not atomic.
+        ch.c_format = std::make_shared<external_log_format>(*elf);
+        ch.c_format->lf_pattern_locks.clear();
+        if (last_pattern != -1) {
+            ch.c_format->lf_pattern_locks.emplace_back(0, last_pattern);
+        }
+        for (auto& stats : ch.c_format->lf_value_stats) {
+            stats.clear();
+        }
+        ch.c_format->lf_rollover_count = 0;
+        retval->ps_chunks.emplace_back(std::move(ch));
+    }
+
+    log_info("%s: scanning %d chunks in parallel from %lld to %lld",
+             this->lf_filename.c_str(),
+             retval->ps_chunks.size() + 1,
+             off,
+             retval->ps_end);
+
+    auto non_utf_is_visible = this->lf_options.loo_non_utf_is_visible;
+    auto index_time = this->lf_index_time;
+    auto* ps = retval.get();
+    for (auto& ch : retval->ps_chunks) {
+        retval->ps_workers.emplace_back(std::async(
+            std::launch::async,
+            [this, ps, &ch, fd, non_utf_is_visible, index_time]() {
+                try {
+                    auto_fd chunk_fd(dup(fd));
+                    line_buffer lb;
+
+                    if (chunk_fd == -1) {
+                        return;
+                    }
+                    lb.set_fd(chunk_fd);
+
+                    auto prev_range = file_range{ch.c_start};
+                    while (prev_range.next_offset() < ch.c_end) {
+                        if (ps->ps_abort) {
+                            return;
+                        }
+
+                        auto load_result = lb.load_next_line(prev_range);
+                        if (load_result.isErr()) {
+                            return;
+                        }
+
+                        auto li = load_result.unwrap();
+                        if (li.li_file_range.empty() || li.li_partial
+                            || (!non_utf_is_visible && !li.li_valid_utf))
+                        {
+                            return;
+                        }
+                        prev_range = li.li_file_range;
+
+                        auto read_result = lb.read_range(li.li_file_range);
+                        if (read_result.isErr()) {
+                            return;
+                        }
+
+                        auto sbr = read_result.unwrap().rtrim(is_line_ending);
+                        auto prescan_size = ch.c_index.size();
+                        time_t prescan_time = 0;
+
+                        if (prescan_size > 0) {
+                            prescan_time = ch.c_index.back().get_time();
+                        }
+                        ch.c_longest_line
+                            = std::max(ch.c_longest_line, sbr.length());
+                        auto found
+                            = ch.c_format->scan(*this, ch.c_index, li, sbr);
+                        if (ch.c_index.empty()) {
+                            return;
+                        }
+                        ch.c_sort_needed
+                            = apply_scan_result(found,
+                                                ch.c_format.get(),
+                                                ch.c_index,
+                                                prescan_size,
+                                                prescan_time,
+                                                index_time,
+                                                li,
+                                                ch.c_out_of_time_order_count)
+                            || ch.c_sort_needed;
+                    }
+
+                    // A rollover in the middle of a chunk would need to
+                    // adjust the lines in the previous chunks too.
+                    ch.c_valid = prev_range.next_offset() == ch.c_end
+                        && ch.c_format->lf_rollover_count == 0;
+                } catch (const line_buffer::error& e) {
+                    log_error("parallel scan failed -- %s", strerror(e.e_err));
+                }
+            }));
+    }
+
+    return retval;
+}
+
+bool
+logfile::finish_parallel_scan(parallel_scan& ps, bool& sort_needed)
+{
+    for (auto& worker : ps.ps_workers) {
+        worker.get();
+    }
+
+    nonstd::optional<logline> prev_line;
+    if (!this->lf_index.empty()) {
+        prev_line = this->lf_index.back();
+    }
+    for (const auto& ch : ps.ps_chunks) {
+        if (!ch.c_valid) {
+            log_info("%s: parallel scan of chunk %lld-%lld failed",
+                     this->lf_filename.c_str(),
+                     ch.c_start,
+                     ch.c_end);
+            return false;
+        }
+
+        // The time adjustments done when a line is out of order depend on
+        // all of the lines before it, so leave these cases to the serial
+        // path.
+        if (prev_line && !prev_line->is_ignored()
+            && ch.c_index.front() < *prev_line)
+        {
+            log_info("%s: chunk at %lld is out of order, scanning serially",
+                     this->lf_filename.c_str(),
+                     ch.c_start);
+            return false;
+        }
+        prev_line = ch.c_index.back();
+    }
+
+    auto* elf = dynamic_cast<external_log_format*>(this->lf_format.get());
+    auto begin_size = this->lf_index.size();
+    size_t total_lines = 0;
+
+    for (const auto& ch : ps.ps_chunks) {
+        total_lines += ch.c_index.size();
+    }
+    this->lf_index.reserve(this->lf_index.size() + total_lines);
+    for (auto& ch : ps.ps_chunks) {
+        auto base = this->lf_index.size();
+
+        for (const auto& pfl : ch.c_format->lf_pattern_locks) {
+            if (pfl.pfl_pat_index == elf->last_pattern_index()) {
+                continue;
+            }
+            elf->lf_pattern_locks.emplace_back(base + pfl.pfl_line,
+                                               pfl.pfl_pat_index);
+        }
+        for (size_t lpc = 0; lpc < elf->lf_value_stats.size(); lpc++) {
+            elf->lf_value_stats[lpc].merge(ch.c_format->lf_value_stats[lpc]);
+        }
+        this->lf_index.append(ch.c_index);
+        this->lf_longest_line
+            = std::max(this->lf_longest_line, ch.c_longest_line);
+        this->lf_out_of_time_order_count += ch.c_out_of_time_order_count;
+        sort_needed = sort_needed || ch.c_sort_needed;
+    }
+    this->lf_partial_line = false;
+
+    this->replay_new_lines(this->begin() + begin_size);
+
+    return true;
+}
+
 void
 logfile::reobserve_from(iterator iter)
 {
@@ -710,8 +2146,8 @@ logfile::reobserve_from(iterator iter)
     if (this->lf_logfile_observer != nullptr) {
         this->lf_logfile_observer->logfile_indexing(
             this->shared_from_this(), this->size(), this->size());
-        this->lf_logline_observer->logline_eof(*this);
     }
+    this->lf_logline_observer->logline_eof(*this);
 }
 
 ghc::filesystem::path
@@ -796,3 +2232,51 @@ logfile::mark_as_duplicate(const std::string& name)
         note_type::duplicate,
         fmt::format(FMT_STRING("hiding duplicate of {}"), name));
 }
+
+namespace lnav {
+namespace logfile {
+
+void
+cleanup_index_cache()
+{
+    (void) std::async(std::launch::async, []() {
+        auto now = std::chrono::system_clock::now();
+        auto cache_path = index_cache_path();
+        const auto& cfg = injector::get<const config&>();
+        std::vector<ghc::filesystem::path> to_remove;
+        std::error_code ec;
+
+        log_debug("index-cache-ttl %d", cfg.lc_index_cache_ttl.count());
+        for (const auto& entry :
+             ghc::filesystem::directory_iterator(cache_path, ec))
+        {
+            auto mtime = ghc::filesystem::last_write_time(entry.path());
+            auto exp_time = mtime + cfg.lc_index_cache_ttl;
+            if (now < exp_time) {
+                continue;
+            }
+
+            to_remove.emplace_back(entry.path());
+        }
+
+        for (auto& entry : to_remove) {
+            log_debug("removing cached index: %s", entry.c_str());
+            ghc::filesystem::remove(entry, ec);
+        }
+    });
+}
+
+size_t
+index_thread_count()
+{
+    const auto& cfg = injector::get<const config&>();
+
+    if (cfg.lc_index_threads > 0) {
+        return cfg.lc_index_threads;
+    }
+
+    return std::min(std::thread::hardware_concurrency(), 8U);
+}
+
+}  // namespace logfile
+}  // namespace lnav
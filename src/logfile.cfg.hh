@@ -32,11 +32,20 @@
 #ifndef lnav_logfile_cfg_hh
 #define lnav_logfile_cfg_hh
 
+#include <chrono>
+
 namespace lnav {
 namespace logfile {
 
 struct config {
     int64_t lc_max_unrecognized_lines{15000};
+    int64_t lc_index_cache_min_size{16 * 1024 * 1024};
+    std::chrono::seconds lc_index_cache_ttl{std::chrono::hours(7 * 24)};
+    int64_t lc_index_threads{0};
+    int64_t lc_scan_chunk_size{16 * 1024 * 1024};
+    bool lc_compact_index{true};
+    int64_t lc_mmap_min_size{4 * 1024 * 1024};
+    std::chrono::seconds lc_mmap_min_age{std::chrono::minutes(10)};
 };
 
 }  // namespace logfile
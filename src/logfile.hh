@@ -33,6 +33,8 @@
 #ifndef logfile_hh
 #define logfile_hh
 
+#include <algorithm>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -43,6 +45,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "base/literal_set.hh"
 #include "base/lnav_log.hh"
 #include "base/result.h"
 #include "byte_array.hh"
@@ -88,6 +91,46 @@ struct logfile_activity {
     };
 };
 
+/**
+ * The values of a single numeric format field in a file, stored as compact
+ * arrays in line order.  The columns are filled in lazily by
+ * logfile::index_values_to() so that scans over a field, like the ones done
+ * for a spectrogram, do not need to read and annotate the messages again.
+ */
+struct logfile_value_column {
+    union value_t {
+        int64_t i;
+        double d;
+    };
+
+    /** True if the values are integers, false if they are floats. */
+    bool lvc_integer{false};
+    /** The lines, relative to the start of the file, that have a value. */
+    std::vector<uint32_t> lvc_lines;
+    std::vector<value_t> lvc_values;
+
+    /**
+     * @param line_number A line number that is covered by the index.
+     * @return The value for the line or nullptr if it does not have one.
+     */
+    const value_t* value_for(uint32_t line_number) const
+    {
+        auto iter = std::lower_bound(
+            this->lvc_lines.begin(), this->lvc_lines.end(), line_number);
+
+        if (iter == this->lvc_lines.end() || *iter != line_number) {
+            return nullptr;
+        }
+
+        return &this->lvc_values[std::distance(this->lvc_lines.begin(), iter)];
+    }
+
+    double to_double(const value_t& val) const
+    {
+        return this->lvc_integer ? (double) val.i : val.d;
+    }
+};
+
 /**
  * Container for the lines in a log file and some metadata.
  */
@@ -95,8 +138,15 @@ class logfile
     : public unique_path_source
     , public std::enable_shared_from_this<logfile> {
 public:
-    typedef std::vector<logline>::iterator iterator;
-    typedef std::vector<logline>::const_iterator const_iterator;
+    typedef logline_store::iterator iterator;
+    typedef logline_store::const_iterator const_iterator;
+
+    /**
+     * The number of lines that the value index can be extended by to cover
+     * a single line.  Larger gaps are left to the caller so that looking at
+     * a few lines does not end up indexing most of a file.
+     */
+    static constexpr size_t VALUE_INDEX_MAX_GAP = 1024;
 
     /**
      * Construct a logfile with the given arguments.
@@ -170,6 +220,14 @@ public:
         return this->lf_line_buffer.is_compressed();
     };
 
+    /**
+     * @return A duplicate of the file descriptor that can be used to read
+     * the text of lines from another thread or nullptr if read_line() does
+     * not return the text as it is in the file, like when the file is
+     * compressed or its format renders the lines.
+     */
+    std::shared_ptr<auto_fd> get_shared_fd();
+
     bool is_valid_filename() const
     {
         return this->lf_valid_filename;
@@ -227,7 +285,7 @@ public:
         } else {
             timeradd(&old_time, &tv, &this->lf_time_offset);
         }
-        for (auto& iter : *this) {
+        for (auto&& iter : *this) {
             struct timeval curr, diff, new_time;
 
             curr = iter.get_timeval();
@@ -299,12 +357,12 @@ public:
     nonstd::optional<const_iterator> find_from_time(
         const struct timeval& tv) const;
 
-    logline& operator[](int index)
+    logline_store::reference operator[](int index)
     {
         return this->lf_index[index];
     };
 
-    logline& front()
+    logline_store::reference front()
     {
         return this->lf_index.front();
     }
@@ -380,6 +438,26 @@ public:
 
     Result<shared_buffer_ref, std::string> read_raw_message(const_iterator ll);
 
+    /**
+     * Extend the index of numeric values to cover the messages up to and
+     * including the given line.  The last message in the file is never
+     * indexed since more lines can still be added to it.
+     *
+     * @param line_number The line, relative to the start of the file.
+     * @param max_lines The maximum number of lines that can be indexed by
+     *   this call.
+     * @return True if the index covers the given line.
+     */
+    bool index_values_to(size_t line_number,
+                         size_t max_lines = VALUE_INDEX_MAX_GAP);
+
+    /**
+     * @param name The name of a numeric field in the file's format.
+     * @return The indexed values for the field or nullptr if the field is
+     *   not a numeric field in this file.
+     */
+    const logfile_value_column* get_value_column(const intern_string_t name);
+
     enum class rebuild_result_t {
         INVALID,
         NO_NEW_LINES,
@@ -397,6 +475,30 @@ public:
     rebuild_result_t rebuild_index(
         nonstd::optional<ui_clock::time_point> deadline = nonstd::nullopt);
 
+    /**
+     * @return True if there is new data in this file that can be indexed
+     * using rebuild_index_in_background().  Only files that have already been
+     * matched to an external format are eligible since format detection and
+     * the builtin formats share state between files.
+     */
+    bool can_index_in_background() const;
+
+    /**
+     * Index any new data in the log file from a worker thread.  The
+     * observers are not called during indexing, instead, the caller must
+     * call finish_background_index() from the main thread once all of the
+     * workers are done.  Nothing else may access this file while it is being
+     * indexed.
+     */
+    rebuild_result_t rebuild_index_in_background(
+        nonstd::optional<ui_clock::time_point> deadline = nonstd::nullopt);
+
+    /**
+     * Deliver the observer notifications that were deferred by
+     * rebuild_index_in_background().
+     */
+    void finish_background_index();
+
     void reobserve_from(iterator iter);
 
     void set_logfile_observer(logfile_observer* lo)
@@ -431,6 +533,28 @@ public:
         return this->lf_indexing;
     }
 
+    /**
+     * Mark this file as having its changes reported by a file_watcher.  The
+     * file will then only be checked for new lines after mark_changed() is
+     * called.
+     */
+    void set_watched(bool watched)
+    {
+        this->lf_watched = watched;
+        this->lf_changed = true;
+    }
+
+    bool is_watched() const
+    {
+        return this->lf_watched;
+    }
+
+    /** Called when the file has been written to, truncated, or moved. */
+    void mark_changed()
+    {
+        this->lf_changed = true;
+    }
+
     /** Check the invariants for this object. */
     bool invariant()
     {
@@ -465,8 +589,65 @@ protected:
      */
     bool process_prefix(shared_buffer_ref& sbr, const line_info& li);
 
+    /**
+     * Process a span of lines from the file with the format that has
+     * already been detected.
+     *
+     * @return True if the index needs to be sorted.
+     */
+    bool process_span(line_span& span);
+
     void set_format_base_time(log_format* lf);
 
+    /**
+     * Try to restore the index from the on-disk cache that was saved the
+     * last time this file was indexed.
+     *
+     * @param st The current stat() of the file.
+     * @return True if the index was restored.
+     */
+    bool load_index_cache(const struct stat& st);
+
+    /**
+     * Save the index to the on-disk cache if the file is large enough and
+     * the index has grown enough since the last time it was saved.
+     *
+     * @param st The stat() of the file that was used while indexing.
+     */
+    void save_index_cache(const struct stat& st);
+
+    struct parallel_scan;
+
+    /**
+     * Split the data after the given offset into line-aligned chunks and
+     * start scanning all but the first chunk on worker threads.  The caller
+     * is expected to index the first chunk as usual and then call
+     * finish_parallel_scan() when it reaches the start of the second chunk.
+     *
+     * @param off The offset of the next line to be indexed.
+     * @param st The current stat() of the file.
+     * @return The pending scan or nullptr if there is not enough data to
+     * make it worthwhile.
+     */
+    std::unique_ptr<parallel_scan> start_parallel_scan(file_off_t off,
+                                                       const struct stat& st);
+
+    /**
+     * Wait for the workers of a parallel scan and append their lines to the
+     * index.
+     *
+     * @param ps The scan returned by start_parallel_scan().
+     * @param sort_needed Set to true if the new lines require a sort.
+     * @return False if the results could not be used and the chunks need to
+     * be indexed serially.
+     */
+    bool finish_parallel_scan(parallel_scan& ps, bool& sort_needed);
+
+    /**
+     * Pass the lines starting at the given iterator to the logline observer.
+     */
+    void replay_new_lines(iterator iter);
+
 private:
     logfile(std::string filename, logfile_open_options& loo);
 
@@ -481,11 +662,14 @@ private:
     struct stat lf_stat {
     };
     std::shared_ptr<log_format> lf_format;
-    std::vector<logline> lf_index;
+    /** The detection literals found in the line being used to find a format. */
+    literal_set::match_set lf_detection_matches;
+    logline_store lf_index;
     time_t lf_index_time{0};
     file_off_t lf_index_size{0};
     bool lf_sort_needed{false};
     line_buffer lf_line_buffer;
+    std::shared_ptr<auto_fd> lf_shared_fd;
     int lf_time_offset_line{0};
     struct timeval lf_time_offset {
         0, 0
@@ -499,8 +683,21 @@ private:
     text_format_t lf_text_format{text_format_t::TF_UNKNOWN};
     uint32_t lf_out_of_time_order_count{0};
     safe_notes lf_notes;
+    std::map<intern_string_t, logfile_value_column> lf_value_columns;
+    /** The names of the fields that did not have consistent numeric values. */
+    std::set<intern_string_t> lf_unindexed_values;
+    /** The number of lines covered by lf_value_columns. */
+    size_t lf_value_index_lines{0};
 
     nonstd::optional<std::pair<file_off_t, size_t>> lf_next_line_cache;
+    bool lf_index_cache_checked{false};
+    file_off_t lf_index_cache_size{0};
+    bool lf_indexing_in_background{false};
+    nonstd::optional<std::pair<size_t, size_t>> lf_deferred_restart;
+    /** A parallel scan whose first chunk is still being indexed. */
+    std::unique_ptr<parallel_scan> lf_pending_scan;
+    bool lf_watched{false};
+    bool lf_changed{true};
 };
 
 class logline_observer {
@@ -516,7 +713,47 @@ public:
                                    shared_buffer_ref& sbr)
         = 0;
 
+    /**
+     * Called with the lines that were indexed from a span of lines in the
+     * file.  The default implementation passes the lines for each message
+     * to logline_new_lines() along with the message's content.
+     *
+     * @param ll_begin The first logline that was added.
+     * @param ll_end The end of the loglines that were added.
+     * @param span The lines from the file that the loglines came from.
+     */
+    virtual void logline_new_batch(const logfile& lf,
+                                   logfile::const_iterator ll_begin,
+                                   logfile::const_iterator ll_end,
+                                   line_span& span);
+
     virtual void logline_eof(const logfile& lf) = 0;
+
+    /**
+     * @return True if logline_new_lines() needs the content of each line.
+     * Otherwise, a batch of lines can be passed along with an empty buffer.
+     */
+    virtual bool logline_needs_content() const
+    {
+        return true;
+    }
 };
 
+namespace lnav {
+namespace logfile {
+
+/**
+ * Remove cached line indexes that have outlived their time-to-live.
+ */
+void cleanup_index_cache();
+
+/**
+ * @return The number of threads to use when indexing, based on the
+ * "/tuning/logfile/index-threads" configuration property.
+ */
+size_t index_thread_count();
+
+}  // namespace logfile
+}  // namespace lnav
+
 #endif
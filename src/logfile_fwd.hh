@@ -37,6 +37,7 @@
 
 #include "base/auto_fd.hh"
 #include "file_format.hh"
+#include "logline_store.hh"
 
 using ui_clock = std::chrono::steady_clock;
 
@@ -44,7 +45,7 @@ class logfile;
 class logline;
 class logline_observer;
 
-using logfile_const_iterator = std::vector<logline>::const_iterator;
+using logfile_const_iterator = logline_store::const_iterator;
 
 enum class logfile_name_source {
     USER,
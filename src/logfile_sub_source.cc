@@ -28,7 +28,9 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <future>
+#include <thread>
 
 #include "logfile_sub_source.hh"
 
@@ -36,11 +38,13 @@
 
 #include "base/ansi_scrubber.hh"
 #include "base/humanize.time.hh"
+#include "base/injector.hh"
 #include "base/string_util.hh"
 #include "command_executor.hh"
 #include "config.h"
 #include "k_merge_tree.h"
 #include "log_accel.hh"
+#include "logfile.cfg.hh"
 #include "relative_time.hh"
 #include "sql_util.hh"
 #include "yajlpp/yajlpp.hh"
@@ -179,17 +183,13 @@ logfile_sub_source::text_value_for_line(textview_curses& tc,
     this->lss_token_attrs.clear();
     this->lss_token_values.clear();
     this->lss_share_manager.invalidate_refs();
-    if (flags & text_sub_source::RF_FULL) {
-        shared_buffer_ref sbr;
 
-        this->lss_token_file->read_full_message(this->lss_token_line, sbr);
-        this->lss_token_value = to_string(sbr);
-    } else {
-        this->lss_token_value
-            = this->lss_token_file->read_line(this->lss_token_line)
-                  .map([](auto sbr) { return to_string(sbr); })
-                  .unwrapOr({});
-    }
+    auto annotated
+        = this->annotate_line(this->lss_token_file_data, line, flags);
+
+    this->lss_token_value = annotated->al_value;
+    this->lss_token_attrs = annotated->al_attrs;
+    this->lss_token_values = annotated->al_values;
     this->lss_token_shift_start = 0;
     this->lss_token_shift_size = 0;
 
@@ -205,17 +205,6 @@ logfile_sub_source::text_value_for_line(textview_curses& tc,
     sbr.share(this->lss_share_manager,
               (char*) this->lss_token_value.c_str(),
               this->lss_token_value.size());
-    if (this->lss_token_line->is_continued()) {
-        this->lss_token_attrs.emplace_back(
-            line_range{0, (int) this->lss_token_value.length()},
-            SA_BODY.value());
-    } else {
-        format->annotate(
-            line, sbr, this->lss_token_attrs, this->lss_token_values);
-    }
-    if (this->lss_token_line->get_sub_offset() != 0) {
-        this->lss_token_attrs.clear();
-    }
     if (flags & RF_REWRITE) {
         exec_context ec(
             &this->lss_token_values, pretty_sql_callback, pretty_pipe_callback);
@@ -336,13 +325,150 @@ logfile_sub_source::text_value_for_line(textview_curses& tc,
     this->lss_in_value_for_line = false;
 }
 
+std::shared_ptr<logfile_sub_source::annotated_line>
+logfile_sub_source::annotate_line(iterator ld,
+                                  content_line_t line,
+                                  line_flags_t flags)
+{
+    auto* lf = (*ld)->get_file_ptr();
+    auto ll = lf->begin() + line;
+    annotation_key key{
+        lf,
+        (*ld)->ld_generation,
+        ll->get_offset(),
+        ll->get_sub_offset(),
+        (flags & text_sub_source::RF_FULL) != 0,
+    };
+    auto cached = this->lss_annotation_cache.get(key);
+
+    if (cached) {
+        return cached.value();
+    }
+
+    auto retval = std::make_shared<annotated_line>();
+    auto format = lf->get_format();
+    shared_buffer share_manager;
+    shared_buffer_ref sbr;
+
+    if (key.ak_full) {
+        shared_buffer_ref full_sbr;
+
+        lf->read_full_message(ll, full_sbr);
+        retval->al_value = to_string(full_sbr);
+    } else {
+        retval->al_value = lf->read_line(ll)
+                               .map([](auto sbr) { return to_string(sbr); })
+                               .unwrapOr({});
+    }
+
+    sbr.share(share_manager,
+              (char*) retval->al_value.c_str(),
+              retval->al_value.size());
+    if (ll->is_continued()) {
+        retval->al_attrs.emplace_back(
+            line_range{0, (int) retval->al_value.length()}, SA_BODY.value());
+    } else {
+        format->annotate(line, sbr, retval->al_attrs, retval->al_values);
+    }
+    if (ll->get_sub_offset() != 0) {
+        retval->al_attrs.clear();
+    }
+    // The values can refer to buffers that are reused for the next line, so
+    // they need their own copies before they are cached.
+    for (auto& lv : retval->al_values) {
+        lv.lv_sbr.take_ownership();
+    }
+
+    this->lss_annotation_cache.put(key, retval);
+
+    return retval;
+}
+
+void
+logfile_sub_source::drop_stale_annotations(const logfile_data& ld)
+{
+    auto* lf = ld.get_file_ptr();
+    file_off_t tail_offset = 0;
+    auto tail_lines = std::min(ld.ld_lines_indexed, lf->size());
+
+    if (tail_lines > 0) {
+        auto ll = lf->begin() + tail_lines - 1;
+
+        while (ll != lf->begin() && ll->is_continued()) {
+            --ll;
+        }
+        tail_offset = ll->get_offset();
+    }
+
+    this->lss_annotation_cache.erase_range(
+        annotation_key{lf, ld.ld_generation, tail_offset, 0, false},
+        annotation_key{lf, ld.ld_generation + 1, 0, 0, false});
+}
+
+void
+logfile_sub_source::prefetch_lines(textview_curses& tc,
+                                   ui_clock::time_point deadline)
+{
+    if (this->lss_in_value_for_line || this->lss_filtered_index.empty()) {
+        return;
+    }
+
+    vis_line_t height;
+    unsigned long width;
+
+    tc.get_dimensions(height, width);
+
+    auto top = tc.get_top();
+    auto bottom = std::min(top + height + height,
+                           vis_line_t(this->lss_filtered_index.size()));
+
+    // The page below is done first since scrolling down is more common.
+    for (auto vl = top + height; vl < bottom; ++vl) {
+        if (ui_clock::now() >= deadline) {
+            return;
+        }
+
+        auto cl = this->at(vl);
+        auto ld = this->find_data(cl);
+
+        this->annotate_line(ld, cl, 0);
+    }
+    for (auto vl = std::max(0_vl, top - height); vl < top; ++vl) {
+        if (ui_clock::now() >= deadline) {
+            return;
+        }
+
+        auto cl = this->at(vl);
+        auto ld = this->find_data(cl);
+
+        this->annotate_line(ld, cl, 0);
+    }
+}
+
+nonstd::optional<grep_line_location>
+logfile_sub_source::text_location_for_line(textview_curses& tc, int row)
+{
+    content_line_t line = this->at(vis_line_t(row));
+    auto lf = this->find(line);
+    auto fd = lf->get_shared_fd();
+
+    if (fd == nullptr) {
+        return nonstd::nullopt;
+    }
+
+    auto ll = lf->begin() + line;
+
+    return grep_line_location{
+        fd, lf->get_file_range(ll, false), ll->is_valid_utf()};
+}
+
 void
 logfile_sub_source::text_attrs_for_line(textview_curses& lv,
                                         int row,
                                         string_attrs_t& value_out)
 {
     view_colors& vc = view_colors::singleton();
-    logline* next_line = nullptr;
+    nonstd::optional<logline> next_line;
     struct line_range lr;
     int time_offset_end = 0;
     int attrs = 0;
@@ -352,10 +478,10 @@ logfile_sub_source::text_attrs_for_line(textview_curses& lv,
     attrs = vc.vc_level_attrs[this->lss_token_line->get_msg_level()].first;
 
     if ((row + 1) < (int) this->lss_filtered_index.size()) {
-        next_line = this->find_line(this->at(vis_line_t(row + 1)));
+        next_line = *this->find_line(this->at(vis_line_t(row + 1)));
     }
 
-    if (next_line != nullptr
+    if (next_line
         && (day_num(next_line->get_time())
             > day_num(this->lss_token_line->get_time())))
     {
@@ -611,13 +737,113 @@ logfile_sub_source::text_attrs_for_line(textview_curses& lv,
     }
 }
 
+std::vector<nonstd::optional<logfile::rebuild_result_t>>
+logfile_sub_source::rebuild_indexes_in_parallel(
+    nonstd::optional<ui_clock::time_point> deadline)
+{
+    std::vector<nonstd::optional<logfile::rebuild_result_t>> retval(
+        this->lss_files.size());
+    auto thread_count = lnav::logfile::index_thread_count();
+
+    if (thread_count <= 1 || this->tss_view->is_paused()) {
+        return retval;
+    }
+
+    std::vector<size_t> eligible;
+    for (size_t lpc = 0; lpc < this->lss_files.size(); lpc++) {
+        auto* lf = this->lss_files[lpc]->get_file_ptr();
+
+        if (lf != nullptr && lf->can_index_in_background()) {
+            eligible.emplace_back(lpc);
+        }
+    }
+    if (eligible.size() < 2) {
+        return retval;
+    }
+
+    std::atomic<size_t> next_file{0};
+    std::vector<std::future<void>> workers;
+
+    thread_count = std::min(thread_count, eligible.size());
+    log_debug("indexing %d files with %d threads",
+              eligible.size(),
+              thread_count);
+    for (size_t lpc = 0; lpc < thread_count; lpc++) {
+        workers.emplace_back(std::async(std::launch::async, [&]() {
+            for (auto pos = next_file++; pos < eligible.size();
+                 pos = next_file++) {
+                auto file_index = eligible[pos];
+                auto* lf = this->lss_files[file_index]->get_file_ptr();
+
+                retval[file_index] = lf->rebuild_index_in_background(deadline);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.wait();
+    }
+
+    // The observers update the filter state and the UI, so they need to be
+    // called from this thread and in a fixed order.
+    for (const auto file_index : eligible) {
+        this->lss_files[file_index]->get_file_ptr()->finish_background_index();
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    return retval;
+}
+
+namespace {
+
+/**
+ * An iterator over some of the lines in a logfile that are to be merged
+ * into the index.  If the lines are already in time order, the iterator
+ * walks the logfile directly.  Otherwise, it walks a list of line numbers
+ * that has been sorted by time.
+ */
+struct merge_line_iterator {
+    logfile* mli_file{nullptr};
+    const uint32_t* mli_order{nullptr};
+    size_t mli_pos{0};
+
+    size_t line_number() const
+    {
+        return this->mli_order != nullptr ? this->mli_order[this->mli_pos]
+                                          : this->mli_pos;
+    }
+
+    logline operator*() const
+    {
+        return (*this->mli_file)[this->line_number()];
+    }
+
+    merge_line_iterator& operator++()
+    {
+        this->mli_pos += 1;
+        return *this;
+    }
+
+    bool operator==(const merge_line_iterator& rhs) const
+    {
+        return this->mli_pos == rhs.mli_pos;
+    }
+
+    bool operator!=(const merge_line_iterator& rhs) const
+    {
+        return this->mli_pos != rhs.mli_pos;
+    }
+};
+
+}  // namespace
+
 logfile_sub_source::rebuild_result
 logfile_sub_source::rebuild_index(
     nonstd::optional<ui_clock::time_point> deadline)
 {
     iterator iter;
     size_t total_lines = 0;
-    bool full_sort = false;
     int file_count = 0;
     bool force = this->lss_force_rebuild;
     auto retval = rebuild_result::rr_no_change;
@@ -631,6 +857,11 @@ logfile_sub_source::rebuild_index(
     }
 
     std::vector<size_t> file_order(this->lss_files.size());
+    // Files whose existing lines have changed order and need to be merged
+    // into the index again from the start.
+    std::vector<bool> reorder(this->lss_files.size());
+    // The line numbers to be merged from files that are not in time order.
+    std::vector<std::vector<uint32_t>> merge_orders(this->lss_files.size());
 
     for (size_t lpc = 0; lpc < file_order.size(); lpc++) {
         file_order[lpc] = lpc;
@@ -654,6 +885,7 @@ logfile_sub_source::rebuild_index(
                          });
     }
 
+    auto bg_results = this->rebuild_indexes_in_parallel(deadline);
     bool time_left = true;
     for (const auto file_index : file_order) {
         auto& ld = *(this->lss_files[file_index]);
@@ -673,12 +905,17 @@ logfile_sub_source::rebuild_index(
                 time_left = false;
             }
 
-            if (!this->tss_view->is_paused() && time_left) {
-                switch (lf->rebuild_index(deadline)) {
+            auto rebuild_res = bg_results[file_index];
+            if (!rebuild_res && !this->tss_view->is_paused() && time_left) {
+                rebuild_res = lf->rebuild_index(deadline);
+            }
+            if (rebuild_res) {
+                switch (rebuild_res.value()) {
                     case logfile::rebuild_result_t::NO_NEW_LINES:
                         // No changes
                         break;
                     case logfile::rebuild_result_t::NEW_LINES:
+                        this->drop_stale_annotations(ld);
                         if (retval == rebuild_result::rr_no_change) {
                             retval = rebuild_result::rr_appended_lines;
                         }
@@ -687,24 +924,35 @@ logfile_sub_source::rebuild_index(
                                   lf->size());
                         if (!this->lss_index.empty()
                             && lf->size() > ld.ld_lines_indexed) {
-                            logline& new_file_line = (*lf)[ld.ld_lines_indexed];
+                            auto new_line_iter
+                                = lf->begin() + ld.ld_lines_indexed;
+                            if (ld.ld_out_of_order) {
+                                new_line_iter = std::min_element(
+                                    new_line_iter, lf->end());
+                            }
+                            logline new_file_line = *new_line_iter;
                             content_line_t cl = this->lss_index.back();
-                            logline* last_indexed_line = this->find_line(cl);
+                            auto last_lf = this->find(cl);
+                            nonstd::optional<logline> last_indexed_line;
+
+                            if (last_lf != nullptr) {
+                                last_indexed_line = (*last_lf)[cl];
+                            }
 
                             // If there are new lines that are older than what
-                            // we have in the index, we need to resort.
-                            if (last_indexed_line == nullptr
+                            // we have in the index, we need to merge them in.
+                            if (!last_indexed_line
                                 || new_file_line
                                     < last_indexed_line->get_timeval())
                             {
                                 log_debug(
-                                    "%s:%ld: found older lines, full "
+                                    "%s:%ld: found older lines, partial "
                                     "rebuild: %p  %lld < %lld",
                                     lf->get_filename().c_str(),
                                     ld.ld_lines_indexed,
-                                    last_indexed_line,
+                                    last_lf.get(),
                                     new_file_line.get_time_in_millis(),
-                                    last_indexed_line == nullptr
+                                    !last_indexed_line
                                         ? (uint64_t) -1
                                         : last_indexed_line
                                               ->get_time_in_millis());
@@ -722,12 +970,25 @@ logfile_sub_source::rebuild_index(
                         }
                         break;
                     case logfile::rebuild_result_t::INVALID:
-                    case logfile::rebuild_result_t::NEW_ORDER:
-                        log_debug("%s: log file has a new order, full rebuild",
+                        log_debug("%s: log file is invalid, full rebuild",
                                   lf->get_filename().c_str());
                         retval = rebuild_result::rr_full_rebuild;
                         force = true;
-                        full_sort = true;
+                        ld.ld_out_of_order = true;
+                        ld.ld_sorted_lines = 0;
+                        ld.ld_generation += 1;
+                        break;
+                    case logfile::rebuild_result_t::NEW_ORDER:
+                        log_debug("%s: log file has a new order, re-merging",
+                                  lf->get_filename().c_str());
+                        if (retval <= rebuild_result::rr_partial_rebuild) {
+                            retval = rebuild_result::rr_partial_rebuild;
+                        }
+                        // Lines are only appended or shifted in time by the
+                        // same amount, so the sorted prefix is still valid.
+                        ld.ld_out_of_order = true;
+                        ld.ld_generation += 1;
+                        reorder[file_index] = true;
                         break;
                 }
             }
@@ -736,6 +997,17 @@ logfile_sub_source::rebuild_index(
         }
     }
 
+    if (this->lss_index_frozen
+        && (force || retval == rebuild_result::rr_partial_rebuild
+            || total_lines >= this->lss_index.ba_capacity))
+    {
+        // Only appending is allowed while frozen, so the index is rebuilt
+        // from scratch once it is thawed.
+        log_debug("index is frozen, deferring rebuild");
+        this->lss_force_rebuild = true;
+        return rebuild_result::rr_no_change;
+    }
+
     if (this->lss_index.empty() && !time_left) {
         return rebuild_result::rr_appended_lines;
     }
@@ -755,52 +1027,82 @@ logfile_sub_source::rebuild_index(
 
         this->lss_index.clear();
         this->lss_filtered_index.clear();
+        this->lss_annotation_cache.clear();
         this->lss_longest_line = 0;
         this->lss_basename_width = 0;
         this->lss_filename_width = 0;
         vis_bm[&textview_curses::BM_USER_EXPR].clear();
     } else if (retval == rebuild_result::rr_partial_rebuild) {
-        size_t remaining = 0;
-
-        log_debug("partial rebuild with lowest time: %ld",
-                  lowest_tv.value().tv_sec);
-        for (iter = this->lss_files.begin(); iter != this->lss_files.end();
-             iter++) {
-            logfile_data& ld = *(*iter);
-            auto lf = ld.get_file_ptr();
+        // Only the part of the index that comes after the oldest new line or
+        // the first line of a reordered file needs to be merged again.  The
+        // lines from that part are gathered up so they can be merged along
+        // with the new lines.
+        auto restart_tv = lowest_tv;
+        auto restart_end = this->lss_index.size();
+
+        for (size_t file_index = 0; file_index < this->lss_files.size();
+             file_index++)
+        {
+            auto lf = this->lss_files[file_index]->get_file_ptr();
 
-            if (lf == nullptr) {
+            if (lf == nullptr || !reorder[file_index]) {
                 continue;
             }
 
-            auto line_iter = lf->find_from_time(lowest_tv.value());
+            for (const auto& ll : *lf) {
+                if (ll.is_ignored()) {
+                    continue;
+                }
+                if (!restart_tv || ll < restart_tv.value()) {
+                    restart_tv = ll.get_timeval();
+                }
+            }
+        }
+        if (std::find(reorder.begin(), reorder.end(), true) != reorder.end()) {
+            for (size_t row = 0; row < this->lss_index.size(); row++) {
+                content_line_t cl = this->lss_index[row];
 
-            if (line_iter) {
-                log_debug("%s: lowest line time %ld; line %ld; size %ld",
-                          lf->get_filename().c_str(),
-                          line_iter.value()->get_timeval().tv_sec,
-                          std::distance(lf->cbegin(), line_iter.value()),
-                          lf->size());
+                if (reorder[cl / MAX_LINES_PER_FILE]) {
+                    restart_end = row;
+                    break;
+                }
             }
-            ld.ld_lines_indexed
-                = std::distance(lf->cbegin(), line_iter.value_or(lf->cend()));
-            remaining += lf->size() - ld.ld_lines_indexed;
-        }
-
-        auto row_iter = std::lower_bound(this->lss_index.begin(),
-                                         this->lss_index.end(),
-                                         *lowest_tv,
-                                         logline_cmp(*this));
-        this->lss_index.shrink_to(
-            std::distance(this->lss_index.begin(), row_iter));
-        log_debug("new index size %ld/%ld; remain %ld",
+        }
+
+        auto row_end = this->lss_index.begin() + restart_end;
+        auto row_iter = restart_tv ? std::lower_bound(this->lss_index.begin(),
+                                                      row_end,
+                                                      restart_tv.value(),
+                                                      logline_cmp(*this))
+                                   : row_end;
+        auto restart_row = std::distance(this->lss_index.begin(), row_iter);
+
+        log_debug("partial rebuild from row %ld/%ld",
+                  restart_row,
+                  this->lss_index.size());
+        for (size_t row = restart_row; row < this->lss_index.size(); row++) {
+            uint64_t line_number;
+            auto ld_iter = this->find_data(this->lss_index[row], line_number);
+            auto file_index = std::distance(this->lss_files.begin(), ld_iter);
+            auto& ld = *(*ld_iter);
+
+            if (reorder[file_index]) {
+                continue;
+            }
+            if (ld.ld_out_of_order) {
+                merge_orders[file_index].push_back(line_number);
+            } else if (line_number < ld.ld_lines_indexed) {
+                ld.ld_lines_indexed = line_number;
+            }
+        }
+
+        this->lss_index.shrink_to(restart_row);
+        log_debug("new index size %ld/%ld",
                   this->lss_index.ba_size,
-                  this->lss_index.ba_capacity,
-                  remaining);
-        auto filt_row_iter = lower_bound(this->lss_filtered_index.begin(),
-                                         this->lss_filtered_index.end(),
-                                         *lowest_tv,
-                                         filtered_logline_cmp(*this));
+                  this->lss_index.ba_capacity);
+        auto filt_row_iter = std::lower_bound(this->lss_filtered_index.begin(),
+                                              this->lss_filtered_index.end(),
+                                              restart_row);
         this->lss_filtered_index.resize(
             std::distance(this->lss_filtered_index.begin(), filt_row_iter));
         search_start = vis_line_t(this->lss_filtered_index.size());
@@ -828,7 +1130,6 @@ logfile_sub_source::rebuild_index(
 
     if (retval != rebuild_result::rr_no_change || force) {
         size_t index_size = 0, start_size = this->lss_index.size();
-        logline_cmp line_cmper(*this);
 
         for (auto& ld : this->lss_files) {
             auto lf = ld->get_file_ptr();
@@ -844,87 +1145,97 @@ logfile_sub_source::rebuild_index(
                 = std::max(this->lss_filename_width, lf->get_filename().size());
         }
 
-        if (full_sort) {
-            for (auto& ld : this->lss_files) {
-                auto lf = ld->get_file_ptr();
-
-                if (lf == nullptr) {
-                    continue;
-                }
+        kmerge_tree_c<logline, logfile_data, merge_line_iterator> merge(
+            file_count);
 
-                for (size_t line_index = 0; line_index < lf->size();
-                     line_index++) {
-                    if ((*lf)[line_index].is_ignored()) {
-                        continue;
-                    }
-
-                    content_line_t con_line(
-                        ld->ld_file_index * MAX_LINES_PER_FILE + line_index);
-
-                    this->lss_index.push_back(con_line);
-                }
+        for (size_t file_index = 0; file_index < this->lss_files.size();
+             file_index++)
+        {
+            auto* ld = this->lss_files[file_index].get();
+            auto lf = ld->get_file_ptr();
+            if (lf == nullptr) {
+                continue;
             }
 
-            // XXX get rid of this full sort on the initial run, it's not
-            // needed unless the file is not in time-order
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(*this, 0, this->lss_index.size());
-            }
-            std::sort(
-                this->lss_index.begin(), this->lss_index.end(), line_cmper);
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(
-                    *this, this->lss_index.size(), this->lss_index.size());
+            auto& order = merge_orders[file_index];
+            merge_line_iterator begin_iter;
+            merge_line_iterator end_iter;
+
+            if (reorder[file_index]) {
+                ld->ld_lines_indexed = 0;
             }
-        } else {
-            kmerge_tree_c<logline, logfile_data, logfile::iterator> merge(
-                file_count);
-
-            for (iter = this->lss_files.begin(); iter != this->lss_files.end();
-                 iter++) {
-                logfile_data* ld = iter->get();
-                auto lf = ld->get_file_ptr();
-                if (lf == nullptr) {
-                    continue;
+            if (ld->ld_out_of_order && ld->ld_lines_indexed == 0
+                && order.empty())
+            {
+                // Only the lines after the ones that were already found to
+                // be in order need to be checked.  The last line can still
+                // be read again, so it is not counted as sorted.
+                auto sorted_lines = std::min(ld->ld_sorted_lines, lf->size());
+                auto check_start = lf->begin()
+                    + (sorted_lines > 0 ? sorted_lines - 1 : 0);
+                auto sorted_end = std::is_sorted_until(check_start, lf->end());
+
+                ld->ld_sorted_lines = std::distance(lf->begin(), sorted_end);
+                if (sorted_end == lf->end()) {
+                    ld->ld_out_of_order = false;
+                    if (ld->ld_sorted_lines > 0) {
+                        ld->ld_sorted_lines -= 1;
+                    }
                 }
-
-                merge.add(ld, lf->begin() + ld->ld_lines_indexed, lf->end());
-                index_size += lf->size();
             }
-
-            file_off_t index_off = 0;
-            merge.execute();
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(*this, index_off, index_size);
+            begin_iter.mli_file = end_iter.mli_file = lf;
+            if (ld->ld_out_of_order) {
+                for (auto line_number = ld->ld_lines_indexed;
+                     line_number < lf->size();
+                     line_number++)
+                {
+                    order.push_back(line_number);
+                }
+                std::stable_sort(order.begin(),
+                                 order.end(),
+                                 [lf](const auto lhs, const auto rhs) {
+                                     return (*lf)[lhs] < (*lf)[rhs];
+                                 });
+                begin_iter.mli_order = end_iter.mli_order = order.data();
+                end_iter.mli_pos = order.size();
+            } else {
+                begin_iter.mli_pos = ld->ld_lines_indexed;
+                end_iter.mli_pos = lf->size();
             }
-            for (;;) {
-                logfile::iterator lf_iter;
-                logfile_data* ld;
 
-                if (!merge.get_top(ld, lf_iter)) {
-                    break;
-                }
+            merge.add(ld, begin_iter, end_iter);
+            index_size += end_iter.mli_pos - begin_iter.mli_pos;
+        }
 
-                if (!lf_iter->is_ignored()) {
-                    int file_index = ld->ld_file_index;
-                    int line_index = lf_iter - ld->get_file_ptr()->begin();
+        file_off_t index_off = 0;
+        merge.execute();
+        if (this->lss_sorting_observer) {
+            this->lss_sorting_observer(*this, index_off, index_size);
+        }
+        for (;;) {
+            merge_line_iterator line_iter;
+            logfile_data* ld;
 
-                    content_line_t con_line(file_index * MAX_LINES_PER_FILE
-                                            + line_index);
+            if (!merge.get_top(ld, line_iter)) {
+                break;
+            }
 
-                    this->lss_index.push_back(con_line);
-                }
+            if (!(*line_iter).is_ignored()) {
+                content_line_t con_line(ld->ld_file_index * MAX_LINES_PER_FILE
+                                        + line_iter.line_number());
 
-                merge.next();
-                index_off += 1;
-                if (index_off % 10000 == 0 && this->lss_sorting_observer) {
-                    this->lss_sorting_observer(*this, index_off, index_size);
-                }
+                this->lss_index.push_back(con_line);
             }
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(*this, index_size, index_size);
+
+            merge.next();
+            index_off += 1;
+            if (index_off % 10000 == 0 && this->lss_sorting_observer) {
+                this->lss_sorting_observer(*this, index_off, index_size);
             }
         }
+        if (this->lss_sorting_observer) {
+            this->lss_sorting_observer(*this, index_size, index_size);
+        }
 
         for (iter = this->lss_files.begin(); iter != this->lss_files.end();
              iter++) {
@@ -1083,7 +1394,7 @@ logfile_sub_source::get_line_accel_direction(vis_line_t vl)
     log_accel la;
 
     while (vl >= 0) {
-        logline* curr_line = this->find_line(this->at(vl));
+        auto curr_line = this->find_line(this->at(vl));
 
         if (!curr_line->is_message()) {
             --vl;
@@ -1100,9 +1411,25 @@ logfile_sub_source::get_line_accel_direction(vis_line_t vl)
     return la.get_direction();
 }
 
+void
+logfile_sub_source::thaw_index()
+{
+    this->lss_index_frozen = false;
+    if (this->lss_filters_changed_while_frozen) {
+        this->lss_filters_changed_while_frozen = false;
+        this->text_filters_changed();
+    }
+}
+
 void
 logfile_sub_source::text_filters_changed()
 {
+    if (this->lss_index_frozen) {
+        this->lss_filters_changed_while_frozen = true;
+        return;
+    }
+
+    this->lss_annotation_cache.clear();
     if (this->lss_line_meta_changed) {
         this->invalidate_sql_filter();
         this->lss_line_meta_changed = false;
@@ -1123,6 +1450,22 @@ logfile_sub_source::text_filters_changed()
 
     this->get_filters().get_enabled_mask(filtered_in_mask, filtered_out_mask);
 
+    // Combine the match bitmaps of the enabled filters a word at a time so
+    // the loop below only needs to check a single bit for each line.
+    std::vector<std::vector<uint64_t>> excluded_lines(this->lss_files.size());
+
+    for (size_t file_index = 0; file_index < this->lss_files.size();
+         file_index++)
+    {
+        auto& ld = this->lss_files[file_index];
+
+        if (ld->get_file_ptr() == nullptr) {
+            continue;
+        }
+        ld->ld_filter_state.lfo_filter_state.excluded_lines(
+            filtered_in_mask, filtered_out_mask, excluded_lines[file_index]);
+    }
+
     if (this->lss_index_delegate != nullptr) {
         this->lss_index_delegate->index_start(*this);
     }
@@ -1142,11 +1485,13 @@ logfile_sub_source::text_filters_changed()
 
         auto lf = (*ld)->get_file_ptr();
         auto line_iter = lf->begin() + line_number;
+        const auto& file_excluded
+            = excluded_lines[std::distance(this->begin(), ld)];
+        auto excluded = line_number / 64 < file_excluded.size()
+            && (file_excluded[line_number / 64] >> (line_number % 64)) & 1;
 
         if (!this->tss_apply_filters
-            || (!(*ld)->ld_filter_state.excluded(
-                    filtered_in_mask, filtered_out_mask, line_number)
-                && this->check_extra_filters(ld, line_iter)))
+            || (!excluded && this->check_extra_filters(ld, line_iter)))
         {
             auto eval_res = this->eval_sql_filter(
                 this->lss_marker_stmt.in(), ld, line_iter);
@@ -1589,7 +1934,7 @@ logfile_sub_source::text_mark(const bookmark_type_t* bm,
     std::vector<content_line_t>::iterator lb;
 
     if (bm == &textview_curses::BM_USER) {
-        logline* ll = this->find_line(cl);
+        auto ll = this->find_line(cl);
 
         ll->set_mark(added);
     }
@@ -1667,6 +2012,7 @@ logfile_sub_source::remove_file(std::shared_ptr<logfile> lf)
             }
         }
 
+        this->lss_annotation_cache.clear();
         this->lss_force_rebuild = true;
     }
 }
@@ -1678,8 +2024,7 @@ logfile_sub_source::find_from_content(content_line_t cl)
     std::shared_ptr<logfile> lf = this->find(line);
 
     if (lf != nullptr) {
-        auto ll_iter = lf->begin() + line;
-        auto& ll = *ll_iter;
+        logline ll = (*lf)[line];
         auto vis_start_opt = this->find_from_time(ll.get_timeval());
 
         if (!vis_start_opt) {
@@ -1695,9 +2040,9 @@ logfile_sub_source::find_from_content(content_line_t cl)
                 return vis_start;
             }
 
-            auto guess_line = this->find_line(guess_cl);
+            auto guess_lf = this->find(guess_cl);
 
-            if (!guess_line || ll < *guess_line) {
+            if (guess_lf == nullptr || ll < (*guess_lf)[guess_cl]) {
                 return nonstd::nullopt;
             }
 
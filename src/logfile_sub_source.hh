@@ -36,16 +36,19 @@
 #include <list>
 #include <map>
 #include <sstream>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include <limits.h>
 
 #include "base/lnav_log.hh"
+#include "base/lrucache.hpp"
 #include "base/time_util.hh"
 #include "big_array.hh"
 #include "bookmarks.hh"
 #include "filter_observer.hh"
+#include "fmt/format.h"
 #include "log_accel.hh"
 #include "log_format.hh"
 #include "logfile.hh"
@@ -104,6 +107,17 @@ public:
             + this->lf_id;
     };
 
+    bool is_thread_safe() const override
+    {
+        return true;
+    }
+
+    std::string get_cache_key() const override
+    {
+        return fmt::format(
+            FMT_STRING("regex:{:x}:{}"), this->pf_pcre.get_options(), this->lf_id);
+    }
+
 protected:
     pcrepp pf_pcre;
 };
@@ -260,6 +274,26 @@ public:
         this->lss_force_rebuild = true;
     }
 
+    /**
+     * Keep the lines that are already in the index at the same visible
+     * line numbers, which is needed while a query is reading the log
+     * tables.  New lines are still appended to the index, but rebuilds
+     * that would move the existing lines and filter changes are put off
+     * until the index is thawed.
+     */
+    void freeze_index()
+    {
+        this->lss_index_frozen = true;
+    }
+
+    /** Apply the filter changes that were put off while frozen. */
+    void thaw_index();
+
+    bool is_index_frozen() const
+    {
+        return this->lss_index_frozen;
+    }
+
     void set_min_log_level(log_level_t level)
     {
         if (this->lss_min_log_level != level) {
@@ -363,6 +397,9 @@ public:
                              std::string& value_out,
                              line_flags_t flags);
 
+    nonstd::optional<grep_line_location> text_location_for_line(
+        textview_curses& tc, int row);
+
     void text_attrs_for_line(textview_curses& tc,
                              int row,
                              string_attrs_t& value_out);
@@ -381,6 +418,25 @@ public:
         return this->lss_line_size_cache[index].second;
     };
 
+    /**
+     * Read and annotate the lines in the pages above and below the view so
+     * that scrolling over them can be done using the cached annotations.
+     *
+     * @param tc The view whose neighboring pages should be prefetched.
+     * @param deadline The time to stop prefetching.
+     */
+    void prefetch_lines(textview_curses& tc, ui_clock::time_point deadline);
+
+    /**
+     * Drop the cached annotations for all of the lines.  This needs to be
+     * called when something changes how lines are annotated, like hiding a
+     * field.
+     */
+    void invalidate_annotations()
+    {
+        this->lss_annotation_cache.clear();
+    }
+
     void text_mark(const bookmark_type_t* bm, vis_line_t line, bool added);
 
     void text_clear_marks(const bookmark_type_t* bm);
@@ -479,15 +535,13 @@ public:
         return retval;
     };
 
-    logline* find_line(content_line_t line) const
+    logfile::iterator find_line(content_line_t line) const
     {
-        logline* retval = nullptr;
+        logfile::iterator retval;
         std::shared_ptr<logfile> lf = this->find(line);
 
         if (lf != nullptr) {
-            auto ll_iter = lf->begin() + line;
-
-            retval = &(*ll_iter);
+            retval = lf->begin() + line;
         }
 
         return retval;
@@ -587,7 +641,25 @@ public:
         size_t ld_file_index;
         line_filter_observer ld_filter_state;
         size_t ld_lines_indexed{0};
+        /**
+         * True if the lines in this file might not be in time order, in
+         * which case they need to be sorted before being merged.
+         */
+        bool ld_out_of_order{false};
+        /**
+         * The number of lines at the start of the file that are known to be
+         * in time order, so that only the lines after them need to be
+         * checked when deciding if the file still needs to be sorted.
+         */
+        size_t ld_sorted_lines{0};
         bool ld_visible;
+        /**
+         * Incremented when the file is reordered or found to be invalid, so
+         * that none of the annotations cached before the change are used.
+         * Appending lines only drops the annotations for the last message,
+         * see drop_stale_annotations().
+         */
+        uint64_t ld_generation{0};
     };
 
     using iterator = std::vector<std::unique_ptr<logfile_data>>::iterator;
@@ -739,6 +811,7 @@ public:
 
 private:
     static const size_t LINE_SIZE_CACHE_SIZE = 512;
+    static const size_t ANNOTATION_CACHE_SIZE = 1024;
 
     enum {
         B_SCRUB,
@@ -779,8 +852,8 @@ private:
         bool operator()(const content_line_t& lhs,
                         const content_line_t& rhs) const
         {
-            logline* ll_lhs = this->llss_controller.find_line(lhs);
-            logline* ll_rhs = this->llss_controller.find_line(rhs);
+            auto ll_lhs = this->llss_controller.find_line(lhs);
+            auto ll_rhs = this->llss_controller.find_line(rhs);
 
             return (*ll_lhs) < (*ll_rhs);
         };
@@ -791,30 +864,30 @@ private:
                 = (content_line_t) llss_controller.lss_index[lhs];
             content_line_t cl_rhs
                 = (content_line_t) llss_controller.lss_index[rhs];
-            logline* ll_lhs = this->llss_controller.find_line(cl_lhs);
-            logline* ll_rhs = this->llss_controller.find_line(cl_rhs);
+            auto ll_lhs = this->llss_controller.find_line(cl_lhs);
+            auto ll_rhs = this->llss_controller.find_line(cl_rhs);
 
             return (*ll_lhs) < (*ll_rhs);
         };
 #if 0
         bool operator()(const indexed_content &lhs, const indexed_content &rhs)
         {
-            logline *ll_lhs = this->llss_controller.find_line(lhs.ic_value);
-            logline *ll_rhs = this->llss_controller.find_line(rhs.ic_value);
+            auto ll_lhs = this->llss_controller.find_line(lhs.ic_value);
+            auto ll_rhs = this->llss_controller.find_line(rhs.ic_value);
 
             return (*ll_lhs) < (*ll_rhs);
         };
 #endif
         bool operator()(const content_line_t& lhs, const time_t& rhs) const
         {
-            logline* ll_lhs = this->llss_controller.find_line(lhs);
+            auto ll_lhs = this->llss_controller.find_line(lhs);
 
             return *ll_lhs < rhs;
         };
         bool operator()(const content_line_t& lhs,
                         const struct timeval& rhs) const
         {
-            logline* ll_lhs = this->llss_controller.find_line(lhs);
+            auto ll_lhs = this->llss_controller.find_line(lhs);
 
             return *ll_lhs < rhs;
         };
@@ -831,8 +904,8 @@ private:
                 = (content_line_t) llss_controller.lss_index[lhs];
             content_line_t cl_rhs
                 = (content_line_t) llss_controller.lss_index[rhs];
-            logline* ll_lhs = this->llss_controller.find_line(cl_lhs);
-            logline* ll_rhs = this->llss_controller.find_line(cl_rhs);
+            auto ll_lhs = this->llss_controller.find_line(cl_lhs);
+            auto ll_rhs = this->llss_controller.find_line(cl_rhs);
 
             return (*ll_lhs) < (*ll_rhs);
         };
@@ -841,7 +914,7 @@ private:
         {
             content_line_t cl_lhs
                 = (content_line_t) llss_controller.lss_index[lhs];
-            logline* ll_lhs = this->llss_controller.find_line(cl_lhs);
+            auto ll_lhs = this->llss_controller.find_line(cl_lhs);
 
             return (*ll_lhs) < rhs;
         };
@@ -872,10 +945,77 @@ private:
 
     bool check_extra_filters(iterator ld, logfile::iterator ll);
 
+    /**
+     * The result of reading a line and running it through the format's
+     * annotate() method, which is cached so that redrawing the same lines
+     * does not need to repeat the work.
+     */
+    struct annotated_line {
+        std::string al_value;
+        string_attrs_t al_attrs;
+        std::vector<logline_value> al_values;
+    };
+
+    struct annotation_key {
+        const logfile* ak_file;
+        uint64_t ak_generation;
+        file_off_t ak_offset;
+        uint16_t ak_sub_offset;
+        bool ak_full;
+
+        bool operator<(const annotation_key& rhs) const
+        {
+            return std::tie(this->ak_file,
+                            this->ak_generation,
+                            this->ak_offset,
+                            this->ak_sub_offset,
+                            this->ak_full)
+                < std::tie(rhs.ak_file,
+                           rhs.ak_generation,
+                           rhs.ak_offset,
+                           rhs.ak_sub_offset,
+                           rhs.ak_full);
+        }
+    };
+
+    /**
+     * Get the annotations for a line from the cache or by reading and
+     * annotating the line.
+     *
+     * @param ld The file that contains the line.
+     * @param line The number of the line in the file.
+     * @param flags The text_sub_source line flags, only RF_FULL is used.
+     * @return The annotated line, the values in it own their data.
+     */
+    std::shared_ptr<annotated_line> annotate_line(iterator ld,
+                                                  content_line_t line,
+                                                  line_flags_t flags);
+
+    /**
+     * Drop the cached annotations for the lines of a file that can change
+     * when lines are appended to it, which are the lines of the last
+     * message that was indexed.
+     */
+    void drop_stale_annotations(const logfile_data& ld);
+
+    /**
+     * Index the files that are eligible for background indexing using a
+     * pool of worker threads.  This call does not return until all of the
+     * workers have finished and the observers have been notified.
+     *
+     * @return The results of indexing each file, indexed by the position of
+     * the file in lss_files.  Files that were not indexed have no value.
+     */
+    std::vector<nonstd::optional<logfile::rebuild_result_t>>
+    rebuild_indexes_in_parallel(
+        nonstd::optional<ui_clock::time_point> deadline);
+
     size_t lss_basename_width = 0;
     size_t lss_filename_width = 0;
     unsigned long lss_flags{0};
     bool lss_force_rebuild{false};
+    bool lss_index_frozen{false};
+    bool lss_filters_changed_while_frozen{false};
     std::vector<std::unique_ptr<logfile_data>> lss_files;
 
     big_array<indexed_content> lss_index;
@@ -897,6 +1037,8 @@ private:
     int lss_token_shift_size{0};
     shared_buffer lss_share_manager;
     logfile::iterator lss_token_line;
+    cache::lru_cache<annotation_key, std::shared_ptr<annotated_line>>
+        lss_annotation_cache{ANNOTATION_CACHE_SIZE};
     std::array<std::pair<int, size_t>, LINE_SIZE_CACHE_SIZE>
         lss_line_size_cache;
     log_level_t lss_min_log_level{LEVEL_UNKNOWN};
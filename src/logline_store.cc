@@ -0,0 +1,347 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file logline_store.cc
+ */
+
+#include <algorithm>
+
+#include "logline_store.hh"
+
+#include <string.h>
+
+#include "base/lnav_log.hh"
+#include "config.h"
+
+/**
+ * Signed values are stored with the sign bit flipped so that the smallest
+ * value in a column is also the smallest unsigned value.
+ */
+static uint64_t
+bias(int64_t value)
+{
+    return ((uint64_t) value) ^ (1ULL << 63);
+}
+
+static int64_t
+unbias(uint64_t value)
+{
+    return (int64_t) (value ^ (1ULL << 63));
+}
+
+static uint8_t
+width_for(uint64_t max_delta)
+{
+    uint8_t retval = 0;
+
+    while (max_delta != 0) {
+        retval += 1;
+        max_delta >>= 8;
+    }
+
+    return retval;
+}
+
+void
+logline_store::packed_column::pack(const uint64_t* values, size_t count)
+{
+    require(count > 0);
+
+    auto minmax = std::minmax_element(values, values + count);
+
+    this->pc_base = *minmax.first;
+    this->pc_width = width_for(*minmax.second - this->pc_base);
+    this->pc_data.clear();
+    this->pc_data.resize(count * this->pc_width);
+    this->pc_data.shrink_to_fit();
+    for (size_t index = 0; index < count; index++) {
+        auto delta = values[index] - this->pc_base;
+        auto* dst = this->pc_data.data() + index * this->pc_width;
+
+        for (size_t lpc = 0; lpc < this->pc_width; lpc++) {
+            dst[lpc] = (delta >> (lpc * 8)) & 0xff;
+        }
+    }
+}
+
+void
+logline_store::packed_column::set(size_t index, uint64_t value)
+{
+    if (value >= this->pc_base
+        && width_for(value - this->pc_base) <= this->pc_width)
+    {
+        auto delta = value - this->pc_base;
+        auto* dst = this->pc_data.data() + index * this->pc_width;
+
+        for (size_t lpc = 0; lpc < this->pc_width; lpc++) {
+            dst[lpc] = (delta >> (lpc * 8)) & 0xff;
+        }
+        return;
+    }
+
+    uint64_t values[BLOCK_SIZE];
+
+    for (size_t lpc = 0; lpc < BLOCK_SIZE; lpc++) {
+        values[lpc] = this->get(lpc);
+    }
+    values[index] = value;
+    this->pack(values, BLOCK_SIZE);
+}
+
+logline
+logline_store::block::get(size_t index) const
+{
+    uint8_t level = (this->b_levels[index / 2] >> ((index % 2) * 4)) & 0x0f;
+
+    if (this->get_flag(F_IGNORE, index)) {
+        level |= LEVEL_IGNORE;
+    }
+    if (this->get_flag(F_TIME_SKEW, index)) {
+        level |= LEVEL_TIME_SKEW;
+    }
+    if (this->get_flag(F_MARK, index)) {
+        level |= LEVEL_MARK;
+    }
+    if (this->get_flag(F_CONTINUED, index)) {
+        level |= LEVEL_CONTINUED;
+    }
+
+    logline retval(this->b_offsets.get(index),
+                   unbias(this->b_times.get(index)),
+                   this->b_millis.get(index),
+                   (log_level_t) level,
+                   this->b_module_ids.get(index),
+                   this->b_opids.get(index));
+    auto schema = this->b_schemas.get(index);
+
+    retval.ll_sub_offset = this->b_sub_offsets.get(index);
+    retval.ll_valid_utf = this->get_flag(F_VALID_UTF, index);
+    retval.ll_expr_mark = this->get_flag(F_EXPR_MARK, index);
+    retval.ll_schema[0] = schema & 0xff;
+    retval.ll_schema[1] = (schema >> 8) & 0xff;
+
+    return retval;
+}
+
+uint64_t
+logline_store::schema_value(const logline& ll)
+{
+    return ((uint8_t) ll.ll_schema[0]) | (((uint8_t) ll.ll_schema[1]) << 8);
+}
+
+void
+logline_store::block::set(size_t index, const logline& ll)
+{
+    auto& level_byte = this->b_levels[index / 2];
+    auto shift = (index % 2) * 4;
+
+    level_byte = (level_byte & ~(0x0f << shift))
+        | ((ll.ll_level & ~LEVEL__FLAGS) << shift);
+    this->set_flag(F_IGNORE, index, ll.ll_level & LEVEL_IGNORE);
+    this->set_flag(F_TIME_SKEW, index, ll.ll_level & LEVEL_TIME_SKEW);
+    this->set_flag(F_MARK, index, ll.ll_level & LEVEL_MARK);
+    this->set_flag(F_CONTINUED, index, ll.ll_level & LEVEL_CONTINUED);
+    this->set_flag(F_VALID_UTF, index, ll.ll_valid_utf);
+    this->set_flag(F_EXPR_MARK, index, ll.ll_expr_mark);
+
+    this->b_offsets.set(index, ll.ll_offset);
+    this->b_times.set(index, bias(ll.ll_time));
+    this->b_millis.set(index, ll.ll_millis);
+    this->b_sub_offsets.set(index, ll.ll_sub_offset);
+    this->b_module_ids.set(index, ll.ll_module_id);
+    this->b_opids.set(index, ll.ll_opid);
+    this->b_schemas.set(index, schema_value(ll));
+}
+
+void
+logline_store::set(size_t index, const logline& ll)
+{
+    auto block_index = index / BLOCK_SIZE;
+
+    if (block_index < this->ls_blocks.size()) {
+        this->ls_blocks[block_index].set(index % BLOCK_SIZE, ll);
+    } else {
+        this->ls_tail[index - this->sealed_size()] = ll;
+    }
+}
+
+logline&
+logline_store::back()
+{
+    require(!this->empty());
+
+    if (this->ls_tail.empty()) {
+        this->unseal_last_block();
+    }
+
+    return this->ls_tail.back();
+}
+
+void
+logline_store::append(const logline_store& other)
+{
+    this->ls_tail.reserve(this->ls_tail.size() + other.size());
+    for (const auto& ll : other) {
+        this->ls_tail.push_back(ll);
+    }
+}
+
+void
+logline_store::assign(std::vector<logline>&& lines)
+{
+    this->ls_blocks.clear();
+    this->ls_tail = std::move(lines);
+}
+
+void
+logline_store::pop_back()
+{
+    require(!this->empty());
+
+    if (this->ls_tail.empty()) {
+        this->unseal_last_block();
+    }
+    this->ls_tail.pop_back();
+}
+
+void
+logline_store::clear()
+{
+    this->ls_blocks.clear();
+    this->ls_tail.clear();
+}
+
+void
+logline_store::reserve(size_t size)
+{
+    if (size > this->sealed_size()) {
+        this->ls_tail.reserve(size - this->sealed_size());
+    }
+}
+
+void
+logline_store::seal()
+{
+    if (!this->ls_compact || this->ls_tail.size() < BLOCK_SIZE * 2) {
+        return;
+    }
+
+    auto full_blocks = (this->ls_tail.size() - BLOCK_SIZE) / BLOCK_SIZE;
+
+    this->ls_blocks.reserve(this->ls_blocks.size() + full_blocks);
+    for (size_t lpc = 0; lpc < full_blocks; lpc++) {
+        this->seal_block(&this->ls_tail[lpc * BLOCK_SIZE]);
+    }
+
+    this->ls_tail.erase(this->ls_tail.begin(),
+                        this->ls_tail.begin() + full_blocks * BLOCK_SIZE);
+    if (this->ls_tail.capacity() > BLOCK_SIZE * 4) {
+        this->ls_tail.shrink_to_fit();
+    }
+}
+
+size_t
+logline_store::memory_usage() const
+{
+    size_t retval = sizeof(*this);
+
+    retval += this->ls_blocks.capacity() * sizeof(block);
+    for (const auto& blk : this->ls_blocks) {
+        retval += blk.b_offsets.pc_data.capacity()
+            + blk.b_times.pc_data.capacity() + blk.b_millis.pc_data.capacity()
+            + blk.b_sub_offsets.pc_data.capacity()
+            + blk.b_module_ids.pc_data.capacity()
+            + blk.b_opids.pc_data.capacity()
+            + blk.b_schemas.pc_data.capacity();
+    }
+    retval += this->ls_tail.capacity() * sizeof(logline);
+
+    return retval;
+}
+
+void
+logline_store::seal_block(const logline* lines)
+{
+    uint64_t values[BLOCK_SIZE];
+    block blk;
+
+    memset(blk.b_levels, 0, sizeof(blk.b_levels));
+    memset(blk.b_flags, 0, sizeof(blk.b_flags));
+    for (size_t lpc = 0; lpc < BLOCK_SIZE; lpc++) {
+        const auto& ll = lines[lpc];
+
+        blk.b_levels[lpc / 2]
+            |= (ll.ll_level & ~LEVEL__FLAGS) << ((lpc % 2) * 4);
+        blk.set_flag(F_IGNORE, lpc, ll.ll_level & LEVEL_IGNORE);
+        blk.set_flag(F_TIME_SKEW, lpc, ll.ll_level & LEVEL_TIME_SKEW);
+        blk.set_flag(F_MARK, lpc, ll.ll_level & LEVEL_MARK);
+        blk.set_flag(F_CONTINUED, lpc, ll.ll_level & LEVEL_CONTINUED);
+        blk.set_flag(F_VALID_UTF, lpc, ll.ll_valid_utf);
+        blk.set_flag(F_EXPR_MARK, lpc, ll.ll_expr_mark);
+    }
+
+    auto pack_field = [lines, &values](packed_column& column, auto getter) {
+        for (size_t lpc = 0; lpc < BLOCK_SIZE; lpc++) {
+            values[lpc] = getter(lines[lpc]);
+        }
+        column.pack(values, BLOCK_SIZE);
+    };
+
+    pack_field(blk.b_offsets,
+               [](const logline& ll) -> uint64_t { return ll.ll_offset; });
+    pack_field(blk.b_times,
+               [](const logline& ll) { return bias(ll.ll_time); });
+    pack_field(blk.b_millis,
+               [](const logline& ll) -> uint64_t { return ll.ll_millis; });
+    pack_field(blk.b_sub_offsets,
+               [](const logline& ll) -> uint64_t { return ll.ll_sub_offset; });
+    pack_field(blk.b_module_ids,
+               [](const logline& ll) -> uint64_t { return ll.ll_module_id; });
+    pack_field(blk.b_opids,
+               [](const logline& ll) -> uint64_t { return ll.ll_opid; });
+    pack_field(blk.b_schemas, schema_value);
+
+    this->ls_blocks.emplace_back(std::move(blk));
+}
+
+void
+logline_store::unseal_last_block()
+{
+    require(!this->ls_blocks.empty());
+
+    const auto& last_block = this->ls_blocks.back();
+    std::vector<logline> lines;
+
+    lines.reserve(BLOCK_SIZE + this->ls_tail.size());
+    for (size_t lpc = 0; lpc < BLOCK_SIZE; lpc++) {
+        lines.emplace_back(last_block.get(lpc));
+    }
+    lines.insert(lines.end(), this->ls_tail.begin(), this->ls_tail.end());
+    this->ls_blocks.pop_back();
+    this->ls_tail = std::move(lines);
+}
@@ -0,0 +1,531 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file logline_store.hh
+ */
+
+#ifndef lnav_logline_store_hh
+#define lnav_logline_store_hh
+
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/file_range.hh"
+#include "log_format_fwd.hh"
+
+/**
+ * The container for the line index of a log file.  New lines are kept in a
+ * plain vector, the tail.  When compaction is enabled, seal() packs all but
+ * the last BLOCK_SIZE lines of the tail into fixed-size blocks:
+ *
+ * - the offsets and timestamps are stored as deltas from a per-block base
+ *   value using the smallest byte width that can hold the largest delta;
+ * - the levels are stored as four-bit values, two to a byte;
+ * - the flags are stored in bitmaps, one per flag.
+ *
+ * Columns that have the same value for every line in a block, like the
+ * module ID for most files, take no space beyond the base value.  Since
+ * every block holds the same number of lines, looking up a line is O(1).
+ *
+ * Since a packed line has no address, lines are returned as copies.  The
+ * copies returned for a non-const store write any changes made through
+ * their setters back into the store.  Only back() returns a real reference,
+ * since the formats build up the last line in place while scanning.
+ */
+class logline_store {
+public:
+    static constexpr size_t BLOCK_SIZE = 256;
+
+    template<bool IS_CONST>
+    class basic_iterator;
+
+    /**
+     * A copy of a line that writes any changes made through its setters
+     * back to the store.
+     */
+    class reference : public logline {
+    public:
+        reference& operator=(const logline& ll)
+        {
+            logline::operator=(ll);
+            this->update();
+            return *this;
+        }
+
+        reference& operator=(const reference& rhs)
+        {
+            return *this = (const logline&) rhs;
+        }
+
+        reference* operator->() { return this; }
+
+        void set_sub_offset(uint16_t suboff)
+        {
+            logline::set_sub_offset(suboff);
+            this->update();
+        }
+
+        void set_time(time_t t)
+        {
+            logline::set_time(t);
+            this->update();
+        }
+
+        void set_time(const struct timeval& tv)
+        {
+            logline::set_time(tv);
+            this->update();
+        }
+
+        void set_millis(uint16_t m)
+        {
+            logline::set_millis(m);
+            this->update();
+        }
+
+        void set_ignore(bool val)
+        {
+            logline::set_ignore(val);
+            this->update();
+        }
+
+        void set_mark(bool val)
+        {
+            logline::set_mark(val);
+            this->update();
+        }
+
+        void set_expr_mark(bool val)
+        {
+            logline::set_expr_mark(val);
+            this->update();
+        }
+
+        void set_time_skew(bool val)
+        {
+            logline::set_time_skew(val);
+            this->update();
+        }
+
+        void set_valid_utf(bool v)
+        {
+            logline::set_valid_utf(v);
+            this->update();
+        }
+
+        void set_level(log_level_t l)
+        {
+            logline::set_level(l);
+            this->update();
+        }
+
+        void set_opid(uint8_t opid)
+        {
+            logline::set_opid(opid);
+            this->update();
+        }
+
+        void set_schema(const byte_array<2, uint64_t>& ba)
+        {
+            logline::set_schema(ba);
+            this->update();
+        }
+
+    private:
+        friend class logline_store;
+
+        reference(logline_store* store, size_t index)
+            : logline((*(const logline_store*) store)[index]),
+              r_store(store), r_index(index)
+        {
+        }
+
+        void update() { this->r_store->set(this->r_index, *this); }
+
+        logline_store* r_store;
+        size_t r_index;
+    };
+
+    /**
+     * A copy of a line returned from a const store.
+     */
+    class const_reference : public logline {
+    public:
+        explicit const_reference(const logline& ll) : logline(ll) {}
+
+        const logline* operator->() const { return this; }
+    };
+
+    template<bool IS_CONST>
+    class basic_iterator {
+    public:
+        using store_type = typename std::
+            conditional<IS_CONST, const logline_store, logline_store>::type;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = logline;
+        using difference_type = ptrdiff_t;
+        using reference = typename std::conditional<IS_CONST,
+                                                    const const_reference,
+                                                    logline_store::reference>::type;
+        using pointer = reference;
+
+        basic_iterator() = default;
+
+        basic_iterator(store_type* store, size_t index)
+            : bi_store(store), bi_index(index)
+        {
+        }
+
+        template<bool OTHER_CONST,
+                 typename = typename std::enable_if<IS_CONST
+                                                    && !OTHER_CONST>::type>
+        basic_iterator(const basic_iterator<OTHER_CONST>& other)
+            : bi_store(other.bi_store), bi_index(other.bi_index)
+        {
+        }
+
+        reference operator*() const
+        {
+            return this->bi_store->at_index(this->bi_index);
+        }
+
+        pointer operator->() const { return **this; }
+
+        reference operator[](difference_type n) const
+        {
+            return this->bi_store->at_index(this->bi_index + n);
+        }
+
+        basic_iterator& operator++()
+        {
+            this->bi_index += 1;
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            auto retval = *this;
+
+            this->bi_index += 1;
+            return retval;
+        }
+
+        basic_iterator& operator--()
+        {
+            this->bi_index -= 1;
+            return *this;
+        }
+
+        basic_iterator operator--(int)
+        {
+            auto retval = *this;
+
+            this->bi_index -= 1;
+            return retval;
+        }
+
+        basic_iterator& operator+=(difference_type n)
+        {
+            this->bi_index += n;
+            return *this;
+        }
+
+        basic_iterator& operator-=(difference_type n)
+        {
+            this->bi_index -= n;
+            return *this;
+        }
+
+        basic_iterator operator+(difference_type n) const
+        {
+            return {this->bi_store, this->bi_index + n};
+        }
+
+        friend basic_iterator operator+(difference_type n,
+                                        const basic_iterator& iter)
+        {
+            return iter + n;
+        }
+
+        basic_iterator operator-(difference_type n) const
+        {
+            return {this->bi_store, this->bi_index - n};
+        }
+
+        difference_type operator-(const basic_iterator& rhs) const
+        {
+            return (difference_type) this->bi_index
+                - (difference_type) rhs.bi_index;
+        }
+
+        bool operator==(const basic_iterator& rhs) const
+        {
+            return this->bi_index == rhs.bi_index;
+        }
+
+        bool operator!=(const basic_iterator& rhs) const
+        {
+            return this->bi_index != rhs.bi_index;
+        }
+
+        bool operator<(const basic_iterator& rhs) const
+        {
+            return this->bi_index < rhs.bi_index;
+        }
+
+        bool operator<=(const basic_iterator& rhs) const
+        {
+            return this->bi_index <= rhs.bi_index;
+        }
+
+        bool operator>(const basic_iterator& rhs) const
+        {
+            return this->bi_index > rhs.bi_index;
+        }
+
+        bool operator>=(const basic_iterator& rhs) const
+        {
+            return this->bi_index >= rhs.bi_index;
+        }
+
+        size_t get_index() const { return this->bi_index; }
+
+    private:
+        friend class logline_store;
+        template<bool>
+        friend class basic_iterator;
+
+        store_type* bi_store{nullptr};
+        size_t bi_index{0};
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    size_t size() const
+    {
+        return this->ls_blocks.size() * BLOCK_SIZE + this->ls_tail.size();
+    }
+
+    bool empty() const { return this->size() == 0; }
+
+    logline operator[](size_t index) const
+    {
+        auto block_index = index / BLOCK_SIZE;
+
+        if (block_index < this->ls_blocks.size()) {
+            return this->ls_blocks[block_index].get(index % BLOCK_SIZE);
+        }
+
+        return this->ls_tail[index - this->sealed_size()];
+    }
+
+    reference operator[](size_t index) { return {this, index}; }
+
+    logline front() const { return (*this)[0]; }
+
+    reference front() { return {this, 0}; }
+
+    logline back() const { return (*this)[this->size() - 1]; }
+
+    /**
+     * @return A reference to the last line, which is always in the tail.
+     */
+    logline& back();
+
+    const_iterator begin() const { return {this, 0}; }
+
+    const_iterator end() const { return {this, this->size()}; }
+
+    iterator begin() { return {this, 0}; }
+
+    iterator end() { return {this, this->size()}; }
+
+    const_iterator cbegin() const { return {this, 0}; }
+
+    const_iterator cend() const { return {this, this->size()}; }
+
+    /**
+     * Replace the line at the given index.  If a value does not fit in the
+     * width used by its column in a packed block, the column is repacked.
+     */
+    void set(size_t index, const logline& ll);
+
+    void push_back(const logline& ll) { this->ls_tail.push_back(ll); }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        this->ls_tail.emplace_back(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Append the lines from another store.
+     */
+    void append(const logline_store& other);
+
+    /**
+     * Replace the contents of this store with the given lines.
+     */
+    void assign(std::vector<logline>&& lines);
+
+    /**
+     * Remove the last line.  If the last block is packed, it is unpacked
+     * back into the tail first.
+     */
+    void pop_back();
+
+    void clear();
+
+    void reserve(size_t size);
+
+    /**
+     * @param compact If true, seal() will pack lines into blocks.
+     */
+    void set_compact(bool compact) { this->ls_compact = compact; }
+
+    bool is_compact() const { return this->ls_compact; }
+
+    /**
+     * Pack the lines in the tail into blocks if compaction is enabled.  The
+     * most recent lines are left in the tail, since the formats can still
+     * update them while scanning.
+     */
+    void seal();
+
+    /**
+     * @return An estimate of the number of bytes of memory used by the
+     * container, including unused capacity.
+     */
+    size_t memory_usage() const;
+
+private:
+    /**
+     * A column of integers that are stored as fixed-width deltas from the
+     * smallest value in the column.
+     */
+    struct packed_column {
+        uint64_t pc_base{0};
+        uint8_t pc_width{0};
+        std::vector<uint8_t> pc_data;
+
+        void pack(const uint64_t* values, size_t count);
+
+        uint64_t get(size_t index) const
+        {
+            uint64_t delta = 0;
+            const auto* src = this->pc_data.data() + index * this->pc_width;
+
+            for (size_t lpc = 0; lpc < this->pc_width; lpc++) {
+                delta |= ((uint64_t) src[lpc]) << (lpc * 8);
+            }
+
+            return this->pc_base + delta;
+        }
+
+        void set(size_t index, uint64_t value);
+    };
+
+    static constexpr size_t FLAG_WORDS = BLOCK_SIZE / 64;
+
+    enum flag_t {
+        F_IGNORE,
+        F_TIME_SKEW,
+        F_MARK,
+        F_CONTINUED,
+        F_VALID_UTF,
+        F_EXPR_MARK,
+
+        F__MAX,
+    };
+
+    struct block {
+        packed_column b_offsets;
+        packed_column b_times;
+        packed_column b_millis;
+        packed_column b_sub_offsets;
+        packed_column b_module_ids;
+        packed_column b_opids;
+        packed_column b_schemas;
+        uint8_t b_levels[BLOCK_SIZE / 2];
+        uint64_t b_flags[F__MAX][FLAG_WORDS];
+
+        bool get_flag(flag_t flag, size_t index) const
+        {
+            return (this->b_flags[flag][index / 64] >> (index % 64)) & 1;
+        }
+
+        void set_flag(flag_t flag, size_t index, bool value)
+        {
+            auto& word = this->b_flags[flag][index / 64];
+            auto mask = 1ULL << (index % 64);
+
+            if (value) {
+                word |= mask;
+            } else {
+                word &= ~mask;
+            }
+        }
+
+        logline get(size_t index) const;
+
+        void set(size_t index, const logline& ll);
+    };
+
+    static uint64_t schema_value(const logline& ll);
+
+    size_t sealed_size() const { return this->ls_blocks.size() * BLOCK_SIZE; }
+
+    const_reference at_index(size_t index) const
+    {
+        return const_reference((*this)[index]);
+    }
+
+    reference at_index(size_t index) { return {this, index}; }
+
+    /**
+     * Pack the first BLOCK_SIZE lines of the given range into a new block.
+     */
+    void seal_block(const logline* lines);
+
+    /**
+     * Move the last block back into the tail.
+     */
+    void unseal_last_block();
+
+    std::vector<block> ls_blocks;
+    std::vector<logline> ls_tail;
+    bool ls_compact{false};
+};
+
+#endif
@@ -283,6 +283,341 @@ pcrepp::replace(const char* str, const char* repl) const
     return retval;
 }
 
+namespace {
+
+/**
+ * Recursive-descent scanner for the literal runs in a PCRE pattern.  A
+ * literal is only reported if it is not inside an alternation or an
+ * optional construct.  Anything that is not recognized fails the whole scan.
+ */
+class literal_scanner {
+public:
+    explicit literal_scanner(const std::string& pattern) : ls_pattern(pattern)
+    {
+    }
+
+    bool scan(std::vector<std::string>& lits_out)
+    {
+        lits_out = this->scan_alternation();
+
+        return !this->ls_failed && this->ls_pos == this->ls_pattern.size();
+    }
+
+private:
+    struct quantifier {
+        bool q_present{false};
+        int q_min{1};
+    };
+
+    int peek(size_t offset = 0) const
+    {
+        if (this->ls_pos + offset >= this->ls_pattern.size()) {
+            return -1;
+        }
+
+        return (unsigned char) this->ls_pattern[this->ls_pos + offset];
+    }
+
+    quantifier scan_quantifier()
+    {
+        quantifier retval;
+
+        switch (this->peek()) {
+            case '*':
+            case '?':
+                retval.q_present = true;
+                retval.q_min = 0;
+                this->ls_pos += 1;
+                break;
+            case '+':
+                retval.q_present = true;
+                this->ls_pos += 1;
+                break;
+            case '{': {
+                auto end = this->ls_pattern.find('}', this->ls_pos);
+
+                if (end == std::string::npos) {
+                    return retval;
+                }
+
+                auto body
+                    = this->ls_pattern.substr(this->ls_pos + 1,
+                                              end - this->ls_pos - 1);
+                auto comma = body.find(',');
+                auto min_str = body.substr(0, comma);
+
+                if (min_str.empty()
+                    || body.find_first_not_of("0123456789,") != std::string::npos
+                    || (comma != std::string::npos
+                        && body.find(',', comma + 1) != std::string::npos))
+                {
+                    return retval;
+                }
+
+                retval.q_present = true;
+                retval.q_min = atoi(min_str.c_str());
+                this->ls_pos = end + 1;
+                break;
+            }
+            default:
+                return retval;
+        }
+
+        if (this->peek() == '?' || this->peek() == '+') {
+            this->ls_pos += 1;
+        }
+
+        return retval;
+    }
+
+    void skip_class()
+    {
+        this->ls_pos += 1;
+        if (this->peek() == '^') {
+            this->ls_pos += 1;
+        }
+        if (this->peek() == ']') {
+            this->ls_pos += 1;
+        }
+        while (true) {
+            switch (this->peek()) {
+                case -1:
+                    this->ls_failed = true;
+                    return;
+                case ']':
+                    this->ls_pos += 1;
+                    return;
+                case '\\':
+                    this->ls_pos += 2;
+                    break;
+                case '[':
+                    if (this->peek(1) == ':') {
+                        auto end = this->ls_pattern.find(":]", this->ls_pos);
+
+                        if (end == std::string::npos) {
+                            this->ls_failed = true;
+                            return;
+                        }
+                        this->ls_pos = end + 2;
+                    } else {
+                        this->ls_pos += 1;
+                    }
+                    break;
+                default:
+                    this->ls_pos += 1;
+                    break;
+            }
+        }
+    }
+
+    std::vector<std::string> scan_alternation()
+    {
+        auto retval = this->scan_sequence();
+        auto branches = 1;
+
+        while (!this->ls_failed && this->peek() == '|') {
+            this->ls_pos += 1;
+            this->scan_sequence();
+            branches += 1;
+        }
+        if (branches > 1) {
+            retval.clear();
+        }
+
+        return retval;
+    }
+
+    /**
+     * Scan the start of a group, after the open parenthesis.
+     *
+     * @return True if the contents of the group need to match for the
+     *   pattern to match.
+     */
+    bool scan_group_start()
+    {
+        if (this->peek() != '?') {
+            return true;
+        }
+
+        switch (this->peek(1)) {
+            case ':':
+            case '>':
+                this->ls_pos += 2;
+                return true;
+            case '=':
+            case '!':
+                this->ls_pos += 2;
+                return false;
+            case 'P':
+                if (this->peek(2) != '<') {
+                    this->ls_failed = true;
+                    return false;
+                }
+                this->ls_pos += 1;
+                // fallthrough
+            case '<':
+            case '\'': {
+                auto term = this->peek(1) == '<' ? '>' : '\'';
+
+                if (this->peek(2) == '=' || this->peek(2) == '!') {
+                    this->ls_pos += 3;
+                    return false;
+                }
+
+                auto end = this->ls_pattern.find(term, this->ls_pos + 2);
+
+                if (end == std::string::npos) {
+                    this->ls_failed = true;
+                    return false;
+                }
+                this->ls_pos = end + 1;
+                return true;
+            }
+            default:
+                this->ls_failed = true;
+                return false;
+        }
+    }
+
+    std::vector<std::string> scan_sequence()
+    {
+        std::vector<std::string> retval;
+        std::string run;
+        auto flush = [&retval, &run]() {
+            if (!run.empty()) {
+                retval.emplace_back(std::move(run));
+                run.clear();
+            }
+        };
+
+        while (!this->ls_failed) {
+            auto ch = this->peek();
+
+            switch (ch) {
+                case -1:
+                case '|':
+                case ')':
+                    flush();
+                    return retval;
+                case '(': {
+                    flush();
+                    this->ls_pos += 1;
+
+                    auto required = this->scan_group_start();
+
+                    if (this->ls_failed) {
+                        return retval;
+                    }
+
+                    auto inner = this->scan_alternation();
+
+                    if (this->peek() != ')') {
+                        this->ls_failed = true;
+                        return retval;
+                    }
+                    this->ls_pos += 1;
+
+                    auto quant = this->scan_quantifier();
+
+                    if (required && quant.q_min > 0) {
+                        retval.insert(retval.end(), inner.begin(), inner.end());
+                    }
+                    continue;
+                }
+                case '[':
+                    flush();
+                    this->skip_class();
+                    this->scan_quantifier();
+                    continue;
+                case '.':
+                case '^':
+                case '$':
+                    flush();
+                    this->ls_pos += 1;
+                    this->scan_quantifier();
+                    continue;
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                    this->ls_failed = true;
+                    continue;
+                case '\\': {
+                    auto next = this->peek(1);
+
+                    if (next == -1 || next >= 0x80
+                        || strchr("xpPgkocNQEu", next) != nullptr)
+                    {
+                        this->ls_failed = true;
+                        continue;
+                    }
+                    if (isalnum(next)) {
+                        flush();
+                        this->ls_pos += 2;
+                        while (isdigit(next) && isdigit(this->peek())) {
+                            this->ls_pos += 1;
+                        }
+                        this->scan_quantifier();
+                        continue;
+                    }
+                    ch = next;
+                    this->ls_pos += 2;
+                    break;
+                }
+                default:
+                    if (ch >= 0x80) {
+                        flush();
+                        this->ls_pos += 1;
+                        while ((this->peek() & 0xc0) == 0x80) {
+                            this->ls_pos += 1;
+                        }
+                        this->scan_quantifier();
+                        continue;
+                    }
+                    this->ls_pos += 1;
+                    break;
+            }
+
+            auto quant = this->scan_quantifier();
+
+            if (!quant.q_present) {
+                run.push_back(ch);
+            } else if (quant.q_min == 0) {
+                flush();
+            } else {
+                run.push_back(ch);
+                flush();
+            }
+        }
+
+        return retval;
+    }
+
+    const std::string& ls_pattern;
+    size_t ls_pos{0};
+    bool ls_failed{false};
+};
+
+}  // namespace
+
+std::vector<std::string>
+pcrepp::required_literals() const
+{
+    std::vector<std::string> retval;
+
+    if (this->p_options & (PCRE_CASELESS | PCRE_EXTENDED)) {
+        return retval;
+    }
+
+    literal_scanner scanner(this->p_pattern);
+
+    if (!scanner.scan(retval)) {
+        retval.clear();
+    }
+
+    return retval;
+}
+
 void
 pcrepp::study()
 {
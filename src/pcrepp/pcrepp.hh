@@ -615,6 +615,11 @@ public:
         return this->p_capture_count;
     };
 
+    unsigned long get_options() const
+    {
+        return this->p_options;
+    };
+
     bool match(pcre_context& pc, pcre_input& pi, int options = 0) const;
 
     template<size_t MATCH_COUNT>
@@ -633,6 +638,16 @@ public:
 
     std::string replace(const char* str, const char* repl) const;
 
+    /**
+     * Find the literal strings that must appear in any string matched by this
+     * pattern.  The analysis is conservative: constructs that are not
+     * understood, like alternations, option settings, and case-insensitive
+     * matching, result in fewer literals being returned, never more.
+     *
+     * @return The required literals in the order they appear in the pattern.
+     */
+    std::vector<std::string> required_literals() const;
+
     size_t match_partial(pcre_input& pi) const
     {
         size_t length = pi.pi_length;
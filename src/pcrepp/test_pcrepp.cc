@@ -170,5 +170,40 @@ main(int argc, char* argv[])
         assert(re.captures()[0].c_end == 11);
     }
 
+    {
+        struct {
+            const char* rl_pattern;
+            std::vector<std::string> rl_expected;
+        } required_literal_tests[] = {
+            {"abc", {"abc"}},
+            {"ab?c", {"a", "c"}},
+            {"ab+c", {"ab", "c"}},
+            {"ab{2,3}c", {"ab", "c"}},
+            {"ab{0,3}c", {"a", "c"}},
+            {"a.b\\d+cd", {"a", "b", "cd"}},
+            {"\\[(?<ts>\\d+)\\] foo", {"[", "] foo"}},
+            {"^(?P<x>k=(?:v)) [a-z\\]]+ end$", {"k=", "v", " ", " end"}},
+            {"(?:opt)? req", {" req"}},
+            {"a|b", {}},
+            {"x(?:a|b)y", {"x", "y"}},
+            {"(?=look)real", {"real"}},
+            {"(?i)abc", {}},
+            {"a\\x41b", {}},
+            {"\xc3\xa9?z", {"z"}},
+            {"a{b", {}},
+            {"[[:alpha:]]+:x", {":x"}},
+        };
+
+        for (const auto& rlt : required_literal_tests) {
+            pcrepp re(rlt.rl_pattern);
+
+            assert(re.required_literals() == rlt.rl_expected);
+        }
+
+        pcrepp caseless("abc", PCRE_CASELESS);
+
+        assert(caseless.required_literals().empty());
+    }
+
     return retval;
 }
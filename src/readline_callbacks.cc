@@ -548,7 +548,6 @@ rl_callback_int(readline_curses* rc, bool is_alt)
 {
     textview_curses* tc = get_textview_for_mode(lnav_data.ld_mode);
     exec_context& ec = lnav_data.ld_exec_context;
-    std::string alt_msg;
 
     lnav_data.ld_bottom_source.set_prompt("");
     lnav_data.ld_doc_source.clear();
@@ -668,31 +667,36 @@ rl_callback_int(readline_curses* rc, bool is_alt)
 
         case LNM_SQL: {
             ec.ec_source.top().s_content = rc->get_value();
-            auto result = execute_sql(ec, rc->get_value(), alt_msg);
-            db_label_source& dls = lnav_data.ld_db_row_source;
-            std::string prompt;
-
-            if (result.isOk()) {
-                auto msg = result.unwrap();
-
-                if (!msg.empty()) {
-                    prompt = ok_prefix("SQL Result: " + msg);
-                    if (dls.dls_rows.size() > 1) {
-                        ensure_view(&lnav_data.ld_views[LNV_DB]);
+            execute_sql_incrementally(
+                ec,
+                rc->get_value(),
+                ui_clock::now() + 100ms,
+                [rc](auto result, const std::string& alt_msg) {
+                    db_label_source& dls = lnav_data.ld_db_row_source;
+                    std::string prompt;
+
+                    if (result.isOk()) {
+                        auto msg = result.unwrap();
+
+                        if (!msg.empty()) {
+                            prompt = ok_prefix("SQL Result: " + msg);
+                            if (dls.row_count() > 1) {
+                                ensure_view(&lnav_data.ld_views[LNV_DB]);
+                            }
+                        }
+                    } else {
+                        auto um = result.unwrapErr();
+                        lnav_data.ld_user_message_source.replace_with(
+                            um.to_attr_line().rtrim());
+                        lnav_data.ld_user_message_view.reload_data();
+                        lnav_data.ld_user_message_expiration
+                            = std::chrono::steady_clock::now() + 20s;
                     }
-                }
-            } else {
-                auto um = result.unwrapErr();
-                lnav_data.ld_user_message_source.replace_with(
-                    um.to_attr_line().rtrim());
-                lnav_data.ld_user_message_view.reload_data();
-                lnav_data.ld_user_message_expiration
-                    = std::chrono::steady_clock::now() + 20s;
-            }
-            ec.ec_source.top().s_content.clear();
 
-            rc->set_value(prompt);
-            rc->set_alt_value(alt_msg);
+                    rc->set_value(prompt);
+                    rc->set_alt_value(alt_msg);
+                });
+            ec.ec_source.top().s_content.clear();
             break;
         }
 
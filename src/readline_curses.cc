@@ -838,8 +838,13 @@ readline_curses::start()
                     }
                     last_h1 = h1;
                     last_h2 = h2;
-                    if (sendcmd(this->rc_command_pipe[RCF_SLAVE], 'w', "", 0)
-                        != 0) {
+                    // The key that finished the line does not leave the
+                    // prompt waiting for more input.
+                    if (!got_line
+                        && sendcmd(
+                               this->rc_command_pipe[RCF_SLAVE], 'w', "", 0)
+                            != 0)
+                    {
                         perror("line: write failed");
                         _exit(1);
                     }
@@ -559,7 +559,7 @@ load_time_bookmarks()
                     }
 
                     auto line_iter
-                        = lower_bound(lf->begin(), lf->end(), log_tv);
+                        = std::lower_bound(lf->begin(), lf->end(), log_tv);
                     while (line_iter != lf->end()) {
                         struct timeval line_tv = line_iter->get_timeval();
 
@@ -744,7 +744,7 @@ load_time_bookmarks()
                     }
 
                     auto line_iter
-                        = lower_bound(lf->begin(), lf->end(), log_tv);
+                        = std::lower_bound(lf->begin(), lf->end(), log_tv);
                     while (line_iter != lf->end()) {
                         struct timeval line_tv = line_iter->get_timeval();
 
@@ -1688,4 +1688,5 @@ reset_session()
             vd.second->vd_meta.lvm_user_hidden = false;
         }
     }
+    lnav_data.ld_log_source.invalidate_annotations();
 }
@@ -64,6 +64,27 @@ textfile_sub_source::text_value_for_line(textview_curses& tc,
     }
 }
 
+nonstd::optional<grep_line_location>
+textfile_sub_source::text_location_for_line(textview_curses& tc, int line)
+{
+    if (this->tss_files.empty()) {
+        return nonstd::nullopt;
+    }
+
+    auto lf = this->current_file();
+    auto fd = lf->get_shared_fd();
+
+    if (fd == nullptr) {
+        return nonstd::nullopt;
+    }
+
+    auto* lfo = (line_filter_observer*) lf->get_logline_observer();
+    auto ll = lf->begin() + lfo->lfo_filter_state.tfs_index[line];
+
+    return grep_line_location{
+        fd, lf->get_file_range(ll, false), ll->is_valid_utf()};
+}
+
 void
 textfile_sub_source::text_attrs_for_line(textview_curses& tc,
                                          int row,
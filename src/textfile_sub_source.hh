@@ -73,6 +73,9 @@ public:
                              std::string& value_out,
                              line_flags_t flags);
 
+    nonstd::optional<grep_line_location> text_location_for_line(
+        textview_curses& tc, int line);
+
     void text_attrs_for_line(textview_curses& tc,
                              int row,
                              string_attrs_t& value_out);
@@ -28,11 +28,13 @@
  */
 
 #include <algorithm>
+#include <thread>
 #include <vector>
 
 #include "textview_curses.hh"
 
 #include "base/ansi_scrubber.hh"
+#include "base/injector.hh"
 #include "base/time_util.hh"
 #include "config.h"
 #include "data_parser.hh"
@@ -45,6 +47,25 @@
 
 const auto REVERSE_SEARCH_OFFSET = 2000_vl;
 
+/**
+ * @return The number of threads to search with or zero to search in a child
+ * process.
+ */
+static size_t
+search_thread_count()
+{
+    const auto& search_cfg = injector::get<const lnav::search::config&>();
+
+    if (search_cfg.c_threads < 0) {
+        return 0;
+    }
+    if (search_cfg.c_threads > 0) {
+        return search_cfg.c_threads;
+    }
+
+    return std::max(1U, std::min(std::thread::hardware_concurrency(), 8U));
+}
+
 void
 text_filter::revert_to_last(logfile_filter_state& lfs, size_t rollback_size)
 {
@@ -63,7 +84,7 @@ text_filter::revert_to_last(logfile_filter_state& lfs, size_t rollback_size)
         lfs.tfs_filter_count[this->lf_index] -= 1;
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        lfs.tfs_mask[line_number] &= ~(((uint32_t) 1) << this->lf_index);
+        lfs.tfs_matches[this->lf_index].reset(line_number);
     }
     if (lfs.tfs_lines_for_message[this->lf_index] > 0) {
         require(lfs.tfs_lines_for_message[this->lf_index] >= rollback_size);
@@ -80,8 +101,14 @@ text_filter::add_line(logfile_filter_state& lfs,
                       logfile::const_iterator ll,
                       shared_buffer_ref& line)
 {
-    bool match_state = this->matches(*lfs.tfs_logfile, ll, line);
+    this->add_match(lfs, ll, this->matches(*lfs.tfs_logfile, ll, line));
+}
 
+void
+text_filter::add_match(logfile_filter_state& lfs,
+                       logfile::const_iterator ll,
+                       bool match_state)
+{
     if (ll->is_message()) {
         this->end_of_message(lfs);
     }
@@ -94,9 +121,7 @@ text_filter::add_line(logfile_filter_state& lfs,
 void
 text_filter::end_of_message(logfile_filter_state& lfs)
 {
-    uint32_t mask = 0;
-
-    mask = ((uint32_t) 1U << this->lf_index);
+    auto& matches = lfs.tfs_matches[this->lf_index];
 
     for (size_t lpc = 0; lpc < lfs.tfs_lines_for_message[this->lf_index]; lpc++)
     {
@@ -105,11 +130,7 @@ text_filter::end_of_message(logfile_filter_state& lfs)
 
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        if (lfs.tfs_message_matched[this->lf_index]) {
-            lfs.tfs_mask[line_number] |= mask;
-        } else {
-            lfs.tfs_mask[line_number] &= ~mask;
-        }
+        matches.assign(line_number, lfs.tfs_message_matched[this->lf_index]);
         lfs.tfs_filter_count[this->lf_index] += 1;
         if (lfs.tfs_message_matched[this->lf_index]) {
             lfs.tfs_filter_hits[this->lf_index] += 1;
@@ -598,6 +619,7 @@ textview_curses::execute_search(const std::string& regex_orig)
             auto gp = std::make_unique<grep_proc<vis_line_t>>(code, *this);
 
             gp->set_sink(this);
+            gp->set_thread_count(search_thread_count());
             auto top = this->get_top();
             if (top < REVERSE_SEARCH_OFFSET) {
                 top = 0_vl;
@@ -619,6 +641,7 @@ textview_curses::execute_search(const std::string& regex_orig)
                         code, *pair.first);
 
                     sgp->set_sink(pair.second);
+                    sgp->set_thread_count(search_thread_count());
                     sgp->queue_request(0_vl);
                     sgp->start();
 
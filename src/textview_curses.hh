@@ -37,6 +37,7 @@
 
 #include "base/func_util.hh"
 #include "base/lnav_log.hh"
+#include "base/compressed_bitmap.hh"
 #include "bookmarks.hh"
 #include "grep_proc.hh"
 #include "highlighter.hh"
@@ -68,7 +69,6 @@ public:
         memset(this->tfs_last_lines_for_message,
                0,
                sizeof(this->tfs_last_lines_for_message));
-        this->tfs_mask.reserve(64 * 1024);
     };
 
     void clear()
@@ -86,7 +86,10 @@ public:
         memset(this->tfs_last_lines_for_message,
                0,
                sizeof(this->tfs_last_lines_for_message));
-        this->tfs_mask.clear();
+        for (auto& matches : this->tfs_matches) {
+            matches.clear();
+        }
+        this->tfs_line_count = 0;
         this->tfs_index.clear();
     };
 
@@ -98,6 +101,7 @@ public:
         this->tfs_lines_for_message[index] = 0;
         this->tfs_last_message_matched[index] = false;
         this->tfs_last_lines_for_message[index] = 0;
+        this->tfs_matches[index].clear();
     };
 
     void clear_deleted_filter_state(uint32_t used_mask)
@@ -107,23 +111,82 @@ public:
                 this->clear_filter_state(lpc);
             }
         }
-        for (size_t lpc = 0; lpc < this->tfs_mask.size(); lpc++) {
-            this->tfs_mask[lpc] &= used_mask;
-        }
     }
 
     void resize(size_t newsize)
     {
-        size_t old_mask_size = this->tfs_mask.size();
-
-        this->tfs_mask.resize(newsize);
-        if (newsize > old_mask_size) {
-            memset(&this->tfs_mask[old_mask_size],
-                   0,
-                   sizeof(uint32_t) * (newsize - old_mask_size));
+        if (newsize < this->tfs_line_count) {
+            for (auto& matches : this->tfs_matches) {
+                matches.truncate(newsize);
+            }
         }
+        this->tfs_line_count = newsize;
     };
 
+    /**
+     * @return A mask with a bit set for each filter that matched the line.
+     */
+    uint32_t line_mask(size_t line) const
+    {
+        uint32_t retval = 0;
+
+        for (int lpc = 0; lpc < MAX_FILTERS; lpc++) {
+            if (this->tfs_matches[lpc].test(line)) {
+                retval |= (1UL << lpc);
+            }
+        }
+
+        return retval;
+    }
+
+    bool excluded(uint32_t filter_in_mask,
+                  uint32_t filter_out_mask,
+                  size_t line) const
+    {
+        bool filtered_in = (filter_in_mask == 0);
+
+        for (auto mask = filter_in_mask; mask != 0 && !filtered_in;
+             mask &= mask - 1)
+        {
+            filtered_in = this->tfs_matches[__builtin_ctz(mask)].test(line);
+        }
+        if (!filtered_in) {
+            return true;
+        }
+        for (auto mask = filter_out_mask; mask != 0; mask &= mask - 1) {
+            if (this->tfs_matches[__builtin_ctz(mask)].test(line)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Compute the lines that are excluded by the given filters for the whole
+     * file at once by combining the match bitmaps of the filters.
+     *
+     * @param excluded_out A word for every 64 lines in the file with the
+     *   bits set for the lines that are excluded.
+     */
+    void excluded_lines(uint32_t filter_in_mask,
+                        uint32_t filter_out_mask,
+                        std::vector<uint64_t>& excluded_out) const
+    {
+        excluded_out.assign((this->tfs_line_count + 63) / 64, 0);
+        if (filter_in_mask != 0) {
+            for (auto mask = filter_in_mask; mask != 0; mask &= mask - 1) {
+                this->tfs_matches[__builtin_ctz(mask)].or_into(excluded_out);
+            }
+            for (auto& word : excluded_out) {
+                word = ~word;
+            }
+        }
+        for (auto mask = filter_out_mask; mask != 0; mask &= mask - 1) {
+            this->tfs_matches[__builtin_ctz(mask)].or_into(excluded_out);
+        }
+    }
+
     const static int MAX_FILTERS = 32;
 
     std::shared_ptr<logfile> tfs_logfile;
@@ -133,7 +196,9 @@ public:
     size_t tfs_lines_for_message[MAX_FILTERS];
     bool tfs_last_message_matched[MAX_FILTERS];
     size_t tfs_last_lines_for_message[MAX_FILTERS];
-    std::vector<uint32_t> tfs_mask;
+    /** The lines that matched each filter. */
+    compressed_bitmap tfs_matches[MAX_FILTERS];
+    size_t tfs_line_count{0};
     std::vector<uint32_t> tfs_index;
 };
 
@@ -207,6 +272,14 @@ public:
                   logfile_const_iterator ll,
                   shared_buffer_ref& line);
 
+    /**
+     * Record the result of calling matches() on a line, for when the
+     * matching was done separately from adding the line.
+     */
+    void add_match(logfile_filter_state& lfs,
+                   logfile_const_iterator ll,
+                   bool match_state);
+
     void end_of_message(logfile_filter_state& lfs);
 
     virtual bool matches(const logfile& lf,
@@ -216,6 +289,25 @@ public:
 
     virtual std::string to_command() const = 0;
 
+    /**
+     * @return True if matches() can be called from more than one thread at
+     *   a time.
+     */
+    virtual bool is_thread_safe() const
+    {
+        return false;
+    }
+
+    /**
+     * @return A string that identifies the lines this filter matches, so
+     *   the results can be reused by another filter with the same key.  An
+     *   empty string means the results should not be reused.
+     */
+    virtual std::string get_cache_key() const
+    {
+        return "";
+    }
+
     bool operator==(const std::string& rhs)
     {
         return this->lf_id == rhs;
@@ -243,6 +335,11 @@ public:
                  shared_buffer_ref& line) override;
 
     std::string to_command() const override;
+
+    bool is_thread_safe() const override
+    {
+        return true;
+    }
 };
 
 class filter_stack {
@@ -514,6 +611,17 @@ public:
                                       line_flags_t raw = 0)
         = 0;
 
+    /**
+     * Get the location of the raw contents of a line in a file so that it
+     * can be searched from another thread, see
+     * grep_proc_source::grep_location_for_line().
+     */
+    virtual nonstd::optional<grep_line_location> text_location_for_line(
+        textview_curses& tc, int line)
+    {
+        return nonstd::nullopt;
+    }
+
     /**
      * Inform the source that the given line has been marked/unmarked.  This
      * callback function can be used to translate between between visible line
@@ -826,6 +934,18 @@ public:
         return retval;
     };
 
+    nonstd::optional<grep_line_location> grep_location_for_line(
+        vis_line_t line)
+    {
+        if (this->tc_sub_source
+            && line < (int) this->tc_sub_source->text_line_count())
+        {
+            return this->tc_sub_source->text_location_for_line(*this, line);
+        }
+
+        return nonstd::nullopt;
+    }
+
     void grep_begin(grep_proc<vis_line_t>& gp,
                     vis_line_t start,
                     vis_line_t stop);
@@ -133,7 +133,7 @@ open_pretty_view()
             auto ll_start = lf->message_start(ll);
             attr_line_t al;
 
-            vl -= vis_line_t(distance(ll_start, ll));
+            vl -= vis_line_t(std::distance(ll_start, ll));
             lss.text_value_for_line(
                 *log_tc,
                 vl,
@@ -421,9 +421,8 @@ execute_examples()
 
                     execute_sql(ec, ex.he_cmd, alt_msg);
 
-                    if (dls.dls_rows.size() == 1 && dls.dls_rows[0].size() == 1)
-                    {
-                        result.append(dls.dls_rows[0][0]);
+                    if (dls.row_count() == 1 && dls.dls_columns.size() == 1) {
+                        result.append(dls.get_cell(0, 0));
                     } else {
                         attr_line_t al;
                         dos.list_value_for_overlay(db_tc, 0, 1, 0_vl, al);
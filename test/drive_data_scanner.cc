@@ -150,7 +150,7 @@ main(int argc, char* argv[])
 
                 auto& root_formats = log_format::get_root_formats();
                 std::vector<std::shared_ptr<log_format>>::iterator iter;
-                std::vector<logline> index;
+                logline_store index;
 
                 if (is_log) {
                     for (iter = root_formats.begin();
@@ -44,11 +44,43 @@ using namespace std;
 
 class my_source : public grep_proc_source<vis_line_t> {
 public:
-    my_source(auto_fd& fd)
+    my_source(auto_fd& fd, bool locate) : ms_locate(locate)
     {
+        if (locate) {
+            this->ms_fd = std::make_shared<auto_fd>(fd.dup());
+        }
         this->ms_buffer.set_fd(fd);
     };
 
+    nonstd::optional<grep_line_location> grep_location_for_line(
+        vis_line_t line_number)
+    {
+        if (!this->ms_locate) {
+            return nonstd::nullopt;
+        }
+
+        try {
+            auto load_result = this->ms_buffer.load_next_line(this->ms_range);
+
+            if (load_result.isOk()) {
+                auto li = load_result.unwrap();
+
+                if (!li.li_file_range.empty()) {
+                    this->ms_range = li.li_file_range;
+                    return grep_line_location{
+                        this->ms_fd, li.li_file_range, li.li_valid_utf};
+                }
+            }
+        } catch (line_buffer::error& e) {
+            fprintf(stderr,
+                    "error: source buffer error %d %s\n",
+                    this->ms_buffer.get_fd(),
+                    strerror(e.e_err));
+        }
+
+        return nonstd::nullopt;
+    }
+
     bool grep_value_for_line(vis_line_t line_number, string& value_out)
     {
         bool retval = false;
@@ -81,6 +113,8 @@ public:
     };
 
 private:
+    bool ms_locate;
+    std::shared_ptr<auto_fd> ms_fd;
     line_buffer ms_buffer;
     file_range ms_range;
 };
@@ -117,30 +151,51 @@ public:
 int
 main(int argc, char* argv[])
 {
-    int retval = EXIT_SUCCESS;
+    int c, retval = EXIT_SUCCESS;
+    size_t thread_count = 0;
+    bool locate = false;
     const char* errptr;
     auto_fd fd;
     pcre* code;
     int eoff;
 
-    if (argc < 3) {
+    while ((c = getopt(argc, argv, "lt:")) != -1) {
+        switch (c) {
+            case 'l':
+                locate = true;
+                break;
+            case 't':
+                thread_count = atoi(optarg);
+                break;
+            default:
+                retval = EXIT_FAILURE;
+                break;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (retval != EXIT_SUCCESS) {
+    } else if (argc < 2) {
         fprintf(stderr, "error: expecting pattern and file arguments\n");
         retval = EXIT_FAILURE;
-    } else if ((fd = open(argv[2], O_RDONLY)) == -1) {
+    } else if ((fd = open(argv[1], O_RDONLY)) == -1) {
         perror("open");
         retval = EXIT_FAILURE;
     } else if ((code
-                = pcre_compile(argv[1], PCRE_CASELESS, &errptr, &eoff, NULL))
+                = pcre_compile(argv[0], PCRE_CASELESS, &errptr, &eoff, NULL))
                == NULL)
     {
         fprintf(stderr, "error: invalid pattern -- %s\n", errptr);
     } else {
-        my_source ms(fd);
+        my_source ms(fd, locate);
         my_sink msink;
 
         grep_proc<vis_line_t> gp(code, ms);
 
         gp.set_sink(&msink);
+        gp.set_thread_count(thread_count);
         gp.queue_request();
         gp.start();
 
@@ -34,6 +34,7 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +49,24 @@
 
 using namespace std;
 
+static volatile sig_atomic_t FORWARDED_SIGNALS = 0;
+
+/**
+ * A SIGBUS handler that is installed before the line_buffer's so that we
+ * can check which signals are forwarded to it.
+ */
+static void
+count_sigbus(int sig, siginfo_t* info, void* context)
+{
+    if (info->si_code > 0) {
+        static const char MSG[] = "error: fault in mapping was forwarded\n";
+
+        write(STDERR_FILENO, MSG, sizeof(MSG) - 1);
+        _exit(EXIT_FAILURE);
+    }
+    FORWARDED_SIGNALS += 1;
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -57,10 +76,18 @@ main(int argc, char* argv[])
     int offseti = 0;
     off_t offset = 0;
     int count = 1000;
+    bool map_file = false, truncate_file = false;
     struct stat st;
 
-    while ((c = getopt(argc, argv, "o:i:n:c:")) != -1) {
+    while ((c = getopt(argc, argv, "o:i:n:c:mt")) != -1) {
         switch (c) {
+            case 'm':
+                map_file = true;
+                break;
+            case 't':
+                map_file = true;
+                truncate_file = true;
+                break;
             case 'o':
                 if (sscanf(optarg, "%d", &offseti) != 1) {
                     fprintf(stderr,
@@ -145,7 +172,43 @@ main(int argc, char* argv[])
             int fd2 = (argc > 1) ? fd_cmp.get() : fd.get();
             assert(fd2 >= 0);
             lb.set_fd(fd);
-            if (index.size() == 0) {
+            if (truncate_file) {
+                struct sigaction sa;
+
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_flags = SA_SIGINFO;
+                sa.sa_sigaction = count_sigbus;
+                sigemptyset(&sa.sa_mask);
+                sigaction(SIGBUS, &sa, nullptr);
+            }
+            if (map_file && !lb.map_file()) {
+                fprintf(stderr, "error: unable to map file\n");
+                return EXIT_FAILURE;
+            }
+            if (truncate_file) {
+                auto read_result = lb.read_range({st.st_size - 1, 1});
+
+                assert(read_result.isOk());
+
+                auto sbr = read_result.unwrap();
+
+                // A signal that is not for a mapping should be passed on to
+                // the previous handler without removing the line_buffer's.
+                raise(SIGBUS);
+                printf("forwarded signals: %d\n", (int) FORWARDED_SIGNALS);
+
+                // Reading the mapping after the truncate should get zeroes
+                // instead of a SIGBUS.
+                assert(truncate(argv[0], 0) == 0);
+                printf("last byte after truncate: %d\n", sbr.get_data()[0]);
+
+                auto load_result = lb.load_next_line({0});
+
+                assert(load_result.isOk());
+                printf("mapped: %d; line size: %d\n",
+                       lb.is_mapped(),
+                       (int) load_result.unwrap().li_file_range.fr_size);
+            } else if (index.size() == 0) {
                 while (count) {
                     auto load_result = lb.load_next_line(last_range);
 
@@ -40,6 +40,7 @@
 #include "base/injector.hh"
 #include "base/opt_util.hh"
 #include "config.h"
+#include "lnav_config.hh"
 #include "log_format.hh"
 #include "log_format_loader.hh"
 #include "logfile.hh"
@@ -66,6 +67,7 @@ main(int argc, char* argv[])
     int c, retval = EXIT_SUCCESS;
     dl_mode_t mode = MODE_NONE;
     string expected_format;
+    bool incremental = false;
 
     {
         static auto builtin_formats
@@ -87,8 +89,21 @@ main(int argc, char* argv[])
         load_formats(paths, errors);
     }
 
-    while ((c = getopt(argc, argv, "ef:ltv")) != -1) {
+    while ((c = getopt(argc, argv, "c:d:ef:ij:ltuv")) != -1) {
         switch (c) {
+            case 'c':
+                lnav_config.lc_logfile.lc_scan_chunk_size = atoll(optarg);
+                break;
+            case 'd':
+                lnav_log_file = make_optional_from_nullable(fopen(optarg, "a"));
+                lnav_log_level = lnav_log_level_t::TRACE;
+                break;
+            case 'i':
+                incremental = true;
+                break;
+            case 'j':
+                lnav_config.lc_logfile.lc_index_threads = atoi(optarg);
+                break;
             case 'f':
                 expected_format = optarg;
                 break;
@@ -101,6 +116,9 @@ main(int argc, char* argv[])
             case 't':
                 mode = MODE_TIMES;
                 break;
+            case 'u':
+                lnav_config.lc_logfile.lc_compact_index = false;
+                break;
             case 'v':
                 mode = MODE_LEVELS;
                 break;
@@ -130,15 +148,24 @@ main(int argc, char* argv[])
         stat(argv[0], &st);
         assert(strcmp(argv[0], lf->get_filename().c_str()) == 0);
 
-        lf->rebuild_index();
-        assert(!lf->is_closed());
-        lf->rebuild_index();
-        assert(!lf->is_closed());
-        lf->rebuild_index();
-        assert(!lf->is_closed());
-        assert(lf->get_activity().la_polls == 3);
-        if (lf->size() > 1) {
-            assert(lf->get_activity().la_reads == 2);
+        if (incremental) {
+            // Index the file a little at a time, like the UI does when it
+            // runs out of time in a pass through the main loop.
+            while (lf->get_index_size() < st.st_size) {
+                lf->rebuild_index(ui_clock::now());
+                assert(!lf->is_closed());
+            }
+        } else {
+            lf->rebuild_index();
+            assert(!lf->is_closed());
+            lf->rebuild_index();
+            assert(!lf->is_closed());
+            lf->rebuild_index();
+            assert(!lf->is_closed());
+            assert(lf->get_activity().la_polls == 3);
+            if (lf->size() > 1) {
+                assert(lf->get_activity().la_reads == 2);
+            }
         }
         if (expected_format.empty()) {
             assert(lf->get_format() == nullptr);
@@ -166,7 +193,7 @@ main(int argc, char* argv[])
                 printf("%zd\n", lf->size());
                 break;
             case MODE_TIMES:
-                for (auto& iter : *lf) {
+                for (const auto& iter : *lf) {
                     if (iter.is_ignored()) {
                         continue;
                     }
@@ -183,7 +210,7 @@ main(int argc, char* argv[])
                 }
                 break;
             case MODE_LEVELS:
-                for (auto& iter : *lf) {
+                for (const auto& iter : *lf) {
                     log_level_t level = iter.get_level_and_flags();
                     printf("%s 0x%x\n",
                            level_names[level & ~LEVEL__FLAGS],
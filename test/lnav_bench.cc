@@ -0,0 +1,796 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "base/auto_mem.hh"
+#include "base/injector.hh"
+#include "config.h"
+#include "fmt/format.h"
+#include "ghc/filesystem.hpp"
+#include "grep_proc.hh"
+#include "lnav_config.hh"
+#include "log_format.hh"
+#include "log_format_loader.hh"
+#include "log_vtab_impl.hh"
+#include "logfile.hh"
+#include "logfile_sub_source.hh"
+#include "sqlite-extension-func.hh"
+#include "textview_curses.hh"
+#include "yajlpp/yajlpp.hh"
+
+/**
+ * Benchmark for the hot paths that are taken when a log file is loaded and
+ * queried.  A synthetic log is generated for each format and then, for
+ * every round:
+ *
+ * - the file is indexed by logfile::rebuild_index(), once on its own and
+ *   once with an observer that needs the content of each line, like a
+ *   filter would;
+ * - the file is added to a logfile_sub_source and it is indexed by
+ *   logfile_sub_source::rebuild_index();
+ * - a filter-out is applied, which runs every line through the
+ *   line_filter_observer for the file;
+ * - the view is searched with a grep_proc, once in a child process and
+ *   once with a pool of threads, and the match counts are compared;
+ * - a few SELECT statements are run against the vtab for the format.
+ *
+ * The fastest time from all the rounds is reported for each step along with
+ * a count that can be used to check that the work done was the same.  The
+ * results are written to the standard output as JSON so that runs from
+ * different versions can be compared.
+ *
+ * usage: lnav_bench [-n <lines>] [-r <rounds>] [-t <threads>]
+ *                   [-f <format>] [-d <dir>]
+ */
+
+int register_collation_functions(sqlite3* db);
+
+namespace {
+
+enum class bench_level {
+    info,
+    warning,
+    error,
+};
+
+struct bench_message {
+    time_t bm_time;
+    int bm_usecs;
+    bench_level bm_level;
+    uint32_t bm_request_id;
+    uint32_t bm_user;
+    uint32_t bm_duration;
+    uint32_t bm_pid;
+};
+
+/**
+ * A small xorshift generator so that the generated logs are the same on
+ * every platform.
+ */
+class bench_random {
+public:
+    uint32_t next()
+    {
+        this->br_state ^= this->br_state << 13;
+        this->br_state ^= this->br_state >> 17;
+        this->br_state ^= this->br_state << 5;
+
+        return this->br_state;
+    }
+
+private:
+    uint32_t br_state{2463534242};
+};
+
+const char*
+status_for(bench_level level)
+{
+    switch (level) {
+        case bench_level::warning:
+            return "retry";
+        case bench_level::error:
+            return "failed";
+        default:
+            return "ok";
+    }
+}
+
+void
+write_syslog(FILE* file, const bench_message& bm)
+{
+    static const char* LEVEL_PREFIXES[] = {"", "warning: ", "error: "};
+
+    char timestamp[64];
+    struct tm tm;
+
+    gmtime_r(&bm.bm_time, &tm);
+    strftime(timestamp, sizeof(timestamp), "%b %e %H:%M:%S", &tm);
+    fmt::print(file,
+               FMT_STRING("{} bench-host appd[{}]: {}request {} from user{} "
+                          "took {}ms status={}\n"),
+               timestamp,
+               bm.bm_pid,
+               LEVEL_PREFIXES[(int) bm.bm_level],
+               bm.bm_request_id,
+               bm.bm_user,
+               bm.bm_duration,
+               status_for(bm.bm_level));
+}
+
+void
+write_access_log(FILE* file, const bench_message& bm)
+{
+    static const int STATUS_CODES[] = {200, 503, 500};
+
+    char timestamp[64];
+    struct tm tm;
+
+    gmtime_r(&bm.bm_time, &tm);
+    strftime(timestamp, sizeof(timestamp), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+    fmt::print(file,
+               FMT_STRING("10.0.{}.{} - - [{}] \"GET /api/request/{}?status={} "
+                          "HTTP/1.1\" {} {} \"-\" \"bench-agent/1.0\"\n"),
+               bm.bm_user / 256,
+               bm.bm_user % 256,
+               timestamp,
+               bm.bm_request_id,
+               status_for(bm.bm_level),
+               STATUS_CODES[(int) bm.bm_level],
+               bm.bm_duration * 10);
+}
+
+void
+write_glog(FILE* file, const bench_message& bm)
+{
+    static const char LEVEL_CHARS[] = {'I', 'W', 'E'};
+
+    char timestamp[64];
+    struct tm tm;
+
+    gmtime_r(&bm.bm_time, &tm);
+    strftime(timestamp, sizeof(timestamp), "%m%d %H:%M:%S", &tm);
+    fmt::print(file,
+               FMT_STRING("{}{}.{:06} {:5} server.cc:{}] request {} from "
+                          "user{} took {}ms status={}\n"),
+               LEVEL_CHARS[(int) bm.bm_level],
+               timestamp,
+               bm.bm_usecs,
+               bm.bm_pid,
+               100 + bm.bm_duration % 400,
+               bm.bm_request_id,
+               bm.bm_user,
+               bm.bm_duration,
+               status_for(bm.bm_level));
+}
+
+void
+write_journald_json(FILE* file, const bench_message& bm)
+{
+    static const int PRIORITIES[] = {6, 4, 3};
+
+    fmt::print(file,
+               FMT_STRING("{{\"__REALTIME_TIMESTAMP\":\"{}{:06}\","
+                          "\"__MONOTONIC_TIMESTAMP\":\"{}\","
+                          "\"_SYSTEMD_UNIT\":\"appd.service\","
+                          "\"SYSLOG_IDENTIFIER\":\"appd\",\"_PID\":\"{}\","
+                          "\"PRIORITY\":\"{}\",\"MESSAGE\":\"request {} from "
+                          "user{} took {}ms status={}\"}}\n"),
+               bm.bm_time,
+               bm.bm_usecs,
+               bm.bm_request_id * 1000,
+               bm.bm_pid,
+               PRIORITIES[(int) bm.bm_level],
+               bm.bm_request_id,
+               bm.bm_user,
+               bm.bm_duration,
+               status_for(bm.bm_level));
+}
+
+struct bench_format {
+    const char* bf_name;
+    void (*bf_writer)(FILE* file, const bench_message& bm);
+};
+
+const bench_format BENCH_FORMATS[] = {
+    {"syslog_log", write_syslog},
+    {"access_log", write_access_log},
+    {"glog_log", write_glog},
+    {"journald_json_log", write_journald_json},
+};
+
+bool
+generate_log(const std::string& path, const bench_format& bf, size_t lines)
+{
+    auto* file = fopen(path.c_str(), "w");
+
+    if (file == nullptr) {
+        return false;
+    }
+
+    bench_random rand;
+    time_t start_time = 1640995200;
+
+    for (size_t index = 0; index < lines; index++) {
+        bench_message bm;
+        auto roll = rand.next() % 100;
+
+        bm.bm_time = start_time + index / 20;
+        bm.bm_usecs = (index % 20) * 50000 + rand.next() % 1000;
+        if (roll < 10) {
+            bm.bm_level = bench_level::error;
+        } else if (roll < 30) {
+            bm.bm_level = bench_level::warning;
+        } else {
+            bm.bm_level = bench_level::info;
+        }
+        bm.bm_request_id = index;
+        bm.bm_user = rand.next() % 1000;
+        bm.bm_duration = rand.next() % 5000;
+        bm.bm_pid = 1000 + rand.next() % 8;
+        bf.bf_writer(file, bm);
+    }
+
+    return fclose(file) == 0;
+}
+
+struct bench_result {
+    std::string br_name;
+    size_t br_lines{0};
+    double br_best{std::numeric_limits<double>::max()};
+    int64_t br_count{0};
+
+    void add_time(std::chrono::steady_clock::duration elapsed)
+    {
+        std::chrono::duration<double> secs = elapsed;
+
+        this->br_best = std::min(this->br_best, secs.count());
+    }
+};
+
+class counting_observer : public logline_observer {
+public:
+    void logline_restart(const logfile& lf, file_size_t rollback_size) override
+    {
+        this->co_lines -= rollback_size;
+    }
+
+    void logline_new_lines(const logfile& lf,
+                           logfile::const_iterator ll_begin,
+                           logfile::const_iterator ll_end,
+                           shared_buffer_ref& sbr) override
+    {
+        this->co_lines += std::distance(ll_begin, ll_end);
+    }
+
+    void logline_eof(const logfile& lf) override {}
+
+    bool logline_needs_content() const override { return true; }
+
+    size_t co_lines{0};
+};
+
+class counting_sink : public grep_proc_sink<vis_line_t> {
+public:
+    void grep_match(grep_proc<vis_line_t>& gp,
+                    vis_line_t line,
+                    int start,
+                    int end) override
+    {
+        this->cs_matches += 1;
+    }
+
+    void grep_end(grep_proc<vis_line_t>& gp) override
+    {
+        this->cs_finished = true;
+    }
+
+    size_t cs_matches{0};
+    bool cs_finished{false};
+};
+
+struct bench_query {
+    const char* bq_name;
+    const char* bq_sql;
+};
+
+/**
+ * The queries to run against the vtab for a format.  The '{table}' string is
+ * replaced with the name of the table and each query must return a single
+ * integer.
+ */
+const bench_query BENCH_QUERIES[] = {
+    {"sql_count", "SELECT count(*) FROM {table}"},
+    {"sql_level",
+     "SELECT count(*) FROM {table} WHERE log_level >= 'warning'"},
+    {"sql_line_range",
+     "SELECT count(*) FROM {table} WHERE log_line BETWEEN {quarter} AND "
+     "{half}"},
+    {"sql_text_like",
+     "SELECT count(*) FROM {table} WHERE log_text LIKE '%status=failed%'"},
+    {"sql_group_by",
+     "SELECT count(*) FROM (SELECT log_level, count(*) FROM {table} GROUP "
+     "BY log_level)"},
+};
+
+const char* FILTER_PATTERN = "status=retry";
+const char* SEARCH_PATTERN = "status=failed";
+
+Result<int64_t, std::string>
+exec_count(sqlite3* db, const std::string& sql)
+{
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+    int64_t retval = 0;
+
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, stmt.out(), nullptr)
+        != SQLITE_OK)
+    {
+        return Err(std::string(sqlite3_errmsg(db)));
+    }
+    if (sqlite3_step(stmt.in()) != SQLITE_ROW) {
+        return Err(std::string(sqlite3_errmsg(db)));
+    }
+    retval = sqlite3_column_int64(stmt.in(), 0);
+
+    return Ok(retval);
+}
+
+pcre*
+compile_pattern(const char* pattern)
+{
+    const char* errptr;
+    int eoff;
+    auto* retval = pcre_compile(pattern, 0, &errptr, &eoff, nullptr);
+
+    if (retval == nullptr) {
+        fprintf(stderr, "error: invalid pattern -- %s\n", errptr);
+        exit(EXIT_FAILURE);
+    }
+    pcre_refcount(retval, 1);
+
+    return retval;
+}
+
+size_t
+run_search(textview_curses& tc, size_t thread_count)
+{
+    counting_sink sink;
+    grep_proc<vis_line_t> gp(compile_pattern(SEARCH_PATTERN), tc);
+
+    gp.set_sink(&sink);
+    gp.set_thread_count(thread_count);
+    gp.queue_request();
+    gp.start();
+    while (!sink.cs_finished) {
+        std::vector<struct pollfd> pollfds;
+
+        gp.update_poll_set(pollfds);
+        poll(&pollfds[0], pollfds.size(), -1);
+
+        gp.check_poll_set(pollfds);
+    }
+
+    return sink.cs_matches;
+}
+
+/**
+ * Run one round of benchmarks against the given file.
+ */
+Result<void, std::string>
+run_round(const std::string& path,
+          const log_format& expected_format,
+          size_t thread_count,
+          std::map<std::string, bench_result>& results)
+{
+    using clock = std::chrono::steady_clock;
+
+    logfile_open_options loo;
+    auto open_res = logfile::open(path, loo);
+
+    if (open_res.isErr()) {
+        return Err(open_res.unwrapErr());
+    }
+
+    auto lf = open_res.unwrap();
+    auto start_time = clock::now();
+
+    while (lf->rebuild_index() != logfile::rebuild_result_t::NO_NEW_LINES) {
+        if (lf->is_closed()) {
+            return Err(std::string("file was closed while indexing"));
+        }
+    }
+    {
+        auto& res = results["logfile_index"];
+
+        res.add_time(clock::now() - start_time);
+        res.br_lines = lf->size();
+        res.br_count = lf->size();
+    }
+    if (lf->get_format() == nullptr
+        || lf->get_format()->get_name() != expected_format.get_name())
+    {
+        return Err(fmt::format(
+            FMT_STRING("file was not detected as {}, found {}"),
+            expected_format.get_name(),
+            lf->get_format() == nullptr ? "no format"
+                                        : lf->get_format()->get_name().get()));
+    }
+
+    {
+        auto observed_res = logfile::open(path, loo);
+
+        if (observed_res.isErr()) {
+            return Err(observed_res.unwrapErr());
+        }
+
+        auto observed_lf = observed_res.unwrap();
+        counting_observer observer;
+
+        observed_lf->set_logline_observer(&observer);
+        start_time = clock::now();
+        while (observed_lf->rebuild_index()
+               != logfile::rebuild_result_t::NO_NEW_LINES)
+        {
+            if (observed_lf->is_closed()) {
+                return Err(std::string("file was closed while indexing"));
+            }
+        }
+
+        auto& res = results["logfile_index_content"];
+
+        res.add_time(clock::now() - start_time);
+        res.br_lines = observed_lf->size();
+        res.br_count = observer.co_lines;
+        if (observer.co_lines != observed_lf->size()) {
+            return Err(fmt::format(
+                FMT_STRING("observer saw {} lines, expected {}"),
+                observer.co_lines,
+                observed_lf->size()));
+        }
+    }
+
+    textview_curses tc;
+    logfile_sub_source lss;
+
+    tc.set_sub_source(&lss);
+    lss.insert_file(lf);
+    start_time = clock::now();
+    lss.rebuild_index();
+    {
+        auto& res = results["lss_index"];
+
+        res.add_time(clock::now() - start_time);
+        res.br_lines = lf->size();
+        res.br_count = lss.text_line_count();
+    }
+
+    {
+        auto& fs = lss.get_filters();
+        auto filter_index = fs.next_index();
+
+        if (!filter_index) {
+            return Err(std::string("no filter slots available"));
+        }
+
+        auto pf = std::make_shared<pcre_filter>(text_filter::EXCLUDE,
+                                                FILTER_PATTERN,
+                                                filter_index.value(),
+                                                compile_pattern(FILTER_PATTERN));
+
+        fs.add_filter(pf);
+        start_time = clock::now();
+        lss.text_filters_changed();
+
+        auto& res = results["filter_out"];
+
+        res.add_time(clock::now() - start_time);
+        res.br_lines = lf->size();
+        res.br_count = lss.text_line_count();
+
+        fs.clear_filters();
+        lss.text_filters_changed();
+    }
+
+    tc.reload_data();
+    {
+        start_time = clock::now();
+        auto fork_matches = run_search(tc, 0);
+        auto& fork_res = results["search_fork"];
+
+        fork_res.add_time(clock::now() - start_time);
+        fork_res.br_lines = lf->size();
+        fork_res.br_count = fork_matches;
+
+        start_time = clock::now();
+        auto matches = run_search(tc, thread_count);
+        auto& res = results["search"];
+
+        res.add_time(clock::now() - start_time);
+        res.br_lines = lf->size();
+        res.br_count = matches;
+
+        if (fork_matches != matches) {
+            return Err(fmt::format(
+                FMT_STRING("search found {} matches in a child process and "
+                           "{} with threads"),
+                fork_matches,
+                matches));
+        }
+    }
+
+    auto_mem<sqlite3> db(sqlite3_close);
+
+    if (sqlite3_open(":memory:", db.out()) != SQLITE_OK) {
+        return Err(std::string("unable to create sqlite memory database"));
+    }
+
+    register_sqlite_funcs(db.in(), sqlite_registration_funcs);
+    register_collation_functions(db.in());
+
+    {
+        log_vtab_manager vtab_manager(db.in(), tc, lss);
+        auto vtab_res
+            = vtab_manager.register_vtab(expected_format.get_vtab_impl());
+
+        if (!vtab_res.empty()) {
+            return Err(vtab_res);
+        }
+
+        for (const auto& bq : BENCH_QUERIES) {
+            auto sql = fmt::format(bq.bq_sql,
+                                   fmt::arg("table", expected_format.get_name()),
+                                   fmt::arg("quarter", lf->size() / 4),
+                                   fmt::arg("half", lf->size() / 2));
+
+            start_time = clock::now();
+            auto count_res = exec_count(db.in(), sql);
+            if (count_res.isErr()) {
+                return Err(fmt::format(FMT_STRING("query {} failed -- {}"),
+                                       bq.bq_name,
+                                       count_res.unwrapErr()));
+            }
+
+            auto& res = results[bq.bq_name];
+
+            res.add_time(clock::now() - start_time);
+            res.br_lines = lf->size();
+            res.br_count = count_res.unwrap();
+        }
+    }
+
+    return Ok();
+}
+
+}  // namespace
+
+int
+main(int argc, char* argv[])
+{
+    int c, retval = EXIT_SUCCESS;
+    size_t lines = 100000;
+    size_t rounds = 3;
+    size_t thread_count;
+    std::vector<std::string> format_names;
+    std::string dir;
+    bool remove_dir = false;
+
+    {
+        static auto builtin_formats
+            = injector::get<std::vector<std::shared_ptr<log_format>>>();
+        auto& root_formats = log_format::get_root_formats();
+
+        log_format::get_root_formats().insert(root_formats.begin(),
+                                              builtin_formats.begin(),
+                                              builtin_formats.end());
+        builtin_formats.clear();
+    }
+
+    {
+        std::vector<lnav::console::user_message> errors;
+        std::vector<ghc::filesystem::path> paths;
+
+        load_formats(paths, errors);
+    }
+
+    lnav_config.lc_logfile.lc_index_cache_min_size
+        = std::numeric_limits<int64_t>::max();
+    thread_count = lnav_config.lc_search.c_threads;
+    if (thread_count == 0) {
+        // The search is compared against a search in a child process, so
+        // use some threads even if the default is to fork.
+        thread_count = 4;
+    }
+
+    while ((c = getopt(argc, argv, "d:f:n:r:t:")) != -1) {
+        switch (c) {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'f':
+                format_names.emplace_back(optarg);
+                break;
+            case 'n':
+                lines = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 't':
+                thread_count = atoi(optarg);
+                break;
+            default:
+                retval = EXIT_FAILURE;
+                break;
+        }
+    }
+
+    if (retval != EXIT_SUCCESS || lines == 0 || rounds == 0) {
+        fprintf(stderr,
+                "usage: lnav_bench [-n <lines>] [-r <rounds>] [-t <threads>] "
+                "[-f <format>] [-d <dir>]\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<const bench_format*> formats;
+
+    for (const auto& bf : BENCH_FORMATS) {
+        if (format_names.empty()
+            || std::find(format_names.begin(), format_names.end(), bf.bf_name)
+                != format_names.end())
+        {
+            formats.push_back(&bf);
+        }
+    }
+    if (formats.size() != format_names.size() && !format_names.empty()) {
+        fprintf(stderr, "error: unknown format, expecting one of:\n");
+        for (const auto& bf : BENCH_FORMATS) {
+            fprintf(stderr, "  %s\n", bf.bf_name);
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (dir.empty()) {
+        auto tmpl = (ghc::filesystem::temp_directory_path()
+                     / "lnav-bench.XXXXXX")
+                        .string();
+
+        if (mkdtemp(&tmpl[0]) == nullptr) {
+            perror("mkdtemp");
+            return EXIT_FAILURE;
+        }
+        dir = tmpl;
+        remove_dir = true;
+    }
+
+    yajlpp_gen gen;
+
+    yajl_gen_config(gen, yajl_gen_beautify, true);
+    {
+        yajlpp_map root_map(gen);
+
+        root_map.gen("version");
+        root_map.gen(PACKAGE_VERSION);
+        root_map.gen("lines");
+        root_map.gen(lines);
+        root_map.gen("rounds");
+        root_map.gen(rounds);
+        root_map.gen("search_threads");
+        root_map.gen(thread_count);
+        root_map.gen("formats");
+
+        yajlpp_array formats_array(gen);
+
+        for (const auto* bf : formats) {
+            auto format = log_format::find_root_format(bf->bf_name);
+            auto path = fmt::format(FMT_STRING("{}/{}.log"), dir, bf->bf_name);
+            std::map<std::string, bench_result> results;
+
+            if (format == nullptr) {
+                fprintf(stderr, "error: unknown format -- %s\n", bf->bf_name);
+                retval = EXIT_FAILURE;
+                break;
+            }
+            if (!generate_log(path, *bf, lines)) {
+                fprintf(stderr,
+                        "error: unable to write log -- %s: %s\n",
+                        path.c_str(),
+                        strerror(errno));
+                retval = EXIT_FAILURE;
+                break;
+            }
+            for (size_t round = 0; round < rounds; round++) {
+                auto round_res
+                    = run_round(path, *format, thread_count, results);
+
+                if (round_res.isErr()) {
+                    fprintf(stderr,
+                            "error: %s -- %s\n",
+                            bf->bf_name,
+                            round_res.unwrapErr().c_str());
+                    retval = EXIT_FAILURE;
+                    break;
+                }
+            }
+            if (retval != EXIT_SUCCESS) {
+                break;
+            }
+
+            yajlpp_map format_map(gen);
+
+            format_map.gen("format");
+            format_map.gen(bf->bf_name);
+            format_map.gen("file_size");
+            format_map.gen(ghc::filesystem::file_size(path));
+            format_map.gen("benchmarks");
+
+            yajlpp_map bench_map(gen);
+
+            for (const auto& res_pair : results) {
+                const auto& res = res_pair.second;
+
+                bench_map.gen(res_pair.first);
+
+                yajlpp_map res_map(gen);
+
+                res_map.gen("count");
+                res_map.gen(res.br_count);
+                res_map.gen("usecs");
+                res_map.gen((int64_t) (res.br_best * 1000000.0));
+                res_map.gen("lines_per_sec");
+                res_map.gen(res.br_best > 0.0
+                                ? (int64_t) (res.br_lines / res.br_best)
+                                : (int64_t) 0);
+            }
+        }
+    }
+
+    if (remove_dir) {
+        ghc::filesystem::remove_all(dir);
+    }
+
+    if (retval == EXIT_SUCCESS) {
+        auto sf = gen.to_string_fragment();
+
+        printf("%.*s\n", sf.length(), sf.data());
+    }
+
+    return retval;
+}
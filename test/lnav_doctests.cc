@@ -34,6 +34,7 @@
 #include "doctest/doctest.h"
 #include "lnav_config.hh"
 #include "lnav_util.hh"
+#include "logline_store.hh"
 #include "relative_time.hh"
 #include "unique_path.hh"
 
@@ -210,3 +211,108 @@ TEST_CASE("user_message to json")
 
     CHECK(json == json2);
 }
+
+static bool
+same_logline(const logline& lhs, const logline& rhs)
+{
+    return lhs.get_offset() == rhs.get_offset()
+        && lhs.get_time() == rhs.get_time()
+        && lhs.get_millis() == rhs.get_millis()
+        && lhs.get_level_and_flags() == rhs.get_level_and_flags()
+        && lhs.get_module_id() == rhs.get_module_id()
+        && lhs.get_opid() == rhs.get_opid()
+        && lhs.get_sub_offset() == rhs.get_sub_offset()
+        && lhs.is_valid_utf() == rhs.is_valid_utf()
+        && lhs.is_expr_marked() == rhs.is_expr_marked()
+        && lhs.get_schema() == rhs.get_schema();
+}
+
+TEST_CASE("logline_store")
+{
+    std::vector<logline> expected;
+    logline_store store;
+    file_off_t off = 0;
+    time_t t = 1600000000;
+
+    store.set_compact(true);
+    srand(1);
+    for (size_t lpc = 0; lpc < 4 * logline_store::BLOCK_SIZE + 10; lpc++) {
+        auto level = (log_level_t) (rand() % LEVEL__MAX);
+
+        if (lpc % 7 == 0) {
+            level = (log_level_t) (level | LEVEL_CONTINUED);
+        }
+        if (lpc == 300) {
+            // a jump back in time that needs a wider column
+            t = -86400;
+        }
+        logline ll(off, t, rand() % 1000, level, lpc % 3, lpc % 64);
+
+        ll.set_sub_offset(lpc % 5 == 0 ? 1 : 0);
+        ll.set_valid_utf(lpc % 11 != 0);
+        ll.set_expr_mark(lpc % 13 == 0);
+        expected.emplace_back(ll);
+        store.push_back(ll);
+        off += 10 + rand() % 500;
+        t += rand() % 3;
+    }
+    store.seal();
+
+    REQUIRE(store.size() == expected.size());
+    for (size_t lpc = 0; lpc < expected.size(); lpc++) {
+        CHECK(same_logline(store[lpc], expected[lpc]));
+    }
+
+    SUBCASE("set")
+    {
+        store[5].set_mark(true);
+        store[5].set_time(expected[5].get_time() + 1000000);
+        CHECK(store[5].is_marked());
+        CHECK(store[5].get_time() == expected[5].get_time() + 1000000);
+        CHECK(same_logline(store[4], expected[4]));
+        CHECK(same_logline(store[6], expected[6]));
+
+        for (auto&& ll : store) {
+            ll.set_expr_mark(true);
+        }
+        for (const auto& ll : store) {
+            CHECK(ll.is_expr_marked());
+        }
+    }
+
+    SUBCASE("back")
+    {
+        store.back().set_millis(999);
+        CHECK(store[store.size() - 1].get_millis() == 999);
+    }
+
+    SUBCASE("pop_back")
+    {
+        while (store.size() > logline_store::BLOCK_SIZE - 1) {
+            store.pop_back();
+            expected.pop_back();
+        }
+        store.push_back(expected.back());
+        expected.push_back(expected.back());
+        REQUIRE(store.size() == expected.size());
+        for (size_t lpc = 0; lpc < expected.size(); lpc++) {
+            CHECK(same_logline(store[lpc], expected[lpc]));
+        }
+    }
+
+    SUBCASE("iterator")
+    {
+        const auto& cstore = store;
+
+        CHECK(std::distance(cstore.begin(), cstore.end()) == store.size());
+        auto iter = std::lower_bound(
+            cstore.begin() + 300, cstore.end(), expected[400].get_time());
+        CHECK(iter->get_time() == expected[400].get_time());
+        CHECK(iter.get_index() <= 400);
+    }
+
+    SUBCASE("memory")
+    {
+        CHECK(store.memory_usage() < expected.size() * sizeof(logline));
+    }
+}
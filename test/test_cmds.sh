@@ -80,6 +80,18 @@ World!"
 EOF
 
 
+run_test ${lnav_test} -n -d /tmp/lnav.err \
+    -c ";SELECT 1 AS c1, 2.50 AS c2, NULL AS c3, 'abc' AS c4 UNION ALL SELECT -42, 1.5e3, NULL, ''" \
+    -c ":write-csv-to -" \
+    "${test_dir}/logfile_access_log.*"
+
+check_output "writing mixed column types to CSV does not work" <<EOF
+c1,c2,c3,c4
+1,2.5,<NULL>,abc
+-42,1500.0,<NULL>,
+EOF
+
+
 run_test ${lnav_test} -n -d /tmp/lnav.err \
     -c ";SELECT 1 AS c1, 'Hello, World!' AS c2" \
     -c ":write-table-to -" \
@@ -400,6 +412,44 @@ check_output "adjust-log-time is not working" <<EOF
 EOF
 
 
+# Lines appended to a file after it has been sorted and merged need to be
+# merged with the lines from the other files.
+access_line() {
+    printf '192.168.202.254 - - [20/Jul/2009:22:59:%s +0000] "GET /%s HTTP/1.0" 200 134 "-" "gPXE/0.9.7"\n' $1 $2
+}
+{ access_line 26 a1; access_line 28 a2; } > merge-append-a.log
+{ access_line 27 b1; access_line 31 b2; } > merge-append-b.log
+access_line 29 a3 > merge-append-new.log
+
+run_test ${lnav_test} -n \
+    -c ":adjust-log-time 2009-07-20T22:59:26" \
+    -c ":shexec cat merge-append-new.log >> merge-append-a.log" \
+    merge-append-a.log \
+    merge-append-b.log
+
+check_output "lines appended to a merged file are out of order" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] "GET /a1 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:27 +0000] "GET /b1 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:28 +0000] "GET /a2 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /a3 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:31 +0000] "GET /b2 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+EOF
+
+# The last line is partial when it is first drawn, so its cached
+# annotations need to be dropped once the rest of it is appended.
+{ access_line 26 a1; access_line 27 a2; } | head -c -22 > annotate-tail.log
+access_line 27 a2 | tail -c 22 > annotate-tail-new.log
+
+run_test ${lnav_test} -n \
+    -c ":write-screen-to annotate-tail.0" \
+    -c ":shexec cat annotate-tail-new.log >> annotate-tail.log" \
+    annotate-tail.log
+
+check_output "cached annotations for the last line were not dropped" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] "GET /a1 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:27 +0000] "GET /a2 HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+EOF
+
 run_test ${lnav_test} -n \
     -c ":goto 1" \
     ${test_dir}/logfile_access_log.0
@@ -633,6 +683,64 @@ Dec  6 13:01:34 ubu-mac dnsmasq[1840]: read /var/lib/libvirt/dnsmasq/default.add
 Dec  6 13:01:34 ubu-mac dnsmasq-dhcp[1840]: read /var/lib/libvirt/dnsmasq/default.hostsfile
 EOF
 
+run_test ${lnav_test} -n \
+    -c ":filter-out avahi" \
+    -c ":delete-filter avahi" \
+    -c ":filter-in avahi" \
+    ${test_dir}/logfile_filter.0
+
+check_output "filter-in after delete-filter is not working" <<EOF
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Joining mDNS multicast group on interface virbr0.IPv4 with address 192.168.122.1.
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: New relevant interface virbr0.IPv4 for mDNS.
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Registering new address record for 192.168.122.1 on virbr0.IPv4.
+EOF
+
+# The results of a deleted filter are kept until it is added back, so lines
+# that are indexed in between still need to be checked.
+cp ${test_dir}/logfile_filter.0 filter-readd.log
+chmod u+w filter-readd.log
+run_test ${lnav_test} -n \
+    -c ":filter-in avahi" \
+    -c ":rebuild" \
+    -c ":delete-filter avahi" \
+    -c ":shexec echo 'Dec  6 13:01:35 ubu-mac avahi-daemon[786]: Appended.' >> filter-readd.log" \
+    -c ":rebuild" \
+    -c ":filter-in avahi" \
+    filter-readd.log
+
+check_output "filter-in after delete-filter in another rebuild is not working" <<EOF
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Joining mDNS multicast group on interface virbr0.IPv4 with address 192.168.122.1.
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: New relevant interface virbr0.IPv4 for mDNS.
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Registering new address record for 192.168.122.1 on virbr0.IPv4.
+Dec  6 13:01:35 ubu-mac avahi-daemon[786]: Appended.
+EOF
+
+# Files that start with the same line share a content ID, but the results of
+# a filter on one of them must not be used for the other.
+cat > filter-same-start-1.log <<EOF
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Joining mDNS multicast group
+Dec  6 13:01:35 ubu-mac dnsmasq[1840]: foo read /etc/hosts
+Dec  6 13:01:36 ubu-mac dnsmasq[1840]: foo read /etc/ethers
+Dec  6 13:01:37 ubu-mac dnsmasq[1840]: bar read /etc/resolv.conf
+EOF
+cat > filter-same-start-2.log <<EOF
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Joining mDNS multicast group
+Dec  6 13:01:38 ubu-mac kernel: bar eth0 up
+EOF
+run_test ${lnav_test} -n \
+    -c ":filter-out foo" \
+    -c ":rebuild" \
+    -c ":delete-filter foo" \
+    -c ":rebuild" \
+    -c ":filter-out foo" \
+    filter-same-start-1.log \
+    filter-same-start-2.log
+
+check_output "filter results were shared by files with the same first line" <<EOF
+Dec  6 13:01:34 ubu-mac avahi-daemon[786]: Joining mDNS multicast group
+Dec  6 13:01:37 ubu-mac dnsmasq[1840]: bar read /etc/resolv.conf
+EOF
+
 
 run_test ${lnav_test} -n \
     -c ":switch-to-view text" \
@@ -1180,6 +1288,44 @@ check_output "histogram is not working?" <<EOF
  Sat Nov 03 09:45:00          1 normal         0 errors         0 warnings         0 marks
 EOF
 
+# Continued lines are not counted in the histogram, so marking one should
+# not count a mark when the marks are recounted for a new zoom level.
+cat > hist-continued.log <<EOF
+Nov  3 09:23:38 veridian automount[7998]: lookup(file): lookup for foobar failed
+    more detail for the lookup
+Nov  3 09:47:02 veridian sudo: timstack : TTY=pts/6 ; COMMAND=/usr/bin/tail
+EOF
+touch -t 200711030923 hist-continued.log
+
+run_test ${lnav_test} -n \
+    -c ":goto 1" \
+    -c ":mark" \
+    -c ":switch-to-view histogram" \
+    -c ":zoom-to 4-hour" \
+    hist-continued.log
+
+check_output "marked continued line is counted in the histogram?" <<EOF
+ Sat Nov 03 08:00:00          1 normal         1 errors         0 warnings         0 marks
+EOF
+
+# The zoomed out buckets are folded from the finest ones, they should follow
+# the filters and marks as they change.
+run_test ${lnav_test} -n \
+    -c ":goto 0" \
+    -c ":mark" \
+    -c ":filter-out sudo" \
+    -c ":switch-to-view histogram" \
+    -c ":zoom-to 1-day" \
+    -c ":switch-to-view log" \
+    -c ":delete-filter sudo" \
+    -c ":switch-to-view histogram" \
+    -c ":zoom-to 4-hour" \
+    ${test_dir}/logfile_syslog.0
+
+check_output "zoomed histogram does not follow the filters?" <<EOF
+ Sat Nov 03 08:00:00          2 normal         2 errors         0 warnings         1 marks
+EOF
+
 run_test ${lnav_test} -n \
     -c ":zoom-to bad" \
     ${test_dir}/logfile_access_log.0
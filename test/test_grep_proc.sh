@@ -13,6 +13,14 @@ grep_capture() {
     ./drive_grep_proc "$1" "$2" 1>/dev/null
 }
 
+grep_slice_threads() {
+    ./drive_grep_proc -t 2 "$1" "$2" | ./slicer "$2"
+}
+
+grep_capture_threads() {
+    ./drive_grep_proc -t 2 "$1" "$2" 1>/dev/null
+}
+
 run_test grep_slice 'Hello' gp.dat
 
 check_output "grep_proc didn't find the right match?" <<EOF
@@ -48,3 +56,49 @@ EOF
 
 check_output "grep_proc didn't capture matches?" <<EOF
 EOF
+
+run_test grep_slice_threads '\w+.' gp.dat
+
+check_output "threaded grep_proc didn't find multiple matches?" <<EOF
+Hello,
+World!
+Goodbye,
+World?
+EOF
+
+run_test grep_capture_threads '(\w+), World' gp.dat
+
+check_error_output "threaded grep_proc didn't capture matches?" <<EOF
+0(0:5)Hello
+1(0:7)Goodbye
+EOF
+
+grep_slice_locate() {
+    ./drive_grep_proc -l -t 2 "$1" "$2" | ./slicer "$2"
+}
+
+run_test grep_slice_locate '\w+.' gp.dat
+
+check_output "threads reading the lines didn't find multiple matches?" <<EOF
+Hello,
+World!
+Goodbye,
+World?
+EOF
+
+# Many chunks of lines are searched at once, the matches should still be
+# passed on in line order.
+seq 1 50000 | sed -e 's/^/line /' > gp-big.dat
+./drive_grep_proc '(\d*)7\d$' gp-big.dat > gp-big-child.tmp 2> gp-big-child.err
+
+run_test ./drive_grep_proc -t 3 '(\d*)7\d$' gp-big.dat
+
+check_output "threaded grep_proc matches are out of order?" < gp-big-child.tmp
+check_error_output "threaded grep_proc captures are out of order?" \
+    < gp-big-child.err
+
+run_test ./drive_grep_proc -l -t 3 '(\d*)7\d$' gp-big.dat
+
+check_output "threads reading the lines are out of order?" < gp-big-child.tmp
+check_error_output "threads reading the lines captured out of order?" \
+    < gp-big-child.err
@@ -57,6 +57,21 @@ check_output "Random reads don't match input?" <<EOF
 All done
 EOF
 
+run_test ./drive_line_buffer -m -i lb.index -n 10 lb-2.dat
+
+check_output "Random reads from a mapped file don't match input?" <<EOF
+All done
+EOF
+
+cp lb-2.dat lb-trunc.dat
+run_test ./drive_line_buffer -t lb-trunc.dat
+
+check_output "Truncating a mapped file is not handled?" <<EOF
+forwarded signals: 1
+last byte after truncate: 0
+mapped: 0; line size: 0
+EOF
+
 gzip -c ${test_dir}/logfile_access_log.1 > lb-double.gz
 gzip -c ${test_dir}/logfile_access_log.1 >> lb-double.gz
 run_test ${lnav_test} -n lb-double.gz
@@ -75,4 +90,123 @@ run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.gz lb-3.dat
 
 check_output "Random gzipped reads don't match input" <<EOF
 All done
-EOF
\ No newline at end of file
+EOF
+
+if [ "$BZIP2_SUPPORT" -eq 1 ] && [ x"$BZIP2_CMD" != x"" ] ; then
+    $BZIP2_CMD -1 -c lb-3.dat > lb-3.bz2
+
+    run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.bz2 lb-3.dat
+
+    check_output "Random bzip2 reads don't match input" <<EOF
+All done
+EOF
+
+    $BZIP2_CMD -1 -c lb-2.dat > lb-double.bz2
+    $BZIP2_CMD -9 -c lb-2.dat >> lb-double.bz2
+    cat lb-2.dat lb-2.dat > lb-double.dat
+    grep -b '$' lb-double.dat | cut -f 1 -d : > lb-double.index
+
+    run_test ./drive_line_buffer -i lb-double.index -n 10 lb-double.bz2 \
+        lb-double.dat
+
+    check_output "Random reads of concatenated bzip2 files don't match input" <<EOF
+All done
+EOF
+fi
+
+if [ "$ZSTD_SUPPORT" -eq 1 ] && [ x"$ZSTD_CMD" != x"" ] ; then
+    $ZSTD_CMD -q -1 -c lb-3.dat > lb-3.zst
+
+    run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.zst lb-3.dat
+
+    check_output "Random zstd reads don't match input" <<EOF
+All done
+EOF
+
+    $ZSTD_CMD -q -1 -c lb-2.dat > lb-double.zst
+    $ZSTD_CMD -q -9 -c lb-2.dat >> lb-double.zst
+    cat lb-2.dat lb-2.dat > lb-double.dat
+    grep -b '$' lb-double.dat | cut -f 1 -d : > lb-double.index
+
+    run_test ./drive_line_buffer -i lb-double.index -n 10 lb-double.zst \
+        lb-double.dat
+
+    check_output "Random reads of concatenated zstd files don't match input" <<EOF
+All done
+EOF
+
+    # Build a file in the zstd seekable format: independent frames followed
+    # by a skippable frame with the seek table.
+    le32() {
+        printf "\\$(printf %03o $(( $1 & 255 )))"
+        printf "\\$(printf %03o $(( ($1 >> 8) & 255 )))"
+        printf "\\$(printf %03o $(( ($1 >> 16) & 255 )))"
+        printf "\\$(printf %03o $(( ($1 >> 24) & 255 )))"
+    }
+
+    head -c 2000000 lb-3.dat > lb-seekable.0
+    tail -c +2000001 lb-3.dat > lb-seekable.1
+    $ZSTD_CMD -q -1 -c lb-seekable.0 > lb-seekable.zst
+    $ZSTD_CMD -q -1 -c lb-seekable.1 >> lb-seekable.zst
+    {
+        le32 $((0x184D2A5E))
+        le32 25
+        le32 $($ZSTD_CMD -q -1 -c lb-seekable.0 | wc -c)
+        le32 $(wc -c < lb-seekable.0)
+        le32 $($ZSTD_CMD -q -1 -c lb-seekable.1 | wc -c)
+        le32 $(wc -c < lb-seekable.1)
+        le32 2
+        printf '\000'
+        le32 $((0x8F92EAB1))
+    } >> lb-seekable.zst
+
+    run_test ./drive_line_buffer -i lb-3.index -n 10 lb-seekable.zst lb-3.dat
+
+    check_output "Random reads of seekable zstd files don't match input" <<EOF
+All done
+EOF
+fi
+
+if [ "$XZ_SUPPORT" -eq 1 ] && [ x"$XZ_CMD" != x"" ] ; then
+    $XZ_CMD -1 --block-size=1MiB -c lb-3.dat > lb-3.xz
+
+    run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.xz lb-3.dat
+
+    check_output "Random xz reads don't match input" <<EOF
+All done
+EOF
+
+    $XZ_CMD -1 -c lb-2.dat > lb-double.xz
+    $XZ_CMD -9 -c lb-2.dat >> lb-double.xz
+    cat lb-2.dat lb-2.dat > lb-double.dat
+    grep -b '$' lb-double.dat | cut -f 1 -d : > lb-double.index
+
+    run_test ./drive_line_buffer -i lb-double.index -n 10 lb-double.xz \
+        lb-double.dat
+
+    check_output "Random reads of concatenated xz files don't match input" <<EOF
+All done
+EOF
+fi
+
+if [ "$LZ4_SUPPORT" -eq 1 ] && [ x"$LZ4_CMD" != x"" ] ; then
+    $LZ4_CMD -q -1 -c lb-3.dat > lb-3.lz4
+
+    run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.lz4 lb-3.dat
+
+    check_output "Random lz4 reads don't match input" <<EOF
+All done
+EOF
+
+    $LZ4_CMD -q -1 -c lb-2.dat > lb-double.lz4
+    $LZ4_CMD -q -9 -c lb-2.dat >> lb-double.lz4
+    cat lb-2.dat lb-2.dat > lb-double.dat
+    grep -b '$' lb-double.dat | cut -f 1 -d : > lb-double.index
+
+    run_test ./drive_line_buffer -i lb-double.index -n 10 lb-double.lz4 \
+        lb-double.dat
+
+    check_output "Random reads of concatenated lz4 files don't match input" <<EOF
+All done
+EOF
+fi
@@ -44,6 +44,93 @@ check_output "truncated log file not detected" <<EOF
 Nov  3 09:23:38 veridian automount[16442]: attempting to mount entry /auto/opt
 EOF
 
+run_test ${lnav_test} -n \
+    -c ':config /tuning/logfile/index-threads 4' \
+    ${srcdir}/logfile_syslog.0
+
+# The formats are only known after the first rebuild, so both files are
+# appended to in one step to have the next rebuild index them in parallel.
+cp ${srcdir}/logfile_access_log.0 parallel-access.0
+cp ${srcdir}/logfile_syslog.0 parallel-syslog.0
+touch -t 200711030923 parallel-syslog.0
+run_test ${lnav_test} -n -d parallel-index.err \
+    -c ":shexec tail -n 1 ${srcdir}/logfile_access_log.0 >> parallel-access.0 && tail -n 1 ${srcdir}/logfile_syslog.0 >> parallel-syslog.0" \
+    -c ';SELECT log_line, log_time, log_level FROM all_logs' \
+    -c ':write-csv-to -' \
+    parallel-access.0 \
+    parallel-syslog.0
+
+check_output "files indexed in parallel are not merged correctly" <<EOF
+log_line,log_time,log_level
+0,2007-11-03 09:23:38.000,error
+1,2007-11-03 09:23:38.000,info
+2,2007-11-03 09:23:38.000,error
+3,2007-11-03 09:47:02.000,info
+4,2007-11-03 09:47:02.000,info
+5,2009-07-20 22:59:26.000,info
+6,2009-07-20 22:59:29.000,error
+7,2009-07-20 22:59:29.000,info
+8,2009-07-20 22:59:29.000,info
+EOF
+
+run_test grep -q "indexing 2 files with" parallel-index.err
+on_error_fail_with "the files were not indexed in parallel?"
+
+# A file that is big enough to be split into chunks.  Every message has
+# continued lines, so they end up at the seams between the chunks.
+awk 'BEGIN {
+    for (lpc = 0; lpc < 20000; lpc++) {
+        printf("Nov  3 %02d:%02d:%02d veridian seq[%d]: message %d\n",
+               int(lpc / 3600), int(lpc / 60) % 60, lpc % 60, lpc, lpc);
+        for (cont = 0; cont <= lpc % 2; cont++) {
+            printf("    continued %d.%d\n", lpc, cont);
+        }
+    }
+}' > parallel-scan.0
+touch -t 200711030923 parallel-scan.0
+rm -f parallel-scan.err parallel-scan-inc.err
+
+for mode in -t -v; do
+    ./drive_logfile -j 1 -u ${mode} -f syslog_log parallel-scan.0 \
+        > parallel-scan.serial
+
+    run_test ./drive_logfile -j 1 ${mode} -f syslog_log parallel-scan.0
+
+    check_output "compacted index does not match ($mode)?" \
+        < parallel-scan.serial
+
+    run_test ./drive_logfile -j 4 -c 131072 -d parallel-scan.err ${mode} \
+        -f syslog_log parallel-scan.0
+
+    check_output "chunks scanned in parallel do not match ($mode)?" \
+        < parallel-scan.serial
+
+    run_test ./drive_logfile -j 4 -c 131072 -d parallel-scan-inc.err -i \
+        ${mode} -f syslog_log parallel-scan.0
+
+    check_output "chunks scanned across rebuilds do not match ($mode)?" \
+        < parallel-scan.serial
+done
+
+run_test grep -q "scanning 4 chunks in parallel" parallel-scan.err
+on_error_fail_with "the file was not split into chunks?"
+
+run_test grep -q "continuing the parallel scan in the next rebuild" \
+    parallel-scan-inc.err
+on_error_fail_with "the parallel scan was not left for the next rebuild?"
+
+run_test grep -c "parallel scan of chunk\|scanning serially" \
+    parallel-scan.err parallel-scan-inc.err
+
+check_output "the chunks were scanned serially?" <<EOF
+parallel-scan.err:0
+parallel-scan-inc.err:0
+EOF
+
+run_test ${lnav_test} -n \
+    -c ':config /tuning/logfile/index-threads 0' \
+    ${srcdir}/logfile_syslog.0
+
 
 if locale -a | grep fr_FR; then
     cp ${srcdir}/logfile_syslog_fr.0 logfile_syslog_fr_test.0
@@ -76,7 +163,8 @@ EOF
 
     rm -rf tmp/lnav-*
     if test x"${XZ_CMD}" != x""; then
-        ${XZ_CMD} -z -c ${srcdir}/logfile_syslog.1 > logfile_syslog.1.xz
+        tar cf - -C ${srcdir} logfile_syslog.1 | \
+            ${XZ_CMD} -z -c > logfile_syslog.1.tar.xz
 
         run_test env TMPDIR=tmp ${lnav_test} -n \
             -c ':config /tuning/archive-manager/min-free-space 1125899906842624' \
@@ -84,7 +172,7 @@ EOF
             ${srcdir}/logfile_syslog.0
 
         run_test env TMPDIR=tmp ${lnav_test} -d /tmp/lnav.err -n \
-            logfile_syslog.1.xz
+            logfile_syslog.1.tar.xz
 
         sed -e "s|lnav-user-[0-9]*-work|lnav-user-NNN-work|g" \
             -e "s|arc-[0-9a-z]*-logfile|arc-NNN-logfile|g" \
@@ -93,8 +181,8 @@ EOF
             `test_err_filename` > test_logfile.big.out
         mv test_logfile.big.out `test_err_filename`
         check_error_output "decompression worked?" <<EOF
-✘ error: unable to open file: /logfile_syslog.1.xz
- reason: available space on disk (NNN) is below the minimum-free threshold (1.0PB).  Unable to unpack 'logfile_syslog.1.xz' to 'tmp/lnav-user-NNN-work/archives/arc-NNN-logfile_syslog.1.xz'
+✘ error: unable to open file: /logfile_syslog.1.tar.xz
+ reason: available space on disk (NNN) is below the minimum-free threshold (1.0PB).  Unable to unpack 'logfile_syslog.1' to 'tmp/lnav-user-NNN-work/archives/arc-NNN-logfile_syslog.1.tar.xz'
 EOF
 
         run_test env TMPDIR=tmp ${lnav_test} -n \
@@ -102,7 +190,7 @@ EOF
             ${srcdir}/logfile_syslog.0
 
         run_test env TMPDIR=tmp ${lnav_test} -n \
-            logfile_syslog.1.xz
+            logfile_syslog.1.tar.xz
 
         check_output "decompression not working" <<EOF
 Dec  3 09:23:38 veridian automount[7998]: lookup(file): lookup for foobar failed
@@ -168,6 +256,64 @@ EOF
  reason: failed to extract 'src/lnav' from archive '/test-logs-trunc.tgz' -- truncated gzip input
 EOF
 
+    run_test env TMPDIR=tmp ${lnav_test} -n \
+        -c ':config /tuning/archive-manager/stream-members true' \
+        ${srcdir}/logfile_syslog.0
+
+    rm -rf tmp/lnav*/archives
+    run_test env TMPDIR=tmp ${lnav_test} -n\
+        -c ';SELECT view_name, basename(filepath), visible FROM lnav_view_files' \
+        test-logs.tgz
+
+    check_output "streamed archive files not loaded correctly" <<EOF
+view_name  basename(filepath)  visible
+log       logfile_access_log.0       1
+log       logfile_access_log.1       1
+EOF
+
+    if test -f tmp/lnav*/archives/*-test-logs.tgz/test/logfile_access_log.0; then
+        echo "streamed archive was unpacked?"
+        exit 1
+    fi
+
+    if test x"${ZIP_CMD}" != x""; then
+        rm -f test-logs.zip
+        (cd ${top_srcdir} && ${ZIP_CMD} -q ${builddir}/test-logs.zip \
+            test/logfile_access_log.0 \
+            test/logfile_access_log.1 \
+            test/logfile_empty.0)
+
+        run_test env TMPDIR=tmp ${lnav_test} -n \
+            -c ';SELECT basename(log_path) AS name, count(*) AS total FROM access_log GROUP BY name' \
+            test-logs.zip
+
+        check_output "streamed zip files not loaded correctly" <<EOF
+        name         total
+logfile_access_log.0     3
+logfile_access_log.1     1
+EOF
+
+        if test -f tmp/lnav*/archives/*-test-logs.zip/test/logfile_access_log.0; then
+            echo "streamed zip was unpacked?"
+            exit 1
+        fi
+    fi
+
+    run_test env TMPDIR=tmp ${lnav_test} -n \
+        test-logs-trunc.tgz
+
+    sed -e "s|${builddir}||g" `test_err_filename` | head -2 \
+        > test_logfile.trunc.out
+    mv test_logfile.trunc.out `test_err_filename`
+    check_error_output "truncated tgz not reported correctly when streamed" <<EOF
+✘ error: unable to open file: /test-logs-trunc.tgz
+ reason: failed to extract 'src/lnav' from archive '/test-logs-trunc.tgz' -- truncated gzip input
+EOF
+
+    run_test env TMPDIR=tmp ${lnav_test} -n \
+        -c ':config /tuning/archive-manager/stream-members false' \
+        ${srcdir}/logfile_syslog.0
+
     mkdir -p rotmp
     chmod ugo-w rotmp
     run_test env TMPDIR=rotmp ${lnav_test} -n test-logs.tgz
@@ -645,6 +791,136 @@ Header2: def
 2014-10-08 16:56:38,344:WARN:foo bar baz
 EOF
 
+# Lines restored from the index cache need to be passed through the filters
+# of a view that the file was already added to.
+rm -rf index-cache-config
+mkdir -p index-cache-config/configs/default
+cat > index-cache-config/configs/default/config.json <<EOF
+{
+    "tuning": {
+        "logfile": {
+            "index-cache-min-size": 1
+        }
+    }
+}
+EOF
+printf 'line one\nline two\nline three\n' > index-cache.txt
+printf 'first file\n' > index-cache-first.txt
+# Keep the cache in a private work directory so that the sidecar files can
+# be found and no cache is left over from an earlier run.
+rm -rf index-cache-tmp index-cache.err
+mkdir index-cache-tmp
+ORIG_TMPDIR="${TMPDIR}"
+export TMPDIR="${builddir}/index-cache-tmp"
+run_test ${lnav_test} -n -I index-cache-config index-cache.txt
+
+run_test ${lnav_test} -n -I index-cache-config -d index-cache.err \
+    -c ":switch-to-view text" \
+    -c ":filter-out two" \
+    -c ":open ${builddir}/index-cache.txt" \
+    -c ":rebuild" \
+    index-cache-first.txt
+
+check_output "lines restored from the index cache were not filtered?" <<EOF
+line one
+line three
+EOF
+
+run_test grep -c "index-cache.txt: restored 3 lines from index cache" \
+    index-cache.err
+
+check_output "the index cache was not used?" <<EOF
+1
+EOF
+
+# A file that is rewritten in place after the cache was saved.  The size
+# stays the same but the lines end in different places.
+printf 'LINE ONE LINE TWO\nLINE THREE\n' > index-cache.txt
+rm -f index-cache.err
+run_test ${lnav_test} -n -I index-cache-config -d index-cache.err \
+    index-cache.txt
+
+check_output "a rewritten file was read from the index cache?" <<EOF
+LINE ONE LINE TWO
+LINE THREE
+EOF
+
+run_test grep -q "index-cache.txt: file content does not match index cache" \
+    index-cache.err
+on_error_fail_with "the rewritten file was not detected?"
+
+run_test grep -c "restored .* from index cache" index-cache.err
+
+check_output "the index cache of a rewritten file was used?" <<EOF
+0
+EOF
+
+# A change to the format definitions invalidates all of the caches.
+mkdir -p index-cache-config/formats/test
+cat > index-cache-config/formats/test/format.json <<'EOF'
+{
+    "$schema": "https://lnav.org/schemas/format-v1.schema.json",
+    "index_cache_test_log": {
+        "regex": {
+            "std": {
+                "pattern": "^(?<timestamp>\\d{4}-\\d{2}-\\d{2}T\\d{2}:\\d{2}:\\d{2}) index-cache (?<body>.*)$"
+            }
+        },
+        "sample": [
+            {
+                "line": "2022-01-01T00:00:00 index-cache hello"
+            }
+        ]
+    }
+}
+EOF
+rm -f index-cache.err
+run_test ${lnav_test} -n -I index-cache-config -d index-cache.err \
+    index-cache.txt
+
+check_output "a changed format definition broke the file?" <<EOF
+LINE ONE LINE TWO
+LINE THREE
+EOF
+
+run_test grep -q "index-cache.txt: index cache is stale" index-cache.err
+on_error_fail_with "the changed format definitions were not detected?"
+
+run_test grep -c "restored .* from index cache" index-cache.err
+
+check_output "the index cache was used after the formats changed?" <<EOF
+0
+EOF
+
+# A damaged sidecar file is ignored.
+for idx in index-cache-tmp/lnav-user-*-work/index-cache/idx-*; do
+    idx_size=$(wc -c < "${idx}")
+    printf 'XXXXXXXXXXXXXXXX' | \
+        dd of="${idx}" bs=1 seek=$((idx_size - 48)) conv=notrunc 2> /dev/null
+done
+rm -f index-cache.err
+run_test ${lnav_test} -n -I index-cache-config -d index-cache.err \
+    index-cache.txt
+
+check_output "a corrupt index cache broke the file?" <<EOF
+LINE ONE LINE TWO
+LINE THREE
+EOF
+
+run_test grep -q "index-cache.txt: index cache is corrupt" index-cache.err
+on_error_fail_with "the corrupt index cache was not detected?"
+
+run_test grep -c "restored .* from index cache" index-cache.err
+
+check_output "a corrupt index cache was used?" <<EOF
+0
+EOF
+
+export TMPDIR="${ORIG_TMPDIR}"
+if test -z "${TMPDIR}"; then
+    unset TMPDIR
+fi
+
 # XXX get this working...
 # run_test ${lnav_test} -n -I ${test_dir} <(cat ${srcdir}/logfile_access_log.0)
 #
@@ -49,6 +49,18 @@ log_line,log_part,log_time,log_idle_msecs,log_level,log_mark,log_comment,log_tag
 2,<NULL>,2015-11-03 09:23:38.000,0,info,0,<NULL>,<NULL>,<NULL>,syslog_log,# is down,506560b3c73dee057732e69a3c666718
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, log_msg_schema FROM all_logs" \
+    -c ":write-csv-to -" \
+    logfile_syslog_test.2
+
+check_output "all_logs schema without the message format does not work?" <<EOF
+log_line,log_msg_schema
+0,aff2bfc3c61e7b86329b83190f0912b3
+1,aff2bfc3c61e7b86329b83190f0912b3
+2,506560b3c73dee057732e69a3c666718
+EOF
+
 
 run_test ${lnav_test} -n \
     -c ";SELECT fields FROM logfmt_log" \
@@ -656,6 +668,46 @@ check_output "range query failed?" <<EOF
 2009-07-20 22:59:29.000
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";select log_line, log_time from access_log where log_time <= '2009-07-20 22:59:29.000'" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "time range query did not include the last time?" <<EOF
+log_line        log_time
+       0 2009-07-20 22:59:26.000
+       1 2009-07-20 22:59:29.000
+       2 2009-07-20 22:59:29.000
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";select log_line, log_time from access_log where log_time > '2009-07-20 22:59:26.000' and log_line < 10" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "time and line range query failed?" <<EOF
+log_line        log_time
+       1 2009-07-20 22:59:29.000
+       2 2009-07-20 22:59:29.000
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";select log_line, log_level from access_log where log_level >= 'warning'" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "level range query failed?" <<EOF
+log_line log_level
+       1 error
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";select log_line, log_level from access_log where log_level = 'info' and log_mark = 0" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "level and mark query failed?" <<EOF
+log_line log_level
+       0 info
+       2 info
+EOF
+
 
 run_test ${lnav_test} -n \
     -c ';select sc_bytes from access_log' \
@@ -1607,3 +1659,64 @@ content
 1.0
 1.0
 EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT sum(sc_bytes) AS total, count(sc_bytes) AS cnt FROM access_log" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_access_log.0
+
+check_output "summing a numeric column is not working?" <<EOF
+total,cnt
+125273,3
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, sc_bytes FROM access_log WHERE log_line > 0" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_access_log.0
+
+check_output "reading a numeric column for a range of lines is not working?" <<EOF
+log_line,sc_bytes
+1,46210
+2,78929
+EOF
+
+# Queries from the SQL prompt run in the interactive loop and are stopped
+# once their results use more memory than the configured limit.  A copy of
+# the log is used so that sessions saved by other tests are not restored.
+# The sessions send each key when lnav asks for input.  Progress counts on
+# the screen can differ between runs, so only the messages have to match.
+rm -rf sql-limit-config
+mkdir -p sql-limit-config/configs/default
+cat > sql-limit-config/configs/default/config.json <<EOF
+{
+    "tuning": {
+        "sql": {
+            "max-result-size": 1
+        }
+    }
+}
+EOF
+
+cp ${test_dir}/logfile_access_log.0 sql-prompt.log
+chmod u+w sql-prompt.log
+rm -f sql-limit.0
+run_test ./scripty -n -a sql-limit.0 -e ${srcdir}/sql_limit_tui.0 -- \
+    ${lnav_test} -I sql-limit-config sql-prompt.log < /dev/null
+
+on_error_log "the SQL prompt screen does not match?"
+
+run_test grep -q "stopped at the result siz" sql-limit.0
+on_error_fail_with "the result size limit did not stop the query?"
+
+# A query that is still running after its first time slice keeps going in
+# the main loop until it is cancelled.  The time of day is fixed in
+# lnav-test, so CTRL-] is sent instead of an Esc that would need to time out.
+rm -f sql-cancel.0
+run_test ./scripty -n -a sql-cancel.0 -e ${srcdir}/sql_cancel_tui.0 -- \
+    ${lnav_test} sql-prompt.log < /dev/null
+
+on_error_log "the cancelled query screen does not match?"
+
+run_test grep -q "query cancelled after" sql-cancel.0
+on_error_fail_with "a pending query was not cancelled?"
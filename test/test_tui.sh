@@ -26,3 +26,60 @@ run_test ./scripty -n -e ${srcdir}/xpath_tui.0 -- \
         ${srcdir}/logfile_xml_msg.0
 
 on_error_log "xpath() fields are not working?"
+
+# The captures above replay recorded input.  These run the interactive loop
+# with commands that write their results to a file and then quit.
+# A copy of the log is used so that sessions saved by other tests are not
+# restored.
+rm -f tui-looper.csv
+cp ${test_dir}/logfile_access_log.0 tui-looper.log
+chmod u+w tui-looper.log
+./scripty -n -- ${lnav_test} \
+    -c ";SELECT count(*) AS total FROM access_log" \
+    -c ":write-csv-to tui-looper.csv" \
+    -c ":quit" \
+    tui-looper.log < /dev/null
+
+run_test cat tui-looper.csv
+
+check_output "the interactive loop does not rescan files?" <<EOF
+total
+3
+EOF
+
+# Lines appended to a watched file after it was indexed should show up.
+# The line is appended by an initial command, so it is already in the file
+# by the time the recorded session asks for the count.
+rm -f tui-looper.csv tui-append.0 tui-append.err
+cp ${test_dir}/logfile_access_log.0 tui-looper.log
+chmod u+w tui-looper.log
+run_test ./scripty -n -a tui-append.0 -e ${srcdir}/append_tui.0 -- \
+    ${lnav_test} -d tui-append.err \
+        -c ":shexec tail -n 1 ${test_dir}/logfile_access_log.0 >> tui-looper.log" \
+        tui-looper.log < /dev/null
+
+on_error_log "the append screen does not match?"
+
+run_test cat tui-looper.csv
+
+check_output "lines appended while running are not picked up?" <<EOF
+total
+4
+EOF
+
+# Polling would also find the new line, so check the debug log to make sure
+# that the file was only read again after the watcher reported the change
+# and that it is skipped once it has been indexed.
+run_test grep -q "change event for file: .*/tui-looper.log" tui-append.err
+on_error_fail_with "the append was not reported by the file watcher?"
+
+sed -n '/change event for file: .*\/tui-looper.log/,$p' tui-append.err \
+    > tui-append-woken.err
+run_test grep -q "new lines for .*/tui-looper.log:4" tui-append-woken.err
+on_error_fail_with "the change event did not wake up the file?"
+
+sed -n '/new lines for .*\/tui-looper.log:4/,$p' tui-append.err \
+    > tui-append-indexed.err
+run_test grep -q "tui-looper.log: skipping rebuild of unchanged watched file" \
+    tui-append-indexed.err
+on_error_fail_with "an unchanged watched file was read again?"